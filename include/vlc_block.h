@@ -621,6 +621,173 @@ static inline void vlc_fifo_Cleanup(void *fifo)
 }
 #define vlc_fifo_CleanupPush(fifo) vlc_cleanup_push(vlc_fifo_Cleanup, fifo)
 
+/**
+ * @}
+ * \defgroup spsc Single-producer single-consumer block queue
+ * Block queue with lock-free queuing and dequeuing
+ *
+ * This queue is meant for high packet rates between two threads, such as
+ * an input thread feeding a decoder thread. Blocks are queued and dequeued
+ * without any lock, and the producer only takes the lock to wake the
+ * consumer up if the later is waiting.
+ *
+ * Only one thread at a time may use the producer functions
+ * (block_SpscPut(), vlc_spsc_Flush(), vlc_spsc_Empty()), and only one thread
+ * at a time the consumer functions (block_SpscGet(), vlc_spsc_Dequeue(),
+ * vlc_spsc_Wait()).
+ * Several threads may take those roles in turn, if and only if they are
+ * synchronized by some other means, e.g. a common mutex.
+ *
+ * The queue also has a lock, and a condition variable, that are used by the
+ * consumer to sleep. They can also protect the callers' state, in the same
+ * way as those of a block FIFO (see vlc_fifo_Lock()).
+ * @{
+ */
+
+/**
+ * Creates a single-producer single-consumer queue of blocks.
+ *
+ * The created queue must be released with block_SpscRelease().
+ *
+ * @return the queue or NULL on memory error
+ */
+VLC_API block_spsc_t *block_SpscNew(void) VLC_USED VLC_MALLOC;
+
+/**
+ * Destroys a queue created by block_SpscNew().
+ *
+ * @note Any queued blocks are also destroyed.
+ * @warning No other threads may be using the queue.
+ */
+VLC_API void block_SpscRelease(block_spsc_t *);
+
+/**
+ * Queues blocks at the end of a queue (producer).
+ *
+ * This function does not block, and only locks the queue if the consumer
+ * waits in vlc_spsc_Wait().
+ *
+ * @param block head of a block list to queue (may be NULL)
+ */
+VLC_API void block_SpscPut(block_spsc_t *, block_t *block);
+
+/**
+ * Dequeues the first block from the queue (consumer). If necessary, waits
+ * until there is one block in the queue. This function is (always)
+ * cancellation point.
+ *
+ * @warning The queue must not be locked by the calling thread.
+ *
+ * @return a valid block
+ */
+VLC_API block_t *block_SpscGet(block_spsc_t *) VLC_USED;
+
+/**
+ * Dequeues the first block from the queue, if any (consumer).
+ *
+ * This function does not block, and the queue can be either locked or
+ * unlocked.
+ *
+ * @return the first block, or NULL if the queue is empty
+ */
+VLC_API block_t *vlc_spsc_Dequeue(block_spsc_t *) VLC_USED;
+
+/**
+ * Discards all currently queued blocks (producer).
+ *
+ * The discarded blocks are not counted anymore. They are released by the
+ * consumer on its next dequeue, or when the queue is released.
+ */
+VLC_API void vlc_spsc_Flush(block_spsc_t *);
+
+/**
+ * Releases all currently queued blocks (producer).
+ *
+ * Unlike vlc_spsc_Flush(), the blocks are released immediately, even if the
+ * consumer does not dequeue anymore.
+ *
+ * @warning The queue must be locked by the calling thread, and the consumer
+ * must only dequeue with the queue locked.
+ */
+VLC_API void vlc_spsc_Empty(block_spsc_t *);
+
+/**
+ * Locks a queue.
+ *
+ * The lock is only needed to wait, to signal and for the callers' state.
+ * Queuing and dequeuing do not require it.
+ */
+VLC_API void vlc_spsc_Lock(block_spsc_t *);
+
+/**
+ * Unlocks a queue.
+ */
+VLC_API void vlc_spsc_Unlock(block_spsc_t *);
+
+/**
+ * Wakes up the consumer waiting in vlc_spsc_Wait().
+ *
+ * @warning The queue must be locked by the calling thread.
+ */
+VLC_API void vlc_spsc_Signal(block_spsc_t *);
+
+/**
+ * Waits on the queue (consumer).
+ *
+ * Atomically unlocks the queue and waits until blocks are queued, or until
+ * vlc_spsc_Signal() is called, then locks the queue again. Blocks queued
+ * since the last dequeue attempt, or since the last wait, wake up the caller.
+ * Spurious wakeups may occur. This function is a cancellation point.
+ *
+ * @warning The queue must be locked by the calling thread.
+ */
+VLC_API void vlc_spsc_Wait(block_spsc_t *);
+
+/**
+ * Waits on another condition variable with the queue lock.
+ *
+ * @warning The queue must be locked by the calling thread.
+ */
+VLC_API void vlc_spsc_WaitCond(block_spsc_t *, vlc_cond_t *);
+
+/**
+ * Timed variant of vlc_spsc_WaitCond().
+ *
+ * @return 0 if woken up, ETIMEDOUT if the deadline was reached
+ * @warning The queue must be locked by the calling thread.
+ */
+VLC_API int vlc_spsc_TimedWaitCond(block_spsc_t *, vlc_cond_t *, mtime_t);
+
+/**
+ * Counts blocks in a queue.
+ *
+ * This can be called from any thread. The value may be outdated as soon as
+ * it is returned, and may transiently include blocks still being queued.
+ *
+ * @return the number of blocks in the queue (zero if it is empty)
+ */
+VLC_API size_t vlc_spsc_GetCount(const block_spsc_t *) VLC_USED;
+
+/**
+ * Counts bytes in a queue.
+ *
+ * This can be called from any thread, see vlc_spsc_GetCount().
+ *
+ * @return the total number of bytes
+ */
+VLC_API size_t vlc_spsc_GetBytes(const block_spsc_t *) VLC_USED;
+
+VLC_USED static inline bool vlc_spsc_IsEmpty(const block_spsc_t *q)
+{
+    return vlc_spsc_GetCount(q) == 0;
+}
+
+static inline void vlc_spsc_Cleanup(void *q)
+{
+    vlc_spsc_Unlock((block_spsc_t *)q);
+}
+#define vlc_spsc_CleanupPush(q) vlc_cleanup_push(vlc_spsc_Cleanup, q)
+
 /** @} */
 
 /** @} */
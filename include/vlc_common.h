@@ -301,6 +301,7 @@ typedef struct iso639_lang_t iso639_lang_t;
 /* block */
 typedef struct block_t      block_t;
 typedef struct block_fifo_t block_fifo_t;
+typedef struct block_spsc_t block_spsc_t;
 
 /* Hashing */
 typedef struct md5_s md5_t;
@@ -323,6 +323,17 @@ enum demux_query_e
     DEMUX_NAV_POPUP,
     /** Activate disc Root Menu. Can fail */
     DEMUX_NAV_MENU,            /* res=can fail */
+
+    /* III. Common queries added later, last for binary compatibility */
+
+    /**
+     * Gets the progress of the seek index being built in the background,
+     * between 0.0 and 1.0. Seeking is exact in the parts already indexed.
+     *
+     * Can fail if the demuxer does not build its index in the background.
+     *
+     * arg1= double * */
+    DEMUX_GET_INDEX_PROGRESS,
 };
 
 /*************************************************************************
@@ -433,6 +444,27 @@ VLC_API decoder_t * demux_PacketizerNew( demux_t *p_demux, es_format_t *p_fmt, c
  */
 VLC_API void demux_PacketizerDestroy( decoder_t *p_packetizer );
 
+/**
+ * Loads a seek index saved by demux_IndexCacheSave() for the same local file.
+ *
+ * The file is identified by its size, modification date and first bytes.
+ * Demuxers that must scan the file to seek precisely use this to skip the
+ * scan the next time the file is opened. The index format is private to the
+ * demuxer, which must validate it like any other input.
+ *
+ * \param psz_name index name, usually the demuxer name
+ * \param pi_size pointer to the index size [OUT]
+ * \return the index data (to be released with free()), or NULL
+ */
+VLC_API void *demux_IndexCacheLoad( demux_t *, const char *psz_name,
+                                    size_t *pi_size ) VLC_USED;
+
+/**
+ * Saves a seek index for the current local file, if caching is enabled.
+ */
+VLC_API int demux_IndexCacheSave( demux_t *, const char *psz_name,
+                                  const void *p_data, size_t i_size );
+
 /* */
 #define DEMUX_INIT_COMMON() do {            \
     p_demux->pf_control = Control;          \
@@ -0,0 +1,109 @@
+/*****************************************************************************
+ * vlc_executor.h: thread pool executing tasks
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_EXECUTOR_H
+# define VLC_EXECUTOR_H 1
+
+/**
+ * @file
+ * This file declares the task executor API.
+ */
+
+/**
+ * @defgroup executor Task executor
+ * @ingroup thread
+ *
+ * An executor runs tasks on a bounded pool of threads, instead of one thread
+ * per task. Each thread has its own queue of pending tasks, and steals tasks
+ * from the queues of the other threads when its own queue is empty.
+ *
+ * Each task runs with its own interruption context (see vlc_interrupt_set()),
+ * so that interruptible functions return early if the task is cancelled.
+ * @{
+ */
+
+typedef struct vlc_executor vlc_executor_t;
+typedef struct vlc_executor_task vlc_executor_task_t;
+
+/** Task priorities, higher priority tasks are dequeued first */
+enum vlc_executor_priority
+{
+    VLC_EXECUTOR_PRIORITY_LOW,
+    VLC_EXECUTOR_PRIORITY_NORMAL,
+    VLC_EXECUTOR_PRIORITY_HIGH,
+};
+
+/**
+ * Creates an executor.
+ *
+ * \param threads number of threads, or zero for the number of CPUs
+ * \return the executor, or NULL on error
+ */
+VLC_API vlc_executor_t *vlc_executor_New(unsigned threads) VLC_USED;
+
+/**
+ * Destroys an executor.
+ *
+ * Pending tasks are cancelled, and running tasks are interrupted. The
+ * function waits for the running tasks to return.
+ */
+VLC_API void vlc_executor_Delete(vlc_executor_t *);
+
+/**
+ * Submits a task.
+ *
+ * \param run function to run from one of the executor threads
+ * \param data parameter for the task function
+ * \param priority task priority (see enum vlc_executor_priority)
+ * \param task [OUT] pointer to a handle for the task, or NULL if the task
+ *             will not be waited for nor cancelled. The handle must be
+ *             released with vlc_executor_Release().
+ * \return VLC_SUCCESS or VLC_ENOMEM
+ */
+VLC_API int vlc_executor_Submit(vlc_executor_t *, void (*run)(void *),
+                                void *data, int priority,
+                                vlc_executor_task_t **task);
+
+/**
+ * Cancels a task.
+ *
+ * If the task is still pending, it is removed from its queue and will never
+ * run. If it is running, its interruption context is killed.
+ *
+ * \return true if the task was removed before it could run
+ */
+VLC_API bool vlc_executor_Cancel(vlc_executor_task_t *);
+
+/**
+ * Waits for a task to complete or to be cancelled.
+ *
+ * \warning A task must not wait for itself.
+ */
+VLC_API void vlc_executor_Wait(vlc_executor_task_t *);
+
+/**
+ * Releases a task handle.
+ *
+ * Releasing the handle does not cancel the task.
+ */
+VLC_API void vlc_executor_Release(vlc_executor_task_t *);
+
+/** @} */
+#endif
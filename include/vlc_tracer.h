@@ -0,0 +1,78 @@
+/*****************************************************************************
+ * vlc_tracer.h: latency tracing
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_TRACER_H
+# define VLC_TRACER_H 1
+
+/**
+ * @file
+ * This file declares the latency tracing API.
+ */
+
+/**
+ * @defgroup tracer Tracing
+ * @ingroup messages
+ *
+ * Spans record how long an operation took, on which thread. Spans of a
+ * thread nest if they are ended in reverse order of their beginning.
+ *
+ * Tracing is enabled with the "trace-file" option. The spans are then saved
+ * to that file in the Chrome trace event format when the LibVLC instance is
+ * destroyed. Otherwise, beginning and ending a span costs next to nothing.
+ * @{
+ */
+
+struct vlc_tracer;
+
+/** Span of time being traced */
+typedef struct vlc_trace_span
+{
+    struct vlc_tracer *tracer; /**< Tracer (or NULL if disabled) */
+    const char *name; /**< Span name */
+    mtime_t start; /**< Beginning date */
+} vlc_trace_span_t;
+
+/**
+ * Begins a span.
+ *
+ * \param span span to initialize
+ * \param name span name (must remain valid until vlc_trace_End())
+ */
+VLC_API void vlc_trace_Begin(vlc_object_t *, vlc_trace_span_t *span,
+                             const char *name);
+#define vlc_trace_Begin(o, s, n) vlc_trace_Begin(VLC_OBJECT(o), s, n)
+
+/**
+ * Ends a span.
+ *
+ * \param detail optional details about the outcome, e.g. the name of the
+ *               selected module (or NULL)
+ */
+VLC_API void vlc_trace_End(vlc_trace_span_t *span, const char *detail);
+
+/**
+ * Records an instantaneous event, such as the display of the first picture.
+ */
+VLC_API void vlc_trace_Mark(vlc_object_t *, const char *name,
+                            const char *detail);
+#define vlc_trace_Mark(o, n, d) vlc_trace_Mark(VLC_OBJECT(o), n, d)
+
+/** @} */
+#endif
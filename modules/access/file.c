@@ -51,6 +51,9 @@
 #else
 #   include <unistd.h>
 #endif
+#ifdef HAVE_MMAP
+#   include <sys/mman.h>
+#endif
 #include <dirent.h>
 
 #include <vlc_common.h>
@@ -64,12 +67,18 @@
 #include <vlc_fs.h>
 #include <vlc_url.h>
 #include <vlc_interrupt.h>
+#include <vlc_block.h>
 
 struct access_sys_t
 {
     int fd;
 
     bool b_pace_control;
+
+    /* Memory-mapped mode */
+    uint64_t offset; /* current position */
+    uint64_t size; /* last known file size */
+    size_t window; /* mapping size, grows while reading sequentially */
 };
 
 #if !defined (_WIN32) && !defined (__OS2__)
@@ -128,8 +137,16 @@ static bool IsRemote (const char *path)
 # define posix_fadvise(fd, off, len, adv)
 #endif
 
+/* Memory-mapped mode window sizes */
+#define MMAP_WINDOW_MIN (64 << 10)
+#define MMAP_WINDOW_MAX (4 << 20)
+
 static ssize_t Read (access_t *, void *, size_t);
 static int FileSeek (access_t *, uint64_t);
+#ifdef HAVE_MMAP
+static block_t *MmapBlock (access_t *, bool *);
+static int MmapSeek (access_t *, uint64_t);
+#endif
 static int NoSeek (access_t *, uint64_t);
 static int FileControl (access_t *, int, va_list);
 
@@ -237,6 +254,21 @@ int FileOpen( vlc_object_t *p_this )
             fcntl (fd, F_RDAHEAD, 0);
         else
             fcntl (fd, F_RDAHEAD, 1);
+#endif
+#ifdef HAVE_MMAP
+        /* Map regular files instead of copying from the page cache. Remote
+         * file systems fail more often, and would then raise SIGBUS. */
+        if (S_ISREG (st.st_mode) && !IsRemote(fd, p_access->psz_filepath)
+         && var_InheritBool (p_access, "file-mmap"))
+        {
+            p_access->pf_read = NULL;
+            p_access->pf_block = MmapBlock;
+            p_access->pf_seek = MmapSeek;
+            p_sys->offset = 0;
+            p_sys->size = st.st_size;
+            p_sys->window = MMAP_WINDOW_MIN;
+            msg_Dbg (p_access, "memory-mapping file");
+        }
 #endif
     }
     else
@@ -259,7 +291,7 @@ void FileClose (vlc_object_t * p_this)
 {
     access_t     *p_access = (access_t*)p_this;
 
-    if (p_access->pf_read == NULL)
+    if (p_access->pf_readdir != NULL)
     {
         DirClose (p_this);
         return;
@@ -309,6 +341,101 @@ static int FileSeek (access_t *p_access, uint64_t i_pos)
     return VLC_SUCCESS;
 }
 
+#ifdef HAVE_MMAP
+/*****************************************************************************
+ * MmapBlock: map the next part of the file
+ *****************************************************************************
+ * The mapping grows from MMAP_WINDOW_MIN to MMAP_WINDOW_MAX as long as the
+ * file is read sequentially, and is reset by seeking. Kernel read-ahead is
+ * adjusted accordingly, and the next part is requested in advance.
+ *****************************************************************************/
+static block_t *MmapBlock (access_t *p_access, bool *restrict eof)
+{
+    access_sys_t *sys = p_access->p_sys;
+
+    if (sys->offset >= sys->size)
+    {   /* The file may be growing */
+        struct stat st;
+
+        if (fstat (sys->fd, &st) == 0)
+            sys->size = st.st_size;
+        if (sys->offset >= sys->size)
+        {
+            *eof = true;
+            return NULL;
+        }
+    }
+
+    const uintptr_t page_mask = sysconf (_SC_PAGESIZE) - 1;
+    uint64_t left = sys->size - sys->offset;
+    size_t length = (left < sys->window) ? left : sys->window;
+    size_t delta = sys->offset & page_mask;
+    off_t base = sys->offset - delta;
+
+    void *addr = mmap (NULL, delta + length, PROT_READ, MAP_SHARED,
+                       sys->fd, base);
+    if (addr == MAP_FAILED)
+    {   /* Fall back to reading */
+        block_t *block = block_Alloc (length);
+        if (unlikely(block == NULL))
+            return NULL;
+
+        ssize_t val = pread (sys->fd, block->p_buffer, length, sys->offset);
+        if (val <= 0)
+        {
+            if (val < 0)
+                msg_Err (p_access, "read error: %s", vlc_strerror_c(errno));
+            block_Release (block);
+            *eof = (val == 0);
+            return NULL;
+        }
+        block->i_buffer = val;
+        sys->offset += val;
+        return block;
+    }
+
+    /* The data will be copied or parsed right away */
+    madvise (addr, delta + length, MADV_WILLNEED);
+
+    /* Pass the mapping as returned by mmap(), so that it is unmapped
+     * as a whole on error and on release */
+    block_t *block = block_mmap_Alloc (addr, delta + length);
+    if (unlikely(block == NULL))
+        return NULL;
+    block->p_buffer += delta;
+    block->i_buffer -= delta;
+    sys->offset += length;
+
+    if (sys->window < MMAP_WINDOW_MAX)
+    {
+        sys->window *= 2;
+        if (sys->window == MMAP_WINDOW_MAX)
+            /* Sequential reading: restore (and extend) kernel read-ahead */
+            posix_fadvise (sys->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    else /* Request the next part while this one is processed */
+        posix_fadvise (sys->fd, sys->offset, sys->window,
+                       POSIX_FADV_WILLNEED);
+
+    return block;
+}
+
+static int MmapSeek (access_t *p_access, uint64_t i_pos)
+{
+    access_sys_t *sys = p_access->p_sys;
+
+    if (i_pos == sys->offset)
+        return VLC_SUCCESS;
+
+    if (sys->window == MMAP_WINDOW_MAX)
+        /* Random access: avoid reading ahead of what is needed */
+        posix_fadvise (sys->fd, 0, 0, POSIX_FADV_RANDOM);
+    sys->window = MMAP_WINDOW_MIN;
+    sys->offset = i_pos;
+    return VLC_SUCCESS;
+}
+#endif
+
 static int NoSeek (access_t *p_access, uint64_t i_pos)
 {
     /* vlc_assert_unreachable(); ?? */
@@ -39,6 +39,10 @@ vlc_module_begin ()
     set_capability( "access", 50 )
     add_shortcut( "file", "fd", "stream" )
     set_callbacks( FileOpen, FileClose )
+    add_bool( "file-mmap", false, N_("Memory-map files"),
+              N_("Read local files through memory mappings rather than "
+                 "copying their data. The files must not be truncated while "
+                 "they are read."), true )
 
     add_submodule()
     set_section( N_("Directory" ), NULL )
@@ -56,6 +56,10 @@ static void Close( vlc_object_t * );
 #define BUFFER_TEXT N_("Receive buffer")
 #define BUFFER_LONGTEXT N_("UDP receive buffer size (bytes)" )
 #define TIMEOUT_TEXT N_("UDP Source timeout (sec)")
+#define BATCH_TEXT N_("Receive batch depth")
+#define BATCH_LONGTEXT N_( \
+    "Maximum number of datagrams dequeued per wake-up. The datagrams are " \
+    "received together into a single block. 1 disables batching." )
 
 vlc_module_begin ()
     set_shortname( N_("UDP" ) )
@@ -66,6 +70,10 @@ vlc_module_begin ()
     add_obsolete_integer( "server-port" ) /* since 2.0.0 */
     add_obsolete_integer( "udp-buffer" ) /* since 3.0.0 */
     add_integer( "udp-timeout", -1, TIMEOUT_TEXT, NULL, true )
+#ifdef HAVE_RECVMMSG
+    add_integer_with_range( "udp-batch", 16, 1, 1024,
+                            BATCH_TEXT, BATCH_LONGTEXT, true )
+#endif
 
     set_capability( "access", 0 )
     add_shortcut( "udp", "udpstream", "udp4", "udp6" )
@@ -78,12 +86,24 @@ struct access_sys_t
     int fd;
     int timeout;
     size_t mtu;
+#ifdef HAVE_RECVMMSG
+    unsigned batch;
+    block_t *slab; /* spare receive buffer, recycled across wake-ups */
+    struct mmsghdr *msgs;
+    struct iovec *iovecs;
+# ifdef SCM_TIMESTAMP
+    char (*cmsgs)[CMSG_SPACE(sizeof (struct timeval))];
+# endif
+#endif
 };
 
 /*****************************************************************************
  * Local prototypes
  *****************************************************************************/
 static block_t *BlockUDP( access_t *, bool * );
+#ifdef HAVE_RECVMMSG
+static block_t *BlockUDPBatch( access_t *, bool * );
+#endif
 static int Control( access_t *, int, va_list );
 
 /*****************************************************************************
@@ -173,6 +193,41 @@ error:
     if( sys->timeout > 0)
         sys->timeout *= 1000;
 
+#ifdef HAVE_RECVMMSG
+    sys->batch = var_InheritInteger( p_access, "udp-batch" );
+    sys->slab = NULL;
+    sys->msgs = NULL;
+    sys->iovecs = NULL;
+# ifdef SCM_TIMESTAMP
+    sys->cmsgs = NULL;
+# endif
+    if( sys->batch > 1 )
+    {
+        sys->msgs = calloc( sys->batch, sizeof (*sys->msgs) );
+        sys->iovecs = calloc( sys->batch, sizeof (*sys->iovecs) );
+# ifdef SCM_TIMESTAMP
+        sys->cmsgs = calloc( sys->batch, sizeof (*sys->cmsgs) );
+        if( unlikely(sys->cmsgs == NULL) )
+            sys->batch = 1;
+        else
+        if( setsockopt( sys->fd, SOL_SOCKET, SO_TIMESTAMP,
+                        &(int){ 1 }, sizeof (int) ) )
+        {   /* dates are optional */
+            free( sys->cmsgs );
+            sys->cmsgs = NULL;
+        }
+# endif
+        if( unlikely(sys->msgs == NULL || sys->iovecs == NULL) )
+            sys->batch = 1;
+    }
+
+    if( sys->batch > 1 )
+    {
+        p_access->pf_block = BlockUDPBatch;
+        msg_Dbg( p_access, "receiving up to %u datagrams per wake-up",
+                 sys->batch );
+    }
+#endif
     return VLC_SUCCESS;
 }
 
@@ -185,6 +240,15 @@ static void Close( vlc_object_t *p_this )
     access_sys_t *sys = p_access->p_sys;
 
     net_Close( sys->fd );
+#ifdef HAVE_RECVMMSG
+    if( sys->slab != NULL )
+        block_Release( sys->slab );
+    free( sys->msgs );
+    free( sys->iovecs );
+# ifdef SCM_TIMESTAMP
+    free( sys->cmsgs );
+# endif
+#endif
     free( sys );
 }
 
@@ -282,3 +346,135 @@ skip:
 
     return pkt;
 }
+
+#ifdef HAVE_RECVMMSG
+# ifdef SCM_TIMESTAMP
+/**
+ * Converts the kernel (wall clock) reception time of a datagram into the
+ * monotonic VLC clock. Returns VLC_TS_INVALID if no timestamp is attached.
+ */
+static mtime_t GetRecvDate(struct msghdr *hdr)
+{
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(hdr);
+         cmsg != NULL;
+         cmsg = CMSG_NXTHDR(hdr, cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET
+         || cmsg->cmsg_type != SCM_TIMESTAMP)
+            continue;
+
+        struct timeval tv;
+        struct timespec now;
+
+        memcpy(&tv, CMSG_DATA(cmsg), sizeof (tv));
+        if (clock_gettime(CLOCK_REALTIME, &now))
+            break;
+
+        mtime_t age = (now.tv_sec - tv.tv_sec) * CLOCK_FREQ
+                    + now.tv_nsec / 1000 - tv.tv_usec;
+        if (age < 0)
+            age = 0;
+        return mdate() - age;
+    }
+    return VLC_TS_INVALID;
+}
+# endif
+
+/*****************************************************************************
+ * BlockUDPBatch: dequeues several datagrams with a single system call
+ *****************************************************************************
+ * The datagrams are received into consecutive MTU-sized slots of one buffer,
+ * then packed back-to-back so that the caller gets a single contiguous block.
+ * The block date is the kernel reception time of the first datagram.
+ *****************************************************************************/
+static block_t *BlockUDPBatch(access_t *access, bool *restrict eof)
+{
+    access_sys_t *sys = access->p_sys;
+    const size_t mtu = sys->mtu;
+    block_t *slab = sys->slab;
+
+    sys->slab = NULL;
+    if (slab == NULL || slab->i_buffer < sys->batch * mtu)
+    {
+        if (slab != NULL)
+            block_Release(slab);
+
+        slab = block_Alloc(sys->batch * mtu);
+        if (unlikely(slab == NULL))
+            return BlockUDP(access, eof);
+    }
+
+    for (unsigned i = 0; i < sys->batch; i++)
+    {
+        struct msghdr *hdr = &sys->msgs[i].msg_hdr;
+
+        sys->iovecs[i].iov_base = slab->p_buffer + i * mtu;
+        sys->iovecs[i].iov_len = mtu;
+        memset(hdr, 0, sizeof (*hdr));
+        hdr->msg_iov = &sys->iovecs[i];
+        hdr->msg_iovlen = 1;
+# ifdef SCM_TIMESTAMP
+        if (sys->cmsgs != NULL)
+        {
+            hdr->msg_control = sys->cmsgs[i];
+            hdr->msg_controllen = sizeof (sys->cmsgs[i]);
+        }
+# endif
+    }
+
+    struct pollfd ufd[1];
+
+    ufd[0].fd = sys->fd;
+    ufd[0].events = POLLIN;
+
+    switch (vlc_poll_i11e(ufd, 1, sys->timeout))
+    {
+        case 0:
+            msg_Err(access, "receive time-out");
+            *eof = true;
+            /* fall through */
+        case -1:
+            goto skip;
+    }
+
+    int count = recvmmsg(sys->fd, sys->msgs, sys->batch,
+                         MSG_DONTWAIT | MSG_TRUNC, NULL);
+    if (count <= 0)
+        goto skip;
+
+    size_t offset = 0;
+    bool corrupted = false;
+
+    for (int i = 0; i < count; i++)
+    {
+        size_t len = sys->msgs[i].msg_len;
+
+        if (sys->msgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+        {
+            msg_Err(access, "%zu bytes packet truncated (MTU was %zu)",
+                    len, mtu);
+            if (len > sys->mtu)
+                sys->mtu = len;
+            len = mtu;
+            corrupted = true;
+        }
+
+        if (offset != i * mtu)
+            memmove(slab->p_buffer + offset, slab->p_buffer + i * mtu, len);
+        offset += len;
+    }
+
+# ifdef SCM_TIMESTAMP
+    if (sys->cmsgs != NULL)
+        slab->i_dts = GetRecvDate(&sys->msgs[0].msg_hdr);
+# endif
+    if (corrupted)
+        slab->i_flags |= BLOCK_FLAG_CORRUPTED;
+    slab->i_buffer = offset;
+    return slab;
+
+skip:
+    sys->slab = slab;
+    return NULL;
+}
+#endif
@@ -46,6 +46,10 @@
 #else
 #   include <sys/socket.h>
 #endif
+#ifdef HAVE_SENDMMSG
+#   include <netinet/in.h>
+#   include <netinet/udp.h>
+#endif
 
 #include <vlc_network.h>
 
@@ -71,6 +75,12 @@ static void Close( vlc_object_t * );
                           "helps reducing the scheduling load on " \
                           "heavily-loaded systems." )
 
+#define BATCH_TEXT N_("Batch size")
+#define BATCH_LONGTEXT N_("Maximum number of packets handed to the kernel " \
+                          "in a single system call. Packets of a group " \
+                          "are sent together once the group is due. " \
+                          "1 disables batching." )
+
 vlc_module_begin ()
     set_description( N_("UDP stream output") )
     set_shortname( "UDP" )
@@ -79,6 +89,10 @@ vlc_module_begin ()
     add_integer( SOUT_CFG_PREFIX "caching", DEFAULT_PTS_DELAY / 1000, CACHING_TEXT, CACHING_LONGTEXT, true )
     add_integer( SOUT_CFG_PREFIX "group", 1, GROUP_TEXT, GROUP_LONGTEXT,
                                  true )
+#ifdef HAVE_SENDMMSG
+    add_integer_with_range( SOUT_CFG_PREFIX "batch", 64, 1, 1024,
+                            BATCH_TEXT, BATCH_LONGTEXT, true )
+#endif
 
     set_capability( "sout access", 0 )
     add_shortcut( "udp" )
@@ -92,6 +106,9 @@ vlc_module_end ()
 static const char *const ppsz_sout_options[] = {
     "caching",
     "group",
+#ifdef HAVE_SENDMMSG
+    "batch",
+#endif
     NULL
 };
 
@@ -108,6 +125,9 @@ static int  Seek    ( sout_access_out_t *, off_t  );
 static int Control( sout_access_out_t *, int, va_list );
 
 static void* ThreadWrite( void * );
+#ifdef HAVE_SENDMMSG
+static void* ThreadWriteBatch( void * );
+#endif
 static block_t *NewUDPPacket( sout_access_out_t *, mtime_t );
 
 struct sout_access_out_sys_t
@@ -120,8 +140,16 @@ struct sout_access_out_sys_t
     block_fifo_t *p_fifo;
     block_fifo_t *p_empty_blocks;
     block_t      *p_buffer;
+    block_t      *p_free; /* recycled packets, owned by the writer */
 
     vlc_thread_t  thread;
+
+#ifdef HAVE_SENDMMSG
+    unsigned        i_batch;
+    bool            b_gso;
+    struct mmsghdr *p_msgs;
+    struct iovec   *p_iovecs;
+#endif
 };
 
 #define DEFAULT_PORT 1234
@@ -213,13 +241,37 @@ static int Open( vlc_object_t *p_this )
     p_sys->p_fifo = block_FifoNew();
     p_sys->p_empty_blocks = block_FifoNew();
     p_sys->p_buffer = NULL;
+    p_sys->p_free = NULL;
+
+    void *(*pf_thread)( void * ) = ThreadWrite;
+#ifdef HAVE_SENDMMSG
+    p_sys->i_batch = var_GetInteger( p_access, SOUT_CFG_PREFIX "batch" );
+    p_sys->p_msgs = NULL;
+    p_sys->p_iovecs = NULL;
+# ifdef UDP_SEGMENT
+    p_sys->b_gso = true;
+# else
+    p_sys->b_gso = false;
+# endif
+    if( p_sys->i_batch > 1 )
+    {
+        p_sys->p_msgs = calloc( p_sys->i_batch, sizeof (*p_sys->p_msgs) );
+        p_sys->p_iovecs = calloc( p_sys->i_batch, sizeof (*p_sys->p_iovecs) );
+        if( likely(p_sys->p_msgs != NULL && p_sys->p_iovecs != NULL) )
+            pf_thread = ThreadWriteBatch;
+    }
+#endif
 
-    if( vlc_clone( &p_sys->thread, ThreadWrite, p_access,
+    if( vlc_clone( &p_sys->thread, pf_thread, p_access,
                            VLC_THREAD_PRIORITY_HIGHEST ) )
     {
         msg_Err( p_access, "cannot spawn sout access thread" );
         block_FifoRelease( p_sys->p_fifo );
         block_FifoRelease( p_sys->p_empty_blocks );
+#ifdef HAVE_SENDMMSG
+        free( p_sys->p_msgs );
+        free( p_sys->p_iovecs );
+#endif
         net_Close (i_handle);
         free (p_sys);
         return VLC_EGENERIC;
@@ -246,6 +298,11 @@ static void Close( vlc_object_t * p_this )
     block_FifoRelease( p_sys->p_empty_blocks );
 
     if( p_sys->p_buffer ) block_Release( p_sys->p_buffer );
+    block_ChainRelease( p_sys->p_free );
+#ifdef HAVE_SENDMMSG
+    free( p_sys->p_msgs );
+    free( p_sys->p_iovecs );
+#endif
 
     net_Close( p_sys->i_handle );
     free( p_sys );
@@ -369,21 +426,36 @@ static block_t *NewUDPPacket( sout_access_out_t *p_access, mtime_t i_dts)
     sout_access_out_sys_t *p_sys = p_access->p_sys;
     block_t *p_buffer;
 
-    while ( block_FifoCount( p_sys->p_empty_blocks ) > MAX_EMPTY_BLOCKS )
+    if( p_sys->p_free == NULL )
     {
-        p_buffer = block_FifoGet( p_sys->p_empty_blocks );
-        block_Release( p_buffer );
+        /* Take back all the packets sent so far in one go, rather than
+         * locking the queue for each packet */
+        vlc_fifo_Lock( p_sys->p_empty_blocks );
+        p_sys->p_free = vlc_fifo_DequeueAllUnlocked( p_sys->p_empty_blocks );
+        vlc_fifo_Unlock( p_sys->p_empty_blocks );
+
+        block_t **pp = &p_sys->p_free;
+        for( unsigned i = 0; *pp != NULL && i < MAX_EMPTY_BLOCKS; i++ )
+            pp = &(*pp)->p_next;
+        block_ChainRelease( *pp );
+        *pp = NULL;
     }
 
-    if( block_FifoCount( p_sys->p_empty_blocks ) == 0 )
+    p_buffer = p_sys->p_free;
+    if( p_buffer == NULL )
     {
         p_buffer = block_Alloc( p_sys->i_mtu );
+        if( unlikely(p_buffer == NULL) )
+            return NULL;
     }
     else
     {
-        p_buffer = block_FifoGet(p_sys->p_empty_blocks );
+        p_sys->p_free = p_buffer->p_next;
+        p_buffer->p_next = NULL;
         p_buffer->i_flags = 0;
         p_buffer = block_Realloc( p_buffer, 0, p_sys->i_mtu );
+        if( unlikely(p_buffer == NULL) )
+            return NULL;
     }
 
     p_buffer->i_dts = i_dts;
@@ -465,3 +537,211 @@ static void* ThreadWrite( void *data )
     }
     return NULL;
 }
+
+#ifdef HAVE_SENDMMSG
+/*****************************************************************************
+ * SendBatch: hand a chain of packets to the kernel
+ *****************************************************************************
+ * Consecutive packets of identical size are coalesced into one message
+ * segmented by the kernel (UDP GSO) when supported.
+ *****************************************************************************/
+#define MAX_GSO_SEGMENTS 64
+
+static void SendBatch( sout_access_out_t *p_access, block_t *p_chain )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+#ifdef UDP_SEGMENT
+    char control[p_sys->i_batch][CMSG_SPACE(sizeof (uint16_t))];
+#endif
+
+retry:;
+    unsigned i_msg = 0, i_iov = 0;
+    size_t i_segment = 0;
+
+    for( block_t *p_pk = p_chain; p_pk != NULL; p_pk = p_pk->p_next )
+    {
+        struct msghdr *hdr = &p_sys->p_msgs[i_msg].msg_hdr;
+
+        /* Only same-sized packets can be segmented by the kernel */
+        if( i_iov == 0 || !p_sys->b_gso || p_pk->i_buffer != i_segment
+         || hdr->msg_iovlen >= MAX_GSO_SEGMENTS
+         || (hdr->msg_iovlen + 1) * i_segment > 65000 )
+        {
+            if( i_iov > 0 )
+                hdr = &p_sys->p_msgs[++i_msg].msg_hdr;
+            memset( hdr, 0, sizeof (*hdr) );
+            hdr->msg_iov = &p_sys->p_iovecs[i_iov];
+            i_segment = p_pk->i_buffer;
+        }
+
+        p_sys->p_iovecs[i_iov].iov_base = p_pk->p_buffer;
+        p_sys->p_iovecs[i_iov].iov_len = p_pk->i_buffer;
+        hdr->msg_iovlen++;
+        i_iov++;
+    }
+    if( i_iov == 0 )
+        return;
+    i_msg++;
+
+#ifdef UDP_SEGMENT
+    for( unsigned i = 0; i < i_msg; i++ )
+    {
+        struct msghdr *hdr = &p_sys->p_msgs[i].msg_hdr;
+
+        if( hdr->msg_iovlen < 2 )
+            continue;
+
+        hdr->msg_control = control[i];
+        hdr->msg_controllen = sizeof (control[i]);
+
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR( hdr );
+        uint16_t segment = hdr->msg_iov[0].iov_len;
+
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof (segment));
+        memcpy( CMSG_DATA(cmsg), &segment, sizeof (segment) );
+    }
+#endif
+
+    for( unsigned i_sent = 0; i_sent < i_msg; )
+    {
+        int val = sendmmsg( p_sys->i_handle, p_sys->p_msgs + i_sent,
+                            i_msg - i_sent, 0 );
+        if( val == -1 )
+        {
+            if( errno == EINTR )
+                continue;
+            if( p_sys->b_gso && i_sent == 0
+             && (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT) )
+            {
+                msg_Dbg( p_access, "UDP segmentation offload unavailable" );
+                p_sys->b_gso = false;
+                goto retry;
+            }
+            msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
+            /* skip the failing message and carry on */
+            val = 1;
+        }
+        i_sent += val;
+    }
+}
+
+static void ReleaseChains( void *data )
+{
+    block_t **pp_chains = data;
+
+    block_ChainRelease( pp_chains[0] );
+    block_ChainRelease( pp_chains[1] );
+}
+
+/*****************************************************************************
+ * ThreadWriteBatch: Write packets on the network by pacing windows.
+ *****************************************************************************
+ * Packets are dequeued all at once. Packets that need not be waited for
+ * (inside a group, or already late) accumulate and are sent together with
+ * the next group boundary, up to the batch size.
+ *****************************************************************************/
+static void* ThreadWriteBatch( void *data )
+{
+    sout_access_out_t *p_access = data;
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    block_fifo_t *p_fifo = p_sys->p_fifo;
+    mtime_t i_date_last = -1;
+    const unsigned i_group = var_GetInteger( p_access,
+                                             SOUT_CFG_PREFIX "group" );
+    mtime_t i_to_send = i_group;
+    unsigned i_dropped_packets = 0;
+
+    /* [0]: packets dequeued but not processed, [1]: packets pending send */
+    block_t *chains[2] = { NULL, NULL };
+    block_t **pp_pending = &chains[1];
+    unsigned i_pending = 0;
+
+    vlc_cleanup_push( ReleaseChains, chains );
+    for (;;)
+    {
+        if( chains[0] == NULL )
+        {
+            vlc_fifo_Lock( p_fifo );
+            vlc_fifo_CleanupPush( p_fifo );
+            while( vlc_fifo_IsEmpty( p_fifo ) )
+                vlc_fifo_Wait( p_fifo );
+            chains[0] = vlc_fifo_DequeueAllUnlocked( p_fifo );
+            vlc_cleanup_pop();
+            vlc_fifo_Unlock( p_fifo );
+        }
+
+        block_t *p_pk = chains[0];
+        mtime_t i_date;
+
+        chains[0] = p_pk->p_next;
+        p_pk->p_next = NULL;
+
+        i_date = p_sys->i_caching + p_pk->i_dts;
+        if( i_date_last > 0 )
+        {
+            if( i_date - i_date_last > 2000000 )
+            {
+                if( !i_dropped_packets )
+                    msg_Dbg( p_access, "mmh, hole (%"PRId64" > 2s) -> drop",
+                             i_date - i_date_last );
+
+                block_FifoPut( p_sys->p_empty_blocks, p_pk );
+
+                i_date_last = i_date;
+                i_dropped_packets++;
+                continue;
+            }
+            else if( i_date - i_date_last < -1000 )
+            {
+                if( !i_dropped_packets )
+                    msg_Dbg( p_access, "mmh, packets in the past (%"PRId64")",
+                             i_date_last - i_date );
+            }
+        }
+        i_date_last = i_date;
+
+        *pp_pending = p_pk;
+        pp_pending = &p_pk->p_next;
+        i_pending++;
+
+        bool b_pace = false;
+        i_to_send--;
+        if( !i_to_send || (p_pk->i_flags & BLOCK_FLAG_CLOCK) )
+        {
+            b_pace = true;
+            i_to_send = i_group;
+        }
+
+        if( i_pending < p_sys->i_batch && chains[0] != NULL
+         && (!b_pace || i_date <= mdate()) )
+            continue; /* more packets can go with this one */
+
+        if( b_pace )
+            mwait( i_date );
+
+        SendBatch( p_access, chains[1] );
+
+        if( i_dropped_packets )
+        {
+            msg_Dbg( p_access, "dropped %i packets", i_dropped_packets );
+            i_dropped_packets = 0;
+        }
+
+        mtime_t i_sent = mdate();
+        if ( i_sent > i_date + 20000 )
+        {
+            msg_Dbg( p_access, "packet has been sent too late (%"PRId64 ")",
+                     i_sent - i_date );
+        }
+
+        block_FifoPut( p_sys->p_empty_blocks, chains[1] );
+        chains[1] = NULL;
+        pp_pending = &chains[1];
+        i_pending = 0;
+    }
+    vlc_cleanup_pop();
+    return NULL;
+}
+#endif
@@ -273,6 +273,13 @@ SegmentChunk * SegmentTracker::getNextChunk(bool switch_allowed,
     {
         curNumber = next;
         next++;
+
+        /* Start requesting the upcoming segment */
+        uint64_t prefetchNumber;
+        segment = rep->getNextSegment(BaseRepresentation::INFOTYPE_MEDIA, next,
+                                      &prefetchNumber, &b_gap);
+        if(segment)
+            segment->prefetch(prefetchNumber, rep, connManager);
     }
 
     return chunk;
@@ -75,6 +75,19 @@ static void Close   (vlc_object_t *);
 #define ADAPT_ACCESS_TEXT N_("Use regular HTTP modules")
 #define ADAPT_ACCESS_LONGTEXT N_("Connect using http access instead of custom http code")
 
+#define ADAPT_THREADS_TEXT N_("Download threads")
+#define ADAPT_THREADS_LONGTEXT N_("Number of segments downloaded concurrently. " \
+                                  "Each stream gets its own share of the threads.")
+
+#define ADAPT_HTTP2_TEXT N_("Use HTTP/2 multiplexing")
+#define ADAPT_HTTP2_LONGTEXT N_("Connect using the core HTTP client, sharing one " \
+                                "(HTTP/2 when available) connection per server " \
+                                "between all segment requests.")
+
+#define ADAPT_PREFETCH_TEXT N_("Segments prefetch window")
+#define ADAPT_PREFETCH_LONGTEXT N_("Number of upcoming segments to request in advance " \
+                                   "from each server. 0 disables prefetching.")
+
 static const AbstractAdaptationLogic::LogicType pi_logics[] = {
                                 AbstractAdaptationLogic::Default,
                                 AbstractAdaptationLogic::Predictive,
@@ -116,6 +129,11 @@ vlc_module_begin ()
         add_integer( "adaptive-height", 0, ADAPT_HEIGHT_TEXT, ADAPT_HEIGHT_TEXT, true )
         add_integer( "adaptive-bw",     250, ADAPT_BW_TEXT,     ADAPT_BW_LONGTEXT,     false )
         add_bool   ( "adaptive-use-access", false, ADAPT_ACCESS_TEXT, ADAPT_ACCESS_LONGTEXT, true );
+        add_integer_with_range( "adaptive-download-threads", 2, 1, 16,
+                                ADAPT_THREADS_TEXT, ADAPT_THREADS_LONGTEXT, true )
+        add_bool   ( "adaptive-http2", false, ADAPT_HTTP2_TEXT, ADAPT_HTTP2_LONGTEXT, true )
+        add_integer_with_range( "adaptive-prefetch", 2, 0, 8,
+                                ADAPT_PREFETCH_TEXT, ADAPT_PREFETCH_LONGTEXT, true )
         set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -277,9 +277,12 @@ bool HTTPChunkBufferedSource::isDone() const
 
 void HTTPChunkBufferedSource::bufferize(size_t readsize)
 {
-    vlc_mutex_lock(&lock);
+    /* Only the downloader calls this, one worker at a time per source.
+     * The request is sent without holding the lock so that readers
+     * don't block on the network. */
     if(!prepare())
     {
+        vlc_mutex_lock(&lock);
         done = true;
         eof = true;
         vlc_cond_signal(&avail);
@@ -287,6 +290,7 @@ void HTTPChunkBufferedSource::bufferize(size_t readsize)
         return;
     }
 
+    vlc_mutex_lock(&lock);
     if(readsize < HTTPChunkSource::CHUNK_SIZE)
         readsize = HTTPChunkSource::CHUNK_SIZE;
 
@@ -26,36 +26,44 @@
 #include <vlc_threads.h>
 #include <vlc_atomic.h>
 
+#include <algorithm>
+
 using namespace adaptive::http;
 
-Downloader::Downloader()
+Downloader::Downloader(unsigned threadcount_)
 {
     vlc_mutex_init(&lock);
     vlc_cond_init(&waitcond);
+    vlc_cond_init(&updatedcond);
     killed = false;
-    thread_handle_valid = false;
+    threadcount = threadcount_ ? threadcount_ : 1;
 }
 
 bool Downloader::start()
 {
-    if(!thread_handle_valid &&
-       vlc_clone(&thread_handle, downloaderThread,
-                 reinterpret_cast<void *>(this), VLC_THREAD_PRIORITY_INPUT))
+    while(threads.size() < threadcount)
     {
-        return false;
+        vlc_thread_t thread_handle;
+        if(vlc_clone(&thread_handle, downloaderThread,
+                     reinterpret_cast<void *>(this), VLC_THREAD_PRIORITY_INPUT))
+            break;
+        threads.push_back(thread_handle);
     }
-    thread_handle_valid = true;
-    return true;
+    return !threads.empty();
 }
 
 Downloader::~Downloader()
 {
+    vlc_mutex_lock(&lock);
     killed = true;
-    vlc_cond_signal(&waitcond);
-    if(thread_handle_valid)
-        vlc_join(thread_handle, NULL);
-    vlc_mutex_destroy(&lock);
+    vlc_cond_broadcast(&waitcond);
+    vlc_mutex_unlock(&lock);
+    std::vector<vlc_thread_t>::const_iterator it;
+    for(it = threads.begin(); it != threads.end(); ++it)
+        vlc_join(*it, NULL);
+    vlc_cond_destroy(&updatedcond);
     vlc_cond_destroy(&waitcond);
+    vlc_mutex_destroy(&lock);
 }
 void Downloader::schedule(HTTPChunkBufferedSource *source)
 {
@@ -69,6 +77,9 @@ void Downloader::cancel(HTTPChunkBufferedSource *source)
 {
     vlc_mutex_lock(&lock);
     chunks.remove(source);
+    /* source can't be released while a worker still reads into it */
+    while(isDownloading(source))
+        vlc_cond_wait(&updatedcond, &lock);
     vlc_mutex_unlock(&lock);
 }
 
@@ -87,31 +98,69 @@ void Downloader::DownloadSource(HTTPChunkBufferedSource *source)
         source->bufferize(HTTPChunkSource::CHUNK_SIZE);
 }
 
+bool Downloader::isDownloading(const HTTPChunkBufferedSource *source) const
+{
+    return std::find(downloading.begin(), downloading.end(), source) != downloading.end();
+}
+
+HTTPChunkBufferedSource * Downloader::getNextSource() const
+{
+    /* Prefer sources from streams no other worker is serving,
+     * so that each stream (audio, video...) progresses on its own */
+    HTTPChunkBufferedSource *fallback = NULL;
+    std::list<HTTPChunkBufferedSource *>::const_iterator it;
+    for(it = chunks.begin(); it != chunks.end(); ++it)
+    {
+        HTTPChunkBufferedSource *source = *it;
+        if(isDownloading(source))
+            continue;
+
+        bool b_streambusy = false;
+        std::list<HTTPChunkBufferedSource *>::const_iterator it2;
+        for(it2 = downloading.begin(); it2 != downloading.end(); ++it2)
+            b_streambusy |= ((*it2)->sourceid == source->sourceid);
+
+        if(!b_streambusy)
+            return source;
+        if(!fallback)
+            fallback = source;
+    }
+    return fallback;
+}
+
 void Downloader::Run()
 {
+    vlc_mutex_lock(&lock);
     while(1)
     {
-        vlc_mutex_lock(&lock);
-        if(killed)
-            break;
+        HTTPChunkBufferedSource *source;
 
-        while(chunks.empty() && !killed)
-        {
+        while(!killed && (source = getNextSource()) == NULL)
             vlc_cond_wait(&waitcond, &lock);
-        }
 
         if(killed)
             break;
 
-        if(!chunks.empty())
+        downloading.push_back(source);
+        vlc_mutex_unlock(&lock);
+
+        /* No lock held during I/O */
+        DownloadSource(source);
+
+        vlc_mutex_lock(&lock);
+        downloading.remove(source);
+        std::list<HTTPChunkBufferedSource *>::iterator it =
+                std::find(chunks.begin(), chunks.end(), source);
+        if(it != chunks.end())
         {
-            HTTPChunkBufferedSource *source = chunks.front();
-            DownloadSource(source);
-            if(source->isDone())
-                chunks.pop_front();
+            /* Round robin between sources */
+            chunks.erase(it);
+            if(!source->isDone())
+                chunks.push_back(source);
         }
-
-        vlc_mutex_unlock(&lock);
+        vlc_cond_broadcast(&updatedcond);
+        if(!chunks.empty())
+            vlc_cond_signal(&waitcond);
     }
     vlc_mutex_unlock(&lock);
 }
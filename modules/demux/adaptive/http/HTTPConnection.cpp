@@ -29,6 +29,14 @@
 #include <cstdio>
 #include <sstream>
 #include <vlc_stream.h>
+#include <vlc_block.h>
+
+extern "C"
+{
+    #include "../../../access/http/connmgr.h"
+    #include "../../../access/http/message.h"
+    #include "../../../access/http/resource.h"
+}
 
 using namespace adaptive::http;
 
@@ -459,6 +467,203 @@ void StreamUrlConnection::setUsed( bool b )
        reset();
 }
 
+namespace adaptive
+{
+    namespace http
+    {
+        /* vlc_http_res_get_status() passes the memory following the
+         * resource as opaque data to the callbacks */
+        class LibVLCHTTPSource
+        {
+            public:
+                struct vlc_http_resource resource;
+                struct range_s
+                {
+                    bool   b_range;
+                    size_t start;
+                    size_t end;
+                } range;
+        };
+    }
+}
+
+static int LibVLCHTTPRequestFormat(const struct vlc_http_resource *,
+                                   struct vlc_http_msg *req, void *opaque)
+{
+    const LibVLCHTTPSource::range_s *range =
+            static_cast<const LibVLCHTTPSource::range_s *>(opaque);
+
+    vlc_http_msg_add_header(req, "Cache-Control", "no-cache");
+    if(!range->b_range)
+        return 0;
+    if(range->end)
+        return vlc_http_msg_add_header(req, "Range", "bytes=%zu-%zu",
+                                       range->start, range->end);
+    return vlc_http_msg_add_header(req, "Range", "bytes=%zu-", range->start);
+}
+
+static int LibVLCHTTPResponseValidate(const struct vlc_http_resource *,
+                                      const struct vlc_http_msg *resp, void *opaque)
+{
+    const LibVLCHTTPSource::range_s *range =
+            static_cast<const LibVLCHTTPSource::range_s *>(opaque);
+    int status = vlc_http_msg_get_status(resp);
+
+    if(status < 200 || status >= 300)
+        return -1;
+    /* A server ignoring the range would send us the wrong bytes */
+    if(range->b_range && range->start > 0 && status != 206)
+        return -1;
+    return 0;
+}
+
+static const struct vlc_http_resource_cbs LibVLCHTTPCallbacks =
+{
+    LibVLCHTTPRequestFormat,
+    LibVLCHTTPResponseValidate,
+};
+
+LibVLCHTTPConnection::LibVLCHTTPConnection(vlc_object_t *p_object_,
+                                           struct vlc_http_mgr *mgr,
+                                           vlc_mutex_t *lock)
+    : AbstractConnection(p_object_)
+{
+    source = NULL;
+    p_block = NULL;
+    http_mgr = mgr;
+    mgr_lock = lock;
+    psz_useragent = var_InheritString(p_object_, "http-user-agent");
+}
+
+LibVLCHTTPConnection::~LibVLCHTTPConnection()
+{
+    reset();
+    free(psz_useragent);
+}
+
+void LibVLCHTTPConnection::reset()
+{
+    if(p_block)
+        block_Release(p_block);
+    p_block = NULL;
+    if(source)
+    {
+        /* closes, or resets if unfinished, the underlying HTTP stream */
+        vlc_http_res_destroy(&source->resource);
+        source = NULL;
+    }
+    bytesRead = 0;
+    contentLength = 0;
+    bytesRange = BytesRange();
+}
+
+bool LibVLCHTTPConnection::canReuse(const ConnectionParams &params_) const
+{
+    return ( available &&
+             params.getHostname() == params_.getHostname() &&
+             params.getScheme() == params_.getScheme() &&
+             params.getPort() == params_.getPort() );
+}
+
+int LibVLCHTTPConnection::request(const std::string &path, const BytesRange &range)
+{
+    reset();
+
+    /* Set new path for this query */
+    params.setPath(path);
+
+    msg_Dbg(p_object, "Retrieving %s @%zu", params.getUrl().c_str(),
+                      range.isValid() ? range.getStartByte() : 0);
+
+    /* vlc_http_res_destroy() will free() it */
+    source = static_cast<LibVLCHTTPSource *>(malloc(sizeof(*source)));
+    if(!source)
+        return VLC_ENOMEM;
+
+    static_assert(offsetof(LibVLCHTTPSource, range) == sizeof(struct vlc_http_resource),
+                  "range must follow the resource");
+
+    if(vlc_http_res_init(&source->resource, &LibVLCHTTPCallbacks, http_mgr,
+                         params.getUrl().c_str(), psz_useragent, NULL))
+    {
+        free(source);
+        source = NULL;
+        return VLC_EGENERIC;
+    }
+
+    source->range.b_range = range.isValid();
+    source->range.start = range.getStartByte();
+    source->range.end = range.getEndByte();
+
+    /* The manager is not reentrant: serialize sending requests.
+     * Responses bodies are read without the lock. */
+    vlc_mutex_lock(mgr_lock);
+    int status = vlc_http_res_get_status(&source->resource);
+    vlc_mutex_unlock(mgr_lock);
+    if(status < 200 || status >= 300)
+    {
+        reset();
+        return VLC_EGENERIC;
+    }
+
+    uintmax_t size = vlc_http_msg_get_size(source->resource.response);
+    if(size != (uintmax_t)-1)
+        contentLength = size;
+    if(range.isValid() && range.getEndByte() > 0)
+    {
+        const size_t rangeLength = range.getEndByte() - range.getStartByte() + 1;
+        if(!contentLength || contentLength > rangeLength)
+            contentLength = rangeLength;
+        bytesRange = range;
+    }
+
+    return VLC_SUCCESS;
+}
+
+ssize_t LibVLCHTTPConnection::read(void *p_buffer, size_t len)
+{
+    if(!source)
+        return VLC_EGENERIC;
+
+    if(contentLength && len > contentLength - bytesRead)
+        len = contentLength - bytesRead;
+
+    size_t total = 0;
+    while(total < len)
+    {
+        if(!p_block)
+        {
+            block_t *block = vlc_http_res_read(&source->resource);
+            if(block == vlc_http_error)
+                return (total > 0) ? (ssize_t) total : -1;
+            if(block == NULL)
+                break; /* end of stream */
+            p_block = block;
+        }
+
+        size_t copy = __MIN(p_block->i_buffer, len - total);
+        memcpy(static_cast<uint8_t *>(p_buffer) + total, p_block->p_buffer, copy);
+        p_block->p_buffer += copy;
+        p_block->i_buffer -= copy;
+        total += copy;
+        if(p_block->i_buffer == 0)
+        {
+            block_Release(p_block);
+            p_block = NULL;
+        }
+    }
+
+    bytesRead += total;
+    return total;
+}
+
+void LibVLCHTTPConnection::setUsed( bool b )
+{
+    available = !b;
+    if(available)
+        reset();
+}
+
 ConnectionFactory::ConnectionFactory()
 {
 }
@@ -496,3 +701,41 @@ AbstractConnection * StreamUrlConnectionFactory::createConnection(vlc_object_t *
 {
     return new (std::nothrow) StreamUrlConnection(p_object);
 }
+
+LibVLCHTTPConnectionFactory::LibVLCHTTPConnectionFactory()
+{
+    vlc_mutex_init(&lock);
+}
+
+LibVLCHTTPConnectionFactory::~LibVLCHTTPConnectionFactory()
+{
+    std::map<std::string, struct vlc_http_mgr *>::const_iterator it;
+    for(it = managers.begin(); it != managers.end(); ++it)
+        vlc_http_mgr_destroy((*it).second);
+    vlc_mutex_destroy(&lock);
+}
+
+AbstractConnection * LibVLCHTTPConnectionFactory::createConnection(vlc_object_t *p_object,
+                                                                   const ConnectionParams &params)
+{
+    if((params.getScheme() != "http" && params.getScheme() != "https") || params.getHostname().empty())
+        return NULL;
+
+    std::stringstream origin;
+    origin << params.getScheme() << "://" << params.getHostname() << ":" << params.getPort();
+
+    vlc_mutex_locker locker(&lock);
+
+    struct vlc_http_mgr *mgr;
+    std::map<std::string, struct vlc_http_mgr *>::const_iterator it = managers.find(origin.str());
+    if(it == managers.end())
+    {
+        mgr = vlc_http_mgr_create(p_object, NULL, var_InheritBool(p_object, "http2"));
+        if(!mgr)
+            return NULL;
+        managers[origin.str()] = mgr;
+    }
+    else mgr = (*it).second;
+
+    return new (std::nothrow) LibVLCHTTPConnection(p_object, mgr, &lock);
+}
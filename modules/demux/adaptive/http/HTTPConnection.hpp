@@ -29,6 +29,9 @@
 #include "BytesRange.hpp"
 #include <vlc_common.h>
 #include <string>
+#include <map>
+
+struct vlc_http_mgr;
 
 namespace adaptive
 {
@@ -119,6 +122,34 @@ namespace adaptive
                 stream_t *p_streamurl;
        };
 
+       class LibVLCHTTPSource;
+
+       /* Requests through the core HTTP client (modules/access/http).
+        * Requests to the same origin share one vlc_http_mgr, and therefore
+        * one HTTP/2 connection when the server supports it. */
+       class LibVLCHTTPConnection : public AbstractConnection
+       {
+            public:
+                LibVLCHTTPConnection(vlc_object_t *, struct vlc_http_mgr *,
+                                     vlc_mutex_t *);
+                virtual ~LibVLCHTTPConnection();
+
+                virtual bool    canReuse     (const ConnectionParams &) const;
+
+                virtual int     request     (const std::string& path, const BytesRange & = BytesRange());
+                virtual ssize_t read        (void *p_buffer, size_t len);
+
+                virtual void    setUsed( bool );
+
+            protected:
+                void reset();
+                LibVLCHTTPSource *source;
+                block_t *p_block; /* partially consumed data */
+                struct vlc_http_mgr *http_mgr; /* shared per origin, not owned */
+                vlc_mutex_t *mgr_lock;
+                char *psz_useragent;
+       };
+
        class ConnectionFactory
        {
            public:
@@ -132,6 +163,18 @@ namespace adaptive
            public:
                virtual AbstractConnection * createConnection(vlc_object_t *, const ConnectionParams &);
        };
+
+       class LibVLCHTTPConnectionFactory : public ConnectionFactory
+       {
+           public:
+               LibVLCHTTPConnectionFactory();
+               virtual ~LibVLCHTTPConnectionFactory();
+               virtual AbstractConnection * createConnection(vlc_object_t *, const ConnectionParams &);
+
+           private:
+               vlc_mutex_t lock;
+               std::map<std::string, struct vlc_http_mgr *> managers; /* by origin */
+       };
     }
 }
 
@@ -30,7 +30,10 @@
 #include "ConnectionParams.hpp"
 #include "Sockets.hpp"
 #include "Downloader.hpp"
+#include "Chunk.h"
+#include "BytesRange.hpp"
 #include <vlc_url.h>
+#include <sstream>
 
 using namespace adaptive::http;
 
@@ -61,23 +64,33 @@ HTTPConnectionManager::HTTPConnectionManager    (vlc_object_t *p_object_, Connec
     : AbstractConnectionManager( p_object_ )
 {
     vlc_mutex_init(&lock);
-    downloader = new (std::nothrow) Downloader();
-    downloader->start();
+    downloader = new (std::nothrow) Downloader(
+                var_InheritInteger(p_object, "adaptive-download-threads"));
+    if(downloader && !downloader->start())
+    {
+        delete downloader;
+        downloader = NULL;
+    }
     if(!factory_)
     {
         if(var_InheritBool(p_object, "adaptive-use-access"))
             factory = new (std::nothrow) StreamUrlConnectionFactory();
+        else if(var_InheritBool(p_object, "adaptive-http2"))
+            factory = new (std::nothrow) LibVLCHTTPConnectionFactory();
         else
             factory = new (std::nothrow) ConnectionFactory();
     }
     else
         factory = factory_;
+    prefetchWindow = var_InheritInteger(p_object, "adaptive-prefetch");
 }
 HTTPConnectionManager::~HTTPConnectionManager   ()
 {
+    flushPrefetched();
     delete downloader;
-    delete factory;
+    /* connections can refer to the factory shared state */
     this->closeAllConnections();
+    delete factory;
     vlc_mutex_destroy(&lock);
 }
 
@@ -141,13 +154,110 @@ AbstractConnection * HTTPConnectionManager::getConnection(ConnectionParams &para
 void HTTPConnectionManager::start(AbstractChunkSource *source)
 {
     HTTPChunkBufferedSource *src = dynamic_cast<HTTPChunkBufferedSource *>(source);
-    if(src)
+    if(src && downloader)
         downloader->schedule(src);
 }
 
 void HTTPConnectionManager::cancel(AbstractChunkSource *source)
 {
     HTTPChunkBufferedSource *src = dynamic_cast<HTTPChunkBufferedSource *>(source);
-    if(src)
+    if(src && downloader)
         downloader->cancel(src);
 }
+
+void HTTPConnectionManager::prefetch(const std::string &url, const BytesRange &range,
+                                     const adaptive::ID &id)
+{
+    if(prefetchWindow == 0 || !downloader)
+        return;
+
+    const ConnectionParams params(url);
+    std::stringstream ss;
+    ss << params.getScheme() << "://" << params.getHostname() << ":" << params.getPort();
+    const std::string origin = ss.str();
+
+    vlc_mutex_lock(&lock);
+    size_t count = 0;
+    std::list<PrefetchedSource>::iterator it;
+    for(it = prefetched.begin(); it != prefetched.end(); ++it)
+    {
+        if((*it).url == url && (*it).start == range.getStartByte() &&
+           (*it).end == range.getEndByte())
+        {
+            vlc_mutex_unlock(&lock);
+            return; /* already requested */
+        }
+        if((*it).origin == origin)
+            count++;
+    }
+    vlc_mutex_unlock(&lock);
+
+    HTTPChunkBufferedSource *source = new (std::nothrow) HTTPChunkBufferedSource(url, this, id);
+    if(!source)
+        return;
+    if(range.isValid())
+        source->setBytesRange(range);
+
+    PrefetchedSource entry;
+    entry.url = url;
+    entry.origin = origin;
+    entry.start = range.getStartByte();
+    entry.end = range.getEndByte();
+    entry.source = source;
+
+    HTTPChunkBufferedSource *evicted = NULL;
+    vlc_mutex_lock(&lock);
+    if(count >= prefetchWindow)
+    {
+        /* evict the oldest from that origin, if not taken meanwhile */
+        for(it = prefetched.begin(); it != prefetched.end(); ++it)
+        {
+            if((*it).origin == origin)
+            {
+                evicted = (*it).source;
+                prefetched.erase(it);
+                break;
+            }
+        }
+    }
+    prefetched.push_back(entry);
+    vlc_mutex_unlock(&lock);
+
+    /* Must not be deleted with the lock held, as the downloader
+     * could be waiting for a connection for it */
+    delete evicted;
+
+    downloader->schedule(source);
+}
+
+AbstractChunkSource * HTTPConnectionManager::takePrefetched(const std::string &url,
+                                                           const BytesRange &range)
+{
+    AbstractChunkSource *source = NULL;
+    vlc_mutex_lock(&lock);
+    std::list<PrefetchedSource>::iterator it;
+    for(it = prefetched.begin(); it != prefetched.end(); ++it)
+    {
+        if((*it).url == url && (*it).start == range.getStartByte() &&
+           (*it).end == range.getEndByte())
+        {
+            source = (*it).source;
+            prefetched.erase(it);
+            break;
+        }
+    }
+    vlc_mutex_unlock(&lock);
+    return source;
+}
+
+void HTTPConnectionManager::flushPrefetched()
+{
+    std::list<PrefetchedSource> sources;
+    vlc_mutex_lock(&lock);
+    sources.swap(prefetched);
+    vlc_mutex_unlock(&lock);
+
+    std::list<PrefetchedSource>::const_iterator it;
+    for(it = sources.begin(); it != sources.end(); ++it)
+        delete (*it).source;
+}
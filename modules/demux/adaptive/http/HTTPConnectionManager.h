@@ -29,6 +29,7 @@
 
 #include <vlc_common.h>
 #include <vector>
+#include <list>
 #include <string>
 
 namespace adaptive
@@ -40,6 +41,8 @@ namespace adaptive
         class AbstractConnection;
         class Downloader;
         class AbstractChunkSource;
+        class HTTPChunkBufferedSource;
+        class BytesRange;
 
         class AbstractConnectionManager : public IDownloadRateObserver
         {
@@ -50,6 +53,8 @@ namespace adaptive
                 virtual AbstractConnection * getConnection(ConnectionParams &) = 0;
                 virtual void start(AbstractChunkSource *) = 0;
                 virtual void cancel(AbstractChunkSource *) = 0;
+                virtual void prefetch(const std::string &, const BytesRange &, const ID &) = 0;
+                virtual AbstractChunkSource * takePrefetched(const std::string &, const BytesRange &) = 0;
 
                 virtual void updateDownloadRate(const ID &, size_t, mtime_t); /* impl */
                 void setDownloadRateObserver(IDownloadRateObserver *);
@@ -72,9 +77,23 @@ namespace adaptive
 
                 virtual void start(AbstractChunkSource *) /* impl */;
                 virtual void cancel(AbstractChunkSource *) /* impl */;
+                virtual void prefetch(const std::string &, const BytesRange &, const ID &) /* impl */;
+                virtual AbstractChunkSource * takePrefetched(const std::string &, const BytesRange &) /* impl */;
 
             private:
+                class PrefetchedSource
+                {
+                    public:
+                        std::string url;
+                        std::string origin;
+                        size_t start;
+                        size_t end;
+                        HTTPChunkBufferedSource *source;
+                };
                 void    releaseAllConnections ();
+                void    flushPrefetched ();
+                std::list<PrefetchedSource>                         prefetched;
+                size_t                                              prefetchWindow;
                 Downloader                                         *downloader;
                 vlc_mutex_t                                         lock;
                 std::vector<AbstractConnection *>                   connectionPool;
@@ -70,17 +70,29 @@ void ISegment::onChunkDownload(block_t **, SegmentChunk *, BaseRepresentation *)
 SegmentChunk* ISegment::toChunk(size_t index, BaseRepresentation *rep, AbstractConnectionManager *connManager)
 {
     const std::string url = getUrlSegment().toString(index, rep);
-    HTTPChunkBufferedSource *source = new (std::nothrow) HTTPChunkBufferedSource(url, connManager,
-                                                                                 rep->getAdaptationSet()->getID());
-    if( source )
+    const BytesRange range = (startByte != endByte) ? BytesRange(startByte, endByte)
+                                                    : BytesRange();
+
+    /* Already being downloaded from the prefetch window */
+    AbstractChunkSource *source = connManager->takePrefetched(url, range);
+    const bool b_prefetched = (source != NULL);
+    if( !source )
     {
-        if(startByte != endByte)
-            source->setBytesRange(BytesRange(startByte, endByte));
+        HTTPChunkBufferedSource *bufferedSource =
+                new (std::nothrow) HTTPChunkBufferedSource(url, connManager,
+                                                           rep->getAdaptationSet()->getID());
+        if( bufferedSource && range.isValid() )
+            bufferedSource->setBytesRange(range);
+        source = bufferedSource;
+    }
 
+    if( source )
+    {
         SegmentChunk *chunk = new (std::nothrow) SegmentChunk(this, source, rep);
         if( chunk )
         {
-            connManager->start(source);
+            if( !b_prefetched )
+                connManager->start(source);
             return chunk;
         }
         else
@@ -91,6 +103,14 @@ SegmentChunk* ISegment::toChunk(size_t index, BaseRepresentation *rep, AbstractC
     return NULL;
 }
 
+void ISegment::prefetch(size_t index, BaseRepresentation *rep, AbstractConnectionManager *connManager)
+{
+    const std::string url = getUrlSegment().toString(index, rep);
+    const BytesRange range = (startByte != endByte) ? BytesRange(startByte, endByte)
+                                                    : BytesRange();
+    connManager->prefetch(url, range, rep->getAdaptationSet()->getID());
+}
+
 bool ISegment::isTemplate() const
 {
     return templated;
@@ -59,6 +59,7 @@ namespace adaptive
                  *          when using an UrlTemplate
                  */
                 virtual SegmentChunk*                   toChunk         (size_t, BaseRepresentation *, AbstractConnectionManager *);
+                virtual void                            prefetch        (size_t, BaseRepresentation *, AbstractConnectionManager *);
                 virtual void                            setByteRange    (size_t start, size_t end);
                 virtual void                            setSequenceNumber(uint64_t);
                 virtual uint64_t                        getSequenceNumber() const;
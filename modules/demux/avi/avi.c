@@ -43,6 +43,8 @@
 #include <vlc_codecs.h>
 #include <vlc_charset.h>
 #include <vlc_memory.h>
+#include <vlc_atomic.h>
+#include <vlc_url.h>
 
 #include "libavi.h"
 #include "../rawdv.h"
@@ -56,7 +58,8 @@
 #define INDEX_TEXT N_("Force index creation")
 #define INDEX_LONGTEXT N_( \
     "Recreate a index for the AVI file. Use this if your AVI file is damaged "\
-    "or incomplete (not seekable)." )
+    "or incomplete (not seekable). When fixing in background, playback " \
+    "starts immediately and seeking becomes exact as the file is indexed." )
 
 #define BI_RAWRGB 0x00
 #define BI_RGBBITFIELDS 0x03
@@ -64,12 +67,13 @@
 static int  Open ( vlc_object_t * );
 static void Close( vlc_object_t * );
 
-static const int pi_index[] = {0,1,2,3};
+static const int pi_index[] = {0,1,2,3,4};
 
 static const char *const ppsz_indexes[] = { N_("Ask for action"),
                                             N_("Always fix"),
                                             N_("Never fix"),
-                                            N_("Fix when necessary")};
+                                            N_("Fix when necessary"),
+                                            N_("Fix in background")};
 
 vlc_module_begin ()
     set_shortname( "AVI" )
@@ -141,6 +145,29 @@ static void avi_index_Init( avi_index_t * );
 static void avi_index_Clean( avi_index_t * );
 static void avi_index_Append( avi_index_t *, off_t *, avi_entry_t * );
 
+/* Chunk found by the index builder thread, waiting for the demux thread */
+typedef struct
+{
+    unsigned int    i_track;
+    avi_entry_t     entry;
+} avi_index_pending_t;
+
+typedef struct
+{
+    vlc_thread_t    thread;
+    stream_t        *s;
+    off_t           i_start;    /* last chunk already in the index */
+    atomic_bool     b_stop;
+
+    vlc_mutex_t     lock;
+    avi_index_pending_t *p_pending;
+    size_t          i_pending;
+    size_t          i_pending_max;
+    double          f_progress;
+    bool            b_done;
+    bool            b_complete;
+} avi_index_builder_t;
+
 typedef struct
 {
     bool            b_activated;
@@ -200,6 +227,10 @@ struct demux_sys_t
 
     unsigned int       i_attachment;
     input_attachment_t **attachment;
+
+    /* index being built in background, see AVI_IndexBuilderStart() */
+    avi_index_builder_t *p_index_builder;
+    bool                b_index_builder;
 };
 
 static inline off_t __EVEN( off_t i )
@@ -222,12 +253,17 @@ static int AVI_StreamBytesSet ( demux_t *,
 vlc_fourcc_t AVI_FourccGetCodec( unsigned int i_cat, vlc_fourcc_t );
 static int   AVI_GetKeyFlag    ( vlc_fourcc_t , uint8_t * );
 
-static int AVI_PacketGetHeader( demux_t *, avi_packet_t *p_pk );
-static int AVI_PacketNext     ( demux_t * );
-static int AVI_PacketSearch   ( demux_t * );
+static int AVI_PacketGetHeader( stream_t *, avi_packet_t *p_pk );
+static int AVI_PacketNext     ( stream_t * );
+static int AVI_PacketSearch   ( demux_t *, stream_t *, atomic_bool * );
 
 static void AVI_IndexLoad    ( demux_t * );
 static void AVI_IndexCreate  ( demux_t * );
+static bool AVI_IndexCacheLoad( demux_t * );
+static void AVI_IndexCacheSave( demux_t * );
+static int  AVI_IndexBuilderStart( demux_t * );
+static void AVI_IndexBuilderMerge( demux_t * );
+static void AVI_IndexBuilderStop ( demux_t * );
 
 static void AVI_ExtractSubtitle( demux_t *, unsigned int i_stream, avi_chunk_list_t *, avi_chunk_STRING_t * );
 
@@ -263,7 +299,7 @@ static int Open( vlc_object_t * p_this )
     demux_t  *p_demux = (demux_t *)p_this;
     demux_sys_t     *p_sys;
 
-    bool       b_index = false, b_aborted = false;
+    bool       b_index = false, b_aborted = false, b_index_cached = false;
     int              i_do_index;
 
     avi_chunk_list_t    *p_riff;
@@ -731,7 +767,8 @@ static int Open( vlc_object_t * p_this )
 aviindex:
         if( p_sys->b_fastseekable )
         {
-            AVI_IndexCreate( p_demux );
+            if( b_index_cached || !AVI_IndexCacheLoad( p_demux ) )
+                AVI_IndexCreate( p_demux );
         }
         else if( p_sys->b_seekable )
         {
@@ -765,13 +802,24 @@ aviindex:
     {
         msg_Warn( p_demux, "broken or missing index, 'seek' will be "
                            "approximative or will exhibit strange behavior" );
-        if( (i_do_index == 0 || i_do_index == 3) && !b_index )
+        if( (i_do_index == 0 || i_do_index == 3 || i_do_index == 4) && !b_index )
         {
             if( !p_sys->b_fastseekable ) {
                 b_index = true;
                 goto aviindex;
             }
-            if( i_do_index == 0 )
+            b_index_cached = true; /* tried, whether it is found or not */
+            if( AVI_IndexCacheLoad( p_demux ) )
+            {
+                /* Fixed by a previous opening, no need to ask again */
+                b_index = true;
+                p_sys->i_length = AVI_MovieGetLength( p_demux );
+            }
+            else if( i_do_index == 4 && !AVI_IndexBuilderStart( p_demux ) )
+            {
+                b_index = true;
+            }
+            else if( i_do_index == 0 )
             {
                 const char *psz_msg = _(
                     "Because this AVI file index is broken or missing, "
@@ -878,6 +926,9 @@ static void Close ( vlc_object_t * p_this )
     demux_t *    p_demux = (demux_t *)p_this;
     demux_sys_t *p_sys = p_demux->p_sys  ;
 
+    if( p_sys->p_index_builder )
+        AVI_IndexBuilderStop( p_demux );
+
     for( unsigned int i = 0; i < p_sys->i_track; i++ )
     {
         if( p_sys->track[i] )
@@ -1001,6 +1052,8 @@ static int Demux_Seekable( demux_t *p_demux )
     /* cannot be more than 100 stream (dcXX or wbXX) */
     avi_track_toread_t toread[100];
 
+    if( p_sys->p_index_builder )
+        AVI_IndexBuilderMerge( p_demux );
 
     /* detect new selected/unselected streams */
     for( i_track = 0; i_track < p_sys->i_track; i_track++ )
@@ -1138,7 +1191,7 @@ static int Demux_Seekable( demux_t *p_demux )
             if( p_sys->b_seekable && p_sys->i_movi_lastchunk_pos >= p_sys->i_movi_begin + 12 )
             {
                 vlc_stream_Seek( p_demux->s, p_sys->i_movi_lastchunk_pos );
-                if( AVI_PacketNext( p_demux ) )
+                if( AVI_PacketNext( p_demux->s ) )
                 {
                     return( AVI_TrackStopFinishedStreams( p_demux ) ? 0 : 1 );
                 }
@@ -1152,7 +1205,7 @@ static int Demux_Seekable( demux_t *p_demux )
             {
                 avi_packet_t avi_pk;
 
-                if( AVI_PacketGetHeader( p_demux, &avi_pk ) )
+                if( AVI_PacketGetHeader( p_demux->s, &avi_pk ) )
                 {
                     msg_Warn( p_demux,
                              "cannot get packet header, track disabled" );
@@ -1161,7 +1214,7 @@ static int Demux_Seekable( demux_t *p_demux )
                 if( avi_pk.i_stream >= p_sys->i_track ||
                     ( avi_pk.i_cat != AUDIO_ES && avi_pk.i_cat != VIDEO_ES ) )
                 {
-                    if( AVI_PacketNext( p_demux ) )
+                    if( AVI_PacketNext( p_demux->s ) )
                     {
                         msg_Warn( p_demux,
                                   "cannot skip packet, track disabled" );
@@ -1202,7 +1255,7 @@ static int Demux_Seekable( demux_t *p_demux )
                     }
                     else
                     {
-                        if( AVI_PacketNext( p_demux ) )
+                        if( AVI_PacketNext( p_demux->s ) )
                         {
                             msg_Warn( p_demux,
                                       "cannot skip packet, track disabled" );
@@ -1402,7 +1455,7 @@ static int Demux_UnSeekable( demux_t *p_demux )
 
         avi_packet_t    avi_pk;
 
-        if( AVI_PacketGetHeader( p_demux, &avi_pk ) )
+        if( AVI_PacketGetHeader( p_demux->s, &avi_pk ) )
         {
             return VLC_DEMUXER_EOF;
         }
@@ -1419,18 +1472,18 @@ static int Demux_UnSeekable( demux_t *p_demux )
                 case AVIFOURCC_JUNK:
                 case AVIFOURCC_LIST:
                 case AVIFOURCC_RIFF:
-                    return( !AVI_PacketNext( p_demux ) ? 1 : 0 );
+                    return( !AVI_PacketNext( p_demux->s ) ? 1 : 0 );
                 case AVIFOURCC_idx1:
                     if( p_sys->b_odml )
                     {
-                        return( !AVI_PacketNext( p_demux ) ? 1 : 0 );
+                        return( !AVI_PacketNext( p_demux->s ) ? 1 : 0 );
                     }
                     return VLC_DEMUXER_EOF;
                 default:
                     msg_Warn( p_demux,
                               "seems to have lost position @%"PRIu64", resync",
                               vlc_stream_Tell(p_demux->s) );
-                    if( AVI_PacketSearch( p_demux ) )
+                    if( AVI_PacketSearch( p_demux, p_demux->s, NULL ) )
                     {
                         msg_Err( p_demux, "resync failed" );
                         return VLC_DEMUXER_EGENERIC;
@@ -1466,7 +1519,7 @@ static int Demux_UnSeekable( demux_t *p_demux )
             }
             else
             {
-                if( AVI_PacketNext( p_demux ) )
+                if( AVI_PacketNext( p_demux->s ) )
                 {
                     return VLC_DEMUXER_EOF;
                 }
@@ -1502,6 +1555,9 @@ static int Seek( demux_t *p_demux, mtime_t i_date, int i_percent )
     msg_Dbg( p_demux, "seek requested: %"PRId64" seconds %d%%",
              i_date / CLOCK_FREQ, i_percent );
 
+    if( p_sys->p_index_builder )
+        AVI_IndexBuilderMerge( p_demux );
+
     if( p_sys->b_seekable )
     {
         int64_t i_pos_backup = vlc_stream_Tell( p_demux->s );
@@ -1717,6 +1773,20 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             }
             return VLC_SUCCESS;
 
+        case DEMUX_GET_INDEX_PROGRESS:
+            if( !p_sys->b_index_builder )
+                return VLC_EGENERIC;
+            pf = va_arg( args, double * );
+            if( p_sys->p_index_builder )
+            {
+                vlc_mutex_lock( &p_sys->p_index_builder->lock );
+                *pf = p_sys->p_index_builder->f_progress;
+                vlc_mutex_unlock( &p_sys->p_index_builder->lock );
+            }
+            else
+                *pf = 1.0;
+            return VLC_SUCCESS;
+
         case DEMUX_GET_META:
             p_meta = (vlc_meta_t*)va_arg( args, vlc_meta_t* );
             vlc_meta_Merge( p_meta,  p_sys->meta );
@@ -1837,7 +1907,7 @@ static int AVI_StreamChunkFind( demux_t *p_demux, unsigned int i_stream )
     if( p_sys->i_movi_lastchunk_pos >= p_sys->i_movi_begin + 12 )
     {
         vlc_stream_Seek( p_demux->s, p_sys->i_movi_lastchunk_pos );
-        if( AVI_PacketNext( p_demux ) )
+        if( AVI_PacketNext( p_demux->s ) )
         {
             return VLC_EGENERIC;
         }
@@ -1849,7 +1919,7 @@ static int AVI_StreamChunkFind( demux_t *p_demux, unsigned int i_stream )
 
     for( ;; )
     {
-        if( AVI_PacketGetHeader( p_demux, &avi_pk ) )
+        if( AVI_PacketGetHeader( p_demux->s, &avi_pk ) )
         {
             msg_Warn( p_demux, "cannot get packet header" );
             return VLC_EGENERIC;
@@ -1857,7 +1927,7 @@ static int AVI_StreamChunkFind( demux_t *p_demux, unsigned int i_stream )
         if( avi_pk.i_stream >= p_sys->i_track ||
             ( avi_pk.i_cat != AUDIO_ES && avi_pk.i_cat != VIDEO_ES ) )
         {
-            if( AVI_PacketNext( p_demux ) )
+            if( AVI_PacketNext( p_demux->s ) )
             {
                 return VLC_EGENERIC;
             }
@@ -1891,7 +1961,7 @@ static int AVI_StreamChunkFind( demux_t *p_demux, unsigned int i_stream )
                 return VLC_SUCCESS;
             }
 
-            if( AVI_PacketNext( p_demux ) )
+            if( AVI_PacketNext( p_demux->s ) )
             {
                 return VLC_EGENERIC;
             }
@@ -2189,17 +2259,17 @@ static void AVI_ParseStreamHeader( vlc_fourcc_t i_id,
 /****************************************************************************
  *
  ****************************************************************************/
-static int AVI_PacketGetHeader( demux_t *p_demux, avi_packet_t *p_pk )
+static int AVI_PacketGetHeader( stream_t *s, avi_packet_t *p_pk )
 {
     const uint8_t *p_peek;
 
-    if( vlc_stream_Peek( p_demux->s, &p_peek, 16 ) < 16 )
+    if( vlc_stream_Peek( s, &p_peek, 16 ) < 16 )
     {
         return VLC_EGENERIC;
     }
     p_pk->i_fourcc  = VLC_FOURCC( p_peek[0], p_peek[1], p_peek[2], p_peek[3] );
     p_pk->i_size    = GetDWLE( p_peek + 4 );
-    p_pk->i_pos     = vlc_stream_Tell( p_demux->s );
+    p_pk->i_pos     = vlc_stream_Tell( s );
     if( p_pk->i_fourcc == AVIFOURCC_LIST || p_pk->i_fourcc == AVIFOURCC_RIFF )
     {
         p_pk->i_type = VLC_FOURCC( p_peek[8],  p_peek[9],
@@ -2216,12 +2286,12 @@ static int AVI_PacketGetHeader( demux_t *p_demux, avi_packet_t *p_pk )
     return VLC_SUCCESS;
 }
 
-static int AVI_PacketNext( demux_t *p_demux )
+static int AVI_PacketNext( stream_t *s )
 {
     avi_packet_t    avi_ck;
     size_t          i_skip = 0;
 
-    if( AVI_PacketGetHeader( p_demux, &avi_ck ) )
+    if( AVI_PacketGetHeader( s, &avi_ck ) )
     {
         return VLC_EGENERIC;
     }
@@ -2246,7 +2316,7 @@ static int AVI_PacketNext( demux_t *p_demux )
     if( i_skip > SSIZE_MAX )
         return VLC_EGENERIC;
 
-    ssize_t i_ret = vlc_stream_Read( p_demux->s, NULL, i_skip );
+    ssize_t i_ret = vlc_stream_Read( s, NULL, i_skip );
     if( i_ret < 0 || (size_t) i_ret != i_skip )
     {
         return VLC_EGENERIC;
@@ -2254,7 +2324,10 @@ static int AVI_PacketNext( demux_t *p_demux )
     return VLC_SUCCESS;
 }
 
-static int AVI_PacketSearch( demux_t *p_demux )
+/* Resyncs on the next chunk header. If pb_stop is not NULL, the search is
+ * abandoned once it is set. */
+static int AVI_PacketSearch( demux_t *p_demux, stream_t *s,
+                             atomic_bool *pb_stop )
 {
     demux_sys_t     *p_sys = p_demux->p_sys;
     avi_packet_t    avi_pk;
@@ -2262,11 +2335,13 @@ static int AVI_PacketSearch( demux_t *p_demux )
 
     for( ;; )
     {
-        if( vlc_stream_Read( p_demux->s, NULL, 1 ) != 1 )
+        if( pb_stop != NULL && atomic_load( pb_stop ) )
+            return VLC_EGENERIC;
+        if( vlc_stream_Read( s, NULL, 1 ) != 1 )
         {
             return VLC_EGENERIC;
         }
-        AVI_PacketGetHeader( p_demux, &avi_pk );
+        AVI_PacketGetHeader( s, &avi_pk );
         if( avi_pk.i_stream < p_sys->i_track &&
             ( avi_pk.i_cat == AUDIO_ES || avi_pk.i_cat == VIDEO_ES ) )
         {
@@ -2615,35 +2690,126 @@ static void AVI_IndexLoad( demux_t *p_demux )
     }
 }
 
-static void AVI_IndexCreate( demux_t *p_demux )
+/* State of a sequential scan of the LIST-movi chunks */
+typedef struct
+{
+    stream_t *s;
+    off_t    i_movi_start; /* first chunk of the LIST-movi */
+    off_t    i_movi_end;
+    off_t    i_avix_pos; /* first chunk of the OpenDML RIFF-AVIX, or -1 */
+    atomic_bool *pb_stop; /* interrupts resyncing, or NULL */
+} avi_index_scan_t;
+
+static int AVI_IndexScanInit( demux_t *p_demux, stream_t *s,
+                              avi_index_scan_t *p_scan )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 
-    avi_chunk_list_t *p_riff;
-    avi_chunk_list_t *p_movi;
+    avi_chunk_list_t *p_riff = AVI_ChunkFind( &p_sys->ck_root, AVIFOURCC_RIFF, 0);
+    avi_chunk_list_t *p_movi = AVI_ChunkFind( p_riff, AVIFOURCC_movi, 0);
+
+    if( !p_movi )
+    {
+        msg_Err( p_demux, "cannot find p_movi" );
+        return VLC_EGENERIC;
+    }
+
+    p_scan->s = s;
+    p_scan->pb_stop = NULL;
+    p_scan->i_movi_start = p_movi->i_chunk_pos + 12;
+    p_scan->i_movi_end = __MIN( (off_t)(p_movi->i_chunk_pos + p_movi->i_chunk_size),
+                                stream_Size( s ) );
+    p_scan->i_avix_pos = -1;
+    if( p_sys->b_odml )
+    {
+        avi_chunk_list_t *p_sysx = AVI_ChunkFind( &p_sys->ck_root,
+                                                  AVIFOURCC_RIFF, 1 );
+        if( p_sysx )
+            p_scan->i_avix_pos = p_sysx->i_chunk_pos + 24;
+    }
+    return VLC_SUCCESS;
+}
 
+/* Reads the next chunk, returns its track and fills its index entry if it is
+ * a media chunk, or returns -1. *pb_end is set at the end of the scan. */
+static int AVI_IndexScanNext( demux_t *p_demux, avi_index_scan_t *p_scan,
+                              avi_entry_t *p_entry, bool *pb_end )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    avi_packet_t pk;
+    int i_track = -1;
+
+    *pb_end = true;
+    if( AVI_PacketGetHeader( p_scan->s, &pk ) )
+        return -1;
+
+    if( pk.i_stream < p_sys->i_track &&
+        pk.i_cat == p_sys->track[pk.i_stream]->i_cat )
+    {
+        avi_track_t *tk = p_sys->track[pk.i_stream];
+
+        p_entry->i_id      = pk.i_fourcc;
+        p_entry->i_flags   = AVI_GetKeyFlag(tk->i_codec, pk.i_peek);
+        p_entry->i_pos     = pk.i_pos;
+        p_entry->i_length  = pk.i_size;
+        p_entry->i_lengthtotal = pk.i_size;
+        i_track = pk.i_stream;
+    }
+    else
+    {
+        switch( pk.i_fourcc )
+        {
+        case AVIFOURCC_idx1:
+            if( p_sys->b_odml && p_scan->i_avix_pos >= 0 )
+            {
+                msg_Dbg( p_demux, "looking for new RIFF chunk" );
+                if( vlc_stream_Seek( p_scan->s, p_scan->i_avix_pos ) )
+                    return -1;
+                break;
+            }
+            return -1;
+
+        case AVIFOURCC_RIFF:
+                msg_Dbg( p_demux, "new RIFF chunk found" );
+                break;
+
+        case AVIFOURCC_rec:
+        case AVIFOURCC_JUNK:
+            break;
+
+        default:
+            msg_Warn( p_demux, "need resync, probably broken avi" );
+            if( AVI_PacketSearch( p_demux, p_scan->s, p_scan->pb_stop ) )
+            {
+                msg_Warn( p_demux, "lost sync, abord index creation" );
+                return -1;
+            }
+        }
+    }
+
+    *pb_end = ( !p_sys->b_odml && pk.i_pos + pk.i_size >= p_scan->i_movi_end ) ||
+              AVI_PacketNext( p_scan->s );
+    return i_track;
+}
+
+static void AVI_IndexCreate( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    avi_index_scan_t scan;
     unsigned int i_stream;
-    off_t i_movi_end;
 
     mtime_t i_dialog_update;
     vlc_dialog_id *p_dialog_id = NULL;
+    bool b_cancelled = false;
 
-    p_riff = AVI_ChunkFind( &p_sys->ck_root, AVIFOURCC_RIFF, 0);
-    p_movi = AVI_ChunkFind( p_riff, AVIFOURCC_movi, 0);
-
-    if( !p_movi )
-    {
-        msg_Err( p_demux, "cannot find p_movi" );
+    if( AVI_IndexScanInit( p_demux, p_demux->s, &scan ) )
         return;
-    }
 
     for( i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
         avi_index_Init( &p_sys->track[i_stream]->idx );
 
-    i_movi_end = __MIN( (off_t)(p_movi->i_chunk_pos + p_movi->i_chunk_size),
-                        stream_Size( p_demux->s ) );
-
-    vlc_stream_Seek( p_demux->s, p_movi->i_chunk_pos + 12 );
+    vlc_stream_Seek( p_demux->s, scan.i_movi_start );
     msg_Warn( p_demux, "creating index from LIST-movi, will take time !" );
 
 
@@ -2657,15 +2823,18 @@ static void AVI_IndexCreate( demux_t *p_demux )
                                          _("Fixing AVI Index...") );
     }
 
-    for( ;; )
+    for( bool b_end = false; !b_end; )
     {
-        avi_packet_t pk;
+        avi_entry_t index;
 
         /* Don't update/check dialog too often */
         if( p_dialog_id != NULL && mdate() - i_dialog_update > 100000 )
         {
             if( vlc_dialog_is_cancelled( p_demux, p_dialog_id ) )
+            {
+                b_cancelled = true;
                 break;
+            }
 
             double f_current = vlc_stream_Tell( p_demux->s );
             double f_size    = stream_Size( p_demux->s );
@@ -2675,74 +2844,313 @@ static void AVI_IndexCreate( demux_t *p_demux )
             i_dialog_update = mdate();
         }
 
-        if( AVI_PacketGetHeader( p_demux, &pk ) )
-            break;
+        int i_track = AVI_IndexScanNext( p_demux, &scan, &index, &b_end );
+        if( i_track >= 0 )
+            avi_index_Append( &p_sys->track[i_track]->idx,
+                              &p_sys->i_movi_lastchunk_pos, &index );
+    }
 
-        if( pk.i_stream < p_sys->i_track &&
-            pk.i_cat == p_sys->track[pk.i_stream]->i_cat )
-        {
-            avi_track_t *tk = p_sys->track[pk.i_stream];
+    if( p_dialog_id != NULL )
+        vlc_dialog_release( p_demux, p_dialog_id );
+
+    for( i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
+    {
+        msg_Dbg( p_demux, "stream[%d] creating %d index entries",
+                i_stream, p_sys->track[i_stream]->idx.i_size );
+    }
+
+    if( !b_cancelled )
+        AVI_IndexCacheSave( p_demux );
+}
+
+/* Index built by a previous scan of the same file, see AVI_IndexCreate().
+ * Layout (big endian): track count, then for each track, its entry count
+ * followed by the entries (fourcc, flags, position and length). */
+#define AVI_INDEX_CACHE_ENTRY 20
+
+static bool AVI_IndexCacheLoad( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    size_t i_size;
+    uint8_t *p_data = demux_IndexCacheLoad( p_demux, "avi", &i_size );
+
+    if( p_data == NULL )
+        return false;
+
+    /* Validate the whole index before touching the tracks */
+    const uint8_t *p = p_data, *p_end = p_data + i_size;
+    const uint64_t i_stream_size = stream_Size( p_demux->s );
+
+    if( i_size < 4 || GetDWBE( p ) != p_sys->i_track )
+        goto error;
+    p += 4;
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+    {
+        if( p_end - p < 4 )
+            goto error;
+        uint32_t i_count = GetDWBE( p );
+        p += 4;
+        if( (size_t)(p_end - p) / AVI_INDEX_CACHE_ENTRY < i_count )
+            goto error;
+        for( uint32_t j = 0; j < i_count; j++, p += AVI_INDEX_CACHE_ENTRY )
+            if( GetQWBE( &p[8] ) >= i_stream_size )
+                goto error;
+    }
+    if( p != p_end )
+        goto error;
 
+    p = p_data + 4;
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+    {
+        avi_track_t *tk = p_sys->track[i];
+        uint32_t i_count = GetDWBE( p );
+        p += 4;
+
+        avi_index_Clean( &tk->idx );
+        avi_index_Init( &tk->idx );
+        for( uint32_t j = 0; j < i_count; j++, p += AVI_INDEX_CACHE_ENTRY )
+        {
             avi_entry_t index;
-            index.i_id      = pk.i_fourcc;
-            index.i_flags   = AVI_GetKeyFlag(tk->i_codec, pk.i_peek);
-            index.i_pos     = pk.i_pos;
-            index.i_length  = pk.i_size;
-            index.i_lengthtotal = pk.i_size;
+            index.i_id      = GetDWBE( &p[0] );
+            index.i_flags   = GetDWBE( &p[4] );
+            index.i_pos     = GetQWBE( &p[8] );
+            index.i_length  = GetDWBE( &p[16] );
+            index.i_lengthtotal = index.i_length;
             avi_index_Append( &tk->idx, &p_sys->i_movi_lastchunk_pos, &index );
         }
-        else
-        {
-            switch( pk.i_fourcc )
-            {
-            case AVIFOURCC_idx1:
-                if( p_sys->b_odml )
-                {
-                    avi_chunk_list_t *p_sysx;
-                    p_sysx = AVI_ChunkFind( &p_sys->ck_root,
-                                            AVIFOURCC_RIFF, 1 );
-
-                    msg_Dbg( p_demux, "looking for new RIFF chunk" );
-                    if( vlc_stream_Seek( p_demux->s,
-                                         p_sysx->i_chunk_pos + 24 ) )
-                        goto print_stat;
-                    break;
-                }
-                goto print_stat;
+        msg_Dbg( p_demux, "stream[%u] loaded %u cached index entries",
+                 i, tk->idx.i_size );
+    }
+    free( p_data );
+    return true;
 
-            case AVIFOURCC_RIFF:
-                    msg_Dbg( p_demux, "new RIFF chunk found" );
-                    break;
+error:
+    msg_Warn( p_demux, "cached index does not match the file" );
+    free( p_data );
+    return false;
+}
 
-            case AVIFOURCC_rec:
-            case AVIFOURCC_JUNK:
-                break;
+static void AVI_IndexCacheSave( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    size_t i_size = 4;
 
-            default:
-                msg_Warn( p_demux, "need resync, probably broken avi" );
-                if( AVI_PacketSearch( p_demux ) )
-                {
-                    msg_Warn( p_demux, "lost sync, abord index creation" );
-                    goto print_stat;
-                }
-            }
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+        i_size += 4 + (size_t)p_sys->track[i]->idx.i_size
+                      * AVI_INDEX_CACHE_ENTRY;
+
+    uint8_t *p_data = malloc( i_size );
+    if( unlikely(p_data == NULL) )
+        return;
+
+    uint8_t *p = p_data;
+    SetDWBE( p, p_sys->i_track );
+    p += 4;
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+    {
+        const avi_index_t *p_index = &p_sys->track[i]->idx;
+
+        SetDWBE( p, p_index->i_size );
+        p += 4;
+        for( unsigned j = 0; j < p_index->i_size; j++ )
+        {
+            const avi_entry_t *p_entry = &p_index->p_entry[j];
+            SetDWBE( &p[0], p_entry->i_id );
+            SetDWBE( &p[4], p_entry->i_flags );
+            SetQWBE( &p[8], p_entry->i_pos );
+            SetDWBE( &p[16], p_entry->i_length );
+            p += AVI_INDEX_CACHE_ENTRY;
         }
+    }
+
+    demux_IndexCacheSave( p_demux, "avi", p_data, i_size );
+    free( p_data );
+}
+
+/* Instead of blocking the opening with AVI_IndexCreate(), the chunks are
+ * scanned from a low priority thread, on its own stream. They are appended
+ * to the track indexes by the demux thread, so that seeking is exact in the
+ * parts of the file already scanned. */
+#define AVI_INDEX_BUILDER_BATCH 512
+
+/* Returns false if the entries could not be queued */
+static bool AVI_IndexBuilderPublish( avi_index_builder_t *p_builder,
+                                     const avi_index_pending_t *p_batch,
+                                     size_t i_batch,
+                                     double f_progress )
+{
+    vlc_mutex_lock( &p_builder->lock );
+    if( p_builder->i_pending + i_batch > p_builder->i_pending_max )
+    {
+        size_t i_max = p_builder->i_pending_max + 16384;
+        avi_index_pending_t *p_pending =
+            realloc( p_builder->p_pending, i_max * sizeof( *p_pending ) );
+        if( unlikely( p_pending == NULL ) )
+        {
+            vlc_mutex_unlock( &p_builder->lock );
+            return false;
+        }
+        p_builder->p_pending = p_pending;
+        p_builder->i_pending_max = i_max;
+    }
+    memcpy( &p_builder->p_pending[p_builder->i_pending], p_batch,
+            i_batch * sizeof( *p_batch ) );
+    p_builder->i_pending += i_batch;
+    p_builder->f_progress = f_progress;
+    vlc_mutex_unlock( &p_builder->lock );
+    return true;
+}
+
+static void *AVI_IndexBuilderThread( void *p_data )
+{
+    demux_t *p_demux = p_data;
+    demux_sys_t *p_sys = p_demux->p_sys;
+    avi_index_builder_t *p_builder = p_sys->p_index_builder;
+    stream_t *s = p_builder->s;
+    avi_index_scan_t scan;
+    bool b_end = true;
 
-        if( ( !p_sys->b_odml && pk.i_pos + pk.i_size >= i_movi_end ) ||
-            AVI_PacketNext( p_demux ) )
+    /* Start after the chunks already in the index */
+    if( !AVI_IndexScanInit( p_demux, s, &scan ) )
+    {
+        scan.pb_stop = &p_builder->b_stop;
+        if( p_builder->i_start >= scan.i_movi_start )
+            b_end = vlc_stream_Seek( s, p_builder->i_start ) || AVI_PacketNext( s );
+        else
+            b_end = vlc_stream_Seek( s, scan.i_movi_start ) != VLC_SUCCESS;
+    }
+
+    const double f_size = stream_Size( s );
+    avi_index_pending_t batch[AVI_INDEX_BUILDER_BATCH];
+    size_t i_batch = 0;
+    bool b_failed = false;
+
+    while( !b_end && !b_failed && !atomic_load( &p_builder->b_stop ) )
+    {
+        int i_track = AVI_IndexScanNext( p_demux, &scan,
+                                         &batch[i_batch].entry, &b_end );
+        if( i_track >= 0 )
+            batch[i_batch++].i_track = i_track;
+
+        if( i_batch == AVI_INDEX_BUILDER_BATCH )
         {
-            break;
+            b_failed = !AVI_IndexBuilderPublish( p_builder, batch, i_batch,
+                                                 vlc_stream_Tell( s ) / f_size );
+            i_batch = 0;
         }
     }
+    if( !b_failed )
+        b_failed = !AVI_IndexBuilderPublish( p_builder, batch, i_batch, 1.0 );
+    if( b_failed )
+        msg_Err( p_demux, "cannot queue index entries, "
+                 "background index is incomplete" );
 
-print_stat:
-    if( p_dialog_id != NULL )
-        vlc_dialog_release( p_demux, p_dialog_id );
+    vlc_mutex_lock( &p_builder->lock );
+    p_builder->b_done = true;
+    /* An index with missing entries must not be cached */
+    p_builder->b_complete = b_end && !b_failed
+                         && !atomic_load( &p_builder->b_stop );
+    vlc_mutex_unlock( &p_builder->lock );
+    return NULL;
+}
 
-    for( i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
+static int AVI_IndexBuilderStart( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    /* The file is read again independently of the demux stream */
+    if( p_demux->psz_file == NULL )
+        return VLC_EGENERIC;
+
+    char *psz_mrl = vlc_path2uri( p_demux->psz_file, NULL );
+    if( psz_mrl == NULL )
+        return VLC_ENOMEM;
+
+    avi_index_builder_t *p_builder = calloc( 1, sizeof( *p_builder ) );
+    if( unlikely( p_builder == NULL ) )
     {
-        msg_Dbg( p_demux, "stream[%d] creating %d index entries",
-                i_stream, p_sys->track[i_stream]->idx.i_size );
+        free( psz_mrl );
+        return VLC_ENOMEM;
+    }
+
+    p_builder->s = vlc_stream_NewMRL( p_demux, psz_mrl );
+    free( psz_mrl );
+    if( p_builder->s == NULL )
+    {
+        free( p_builder );
+        return VLC_EGENERIC;
+    }
+
+    p_builder->i_start = p_sys->i_movi_lastchunk_pos;
+    atomic_init( &p_builder->b_stop, false );
+    vlc_mutex_init( &p_builder->lock );
+    p_sys->p_index_builder = p_builder;
+
+    if( vlc_clone( &p_builder->thread, AVI_IndexBuilderThread, p_demux,
+                   VLC_THREAD_PRIORITY_LOW ) )
+    {
+        p_sys->p_index_builder = NULL;
+        vlc_mutex_destroy( &p_builder->lock );
+        vlc_stream_Delete( p_builder->s );
+        free( p_builder );
+        return VLC_EGENERIC;
+    }
+
+    msg_Dbg( p_demux, "building index in background" );
+    p_sys->b_index_builder = true;
+    return VLC_SUCCESS;
+}
+
+static void AVI_IndexBuilderStop( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    avi_index_builder_t *p_builder = p_sys->p_index_builder;
+
+    atomic_store( &p_builder->b_stop, true );
+    vlc_join( p_builder->thread, NULL );
+
+    p_sys->p_index_builder = NULL;
+    vlc_mutex_destroy( &p_builder->lock );
+    vlc_stream_Delete( p_builder->s );
+    free( p_builder->p_pending );
+    free( p_builder );
+}
+
+static void AVI_IndexBuilderMerge( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    avi_index_builder_t *p_builder = p_sys->p_index_builder;
+
+    vlc_mutex_lock( &p_builder->lock );
+    avi_index_pending_t *p_pending = p_builder->p_pending;
+    size_t i_pending = p_builder->i_pending;
+    bool b_done = p_builder->b_done;
+    bool b_complete = p_builder->b_complete;
+
+    p_builder->p_pending = NULL;
+    p_builder->i_pending = p_builder->i_pending_max = 0;
+    vlc_mutex_unlock( &p_builder->lock );
+
+    for( size_t i = 0; i < i_pending; i++ )
+    {
+        /* Skip the chunks indexed by the demuxer while reading ahead */
+        if( p_pending[i].entry.i_pos > p_sys->i_movi_lastchunk_pos )
+            avi_index_Append( &p_sys->track[p_pending[i].i_track]->idx,
+                              &p_sys->i_movi_lastchunk_pos,
+                              &p_pending[i].entry );
+    }
+    free( p_pending );
+
+    if( b_done )
+    {
+        AVI_IndexBuilderStop( p_demux );
+        for( unsigned i = 0; i < p_sys->i_track; i++ )
+            msg_Dbg( p_demux, "stream[%u] built %u index entries in background",
+                     i, p_sys->track[i]->idx.i_size );
+
+        p_sys->i_length = AVI_MovieGetLength( p_demux );
+        if( b_complete )
+            AVI_IndexCacheSave( p_demux );
     }
 }
 
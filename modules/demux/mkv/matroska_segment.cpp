@@ -528,6 +528,24 @@ bool matroska_segment_c::PreloadFamily( const matroska_segment_c & of_segment )
     return false;
 }
 
+/* Segments without cues are indexed by scanning their clusters, keep what
+ * was found for the next time the file is opened */
+void matroska_segment_c::IndexCacheLoad( const char *psz_name )
+{
+    uint64_t i_size;
+
+    if( b_cues || vlc_stream_GetSize( sys.demuxer.s, &i_size ) )
+        return;
+
+    _seeker.load_index( &sys.demuxer, psz_name, i_size );
+}
+
+void matroska_segment_c::IndexCacheSave( const char *psz_name ) const
+{
+    if( !b_cues && _seeker._ranges_changed )
+        _seeker.save_index( &sys.demuxer, psz_name );
+}
+
 bool matroska_segment_c::CompareSegmentUIDs( const matroska_segment_c * p_item_a, const matroska_segment_c * p_item_b )
 {
     EbmlBinary *p_tmp;
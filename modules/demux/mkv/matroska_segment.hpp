@@ -153,6 +153,9 @@ public:
 
     bool SameFamily( const matroska_segment_c & of_segment ) const;
 
+    void IndexCacheLoad( const char *psz_name );
+    void IndexCacheSave( const char *psz_name ) const;
+
 private:
     void LoadCues( KaxCues *cues );
     void LoadTags( KaxTags *tags );
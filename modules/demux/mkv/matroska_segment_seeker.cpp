@@ -379,6 +379,8 @@ SegmentSeeker::mark_range_as_searched( Range data )
 
         _ranges_searched = merged;
     }
+
+    _ranges_changed = true;
 }
 
 
@@ -410,6 +412,151 @@ SegmentSeeker::get_search_areas( fptr_t start, fptr_t end ) const
     return areas_to_search;
 }
 
+// The ranges searched, with the clusters and seekpoints found in them, are
+// cached for files without cues, so that they are not scanned again the next
+// time they are opened. Layout (big endian): range count and ranges (start,
+// end), cluster count and positions, track count, then for each track its
+// id, seekpoint count and seekpoints (fpos, pts, trust level).
+
+namespace {
+    struct IndexWriter
+    {
+        std::vector<uint8_t> data;
+
+        void u32( uint32_t v ) { uint8_t b[4]; SetDWBE( b, v ); data.insert( data.end(), b, b + 4 ); }
+        void u64( uint64_t v ) { uint8_t b[8]; SetQWBE( b, v ); data.insert( data.end(), b, b + 8 ); }
+    };
+
+    struct IndexReader
+    {
+        IndexReader( uint8_t const * p, size_t size ) : p( p ), end( p + size ) { }
+
+        uint8_t const * p;
+        uint8_t const * end;
+
+        bool has( size_t count, size_t size ) const { return size_t( end - p ) / size >= count; }
+        uint32_t u32() { uint32_t v = GetDWBE( p ); p += 4; return v; }
+        uint64_t u64() { uint64_t v = GetQWBE( p ); p += 8; return v; }
+    };
+}
+
+bool
+SegmentSeeker::load_index( demux_t * p_demux, const char * psz_name, fptr_t file_size )
+{
+    size_t i_size;
+    uint8_t * p_data = static_cast<uint8_t*>( demux_IndexCacheLoad( p_demux, psz_name, &i_size ) );
+
+    if( p_data == NULL )
+        return false;
+
+    IndexReader r( p_data, i_size );
+    ranges_t ranges;
+    cluster_positions_t clusters;
+    tracks_seekpoints_t tracks;
+    bool b_valid = false;
+
+    do
+    {
+        uint32_t count = r.has( 1, 4 ) ? r.u32() : 0;
+        size_t const range_count = count;
+        if( count == 0 || !r.has( count, 16 ) )
+            break;
+        for( ; count > 0; --count )
+        {
+            fptr_t start = r.u64(), end = r.u64();
+            if( start > end || end > file_size )
+                break;
+            ranges.push_back( Range( start, end ) );
+        }
+
+        count = r.has( 1, 4 ) ? r.u32() : 0;
+        if( ranges.size() != range_count || !r.has( count, 8 ) )
+            break;
+        for( ; count > 0; --count )
+            clusters.push_back( r.u64() );
+
+        uint32_t track_count = r.has( 1, 4 ) ? r.u32() : 0;
+        for( ; track_count > 0 && r.has( 1, 8 ); --track_count )
+        {
+            track_id_t track_id = r.u32();
+            count = r.u32();
+            if( !r.has( count, 20 ) )
+                break;
+
+            seekpoints_t& seekpoints = tracks[ track_id ];
+            for( ; count > 0; --count )
+            {
+                fptr_t fpos = r.u64();
+                mtime_t pts = r.u64();
+                int trust_level = static_cast<int32_t>( r.u32() );
+                seekpoints.push_back( Seekpoint( trust_level, fpos, pts ) );
+            }
+        }
+        b_valid = track_count == 0 && r.p == r.end;
+    } while( 0 );
+
+    free( p_data );
+
+    if( !b_valid )
+    {
+        msg_Warn( p_demux, "ignoring inconsistent %s index", psz_name );
+        return false;
+    }
+
+    for( cluster_positions_t::const_iterator it = clusters.begin(); it != clusters.end(); ++it )
+    {
+        if( *it < file_size )
+            add_cluster_position( *it );
+    }
+
+    for( tracks_seekpoints_t::const_iterator it = tracks.begin(); it != tracks.end(); ++it )
+    {
+        for( seekpoints_t::const_iterator sp = it->second.begin(); sp != it->second.end(); ++sp )
+        {
+            if( sp->fpos < file_size )
+                add_seekpoint( it->first, sp->trust_level, sp->fpos, sp->pts );
+        }
+    }
+
+    for( ranges_t::const_iterator it = ranges.begin(); it != ranges.end(); ++it )
+        mark_range_as_searched( *it );
+
+    _ranges_changed = false;
+    return true;
+}
+
+void
+SegmentSeeker::save_index( demux_t * p_demux, const char * psz_name ) const
+{
+    IndexWriter w;
+
+    w.u32( _ranges_searched.size() );
+    for( ranges_t::const_iterator it = _ranges_searched.begin(); it != _ranges_searched.end(); ++it )
+    {
+        w.u64( it->start );
+        w.u64( it->end );
+    }
+
+    w.u32( _cluster_positions.size() );
+    for( cluster_positions_t::const_iterator it = _cluster_positions.begin(); it != _cluster_positions.end(); ++it )
+        w.u64( *it );
+
+    w.u32( _tracks_seekpoints.size() );
+    for( tracks_seekpoints_t::const_iterator it = _tracks_seekpoints.begin(); it != _tracks_seekpoints.end(); ++it )
+    {
+        w.u32( it->first );
+        w.u32( it->second.size() );
+        for( seekpoints_t::const_iterator sp = it->second.begin(); sp != it->second.end(); ++sp )
+        {
+            w.u64( sp->fpos );
+            w.u64( sp->pts );
+            w.u32( sp->trust_level );
+        }
+    }
+
+    demux_IndexCacheSave( p_demux, psz_name, &w.data[0], w.data.size() );
+}
+
 void
 SegmentSeeker::mkv_jump_to( matroska_segment_c& ms, fptr_t fpos )
 {
@@ -116,7 +116,13 @@ class SegmentSeeker
         void mark_range_as_searched( Range );
         ranges_t get_search_areas( fptr_t start, fptr_t end ) const;
 
+        bool load_index( demux_t *, const char *psz_name, fptr_t file_size );
+        void save_index( demux_t *, const char *psz_name ) const;
+
+        SegmentSeeker() : _ranges_changed( false ) { }
+
     public:
+        bool                _ranges_changed;
         ranges_t            _ranges_searched;
         tracks_seekpoints_t _tracks_seekpoints;
         cluster_positions_t _cluster_positions;
@@ -89,6 +89,21 @@ static int  Demux  ( demux_t * );
 static int  Control( demux_t *, int, va_list );
 static void Seek   ( demux_t *, mtime_t i_mk_date, double f_percent, virtual_chapter_c *p_vchapter, bool b_precise = true );
 
+/* The seek indexes are cached per segment of the opened file */
+static void IndexCache( matroska_stream_c *p_stream, bool b_save )
+{
+    for( size_t i = 0; i < p_stream->segments.size(); i++ )
+    {
+        char psz_name[32];
+        snprintf( psz_name, sizeof( psz_name ), "mkv%zu", i );
+
+        if( b_save )
+            p_stream->segments[i]->IndexCacheSave( psz_name );
+        else
+            p_stream->segments[i]->IndexCacheLoad( psz_name );
+    }
+}
+
 /*****************************************************************************
  * Open: initializes matroska demux structures
  *****************************************************************************/
@@ -147,6 +162,7 @@ static int Open( vlc_object_t * p_this )
              p_stream->segments[i]->families.size() )
             b_need_preload = true;
     }
+    IndexCache( p_stream, false );
 
     p_segment = p_stream->segments[0];
     if( p_segment->cluster == NULL && p_segment->stored_editions.size() == 0 )
@@ -285,6 +301,10 @@ static void Close( vlc_object_t *p_this )
             p_segment->ESDestroy();
     }
 
+    /* the segments of the opened file are all preloaded, so never freed */
+    if( !p_sys->streams.empty() && p_sys->streams[0] != NULL )
+        IndexCache( p_sys->streams[0], true );
+
     delete p_sys;
 }
 
@@ -1377,6 +1377,71 @@ static int MP4_ReadBox_LtdContainer( stream_t *p_stream, MP4_Box_t *p_box )
     MP4_READBOX_EXIT( 1 );
 }
 
+/* Sample tables can hold millions of entries. Rather than reading a whole
+ * table box into a temporary buffer, then converting it to the box arrays,
+ * only the fixed fields are read with the box, then the entries are read
+ * from the stream by bounded windows, straight into their arrays. */
+#define MP4_TABLE_WINDOW 1024 /* 32-bits words */
+
+/* Returns how many entries of i_entry_size bytes are left in the box */
+static uint32_t MP4_TableEntriesLeft( stream_t *p_stream, const MP4_Box_t *p_box,
+                                      uint32_t i_count, size_t i_entry_size )
+{
+    const uint64_t i_end = p_box->i_pos + p_box->i_size;
+    const uint64_t i_tell = vlc_stream_Tell( p_stream );
+    if( i_tell >= i_end )
+        return 0;
+    return __MIN( i_count, ( i_end - i_tell ) / i_entry_size );
+}
+
+/* Reads up to i_count big endian 32-bits words, in place */
+static uint32_t MP4_ReadTable32( stream_t *p_stream, uint32_t *p_dst,
+                                 uint32_t i_count )
+{
+    ssize_t i_ret = vlc_stream_Read( p_stream, p_dst, (size_t)i_count * 4 );
+    if( i_ret < 0 )
+        return 0;
+    i_count = i_ret / 4;
+    for( uint32_t i = 0; i < i_count; i++ )
+        p_dst[i] = ntoh32( p_dst[i] );
+    return i_count;
+}
+
+/* Reads up to i_count entries of i_fields big endian 32-bits words,
+ * each field going to its own array */
+static uint32_t MP4_ReadTableFields32( stream_t *p_stream, uint32_t **pp_dst,
+                                       unsigned i_fields, uint32_t i_count )
+{
+    uint8_t window[MP4_TABLE_WINDOW * 4];
+    const uint32_t i_window = MP4_TABLE_WINDOW / i_fields;
+    uint32_t i = 0;
+
+    while( i < i_count )
+    {
+        const size_t i_toread = __MIN( i_count - i, i_window ) * i_fields * 4;
+        ssize_t i_ret = vlc_stream_Read( p_stream, window, i_toread );
+        if( i_ret < 0 )
+            break;
+
+        const uint8_t *p_peek = window;
+        for( uint32_t j = i_ret / ( i_fields * 4 ); j > 0; j--, i++ )
+            for( unsigned k = 0; k < i_fields; k++, p_peek += 4 )
+                pp_dst[k][i] = GetDWBE( p_peek );
+
+        if( (size_t)i_ret < i_toread )
+            break;
+    }
+    return i;
+}
+
+/* Moves to the end of a table box, if its entries were not all read */
+static void MP4_TableSkip( stream_t *p_stream, const MP4_Box_t *p_box )
+{
+    const uint64_t i_end = p_box->i_pos + p_box->i_size;
+    if( (uint64_t)vlc_stream_Tell( p_stream ) != i_end )
+        MP4_Seek( p_stream, i_end );
+}
+
 static void MP4_FreeBox_stts( MP4_Box_t *p_box )
 {
     FREENULL( p_box->data.p_stts->pi_sample_count );
@@ -1385,7 +1450,9 @@ static void MP4_FreeBox_stts( MP4_Box_t *p_box )
 
 static int MP4_ReadBox_stts( stream_t *p_stream, MP4_Box_t *p_box )
 {
-    MP4_READBOX_ENTER( MP4_Box_data_stts_t, MP4_FreeBox_stts );
+    MP4_READBOX_ENTER_PARTIAL( MP4_Box_data_stts_t,
+                               mp4_box_headersize( p_box ) + 8,
+                               MP4_FreeBox_stts );
 
     MP4_GETVERSIONFLAGS( p_box->data.p_stts );
     MP4_GET4BYTES( p_box->data.p_stts->i_entry_count );
@@ -1400,15 +1467,15 @@ static int MP4_ReadBox_stts( stream_t *p_stream, MP4_Box_t *p_box )
         MP4_READBOX_EXIT( 0 );
     }
 
-    uint32_t i = 0;
-    for( ; (i < p_box->data.p_stts->i_entry_count )&&( i_read >=8 ); i++ )
-    {
-        MP4_GET4BYTES( p_box->data.p_stts->pi_sample_count[i] );
-        MP4_GET4BYTES( p_box->data.p_stts->pi_sample_delta[i] );
-    }
-
-    if ( i < p_box->data.p_stts->i_entry_count )
-        p_box->data.p_stts->i_entry_count = i;
+    uint32_t *pp_fields[2] = {
+        p_box->data.p_stts->pi_sample_count,
+        (uint32_t *) p_box->data.p_stts->pi_sample_delta,
+    };
+    p_box->data.p_stts->i_entry_count =
+        MP4_ReadTableFields32( p_stream, pp_fields, 2,
+            MP4_TableEntriesLeft( p_stream, p_box,
+                                  p_box->data.p_stts->i_entry_count, 8 ) );
+    MP4_TableSkip( p_stream, p_box );
 
 #ifdef MP4_VERBOSE
     msg_Dbg( p_stream, "read box: \"stts\" entry-count %d",
@@ -1427,7 +1494,9 @@ static void MP4_FreeBox_ctts( MP4_Box_t *p_box )
 
 static int MP4_ReadBox_ctts( stream_t *p_stream, MP4_Box_t *p_box )
 {
-    MP4_READBOX_ENTER( MP4_Box_data_ctts_t, MP4_FreeBox_ctts );
+    MP4_READBOX_ENTER_PARTIAL( MP4_Box_data_ctts_t,
+                               mp4_box_headersize( p_box ) + 8,
+                               MP4_FreeBox_ctts );
 
     MP4_GETVERSIONFLAGS( p_box->data.p_ctts );
 
@@ -1443,14 +1512,15 @@ static int MP4_ReadBox_ctts( stream_t *p_stream, MP4_Box_t *p_box )
         MP4_READBOX_EXIT( 0 );
     }
 
-    uint32_t i = 0;
-    for( ; (i < p_box->data.p_ctts->i_entry_count )&&( i_read >=8 ); i++ )
-    {
-        MP4_GET4BYTES( p_box->data.p_ctts->pi_sample_count[i] );
-        MP4_GET4BYTES( p_box->data.p_ctts->pi_sample_offset[i] );
-    }
-    if ( i < p_box->data.p_ctts->i_entry_count )
-        p_box->data.p_ctts->i_entry_count = i;
+    uint32_t *pp_fields[2] = {
+        p_box->data.p_ctts->pi_sample_count,
+        (uint32_t *) p_box->data.p_ctts->pi_sample_offset,
+    };
+    p_box->data.p_ctts->i_entry_count =
+        MP4_ReadTableFields32( p_stream, pp_fields, 2,
+            MP4_TableEntriesLeft( p_stream, p_box,
+                                  p_box->data.p_ctts->i_entry_count, 8 ) );
+    MP4_TableSkip( p_stream, p_box );
 
 #ifdef MP4_VERBOSE
     msg_Dbg( p_stream, "read box: \"ctts\" entry-count %d",
@@ -2638,7 +2708,9 @@ static void MP4_FreeBox_stsz( MP4_Box_t *p_box )
 
 static int MP4_ReadBox_stsz( stream_t *p_stream, MP4_Box_t *p_box )
 {
-    MP4_READBOX_ENTER( MP4_Box_data_stsz_t, MP4_FreeBox_stsz );
+    MP4_READBOX_ENTER_PARTIAL( MP4_Box_data_stsz_t,
+                               mp4_box_headersize( p_box ) + 12,
+                               MP4_FreeBox_stsz );
 
     MP4_GETVERSIONFLAGS( p_box->data.p_stsz );
 
@@ -2652,13 +2724,13 @@ static int MP4_ReadBox_stsz( stream_t *p_stream, MP4_Box_t *p_box )
         if( unlikely( !p_box->data.p_stsz->i_entry_size ) )
             MP4_READBOX_EXIT( 0 );
 
-        for( unsigned int i = 0; (i<p_box->data.p_stsz->i_sample_count)&&(i_read >= 4 ); i++ )
-        {
-            MP4_GET4BYTES( p_box->data.p_stsz->i_entry_size[i] );
-        }
+        MP4_ReadTable32( p_stream, p_box->data.p_stsz->i_entry_size,
+                         MP4_TableEntriesLeft( p_stream, p_box,
+                                    p_box->data.p_stsz->i_sample_count, 4 ) );
     }
     else
         p_box->data.p_stsz->i_entry_size = NULL;
+    MP4_TableSkip( p_stream, p_box );
 
 #ifdef MP4_VERBOSE
     msg_Dbg( p_stream, "read box: \"stsz\" sample-size %d sample-count %d",
@@ -2678,7 +2750,9 @@ static void MP4_FreeBox_stsc( MP4_Box_t *p_box )
 
 static int MP4_ReadBox_stsc( stream_t *p_stream, MP4_Box_t *p_box )
 {
-    MP4_READBOX_ENTER( MP4_Box_data_stsc_t, MP4_FreeBox_stsc );
+    MP4_READBOX_ENTER_PARTIAL( MP4_Box_data_stsc_t,
+                               mp4_box_headersize( p_box ) + 8,
+                               MP4_FreeBox_stsc );
 
     MP4_GETVERSIONFLAGS( p_box->data.p_stsc );
 
@@ -2697,12 +2771,15 @@ static int MP4_ReadBox_stsc( stream_t *p_stream, MP4_Box_t *p_box )
         MP4_READBOX_EXIT( 0 );
     }
 
-    for( unsigned int i = 0; (i < p_box->data.p_stsc->i_entry_count )&&( i_read >= 12 );i++ )
-    {
-        MP4_GET4BYTES( p_box->data.p_stsc->i_first_chunk[i] );
-        MP4_GET4BYTES( p_box->data.p_stsc->i_samples_per_chunk[i] );
-        MP4_GET4BYTES( p_box->data.p_stsc->i_sample_description_index[i] );
-    }
+    uint32_t *pp_fields[3] = {
+        p_box->data.p_stsc->i_first_chunk,
+        p_box->data.p_stsc->i_samples_per_chunk,
+        p_box->data.p_stsc->i_sample_description_index,
+    };
+    MP4_ReadTableFields32( p_stream, pp_fields, 3,
+        MP4_TableEntriesLeft( p_stream, p_box,
+                              p_box->data.p_stsc->i_entry_count, 12 ) );
+    MP4_TableSkip( p_stream, p_box );
 
 #ifdef MP4_VERBOSE
     msg_Dbg( p_stream, "read box: \"stsc\" entry-count %d",
@@ -2776,7 +2853,9 @@ static void MP4_FreeBox_stco_co64( MP4_Box_t *p_box )
 
 static int MP4_ReadBox_stco_co64( stream_t *p_stream, MP4_Box_t *p_box )
 {
-    MP4_READBOX_ENTER( MP4_Box_data_co64_t, MP4_FreeBox_stco_co64 );
+    MP4_READBOX_ENTER_PARTIAL( MP4_Box_data_co64_t,
+                               mp4_box_headersize( p_box ) + 8,
+                               MP4_FreeBox_stco_co64 );
 
     MP4_GETVERSIONFLAGS( p_box->data.p_co64 );
 
@@ -2787,25 +2866,31 @@ static int MP4_ReadBox_stco_co64( stream_t *p_stream, MP4_Box_t *p_box )
     if( p_box->data.p_co64->i_chunk_offset == NULL )
         MP4_READBOX_EXIT( 0 );
 
-    for( unsigned int i = 0; i < p_box->data.p_co64->i_entry_count; i++ )
+    uint64_t *p_offset = p_box->data.p_co64->i_chunk_offset;
+    if( p_box->i_type == ATOM_stco )
     {
-        if( p_box->i_type == ATOM_stco )
+        uint32_t window[MP4_TABLE_WINDOW];
+        uint32_t i_count = MP4_TableEntriesLeft( p_stream, p_box,
+                                    p_box->data.p_co64->i_entry_count, 4 );
+        for( uint32_t i = 0; i < i_count; )
         {
-            if( i_read < 4 )
-            {
+            uint32_t i_toread = __MIN( i_count - i, MP4_TABLE_WINDOW );
+            uint32_t i_window = MP4_ReadTable32( p_stream, window, i_toread );
+            for( uint32_t j = 0; j < i_window; j++ )
+                p_offset[i++] = window[j];
+            if( i_window < i_toread )
                 break;
-            }
-            MP4_GET4BYTES( p_box->data.p_co64->i_chunk_offset[i] );
-        }
-        else
-        {
-            if( i_read < 8 )
-            {
-                break;
-            }
-            MP4_GET8BYTES( p_box->data.p_co64->i_chunk_offset[i] );
         }
     }
+    else
+    {
+        uint32_t i_count = MP4_TableEntriesLeft( p_stream, p_box,
+                                    p_box->data.p_co64->i_entry_count, 8 );
+        ssize_t i_ret = vlc_stream_Read( p_stream, p_offset, i_count * 8 );
+        for( ssize_t i = 0; i < i_ret / 8; i++ )
+            p_offset[i] = ntoh64( p_offset[i] );
+    }
+    MP4_TableSkip( p_stream, p_box );
 
 #ifdef MP4_VERBOSE
     msg_Dbg( p_stream, "read box: \"co64\" entry-count %d",
@@ -2822,7 +2907,9 @@ static void MP4_FreeBox_stss( MP4_Box_t *p_box )
 
 static int MP4_ReadBox_stss( stream_t *p_stream, MP4_Box_t *p_box )
 {
-    MP4_READBOX_ENTER( MP4_Box_data_stss_t, MP4_FreeBox_stss );
+    MP4_READBOX_ENTER_PARTIAL( MP4_Box_data_stss_t,
+                               mp4_box_headersize( p_box ) + 8,
+                               MP4_FreeBox_stss );
 
     MP4_GETVERSIONFLAGS( p_box->data.p_stss );
 
@@ -2833,16 +2920,14 @@ static int MP4_ReadBox_stss( stream_t *p_stream, MP4_Box_t *p_box )
     if( unlikely( p_box->data.p_stss->i_sample_number == NULL ) )
         MP4_READBOX_EXIT( 0 );
 
-    unsigned int i;
-    for( i = 0; (i < p_box->data.p_stss->i_entry_count )&&( i_read >= 4 ); i++ )
-    {
-
-        MP4_GET4BYTES( p_box->data.p_stss->i_sample_number[i] );
-        /* XXX in libmp4 sample begin at 0 */
+    p_box->data.p_stss->i_entry_count =
+        MP4_ReadTable32( p_stream, p_box->data.p_stss->i_sample_number,
+                         MP4_TableEntriesLeft( p_stream, p_box,
+                                    p_box->data.p_stss->i_entry_count, 4 ) );
+    /* XXX in libmp4 sample begin at 0 */
+    for( uint32_t i = 0; i < p_box->data.p_stss->i_entry_count; i++ )
         p_box->data.p_stss->i_sample_number[i]--;
-    }
-    if ( i < p_box->data.p_stss->i_entry_count )
-        p_box->data.p_stss->i_entry_count = i;
+    MP4_TableSkip( p_stream, p_box );
 
 #ifdef MP4_VERBOSE
     msg_Dbg( p_stream, "read box: \"stss\" entry-count %d",
@@ -3840,18 +3925,21 @@ static void MP4_FreeBox_sdtp( MP4_Box_t *p_box )
 static int MP4_ReadBox_sdtp( stream_t *p_stream, MP4_Box_t *p_box )
 {
     uint32_t i_sample_count;
-    MP4_READBOX_ENTER( MP4_Box_data_sdtp_t, MP4_FreeBox_sdtp );
+    MP4_READBOX_ENTER_PARTIAL( MP4_Box_data_sdtp_t,
+                               mp4_box_headersize( p_box ) + 4,
+                               MP4_FreeBox_sdtp );
     MP4_Box_data_sdtp_t *p_sdtp = p_box->data.p_sdtp;
     MP4_GETVERSIONFLAGS( p_box->data.p_sdtp );
-    i_sample_count = i_read;
+    i_sample_count = MP4_TableEntriesLeft( p_stream, p_box, UINT32_MAX, 1 );
 
     p_sdtp->p_sample_table = calloc( i_sample_count, 1 );
 
     if( !p_sdtp->p_sample_table )
         MP4_READBOX_EXIT( 0 );
 
-    for( uint32_t i = 0; i < i_sample_count; i++ )
-        MP4_GET1BYTE( p_sdtp->p_sample_table[i] );
+    if( vlc_stream_Read( p_stream, p_sdtp->p_sample_table, i_sample_count ) < 0 )
+        MP4_READBOX_EXIT( 0 );
+    MP4_TableSkip( p_stream, p_box );
 
 #ifdef MP4_VERBOSE
     msg_Dbg( p_stream, "i_sample_count is %"PRIu32"", i_sample_count );
@@ -223,21 +223,24 @@ static inline int64_t MP4_TrackGetDTS( demux_t *p_demux, mp4_track_t *p_track )
                                   : &p_track->chunk[p_track->i_chunk];
 
     unsigned int i_index = 0;
-    unsigned int i_sample = p_track->i_sample - p_chunk->i_sample_first;
-    int64_t i_dts = p_chunk->i_first_dts;
+    unsigned int i_sample = p_track->i_sample - p_chunk->i_sample_first
+                          + p_chunk->i_skip_dts;
+    int64_t i_dts = p_chunk->i_first_dts
+                  - (int64_t)p_chunk->i_skip_dts * (p_chunk->i_entries_dts
+                                ? p_chunk->p_sample_delta_dts[0] : 0);
 
     while( i_sample > 0 && i_index < p_chunk->i_entries_dts )
     {
         if( i_sample > p_chunk->p_sample_count_dts[i_index] )
         {
-            i_dts += p_chunk->p_sample_count_dts[i_index] *
+            i_dts += (int64_t)p_chunk->p_sample_count_dts[i_index] *
                 p_chunk->p_sample_delta_dts[i_index];
             i_sample -= p_chunk->p_sample_count_dts[i_index];
             i_index++;
         }
         else
         {
-            i_dts += i_sample * p_chunk->p_sample_delta_dts[i_index];
+            i_dts += (int64_t)i_sample * p_chunk->p_sample_delta_dts[i_index];
             break;
         }
     }
@@ -265,16 +268,13 @@ static inline int64_t MP4_TrackGetDTS( demux_t *p_demux, mp4_track_t *p_track )
     return CLOCK_FREQ * i_dts / p_track->i_timescale;
 }
 
-static inline bool MP4_TrackGetPTSDelta( demux_t *p_demux, mp4_track_t *p_track,
-                                         int64_t *pi_delta )
+/* Returns the composition offset of the i_sample-th sample of a chunk */
+static inline bool MP4_ChunkGetPTSDelta( const mp4_chunk_t *ck, uint32_t i_sample,
+                                         uint32_t i_timescale, int64_t *pi_delta )
 {
-    VLC_UNUSED( p_demux );
-    mp4_chunk_t *ck;
-    ck = ( p_track->cchunk ) ? p_track->cchunk /* DemuxFrg */
-                             : &p_track->chunk[p_track->i_chunk];
-
     unsigned int i_index = 0;
-    unsigned int i_sample = p_track->i_sample - ck->i_sample_first;
+
+    i_sample += ck->i_skip_pts;
 
     if( ck->p_sample_count_pts == NULL || ck->p_sample_offset_pts == NULL )
         return false;
@@ -284,7 +284,7 @@ static inline bool MP4_TrackGetPTSDelta( demux_t *p_demux, mp4_track_t *p_track,
         if( i_sample < ck->p_sample_count_pts[i_index] )
         {
             *pi_delta = ck->p_sample_offset_pts[i_index] * CLOCK_FREQ /
-                        (int64_t)p_track->i_timescale;
+                        (int64_t)i_timescale;
             return true;
         }
 
@@ -293,6 +293,18 @@ static inline bool MP4_TrackGetPTSDelta( demux_t *p_demux, mp4_track_t *p_track,
     return false;
 }
 
+static inline bool MP4_TrackGetPTSDelta( demux_t *p_demux, mp4_track_t *p_track,
+                                         int64_t *pi_delta )
+{
+    VLC_UNUSED( p_demux );
+    mp4_chunk_t *ck;
+    ck = ( p_track->cchunk ) ? p_track->cchunk /* DemuxFrg */
+                             : &p_track->chunk[p_track->i_chunk];
+
+    return MP4_ChunkGetPTSDelta( ck, p_track->i_sample - ck->i_sample_first,
+                                 p_track->i_timescale, pi_delta );
+}
+
 static inline int64_t MP4_GetMoviePTS(demux_sys_t *p_sys )
 {
     return CLOCK_FREQ * p_sys->i_time / p_sys->i_timescale;
@@ -2133,52 +2145,51 @@ static int TrackCreateChunksIndex( demux_t *p_demux,
     return VLC_SUCCESS;
 }
 
-static int xTTS_CountEntries( demux_t *p_demux, uint32_t *pi_entry /* out */,
-                              const uint32_t i_index,
-                              uint32_t i_index_samples_left,
-                              uint32_t i_sample_count,
-                              const uint32_t *pi_index_sample_count,
-                              const uint32_t i_table_count )
+/* Locates the entries of a stts or ctts table covering the i_sample_count
+ * samples of a chunk, starting from the state left by the previous chunk:
+ * the table index and the samples left in that entry (0 if untouched).
+ * The table itself is not copied. Returns false if the table is too short. */
+static bool TrackChunkTTS( uint32_t *pi_index, uint32_t *pi_index_samples_left,
+                           uint32_t i_sample_count,
+                           const uint32_t *pi_index_sample_count,
+                           const int32_t *pi_index_value,
+                           uint32_t i_table_count,
+                           uint32_t *pi_skip, uint32_t *pi_entries,
+                           uint64_t *pi_duration )
 {
-    uint32_t i_array_offset;
-    while( i_sample_count > 0 )
+    uint32_t i_index = *pi_index;
+    uint32_t i_left = *pi_index_samples_left;
+    uint64_t i_duration = 0;
+
+    *pi_skip = ( i_left && i_index < i_table_count )
+             ? pi_index_sample_count[i_index] - i_left : 0;
+    *pi_entries = 0;
+
+    while( i_sample_count > 0 && i_index < i_table_count )
     {
-        if ( likely((UINT32_MAX - i_index) >= *pi_entry) )
-            i_array_offset = i_index + *pi_entry;
-        else
-            return VLC_EGENERIC;
+        uint32_t i_avail = i_left ? i_left : pi_index_sample_count[i_index];
 
-        if ( i_array_offset >= i_table_count )
+        *pi_entries += 1;
+        if( i_avail > i_sample_count )
         {
-            msg_Err( p_demux, "invalid index counting total samples %u %u", i_array_offset,  i_table_count );
-            return VLC_ENOVAR;
-        }
-
-        if ( i_index_samples_left )
-        {
-            if ( i_index_samples_left > i_sample_count )
-            {
-                i_index_samples_left -= i_sample_count;
-                i_sample_count = 0;
-                *pi_entry +=1; /* No samples left, go copy */
-                break;
-            }
-            else
-            {
-                i_sample_count -= i_index_samples_left;
-                i_index_samples_left = 0;
-                *pi_entry += 1;
-                continue;
-            }
+            i_duration += (uint64_t)i_sample_count * pi_index_value[i_index];
+            i_left = i_avail - i_sample_count;
+            i_sample_count = 0;
         }
         else
         {
-            i_sample_count -= __MIN( i_sample_count, pi_index_sample_count[i_array_offset] );
-            *pi_entry += 1;
+            i_duration += (uint64_t)i_avail * pi_index_value[i_index];
+            i_sample_count -= i_avail;
+            i_left = 0;
+            i_index++;
         }
     }
 
-    return VLC_SUCCESS;
+    *pi_index = i_index;
+    *pi_index_samples_left = i_left;
+    if( pi_duration != NULL )
+        *pi_duration = i_duration;
+    return i_sample_count == 0;
 }
 
 static int TrackCreateSamplesIndex( demux_t *p_demux,
@@ -2222,16 +2233,7 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
     {
         /* 2: each sample can have a different size */
         p_demux_track->i_sample_size = 0;
-        p_demux_track->p_sample_size =
-            calloc( p_demux_track->i_sample_count, sizeof( uint32_t ) );
-        if( p_demux_track->p_sample_size == NULL )
-            return VLC_ENOMEM;
-
-        for( uint32_t i_sample = 0; i_sample < p_demux_track->i_sample_count; i_sample++ )
-        {
-            p_demux_track->p_sample_size[i_sample] =
-                    stsz->i_entry_size[i_sample];
-        }
+        p_demux_track->p_sample_size = stsz->i_entry_size;
     }
 
     if ( p_demux_track->i_chunk_count )
@@ -2264,13 +2266,9 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
 
     /* Use stts table to create a sample number -> dts table.
      * XXX: if we don't want to waste too much memory, we can't expand
-     *  the box! so each chunk will contain an "extract" of this table
-     *  for fast research (problem with raw stream where a sample is sometime
-     *  just channels*bits_per_sample/8 */
-
-     /* FIXME: refactor STTS & CTTS, STTS having now only few extra lines and
-      *        differing in 2/2 fields and 1 signedness */
-
+     *  the box! so each chunk points to the extract of this table covering
+     *  its samples, and only the first dts and duration are computed here.
+     *  Timestamps are decoded from the table when reading or seeking. */
     mtime_t i_next_dts = 0;
     /* Find stts
      *  Gives mapping between sample and decoding time
@@ -2287,100 +2285,31 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
 
         msg_Warn( p_demux, "STTS table of %"PRIu32" entries", stts->i_entry_count );
 
-        /* Create sample -> dts table per chunk */
         uint32_t i_index = 0;
         uint32_t i_current_index_samples_left = 0;
+        bool b_complete = true;
 
         for( uint32_t i_chunk = 0; i_chunk < p_demux_track->i_chunk_count; i_chunk++ )
         {
             mp4_chunk_t *ck = &p_demux_track->chunk[i_chunk];
-            uint32_t i_sample_count;
 
             /* save first dts */
             ck->i_first_dts = i_next_dts;
+            ck->p_sample_count_dts = &stts->pi_sample_count[i_index];
+            ck->p_sample_delta_dts = (uint32_t *)&stts->pi_sample_delta[i_index];
 
-            /* count how many entries are needed for this chunk
-             * for p_sample_delta_dts and p_sample_count_dts */
-            ck->i_entries_dts = 0;
-
-            int i_ret = xTTS_CountEntries( p_demux, &ck->i_entries_dts, i_index,
-                                           i_current_index_samples_left,
-                                           ck->i_sample_count,
-                                           stts->pi_sample_count,
-                                           stts->i_entry_count );
-            if ( i_ret == VLC_EGENERIC )
-                return i_ret;
-
-            /* allocate them */
-            ck->p_sample_count_dts = calloc( ck->i_entries_dts, sizeof( uint32_t ) );
-            ck->p_sample_delta_dts = calloc( ck->i_entries_dts, sizeof( uint32_t ) );
-            if( !ck->p_sample_count_dts || !ck->p_sample_delta_dts )
-            {
-                free( ck->p_sample_count_dts );
-                free( ck->p_sample_delta_dts );
-                msg_Err( p_demux, "can't allocate memory for i_entry=%"PRIu32, ck->i_entries_dts );
-                ck->i_entries_dts = 0;
-                return VLC_ENOMEM;
-            }
-
-            /* now copy */
-            i_sample_count = ck->i_sample_count;
-
-            for( uint32_t i = 0; i < ck->i_entries_dts; i++ )
-            {
-                if ( i_current_index_samples_left )
-                {
-                    if ( i_current_index_samples_left > i_sample_count )
-                    {
-                        ck->p_sample_count_dts[i] = i_sample_count;
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        if ( i_sample_count ) ck->i_duration = i_next_dts - ck->i_first_dts;
-                        i_current_index_samples_left -= i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_dts - 1 );
-                        break;
-                    }
-                    else
-                    {
-                        ck->p_sample_count_dts[i] = i_current_index_samples_left;
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        if ( i_current_index_samples_left ) ck->i_duration = i_next_dts - ck->i_first_dts;
-                        i_sample_count -= i_current_index_samples_left;
-                        i_current_index_samples_left = 0;
-                        i_index++;
-                    }
-                }
-                else
-                {
-                    if ( stts->pi_sample_count[i_index] > i_sample_count )
-                    {
-                        ck->p_sample_count_dts[i] = i_sample_count;
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        if ( i_sample_count ) ck->i_duration = i_next_dts - ck->i_first_dts;
-                        i_current_index_samples_left = stts->pi_sample_count[i_index] - i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_dts - 1 );
-                        // keep building from same index
-                    }
-                    else
-                    {
-                        ck->p_sample_count_dts[i] = stts->pi_sample_count[i_index];
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        if ( stts->pi_sample_count[i_index] ) ck->i_duration = i_next_dts - ck->i_first_dts;
-                        i_sample_count -= stts->pi_sample_count[i_index];
-                        i_index++;
-                    }
-                }
-
-            }
+            b_complete &= TrackChunkTTS( &i_index, &i_current_index_samples_left,
+                                         ck->i_sample_count, stts->pi_sample_count,
+                                         stts->pi_sample_delta, stts->i_entry_count,
+                                         &ck->i_skip_dts, &ck->i_entries_dts,
+                                         &ck->i_duration );
+            i_next_dts += ck->i_duration;
         }
+        if( !b_complete )
+            msg_Err( p_demux, "STTS table is too small for %"PRIu32" samples",
+                     p_demux_track->i_sample_count );
     }
 
-
     /* Find ctts
      *  Gives the delta between decoding time (dts) and composition table (pts)
      */
@@ -2391,86 +2320,25 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
 
         msg_Warn( p_demux, "CTTS table of %"PRIu32" entries", ctts->i_entry_count );
 
-        /* Create pts-dts table per chunk */
         uint32_t i_index = 0;
         uint32_t i_current_index_samples_left = 0;
+        bool b_complete = true;
 
         for( uint32_t i_chunk = 0; i_chunk < p_demux_track->i_chunk_count; i_chunk++ )
         {
             mp4_chunk_t *ck = &p_demux_track->chunk[i_chunk];
-            uint32_t i_sample_count;
-
-            /* count how many entries are needed for this chunk
-             * for p_sample_offset_pts and p_sample_count_pts */
-            ck->i_entries_pts = 0;
-            int i_ret = xTTS_CountEntries( p_demux, &ck->i_entries_pts, i_index,
-                                           i_current_index_samples_left,
-                                           ck->i_sample_count,
-                                           ctts->pi_sample_count,
-                                           ctts->i_entry_count );
-            if ( i_ret == VLC_EGENERIC )
-                return i_ret;
-
-            /* allocate them */
-            ck->p_sample_count_pts = calloc( ck->i_entries_pts, sizeof( uint32_t ) );
-            ck->p_sample_offset_pts = calloc( ck->i_entries_pts, sizeof( int32_t ) );
-            if( !ck->p_sample_count_pts || !ck->p_sample_offset_pts )
-            {
-                free( ck->p_sample_count_pts );
-                free( ck->p_sample_offset_pts );
-                msg_Err( p_demux, "can't allocate memory for i_entry=%"PRIu32, ck->i_entries_pts );
-                ck->i_entries_pts = 0;
-                return VLC_ENOMEM;
-            }
 
-            /* now copy */
-            i_sample_count = ck->i_sample_count;
+            ck->p_sample_count_pts = &ctts->pi_sample_count[i_index];
+            ck->p_sample_offset_pts = &ctts->pi_sample_offset[i_index];
 
-            for( uint32_t i = 0; i < ck->i_entries_pts; i++ )
-            {
-                if ( i_current_index_samples_left )
-                {
-                    if ( i_current_index_samples_left > i_sample_count )
-                    {
-                        ck->p_sample_count_pts[i] = i_sample_count;
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index];
-                        i_current_index_samples_left -= i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_pts - 1 );
-                        break;
-                    }
-                    else
-                    {
-                        ck->p_sample_count_pts[i] = i_current_index_samples_left;
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index];
-                        i_sample_count -= i_current_index_samples_left;
-                        i_current_index_samples_left = 0;
-                        i_index++;
-                    }
-                }
-                else
-                {
-                    if ( ctts->pi_sample_count[i_index] > i_sample_count )
-                    {
-                        ck->p_sample_count_pts[i] = i_sample_count;
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index];
-                        i_current_index_samples_left = ctts->pi_sample_count[i_index] - i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_pts - 1 );
-                        // keep building from same index
-                    }
-                    else
-                    {
-                        ck->p_sample_count_pts[i] = ctts->pi_sample_count[i_index];
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index];
-                        i_sample_count -= ctts->pi_sample_count[i_index];
-                        i_index++;
-                    }
-                }
-
-
-            }
+            b_complete &= TrackChunkTTS( &i_index, &i_current_index_samples_left,
+                                         ck->i_sample_count, ctts->pi_sample_count,
+                                         ctts->pi_sample_offset, ctts->i_entry_count,
+                                         &ck->i_skip_pts, &ck->i_entries_pts, NULL );
         }
+        if( !b_complete )
+            msg_Err( p_demux, "CTTS table is too small for %"PRIu32" samples",
+                     p_demux_track->i_sample_count );
     }
 
     msg_Dbg( p_demux, "track[Id 0x%x] read %"PRIu32" samples length:%"PRId64"s",
@@ -2772,33 +2640,39 @@ static int TrackTimeToSampleChunk( demux_t *p_demux, mp4_track_t *p_track,
     }
 
     /* *** find sample in the chunk *** */
-    i_sample = p_track->chunk[i_chunk].i_sample_first;
-    i_dts    = p_track->chunk[i_chunk].i_first_dts;
-    for( i_index = 0; i_sample < p_track->chunk[i_chunk].i_sample_count; )
+    const mp4_chunk_t *ck = &p_track->chunk[i_chunk];
+
+    /* start from the beginning of the first stts entry of the chunk */
+    i_sample = ck->i_sample_first - ck->i_skip_dts;
+    i_dts    = ck->i_first_dts;
+    if( ck->i_entries_dts > 0 )
+        i_dts -= (uint64_t)ck->i_skip_dts * ck->p_sample_delta_dts[0];
+
+    for( i_index = 0; (uint32_t)i_index < ck->i_entries_dts; )
     {
-        if( i_dts +
-            p_track->chunk[i_chunk].p_sample_count_dts[i_index] *
-            p_track->chunk[i_chunk].p_sample_delta_dts[i_index] < (uint64_t)i_start )
+        if( i_dts + (uint64_t)ck->p_sample_count_dts[i_index] *
+            ck->p_sample_delta_dts[i_index] < (uint64_t)i_start )
         {
-            i_dts    +=
-                p_track->chunk[i_chunk].p_sample_count_dts[i_index] *
-                p_track->chunk[i_chunk].p_sample_delta_dts[i_index];
-
-            i_sample += p_track->chunk[i_chunk].p_sample_count_dts[i_index];
+            i_dts    += (uint64_t)ck->p_sample_count_dts[i_index] *
+                        ck->p_sample_delta_dts[i_index];
+            i_sample += ck->p_sample_count_dts[i_index];
             i_index++;
         }
         else
         {
-            if( p_track->chunk[i_chunk].p_sample_delta_dts[i_index] <= 0 )
+            if( ck->p_sample_delta_dts[i_index] <= 0 ||
+                (uint64_t)i_start < i_dts )
             {
                 break;
             }
-            i_sample += ( i_start - i_dts ) /
-                p_track->chunk[i_chunk].p_sample_delta_dts[i_index];
+            i_sample += ( i_start - i_dts ) / ck->p_sample_delta_dts[i_index];
             break;
         }
     }
 
+    if( i_sample < ck->i_sample_first )
+        i_sample = ck->i_sample_first;
+
     if( i_sample >= p_track->i_sample_count )
     {
         msg_Warn( p_demux, "track[Id 0x%x] will be disabled "
@@ -3253,11 +3127,7 @@ static void MP4_TrackDestroy( demux_t *p_demux, mp4_track_t *p_track )
     if( p_track->p_es )
         es_out_Del( p_demux->out, p_track->p_es );
 
-    if( p_track->chunk )
-    {
-        for( unsigned int i_chunk = 0; i_chunk < p_track->i_chunk_count; i_chunk++ )
-            DestroyChunk( &p_track->chunk[i_chunk] );
-    }
+    /* chunks from the moov only point to the boxes tables */
     free( p_track->chunk );
 
     if( p_track->cchunk )
@@ -3267,9 +3137,6 @@ static void MP4_TrackDestroy( demux_t *p_demux, mp4_track_t *p_track )
         free( p_track->cchunk );
     }
 
-    if( !p_track->i_sample_size )
-        free( p_track->p_sample_size );
-
     if ( p_track->asfinfo.p_frame )
         block_ChainRelease( p_track->asfinfo.p_frame );
 }
@@ -4681,23 +4548,27 @@ static int LeafMOOVGetSamplesSize( const mp4_track_t *p_track, const uint32_t i_
     return VLC_SUCCESS;
 }
 
+/* Returns the decoding time of a sample relative to the chunk first dts */
 static inline mtime_t LeafGetMOOVTimeInChunk( const mp4_chunk_t *p_chunk, uint32_t i_sample )
 {
-    mtime_t i_time = 0;
+    /* The first stts entry can start before the chunk, as in MP4_TrackGetDTS */
+    mtime_t i_time = -(mtime_t)p_chunk->i_skip_dts * (p_chunk->i_entries_dts
+                        ? p_chunk->p_sample_delta_dts[0] : 0);
     uint32_t i_index = 0;
 
-    while( i_sample > 0 )
+    i_sample += p_chunk->i_skip_dts;
+    while( i_sample > 0 && i_index < p_chunk->i_entries_dts )
     {
         if( i_sample > p_chunk->p_sample_count_dts[i_index] )
         {
-            i_time += p_chunk->p_sample_count_dts[i_index] *
+            i_time += (mtime_t)p_chunk->p_sample_count_dts[i_index] *
                 p_chunk->p_sample_delta_dts[i_index];
             i_sample -= p_chunk->p_sample_count_dts[i_index];
             i_index++;
         }
         else
         {
-            i_time += i_sample * p_chunk->p_sample_delta_dts[i_index];
+            i_time += (mtime_t)i_sample * p_chunk->p_sample_delta_dts[i_index];
             break;
         }
     }
@@ -4790,19 +4661,22 @@ static int LeafParseMDATwithMOOV( demux_t *p_demux )
                     goto error;
                 }
 
-                i_nb_samples += i_samplescounttoread;
-                i_current_pos += i_samplessize;
-                p_sys->context.i_mdatbytesleft -= i_samplessize;
-
                 /* dts */
                 mtime_t i_time = LeafGetMOOVTimeInChunk( p_chunk, i_nb_samples );
                 i_time += p_chunk->i_first_dts;
                 p_track->i_time = i_time;
                 p_block->i_dts = VLC_TS_0 + CLOCK_FREQ * i_time / p_track->i_timescale;
 
-                /* pts */
+                /* pts, from the moov chunk as the track one is for fragments */
                 int64_t i_delta;
-                if( MP4_TrackGetPTSDelta( p_demux, p_track, &i_delta ) )
+                bool b_delta = MP4_ChunkGetPTSDelta( p_chunk, i_nb_samples,
+                                                     p_track->i_timescale, &i_delta );
+
+                i_nb_samples += i_samplescounttoread;
+                i_current_pos += i_samplessize;
+                p_sys->context.i_mdatbytesleft -= i_samplessize;
+
+                if( b_delta )
                     p_block->i_pts = p_block->i_dts + i_delta;
                 else if( p_track->fmt.i_cat != VIDEO_ES )
                     p_block->i_pts = p_block->i_dts;
@@ -47,11 +47,17 @@ typedef struct
     uint64_t     i_first_dts;   /* DTS of the first sample */
     uint64_t     i_duration;    /* total duration of all samples */
 
+    /* The dts and pts tables of chunks from the moov point to the entries
+     * of the stts and ctts boxes covering the chunk, rather than copies.
+     * The first entry may start with samples of the previous chunks.
+     * Only the tables of fragments (cchunk) are allocated. */
     uint32_t     i_entries_dts;
+    uint32_t     i_skip_dts;  /* samples of the first entry to skip */
     uint32_t     *p_sample_count_dts;
     uint32_t     *p_sample_delta_dts;   /* dts delta */
 
     uint32_t     i_entries_pts;
+    uint32_t     i_skip_pts;  /* samples of the first entry to skip */
     uint32_t     *p_sample_count_pts;
     int32_t      *p_sample_offset_pts;  /* pts-dts */
 
@@ -115,8 +121,7 @@ typedef struct
     /* sample size, p_sample_size defined only if i_sample_size == 0
         else i_sample_size is size for all sample */
     uint32_t         i_sample_size;
-    uint32_t         *p_sample_size; /* XXX perhaps add file offset if take
-                                    too much time to do sumations each time*/
+    const uint32_t   *p_sample_size; /* points to the stsz box entries */
 
     uint32_t     i_sample_first; /* i_sample_first value
                                                    of the next chunk */
@@ -179,6 +179,9 @@ static bool GatherPESData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk, size_
 static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_prg, mtime_t i_pcr );
 
 static block_t* ReadTSPacket( demux_t *p_demux );
+static uint64_t ReadAheadTell( demux_sys_t *p_sys );
+static int ReadAheadSeek( demux_sys_t *p_sys, uint64_t i_pos );
+static void ReadAheadFlush( demux_sys_t *p_sys );
 static int SeekToTime( demux_t *p_demux, const ts_pmt_t *, int64_t time );
 static void ReadyQueuesPostSeek( demux_t *p_demux );
 static void PCRHandle( demux_t *p_demux, ts_pid_t *, mtime_t );
@@ -190,6 +193,9 @@ static void PCRFixHandle( demux_t *, ts_pmt_t *, block_t * );
 #define TS_PACKET_SIZE_MAX 204
 #define TS_HEADER_SIZE 4
 
+/* Number of TS packets read from the stream at once */
+#define TS_READAHEAD_PACKETS 64
+
 static int DetectPacketSize( demux_t *p_demux, unsigned *pi_header_size, int i_offset )
 {
     const uint8_t *p_peek;
@@ -360,6 +366,16 @@ static int Open( vlc_object_t *p_this )
     if( !p_sys )
         return VLC_ENOMEM;
     memset( p_sys, 0, sizeof( demux_sys_t ) );
+
+    p_sys->readahead.p_block = block_Alloc( TS_READAHEAD_PACKETS * i_packet_size );
+    if( !p_sys->readahead.p_block )
+    {
+        free( p_sys );
+        return VLC_ENOMEM;
+    }
+    p_sys->readahead.i_offset = 0;
+    p_sys->readahead.i_data = 0;
+
     vlc_mutex_init( &p_sys->csa_lock );
 
     p_demux->pf_demux = Demux;
@@ -396,6 +412,7 @@ static int Open( vlc_object_t *p_this )
     if ( !PIDSetup( p_demux, TYPE_PAT, patpid, NULL ) )
     {
         vlc_mutex_destroy( &p_sys->csa_lock );
+        block_Release( p_sys->readahead.p_block );
         free( p_sys );
         return VLC_ENOMEM;
     }
@@ -403,6 +420,7 @@ static int Open( vlc_object_t *p_this )
     {
         PIDRelease( p_demux, patpid );
         vlc_mutex_destroy( &p_sys->csa_lock );
+        block_Release( p_sys->readahead.p_block );
         free( p_sys );
         return VLC_EGENERIC;
     }
@@ -558,6 +576,7 @@ static void Close( vlc_object_t *p_this )
     /* Release all non default pids */
     ts_pid_list_Release( p_demux, &p_sys->pids );
 
+    block_Release( p_sys->readahead.p_block );
     free( p_sys );
 }
 
@@ -882,7 +901,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
 
         if( (i64 = stream_Size( p_sys->stream) ) > 0 )
         {
-            uint64_t offset = vlc_stream_Tell( p_sys->stream );
+            uint64_t offset = ReadAheadTell( p_sys );
             *pf = (double)offset / (double)i64;
             return VLC_SUCCESS;
         }
@@ -929,7 +948,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
 
         i64 = stream_Size( p_sys->stream );
         if( i64 > 0 &&
-            vlc_stream_Seek( p_sys->stream, (int64_t)(i64 * f) ) == VLC_SUCCESS )
+            ReadAheadSeek( p_sys, (int64_t)(i64 * f) ) == VLC_SUCCESS )
         {
             ReadyQueuesPostSeek( p_demux );
             return VLC_SUCCESS;
@@ -1061,9 +1080,11 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
     }
 
     case DEMUX_SET_TITLE:
+        ReadAheadFlush( p_sys );
         return vlc_stream_vaControl( p_sys->stream, STREAM_SET_TITLE, args );
 
     case DEMUX_SET_SEEKPOINT:
+        ReadAheadFlush( p_sys );
         return vlc_stream_vaControl( p_sys->stream, STREAM_SET_SEEKPOINT,
                                      args );
 
@@ -1578,7 +1599,47 @@ static void ParsePESDataChain( demux_t *p_demux, ts_pid_t *pid, block_t *p_pes )
     }
 }
 
-static bool PushPESBlock( demux_t *p_demux, ts_pid_t *pid, block_t *p_pkt, bool b_unit_start )
+/* Appends payload data to the PES being gathered. It is kept as a single
+ * block, allocated from the PES size when known, or from the size of the
+ * previous PES of that stream, so that no further gathering is needed. */
+static bool AppendPESData( ts_pes_t *p_pes, const block_t *p_pkt, size_t i_data )
+{
+    block_t *p_data = p_pes->gather.p_data;
+
+    if( p_data == NULL )
+    {
+        size_t i_alloc = p_pes->gather.i_data_size ? p_pes->gather.i_data_size
+                                                    : p_pes->gather.i_size_hint;
+        p_data = block_Alloc( __MAX(i_alloc, i_data) );
+        if( p_data == NULL )
+            return false;
+        p_data->i_buffer = 0;
+        p_data->i_flags = p_pkt->i_flags;
+        p_pes->gather.p_data = p_data;
+    }
+    else if( (size_t)(&p_data->p_start[p_data->i_size] -
+                      &p_data->p_buffer[p_data->i_buffer]) < i_data )
+    {
+        const size_t i_used = p_data->i_buffer;
+        p_data = block_Realloc( p_data, 0, __MAX(i_used * 2, i_used + i_data) );
+        if( p_data == NULL )
+        {
+            p_pes->gather.p_data = NULL;
+            p_pes->gather.i_data_size = 0;
+            p_pes->gather.i_gathered = 0;
+            return false;
+        }
+        p_data->i_buffer = i_used;
+        p_pes->gather.p_data = p_data;
+    }
+
+    memcpy( &p_data->p_buffer[p_data->i_buffer], p_pkt->p_buffer, i_data );
+    p_data->i_buffer += i_data;
+    return true;
+}
+
+static bool PushPESData( demux_t *p_demux, ts_pid_t *pid, const block_t *p_pkt,
+                         size_t i_data, bool b_unit_start )
 {
     bool b_ret = false;
     ts_pes_t *p_pes = pid->u.p_pes;
@@ -1587,10 +1648,11 @@ static bool PushPESBlock( demux_t *p_demux, ts_pid_t *pid, block_t *p_pkt, bool
     {
         block_t *p_datachain = p_pes->gather.p_data;
         /* Flush the pes from pid */
+        p_pes->gather.i_size_hint = ( p_pes->gather.i_size_hint +
+                                      p_pes->gather.i_gathered ) / 2;
         p_pes->gather.p_data = NULL;
         p_pes->gather.i_data_size = 0;
         p_pes->gather.i_gathered = 0;
-        p_pes->gather.pp_last = &p_pes->gather.p_data;
         ParsePESDataChain( p_demux, pid, p_datachain );
         b_ret = true;
     }
@@ -1601,24 +1663,90 @@ static bool PushPESBlock( demux_t *p_demux, ts_pid_t *pid, block_t *p_pkt, bool
     if( !b_unit_start && p_pes->gather.p_data == NULL )
     {
         /* msg_Dbg( p_demux, "broken packet" ); */
-        block_Release( p_pkt );
         return b_ret;
     }
 
-    block_ChainLastAppend( &p_pes->gather.pp_last, p_pkt );
-    p_pes->gather.i_gathered += p_pkt->i_buffer;
+    if( !AppendPESData( p_pes, p_pkt, i_data ) )
+        return b_ret;
+    p_pes->gather.i_gathered += i_data;
 
     if( p_pes->gather.i_data_size > 0 &&
         p_pes->gather.i_gathered >= p_pes->gather.i_data_size )
     {
         /* re-enter in Flush above */
         assert(p_pes->gather.p_data);
-        return PushPESBlock( p_demux, pid, NULL, true );
+        return PushPESData( p_demux, pid, NULL, 0, true );
     }
 
     return b_ret;
 }
 
+static bool PushPESBlock( demux_t *p_demux, ts_pid_t *pid, block_t *p_pkt, bool b_unit_start )
+{
+    if( p_pkt == NULL )
+        return PushPESData( p_demux, pid, NULL, 0, b_unit_start );
+
+    bool b_ret = PushPESData( p_demux, pid, p_pkt, p_pkt->i_buffer, b_unit_start );
+    block_Release( p_pkt );
+    return b_ret;
+}
+
+static void ReadAheadFlush( demux_sys_t *p_sys )
+{
+    p_sys->readahead.i_offset = 0;
+    p_sys->readahead.i_data = 0;
+}
+
+/* Stream position of the next packet */
+static uint64_t ReadAheadTell( demux_sys_t *p_sys )
+{
+    return vlc_stream_Tell( p_sys->stream ) -
+           ( p_sys->readahead.i_data - p_sys->readahead.i_offset );
+}
+
+static int ReadAheadSeek( demux_sys_t *p_sys, uint64_t i_pos )
+{
+    ReadAheadFlush( p_sys );
+    return vlc_stream_Seek( p_sys->stream, i_pos );
+}
+
+/* Makes at least i_min bytes available, unless at end of stream, and
+ * returns the number of available bytes */
+static size_t ReadAheadFill( demux_t *p_demux, size_t i_min )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    uint8_t *p_buf = p_sys->readahead.p_block->p_buffer;
+    const size_t i_size = p_sys->readahead.p_block->i_buffer;
+    size_t i_avail = p_sys->readahead.i_data - p_sys->readahead.i_offset;
+
+    if( i_avail >= i_min )
+        return i_avail;
+
+    /* Move the partial remains at the front */
+    memmove( p_buf, &p_buf[p_sys->readahead.i_offset], i_avail );
+    p_sys->readahead.i_offset = 0;
+    p_sys->readahead.i_data = i_avail;
+
+    while( p_sys->readahead.i_data < i_min )
+    {
+        /* Only wait for what we need, but take whatever is available */
+        ssize_t i_read = vlc_stream_ReadPartial( p_sys->stream,
+                                                 &p_buf[p_sys->readahead.i_data],
+                                                 i_size - p_sys->readahead.i_data );
+        if( i_read <= 0 )
+            break;
+        p_sys->readahead.i_data += i_read;
+    }
+
+    return p_sys->readahead.i_data;
+}
+
+static void ReadAheadPacketRelease( block_t *p_pkt )
+{
+    /* Packets are views on the read-ahead buffer */
+    VLC_UNUSED(p_pkt);
+}
+
 static block_t* ReadTSPacket( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
@@ -1626,7 +1754,7 @@ static block_t* ReadTSPacket( demux_t *p_demux )
     block_t     *p_pkt;
 
     /* Get a new TS packet */
-    if( !( p_pkt = vlc_stream_Block( p_sys->stream, p_sys->i_packet_size ) ) )
+    if( ReadAheadFill( p_demux, p_sys->i_packet_size ) < p_sys->i_packet_size )
     {
         int64_t size = stream_Size( p_sys->stream );
         if( size >= 0 && (uint64_t)size == vlc_stream_Tell( p_sys->stream ) )
@@ -1636,37 +1764,25 @@ static block_t* ReadTSPacket( demux_t *p_demux )
         return NULL;
     }
 
-    if( p_pkt->i_buffer < TS_HEADER_SIZE + p_sys->i_packet_header_size )
-    {
-        block_Release( p_pkt );
-        return NULL;
-    }
-
-    /* Skip header (BluRay streams).
-     * re-sync logic would do this (by adjusting packet start), but this would result in losing first and last ts packets.
-     * First packet is usually PAT, and losing it means losing whole first GOP. This is fatal with still-image based menus.
-     */
-    p_pkt->p_buffer += p_sys->i_packet_header_size;
-    p_pkt->i_buffer -= p_sys->i_packet_header_size;
-
     /* Check sync byte and re-sync if needed */
-    if( p_pkt->p_buffer[0] != 0x47 )
+    if( p_sys->readahead.p_block->p_buffer[p_sys->readahead.i_offset +
+                                           p_sys->i_packet_header_size] != 0x47 )
     {
         msg_Warn( p_demux, "lost synchro" );
-        block_Release( p_pkt );
+        p_sys->readahead.i_offset += p_sys->i_packet_size;
         for( ;; )
         {
             const uint8_t *p_peek;
-            int i_peek = 0;
+            size_t i_peek = 0;
             unsigned i_skip = 0;
 
-            i_peek = vlc_stream_Peek( p_sys->stream, &p_peek,
-                    p_sys->i_packet_size * 10 );
-            if( i_peek < 0 || (unsigned)i_peek < p_sys->i_packet_size + 1 )
+            i_peek = ReadAheadFill( p_demux, p_sys->i_packet_size * 10 );
+            if( i_peek < p_sys->i_packet_size + 1 )
             {
                 msg_Dbg( p_demux, "eof ?" );
                 return NULL;
             }
+            p_peek = &p_sys->readahead.p_block->p_buffer[p_sys->readahead.i_offset];
 
             while( i_skip < i_peek - p_sys->i_packet_size )
             {
@@ -1678,20 +1794,35 @@ static block_t* ReadTSPacket( demux_t *p_demux )
                 i_skip++;
             }
             msg_Dbg( p_demux, "skipping %d bytes of garbage", i_skip );
-            if (vlc_stream_Read( p_sys->stream, NULL, i_skip ) != i_skip)
-                return NULL;
+            p_sys->readahead.i_offset += i_skip;
 
             if( i_skip < i_peek - p_sys->i_packet_size )
             {
                 break;
             }
         }
-        if( !( p_pkt = vlc_stream_Block( p_sys->stream, p_sys->i_packet_size ) ) )
+        if( ReadAheadFill( p_demux, p_sys->i_packet_size ) < p_sys->i_packet_size )
         {
             msg_Dbg( p_demux, "eof ?" );
             return NULL;
         }
     }
+
+    /* No allocation per packet: it is only valid until the next read, and
+     * must be copied by whatever keeps its data */
+    p_pkt = &p_sys->readahead.packet;
+    block_Init( p_pkt, &p_sys->readahead.p_block->p_buffer[p_sys->readahead.i_offset],
+                p_sys->i_packet_size );
+    p_pkt->pf_release = ReadAheadPacketRelease;
+    p_sys->readahead.i_offset += p_sys->i_packet_size;
+
+    /* Skip header (BluRay streams).
+     * re-sync logic would do this (by adjusting packet start), but this would result in losing first and last ts packets.
+     * First packet is usually PAT, and losing it means losing whole first GOP. This is fatal with still-image based menus.
+     */
+    p_pkt->p_buffer += p_sys->i_packet_header_size;
+    p_pkt->i_buffer -= p_sys->i_packet_header_size;
+
     return p_pkt;
 }
 
@@ -1751,7 +1882,6 @@ static inline void FlushESBuffer( ts_pes_t *p_pes )
         p_pes->gather.i_gathered = p_pes->gather.i_data_size = 0;
         block_ChainRelease( p_pes->gather.p_data );
         p_pes->gather.p_data = NULL;
-        p_pes->gather.pp_last = &p_pes->gather.p_data;
         p_pes->gather.i_saved = 0;
     }
 
@@ -1814,13 +1944,13 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
 
     /* Deal with common but worst binary search case */
     if( p_pmt->pcr.i_first == i_scaledtime && p_sys->b_canseek )
-        return vlc_stream_Seek( p_sys->stream, 0 );
+        return ReadAheadSeek( p_sys, 0 );
 
     const int64_t i_stream_size = stream_Size( p_sys->stream );
     if( !p_sys->b_canfastseek || i_stream_size < p_sys->i_packet_size )
         return VLC_EGENERIC;
 
-    const uint64_t i_initial_pos = vlc_stream_Tell( p_sys->stream );
+    const uint64_t i_initial_pos = ReadAheadTell( p_sys );
 
     /* Find the time position by using binary search algorithm. */
     uint64_t i_head_pos = 0;
@@ -1836,7 +1966,7 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
         uint64_t i_div = i_splitpos % p_sys->i_packet_size;
         i_splitpos -= i_div;
 
-        if ( vlc_stream_Seek( p_sys->stream, i_splitpos ) != VLC_SUCCESS )
+        if ( ReadAheadSeek( p_sys, i_splitpos ) != VLC_SUCCESS )
             break;
 
         uint64_t i_pos = i_splitpos;
@@ -1850,7 +1980,7 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
                 break;
             }
             else
-                i_pos = vlc_stream_Tell( p_sys->stream );
+                i_pos = ReadAheadTell( p_sys );
 
             int i_pid = PIDGet( p_pkt );
             ts_pid_t *p_pid = GetPID(p_sys, i_pid);
@@ -1905,7 +2035,7 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
     if( !b_found )
     {
         msg_Dbg( p_demux, "Seek():cannot find a time position." );
-        vlc_stream_Seek( p_sys->stream, i_initial_pos );
+        ReadAheadSeek( p_sys, i_initial_pos );
         return VLC_EGENERIC;
     }
     return VLC_SUCCESS;
@@ -2008,7 +2138,7 @@ static int ProbeChunk( demux_t *p_demux, int i_program, bool b_end, int64_t *pi_
 int ProbeStart( demux_t *p_demux, int i_program )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
-    const uint64_t i_initial_pos = vlc_stream_Tell( p_sys->stream );
+    const uint64_t i_initial_pos = ReadAheadTell( p_sys );
     int64_t i_stream_size = stream_Size( p_sys->stream );
 
     int i_probe_count = 0;
@@ -2021,7 +2151,7 @@ int ProbeStart( demux_t *p_demux, int i_program )
         i_pos = p_sys->i_packet_size * i_probe_count;
         i_pos = __MIN( i_pos, i_stream_size );
 
-        if( vlc_stream_Seek( p_sys->stream, i_pos ) )
+        if( ReadAheadSeek( p_sys, i_pos ) )
             return VLC_EGENERIC;
 
         ProbeChunk( p_demux, i_program, false, &i_pcr, &b_found );
@@ -2030,7 +2160,7 @@ int ProbeStart( demux_t *p_demux, int i_program )
         i_probe_count += PROBE_CHUNK_COUNT;
     } while( i_pos > 0 && (i_pcr == -1 || !b_found) && i_probe_count < (2 * PROBE_CHUNK_COUNT) );
 
-    if( vlc_stream_Seek( p_sys->stream, i_initial_pos ) )
+    if( ReadAheadSeek( p_sys, i_initial_pos ) )
         return VLC_EGENERIC;
 
     return (b_found) ? VLC_SUCCESS : VLC_EGENERIC;
@@ -2039,7 +2169,7 @@ int ProbeStart( demux_t *p_demux, int i_program )
 int ProbeEnd( demux_t *p_demux, int i_program )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
-    const uint64_t i_initial_pos = vlc_stream_Tell( p_sys->stream );
+    const uint64_t i_initial_pos = ReadAheadTell( p_sys );
     int64_t i_stream_size = stream_Size( p_sys->stream );
 
     int i_probe_count = PROBE_CHUNK_COUNT;
@@ -2052,7 +2182,7 @@ int ProbeEnd( demux_t *p_demux, int i_program )
         i_pos = i_stream_size - (p_sys->i_packet_size * i_probe_count);
         i_pos = __MAX( i_pos, 0 );
 
-        if( vlc_stream_Seek( p_sys->stream, i_pos ) )
+        if( ReadAheadSeek( p_sys, i_pos ) )
             return VLC_EGENERIC;
 
         ProbeChunk( p_demux, i_program, true, &i_pcr, &b_found );
@@ -2061,7 +2191,7 @@ int ProbeEnd( demux_t *p_demux, int i_program )
         i_probe_count += PROBE_CHUNK_COUNT;
     } while( i_pos > 0 && (i_pcr == -1 || !b_found) && i_probe_count < (6 * PROBE_CHUNK_COUNT) );
 
-    if( vlc_stream_Seek( p_sys->stream, i_initial_pos ) )
+    if( ReadAheadSeek( p_sys, i_initial_pos ) )
         return VLC_EGENERIC;
 
     return (b_found) ? VLC_SUCCESS : VLC_EGENERIC;
@@ -2115,21 +2245,15 @@ static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_pmt, mtime_t i_pcr )
 
 static int IsVideoEnd( ts_pid_t *p_pid )
 {
-    /* jump to near end of PES packet */
-    block_t *p = p_pid->u.p_pes->gather.p_data;
-    if( !p || !p->p_next )
-        return 0;
-    while( p->p_next->p_next )
-        p = p->p_next;
-    if( p->p_next->i_buffer > 4)
-        p = p->p_next;
-
-    /* extract last bytes */
-    uint8_t tail[ 188 ];
-    const int i_tail = block_ChainExtract( p, tail, sizeof( tail ) );
-    if( i_tail < 4 )
+    /* PES is gathered into a single block */
+    const block_t *p = p_pid->u.p_pes->gather.p_data;
+    if( !p || p->i_buffer < 4 )
         return 0;
 
+    /* last bytes */
+    const uint8_t *tail = p->p_buffer;
+    const size_t i_tail = p->i_buffer;
+
     /* check for start code at end */
     return ( tail[ i_tail - 4 ] == 0 && tail[ i_tail - 3 ] == 0 && tail[ i_tail - 2 ] == 1 &&
              ( tail[ i_tail - 1 ] == 0xb7 ||  tail[ i_tail - 1 ] == 0x0a ) );
@@ -2442,43 +2566,6 @@ static bool ProcessTSPacket( demux_t *p_demux, ts_pid_t *pid, block_t *p_pkt )
     }
 }
 
-/* Avoids largest memcpy */
-static bool block_Split( block_t **pp_block, block_t **pp_remain, size_t i_offset )
-{
-    block_t *p_block = *pp_block;
-    block_t *p_split = NULL;
-    *pp_remain = NULL;
-
-    size_t i_tocopy = p_block->i_buffer - i_offset;
-    if( i_tocopy > i_offset ) /* make new block for head */
-    {
-        if( i_offset > 0 )
-        {
-            p_split = block_Alloc( i_offset );
-            if( p_split == NULL )
-                return false;
-            memcpy( p_split->p_buffer, p_block->p_buffer, i_offset );
-            p_block->p_buffer += i_offset;
-            p_block->i_buffer -= i_offset;
-        }
-        *pp_remain = p_block;
-        *pp_block = p_split;
-    }
-    else /* other gets the tail of our split */
-    {
-        if( i_tocopy > 0 )
-        {
-            p_split = block_Alloc( i_tocopy );
-            if( p_split == NULL )
-                return false;
-            memcpy( p_split->p_buffer, &p_block->p_buffer[i_offset], i_tocopy );
-            p_block->i_buffer -= i_tocopy;
-        }
-        *pp_remain = p_split;
-    }
-    return true;
-}
-
 static uint8_t *FindNextPESHeader( uint8_t *p_buf, size_t i_buffer )
 {
     const uint8_t *p_end = &p_buf[i_buffer];
@@ -2598,14 +2685,11 @@ static bool GatherPESData( demux_t *p_demux, ts_pid_t *pid, block_t *p_pkt,
                 }
                 else /* p_pkt->i_buffer > i_remain */
                 {
-                    block_t *p_split;
-                    if( !block_Split( &p_pkt, &p_split, i_remain ) )
-                    {
-                        block_Release( p_pkt );
-                        return false;
-                    }
-                    b_ret |= PushPESBlock( p_demux, pid, p_pkt, p_pes->gather.p_data == NULL );
-                    p_pkt = p_split;
+                    /* Complete the current PES, and carry on with the next
+                     * one from the same packet */
+                    b_ret |= PushPESData( p_demux, pid, p_pkt, i_remain, p_pes->gather.p_data == NULL );
+                    p_pkt->p_buffer += i_remain;
+                    p_pkt->i_buffer -= i_remain;
                     b_first_sync_done = false;
                 }
             }
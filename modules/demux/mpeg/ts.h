@@ -60,6 +60,15 @@ struct demux_sys_t
     /* how many TS packet we read at once */
     unsigned    i_ts_read;
 
+    /* Bulk read buffer, packets are handed out as views on it */
+    struct
+    {
+        block_t    *p_block;
+        size_t      i_offset; /* next packet */
+        size_t      i_data;   /* end of read data */
+        block_t     packet;   /* current packet view */
+    } readahead;
+
     bool        b_ignore_time_for_positions;
 
     ts_standards_e standard;
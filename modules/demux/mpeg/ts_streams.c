@@ -276,7 +276,7 @@ ts_pes_t *ts_pes_New( demux_t *p_demux, ts_pmt_t *p_program )
     pes->gather.i_data_size = 0;
     pes->gather.i_gathered = 0;
     pes->gather.p_data = NULL;
-    pes->gather.pp_last = &pes->gather.p_data;
+    pes->gather.i_size_hint = 0;
     pes->gather.i_saved = 0;
     pes->b_broken_PUSI_conformance = false;
     pes->b_always_receive = false;
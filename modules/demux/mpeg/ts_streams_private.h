@@ -112,8 +112,8 @@ struct ts_pes_t
     {
         size_t      i_data_size;
         size_t      i_gathered;
-        block_t     *p_data;
-        block_t     **pp_last;
+        block_t     *p_data;  /* single block, i_buffer == i_gathered */
+        size_t      i_size_hint; /* for unbounded PES allocation */
         uint8_t     saved[5];
         size_t      i_saved;
     } gather;
@@ -266,6 +266,9 @@ static void Close( vlc_object_t *p_this )
     /* Cleanup the bitstream parser */
     ogg_sync_clear( &p_sys->oy );
 
+    if( p_sys->b_index_changed )
+        Oggseek_IndexCacheSave( p_demux );
+
     Ogg_EndOfStream( p_demux );
 
     if( p_sys->p_old_stream )
@@ -321,7 +324,10 @@ static int Demux( demux_t * p_demux )
             /* Find the real duration */
             vlc_stream_Control( p_demux->s, STREAM_CAN_SEEK, &b_canseek );
             if ( b_canseek )
+            {
                 Oggseek_ProbeEnd( p_demux );
+                Oggseek_IndexCacheLoad( p_demux );
+            }
         }
         else
         {
@@ -207,6 +207,9 @@ struct demux_sys_t
     /* offset position in file (for reading) */
     int64_t i_input_position;
 
+    /* keyframes were added to the seek indexes since they were loaded */
+    bool    b_index_changed;
+
     /* current page being parsed */
     ogg_page current_page;
 
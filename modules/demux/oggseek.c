@@ -1022,14 +1022,103 @@ int Oggseek_SeektoAbsolutetime( demux_t *p_demux, logical_stream_t *p_stream,
     }
     /* Insert keyframe position into index */
     OggNoDebug(
-    if ( i_pagepos >= p_stream->i_data_start )
-        OggSeek_IndexAdd( p_stream, i_time, i_pagepos )
+    if ( i_pagepos >= p_stream->i_data_start
+      && OggSeek_IndexAdd( p_stream, i_time, i_pagepos ) != NULL )
+        p_sys->b_index_changed = true
     );
 
     OggDebug( msg_Dbg( p_demux, "=================== Seeked To %"PRId64" time %"PRId64, i_pagepos, i_time ) );
     return i_pagepos;
 }
 
+/* The keyframe indexes found by bisection are saved when closing, so that
+ * seeking in the same file later does not bisect again around the same
+ * positions. Layout (big endian): stream count, then for each stream, its
+ * serial number and entry count, followed by the entries (time and page
+ * position). */
+#define OGGSEEK_INDEX_CACHE_ENTRY 16
+
+void Oggseek_IndexCacheLoad( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    size_t i_size;
+    uint8_t *p_data = demux_IndexCacheLoad( p_demux, "ogg", &i_size );
+
+    if ( p_data == NULL )
+        return;
+
+    const uint8_t *p = p_data + 4, *p_end = p_data + i_size;
+    uint32_t i_streams = ( i_size >= 4 ) ? GetDWBE( p_data ) : 0;
+
+    for ( ; i_streams > 0 && p_end - p >= 8; i_streams-- )
+    {
+        uint32_t i_serial = GetDWBE( &p[0] );
+        uint32_t i_count = GetDWBE( &p[4] );
+        p += 8;
+        if ( (size_t)( p_end - p ) / OGGSEEK_INDEX_CACHE_ENTRY < i_count )
+            break;
+
+        logical_stream_t *p_stream = NULL;
+        for ( int i = 0; i < p_sys->i_streams; i++ )
+            if ( (uint32_t)p_sys->pp_stream[i]->os.serialno == i_serial )
+                p_stream = p_sys->pp_stream[i];
+
+        for ( uint32_t i = 0; i < i_count; i++ )
+        {
+            int64_t i_time = GetQWBE( p );
+            int64_t i_pagepos = GetQWBE( p + 8 );
+            p += OGGSEEK_INDEX_CACHE_ENTRY;
+            if ( p_stream != NULL && i_pagepos >= p_stream->i_data_start
+              && i_pagepos < p_sys->i_total_length )
+                OggSeek_IndexAdd( p_stream, i_time, i_pagepos );
+        }
+    }
+
+    free( p_data );
+}
+
+void Oggseek_IndexCacheSave( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    size_t i_size = 4;
+
+    for ( int i = 0; i < p_sys->i_streams; i++ )
+    {
+        i_size += 8;
+        for ( const demux_index_entry_t *idx = p_sys->pp_stream[i]->idx;
+              idx != NULL; idx = idx->p_next )
+            i_size += OGGSEEK_INDEX_CACHE_ENTRY;
+    }
+
+    uint8_t *p_data = malloc( i_size );
+    if ( unlikely( p_data == NULL ) )
+        return;
+
+    uint8_t *p = p_data;
+    SetDWBE( p, p_sys->i_streams );
+    p += 4;
+    for ( int i = 0; i < p_sys->i_streams; i++ )
+    {
+        logical_stream_t *p_stream = p_sys->pp_stream[i];
+        uint8_t *p_count = p + 4;
+        uint32_t i_count = 0;
+
+        SetDWBE( p, p_stream->os.serialno );
+        p += 8;
+        for ( const demux_index_entry_t *idx = p_stream->idx;
+              idx != NULL; idx = idx->p_next, i_count++ )
+        {
+            SetQWBE( p, idx->i_value );
+            SetQWBE( p + 8, idx->i_pagepos );
+            p += OGGSEEK_INDEX_CACHE_ENTRY;
+        }
+        SetDWBE( p_count, i_count );
+    }
+
+    demux_IndexCacheSave( p_demux, "ogg", p_data, i_size );
+    free( p_data );
+}
+
 /****************************************************************************
  * oggseek_read_page: Read a full Ogg page from the physical bitstream.
  ****************************************************************************
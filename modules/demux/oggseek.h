@@ -59,6 +59,8 @@ int     Oggseek_BlindSeektoPosition ( demux_t *, logical_stream_t *, double f, b
 int     Oggseek_SeektoAbsolutetime ( demux_t *, logical_stream_t *, int64_t i_granulepos );
 const demux_index_entry_t *OggSeek_IndexAdd ( logical_stream_t *, int64_t, int64_t );
 void    Oggseek_ProbeEnd( demux_t * );
+void    Oggseek_IndexCacheLoad( demux_t * );
+void    Oggseek_IndexCacheSave( demux_t * );
 
 void oggseek_index_entries_free ( demux_index_entry_t * );
 
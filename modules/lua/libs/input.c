@@ -217,6 +217,8 @@ static int vlclua_input_item_stats( lua_State *L )
         STATS_FLOAT( send_bitrate )
         STATS_INT( played_abuffers )
         STATS_INT( lost_abuffers )
+        STATS_INT( block_pool_hits )
+        STATS_INT( block_pool_misses )
 #undef STATS_INT
 #undef STATS_FLOAT
         vlc_mutex_unlock( &p_item->p_stats->lock );
@@ -39,6 +39,7 @@
 
 #include <vlc_iso_lang.h>
 #include <vlc_meta.h>
+#include <vlc_tracer.h>
 
 #include "../demux/mp4/libmp4.h"
 #include "libmp4mux.h"
@@ -52,6 +53,13 @@
     "Create \"Fast Start\" files. " \
     "\"Fast Start\" files are optimized for downloads and allow the user " \
     "to start previewing the file while it is downloading.")
+#define MOOV_RESERVE_TEXT N_("Space reserved for the header (KiB)")
+#define MOOV_RESERVE_LONGTEXT N_(\
+    "Space reserved at the beginning of \"Fast Start\" files for the " \
+    "header, so that the media data does not need to be moved when the " \
+    "file is closed. The header takes about 20 bytes per audio or video " \
+    "frame. If it does not fit, the media data is moved as far as needed. " \
+    "With 0, the media data is moved after the header when closing.")
 
 static int  Open   (vlc_object_t *);
 static void Close  (vlc_object_t *);
@@ -69,6 +77,8 @@ vlc_module_begin ()
     add_bool(SOUT_CFG_PREFIX "faststart", true,
               FASTSTART_TEXT, FASTSTART_LONGTEXT,
               true)
+    add_integer_with_range(SOUT_CFG_PREFIX "moov-reserve", 0, 0, 1048576,
+                           MOOV_RESERVE_TEXT, MOOV_RESERVE_LONGTEXT, true)
     set_capability("sout mux", 5)
     add_shortcut("mp4", "mov", "3gp")
     set_callbacks(Open, Close)
@@ -88,7 +98,7 @@ vlc_module_end ()
  * Exported prototypes
  *****************************************************************************/
 static const char *const ppsz_sout_options[] = {
-    "faststart", NULL
+    "faststart", "moov-reserve", NULL
 };
 
 static int Control(sout_mux_t *, int, va_list);
@@ -158,6 +168,9 @@ struct sout_mux_sys_t
     bool b_64_ext;
     bool b_fast_start;
 
+    uint64_t i_moov_reserve_pos; /* free box reserved for the moov */
+    uint64_t i_moov_reserve;
+
     uint64_t i_mdat_pos;
     uint64_t i_pos;
     mtime_t  i_read_duration;
@@ -208,6 +221,8 @@ static int Open(vlc_object_t *p_this)
     p_sys->i_read_duration   = 0;
     p_sys->i_start_dts = VLC_TS_INVALID;
     p_sys->b_fragmented = false;
+    p_sys->b_fast_start = var_GetBool(p_this, SOUT_CFG_PREFIX "faststart");
+    p_sys->i_moov_reserve = 0;
 
     if (!p_sys->b_mov) {
         /* Now add ftyp header */
@@ -237,6 +252,23 @@ static int Open(vlc_object_t *p_this)
      * Quicktime actually doesn't like the 64 bits extensions !!! */
     p_sys->b_64_ext = false;
 
+    /* Reserve space for the moov, see Close() */
+    if (p_sys->b_fast_start) {
+        int64_t i_reserve = var_GetInteger(p_this, SOUT_CFG_PREFIX "moov-reserve");
+        block_t *p_free = (i_reserve > 0) ? block_Alloc(i_reserve * 1024) : NULL;
+        if (p_free) {
+            memset(p_free->p_buffer, 0, p_free->i_buffer);
+            SetDWBE(p_free->p_buffer, p_free->i_buffer);
+            memcpy(p_free->p_buffer + 4, "free", 4);
+
+            p_sys->i_moov_reserve_pos = p_sys->i_pos;
+            p_sys->i_moov_reserve = p_free->i_buffer;
+            p_sys->i_pos += p_free->i_buffer;
+            p_sys->i_mdat_pos = p_sys->i_pos;
+            sout_AccessOutWrite(p_mux->p_access, p_free);
+        }
+    }
+
     /* Now add mdat header */
     box = box_new("mdat");
     if(!box)
@@ -261,6 +293,9 @@ static void Close(vlc_object_t *p_this)
 {
     sout_mux_t      *p_mux = (sout_mux_t*)p_this;
     sout_mux_sys_t  *p_sys = p_mux->p_sys;
+    const mtime_t   i_close_start = mdate();
+    const char      *psz_layout = "moov at end";
+    vlc_trace_span_t span;
 
     msg_Dbg(p_mux, "Close");
 
@@ -268,6 +303,7 @@ static void Close(vlc_object_t *p_this)
     bo_t bo;
     if (!bo_init(&bo, 16))
         goto cleanup;
+    vlc_trace_Begin(p_mux, &span, "mp4 mux finalize");
     if (p_sys->i_pos - p_sys->i_mdat_pos >= (((uint64_t)1)<<32)) {
         /* Extended size */
         bo_add_32be  (&bo, 1);
@@ -288,16 +324,59 @@ static void Close(vlc_object_t *p_this)
     uint64_t i_moov_pos = p_sys->i_pos;
     bo_t *moov = BuildMoov(p_mux);
 
+    /* Where the moov goes in "fast start" files, and how far the mdat must
+     * be moved for it to fit there */
+    uint64_t i_fast_start_pos = p_sys->i_mdat_pos;
+    int64_t i_shift = (moov && moov->b) ? moov->b->i_buffer : 0;
+    /* Size of the free box to write after the moov once the mdat moved */
+    uint64_t i_free_after_moov = 0;
+
+    /* Write the moov in the space reserved before the mdat, and mark the
+     * rest as free. If it does not fit, the mdat is moved by the missing
+     * space instead. */
+    if (p_sys->i_moov_reserve > 0 && moov && moov->b) {
+        const uint64_t i_moov_size = moov->b->i_buffer;
+
+        if (i_moov_size == p_sys->i_moov_reserve ||
+            i_moov_size + 8 <= p_sys->i_moov_reserve) {
+            i_moov_pos = p_sys->i_moov_reserve_pos;
+            if (i_moov_size < p_sys->i_moov_reserve) {
+                block_t *p_free = block_Alloc(8);
+                if (p_free) {
+                    SetDWBE(p_free->p_buffer, p_sys->i_moov_reserve - i_moov_size);
+                    memcpy(p_free->p_buffer + 4, "free", 4);
+                    sout_AccessOutSeek(p_mux->p_access, i_moov_pos + i_moov_size);
+                    sout_AccessOutWrite(p_mux->p_access, p_free);
+                }
+            }
+            psz_layout = "moov in reserved space";
+            p_sys->b_fast_start = false;
+        } else {
+            if (i_moov_size < p_sys->i_moov_reserve) {
+                /* The space left is too small for a free box: move the media
+                 * data so that there is room for an empty one */
+                msg_Warn(p_mux, "moov needs %"PRIu64" bytes, leaving no room "
+                         "for a free box in the %"PRIu64" reserved, moving the "
+                         "media data", i_moov_size, p_sys->i_moov_reserve);
+                i_free_after_moov = 8;
+            } else
+                msg_Warn(p_mux, "moov needs %"PRIu64" bytes, more than the %"
+                         PRIu64" reserved, moving the media data", i_moov_size,
+                         p_sys->i_moov_reserve);
+            i_fast_start_pos = p_sys->i_moov_reserve_pos;
+            i_shift = i_moov_size + i_free_after_moov - p_sys->i_moov_reserve;
+        }
+    }
+
     /* Check we need to create "fast start" files */
-    p_sys->b_fast_start = var_GetBool(p_this, SOUT_CFG_PREFIX "faststart");
     while (p_sys->b_fast_start && moov && moov->b) {
         /* Move data to the end of the file so we can fit the moov header
          * at the start */
         int64_t i_size = p_sys->i_pos - p_sys->i_mdat_pos;
-        int i_moov_size = moov->b->i_buffer;
 
+        assert(i_shift > 0);
         while (i_size > 0) {
-            int64_t i_chunk = __MIN(32768, i_size);
+            int64_t i_chunk = __MIN(1 << 20, i_size);
             block_t *p_buf = block_Alloc(i_chunk);
             sout_AccessOutSeek(p_mux->p_access,
                                 p_sys->i_mdat_pos + i_size - i_chunk);
@@ -309,7 +388,7 @@ static void Close(vlc_object_t *p_this)
                 break;
             }
             sout_AccessOutSeek(p_mux->p_access, p_sys->i_mdat_pos + i_size +
-                                i_moov_size - i_chunk);
+                                i_shift - i_chunk);
             sout_AccessOutWrite(p_mux->p_access, p_buf);
             i_size -= i_chunk;
         }
@@ -318,8 +397,19 @@ static void Close(vlc_object_t *p_this)
             break;
 
         /* Update pos pointers */
-        i_moov_pos = p_sys->i_mdat_pos;
-        p_sys->i_mdat_pos += moov->b->i_buffer;
+        i_moov_pos = i_fast_start_pos;
+        p_sys->i_mdat_pos += i_shift;
+
+        if (i_free_after_moov > 0) {
+            block_t *p_free = block_Alloc(i_free_after_moov);
+            if (p_free) {
+                SetDWBE(p_free->p_buffer, i_free_after_moov);
+                memcpy(p_free->p_buffer + 4, "free", 4);
+                sout_AccessOutSeek(p_mux->p_access,
+                                   i_moov_pos + moov->b->i_buffer);
+                sout_AccessOutWrite(p_mux->p_access, p_free);
+            }
+        }
 
         /* Fix-up samples to chunks table in MOOV header */
         for (unsigned int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++) {
@@ -328,9 +418,9 @@ static void Close(vlc_object_t *p_this)
             for (unsigned i = 0; i < p_stream->mux.i_entry_count; ) {
                 mp4mux_entry_t *entry = p_stream->mux.entry;
                 if (b_stco64)
-                    bo_set_64be(moov, p_stream->mux.i_stco_pos + i_written++ * 8, entry[i].i_pos + p_sys->i_mdat_pos - i_moov_pos);
+                    bo_set_64be(moov, p_stream->mux.i_stco_pos + i_written++ * 8, entry[i].i_pos + i_shift);
                 else
-                    bo_set_32be(moov, p_stream->mux.i_stco_pos + i_written++ * 4, entry[i].i_pos + p_sys->i_mdat_pos - i_moov_pos);
+                    bo_set_32be(moov, p_stream->mux.i_stco_pos + i_written++ * 4, entry[i].i_pos + i_shift);
 
                 for (; i < p_stream->mux.i_entry_count; i++)
                     if (i >= p_stream->mux.i_entry_count - 1 ||
@@ -342,13 +432,19 @@ static void Close(vlc_object_t *p_this)
         }
 
         p_sys->b_fast_start = false;
+        psz_layout = "mdat moved after moov";
     }
 
     /* Write MOOV header */
     sout_AccessOutSeek(p_mux->p_access, i_moov_pos);
+    size_t i_moov_size = (moov && moov->b) ? moov->b->i_buffer : 0;
     if (moov != NULL)
         box_send(p_mux, moov);
 
+    msg_Dbg(p_mux, "finalized %zu bytes header in %"PRId64" ms (%s)",
+            i_moov_size, (mdate() - i_close_start) / 1000, psz_layout);
+    vlc_trace_End(&span, psz_layout);
+
 cleanup:
     /* Clean-up */
     for (unsigned int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++) {
@@ -60,7 +60,24 @@ struct stream_sys_t
     size_t       buffer_size;
     char        *buffer;
     size_t       read_size;
+    size_t       read_min;
+    size_t       read_max;
     size_t       seek_threshold;
+
+    /* Consumption rate tracking for the adaptive read size */
+    uint64_t     consumed;
+    uint64_t     rate_consumed;
+    mtime_t      rate_date;
+    bool         starved;
+
+    /* Statistics */
+    struct
+    {
+        uint64_t reads;
+        uint64_t bytes;
+        size_t   read_size_max;
+        unsigned starvations;
+    } stats;
 };
 
 static ssize_t ThreadRead(stream_t *stream, void *buf, size_t length)
@@ -74,6 +91,11 @@ static ssize_t ThreadRead(stream_t *stream, void *buf, size_t length)
     ssize_t val = vlc_stream_ReadPartial(stream->p_source, buf, length);
 
     vlc_mutex_lock(&sys->lock);
+    if (val > 0)
+    {
+        sys->stats.reads++;
+        sys->stats.bytes += val;
+    }
     vlc_restorecancel(canc);
     return val;
 }
@@ -117,6 +139,50 @@ static int ThreadControl(stream_t *stream, int query, ...)
 #define MAX_READ 65536
 #define SEEK_THRESHOLD MAX_READ
 
+/* Interval over which the consumption rate is measured */
+#define RATE_INTERVAL (CLOCK_FREQ / 4)
+/* Amount of playback a single background read should cover */
+#define READ_DURATION (CLOCK_FREQ / 8)
+
+/**
+ * Adapts the background read size to the rate at which the data is consumed.
+ *
+ * Small reads keep the latency low at start-up and after seeking, while large
+ * reads reduce the per-read overhead once the consumer is streaming. The size
+ * is doubled if the consumer ran out of data since the last update.
+ */
+static void ThreadAdapt(stream_t *stream)
+{
+    stream_sys_t *sys = stream->p_sys;
+    mtime_t now = mdate();
+    mtime_t elapsed = now - sys->rate_date;
+
+    if (elapsed < RATE_INTERVAL)
+        return;
+
+    uint64_t target = (sys->consumed - sys->rate_consumed) * READ_DURATION
+                      / elapsed;
+    if (sys->starved && target < 2 * sys->read_size)
+        target = 2 * sys->read_size;
+    if (target < sys->read_min)
+        target = sys->read_min;
+    if (target > sys->read_max)
+        target = sys->read_max;
+
+    if (target != sys->read_size)
+    {
+        msg_Dbg(stream, "read size %zu -> %"PRIu64" bytes", sys->read_size,
+                target);
+        sys->read_size = target;
+        if (target > sys->stats.read_size_max)
+            sys->stats.read_size_max = target;
+    }
+
+    sys->rate_consumed = sys->consumed;
+    sys->rate_date = now;
+    sys->starved = false;
+}
+
 static void *Thread(void *data)
 {
     stream_t *stream = data;
@@ -204,6 +270,8 @@ static void *Thread(void *data)
 
         assert(sys->buffer_size >= sys->buffer_length);
 
+        ThreadAdapt(stream);
+
         size_t len = sys->buffer_size - sys->buffer_length;
         if (len == 0)
         {   /* Buffer is full */
@@ -321,6 +389,11 @@ static ssize_t Read(stream_t *stream, void *buf, size_t buflen)
             return 0;
         }
 
+        if (!sys->starved)
+        {
+            sys->starved = true;
+            sys->stats.starvations++;
+        }
         vlc_interrupt_forward_start(sys->interrupt, data);
         vlc_cond_wait(&sys->wait_data, &sys->lock);
         vlc_interrupt_forward_stop(data);
@@ -335,6 +408,7 @@ static ssize_t Read(stream_t *stream, void *buf, size_t buflen)
 
     memcpy(buf, sys->buffer + offset, copy);
     sys->stream_offset += copy;
+    sys->consumed += copy;
 out:
     vlc_cond_signal(&sys->wait_space);
     vlc_mutex_unlock(&sys->lock);
@@ -459,6 +533,7 @@ static int Open(vlc_object_t *obj)
     sys->buffer_length = 0;
     sys->buffer_size = var_InheritInteger(obj, "prefetch-buffer-size") << 10u;
     sys->read_size = var_InheritInteger(obj, "prefetch-read-size");
+    sys->read_max = var_InheritInteger(obj, "prefetch-read-size-max");
     sys->seek_threshold = var_InheritInteger(obj, "prefetch-seek-threshold");
 
     uint64_t size = stream_Size(stream->p_source);
@@ -472,6 +547,20 @@ static int Open(vlc_object_t *obj)
     if (sys->buffer_size < sys->read_size)
         sys->buffer_size = sys->read_size;
 
+    /* Keep at least four reads' worth of room in the buffer */
+    if (sys->read_max > sys->buffer_size / 4)
+        sys->read_max = sys->buffer_size / 4;
+    if (sys->read_max < sys->read_size)
+        sys->read_max = sys->read_size;
+    sys->read_min = sys->read_size;
+
+    sys->consumed = 0;
+    sys->rate_consumed = 0;
+    sys->rate_date = mdate();
+    sys->starved = false;
+    memset(&sys->stats, 0, sizeof (sys->stats));
+    sys->stats.read_size_max = sys->read_size;
+
     sys->buffer = malloc(sys->buffer_size);
     if (sys->buffer == NULL)
         goto error;
@@ -495,8 +584,8 @@ static int Open(vlc_object_t *obj)
         goto error;
     }
 
-    msg_Dbg(stream, "using %zu bytes buffer, %zu bytes read",
-            sys->buffer_size, sys->read_size);
+    msg_Dbg(stream, "using %zu bytes buffer, %zu to %zu bytes read",
+            sys->buffer_size, sys->read_min, sys->read_max);
     stream->pf_read = Read;
     stream->pf_readdir = ReadDir;
     stream->pf_control = Control;
@@ -521,6 +610,11 @@ static void Close (vlc_object_t *obj)
     vlc_cancel(sys->thread);
     vlc_interrupt_kill(sys->interrupt);
     vlc_join(sys->thread, NULL);
+
+    msg_Dbg(stream, "%"PRIu64" bytes in %"PRIu64" reads, %u underruns, "
+            "largest read size %zu bytes", sys->stats.bytes, sys->stats.reads,
+            sys->stats.starvations, sys->stats.read_size_max);
+
     vlc_interrupt_destroy(sys->interrupt);
     vlc_cond_destroy(&sys->wait_space);
     vlc_cond_destroy(&sys->wait_data);
@@ -545,6 +639,10 @@ vlc_module_begin()
     add_integer("prefetch-read-size", 1 << 14, N_("Read size"),
                 N_("Prefetch background read size (bytes)"), true)
         change_integer_range(1, 1 << 29)
+    add_integer("prefetch-read-size-max", 1 << 20, N_("Maximum read size"),
+                N_("Upper bound for the background read size, which adapts "
+                   "to the consumption rate (bytes)"), true)
+        change_integer_range(1, 1 << 29)
     add_integer("prefetch-seek-threshold", 1 << 14, N_("Seek threshold"),
                 N_("Prefetch forward seek threshold (bytes)"), true)
         change_integer_range(0, UINT64_C(1) << 60)
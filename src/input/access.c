@@ -34,6 +34,7 @@
 #include <vlc_url.h>
 #include <vlc_modules.h>
 #include <vlc_interrupt.h>
+#include <vlc_tracer.h>
 
 #include <libvlc.h>
 #include "stream.h"
@@ -72,11 +73,14 @@ static access_t *access_New(vlc_object_t *parent, input_thread_t *input,
 {
     char *redirv[MAX_REDIR];
     unsigned redirc = 0;
+    vlc_trace_span_t span;
 
     stream_t *access = vlc_stream_CommonNew(parent, vlc_access_Destroy);
     if (unlikely(access == NULL))
         return NULL;
 
+    vlc_trace_Begin(access, &span, "access open");
+
     access->p_input = input;
     access->psz_name = NULL;
     access->psz_url = strdup(mrl);
@@ -112,6 +116,7 @@ static access_t *access_New(vlc_object_t *parent, input_thread_t *input,
                 free(redirv[--redirc]);
 
             assert(access->pf_control != NULL);
+            vlc_trace_End(&span, module_get_object(access->p_module));
             return access;
         }
 
@@ -136,6 +141,7 @@ static access_t *access_New(vlc_object_t *parent, input_thread_t *input,
 
     msg_Err(access, "too many redirections");
 error:
+    vlc_trace_End(&span, NULL);
     while (redirc > 0)
         free(redirv[--redirc]);
     free(access->psz_filepath);
@@ -43,6 +43,7 @@
 #include <vlc_meta.h>
 #include <vlc_dialog.h>
 #include <vlc_modules.h>
+#include <vlc_tracer.h>
 
 #include "audio_output/aout_internal.h"
 #include "stream_output/stream_output.h"
@@ -92,8 +93,8 @@ struct decoder_owner_sys_t
     vlc_meta_t     *p_description;
     atomic_int     reload;
 
-    /* fifo */
-    block_fifo_t *p_fifo;
+    /* fifo (single producer, single consumer) */
+    block_spsc_t *p_fifo;
 
     /* Lock for communication with decoder thread */
     vlc_mutex_t lock;
@@ -165,10 +166,16 @@ static int LoadDecoder( decoder_t *p_dec, bool b_packetizer,
     es_format_Init( &p_dec->fmt_out, UNKNOWN_ES, 0 );
 
     /* Find a suitable decoder/packetizer module */
+    vlc_trace_span_t span;
+
+    vlc_trace_Begin( p_dec, &span,
+                     b_packetizer ? "packetizer load" : "decoder load" );
     if( !b_packetizer )
         p_dec->p_module = module_need( p_dec, "decoder", "$codec", false );
     else
         p_dec->p_module = module_need( p_dec, "packetizer", "$packetizer", false );
+    vlc_trace_End( &span, p_dec->p_module != NULL
+                   ? module_get_object( p_dec->p_module ) : NULL );
 
     if( !p_dec->p_module )
     {
@@ -689,12 +696,12 @@ static int DecoderTimedWait( decoder_t *p_dec, mtime_t deadline )
     if (deadline - mdate() <= 0)
         return VLC_SUCCESS;
 
-    vlc_fifo_Lock( p_owner->p_fifo );
+    vlc_spsc_Lock( p_owner->p_fifo );
     while( !p_owner->flushing
-        && vlc_fifo_TimedWaitCond( p_owner->p_fifo, &p_owner->wait_timed,
+        && vlc_spsc_TimedWaitCond( p_owner->p_fifo, &p_owner->wait_timed,
                                    deadline ) == 0 );
     int ret = p_owner->flushing ? VLC_EGENERIC : VLC_SUCCESS;
-    vlc_fifo_Unlock( p_owner->p_fifo );
+    vlc_spsc_Unlock( p_owner->p_fifo );
     return ret;
 }
 
@@ -885,7 +892,7 @@ static void DecoderGetCc( decoder_t *p_dec, decoder_t *p_dec_cc )
         if( !p_owner->cc.pp_decoder[i] )
             continue;
 
-        block_FifoPut( p_owner->cc.pp_decoder[i]->p_owner->p_fifo,
+        block_SpscPut( p_owner->cc.pp_decoder[i]->p_owner->p_fifo,
             (i_cc_decoder > 1) ? block_Duplicate(p_cc) : p_cc);
 
         i_cc_decoder--;
@@ -964,10 +971,10 @@ static int DecoderPlayVideo( decoder_t *p_dec, picture_t *p_picture,
 
     /* FIXME: The *input* FIFO should not be locked here. This will not work
      * properly if/when pictures are queued asynchronously. */
-    vlc_fifo_Lock( p_owner->p_fifo );
+    vlc_spsc_Lock( p_owner->p_fifo );
     if( unlikely(p_owner->paused) && likely(p_owner->frames_countdown > 0) )
         p_owner->frames_countdown--;
-    vlc_fifo_Unlock( p_owner->p_fifo );
+    vlc_spsc_Unlock( p_owner->p_fifo );
 
     /* */
     if( p_vout == NULL )
@@ -1514,8 +1521,8 @@ static void *DecoderThread( void *p_data )
     bool paused = false;
 
     /* The decoder's main loop */
-    vlc_fifo_Lock( p_owner->p_fifo );
-    vlc_fifo_CleanupPush( p_owner->p_fifo );
+    vlc_spsc_Lock( p_owner->p_fifo );
+    vlc_spsc_CleanupPush( p_owner->p_fifo );
 
     for( ;; )
     {
@@ -1524,12 +1531,12 @@ static void *DecoderThread( void *p_data )
              * for the sake of flushing (glitches could otherwise happen). */
             int canc = vlc_savecancel();
 
-            vlc_fifo_Unlock( p_owner->p_fifo );
+            vlc_spsc_Unlock( p_owner->p_fifo );
 
             /* Flush the decoder (and the output) */
             DecoderProcessFlush( p_dec );
 
-            vlc_fifo_Lock( p_owner->p_fifo );
+            vlc_spsc_Lock( p_owner->p_fifo );
             vlc_restorecancel( canc );
 
             /* Reset flushing after DecoderProcess in case input_DecoderFlush
@@ -1546,7 +1553,7 @@ static void *DecoderThread( void *p_data )
             mtime_t date = p_owner->pause_date;
 
             paused = p_owner->paused;
-            vlc_fifo_Unlock( p_owner->p_fifo );
+            vlc_spsc_Unlock( p_owner->p_fifo );
 
             /* NOTE: Only the audio and video outputs care about pause. */
             msg_Dbg( p_dec, "toggling %s", paused ? "resume" : "pause" );
@@ -1556,14 +1563,14 @@ static void *DecoderThread( void *p_data )
                 aout_DecChangePause( p_owner->p_aout, paused, date );
 
             vlc_restorecancel( canc );
-            vlc_fifo_Lock( p_owner->p_fifo );
+            vlc_spsc_Lock( p_owner->p_fifo );
             continue;
         }
 
         if( p_owner->paused && p_owner->frames_countdown == 0 )
         {   /* Wait for resumption from pause */
             p_owner->b_idle = true;
-            vlc_fifo_Wait( p_owner->p_fifo );
+            vlc_spsc_Wait( p_owner->p_fifo );
             p_owner->b_idle = false;
             continue;
         }
@@ -1571,13 +1578,13 @@ static void *DecoderThread( void *p_data )
         vlc_cond_signal( &p_owner->wait_fifo );
         vlc_testcancel(); /* forced expedited cancellation in case of stop */
 
-        block_t *p_block = vlc_fifo_DequeueUnlocked( p_owner->p_fifo );
+        block_t *p_block = vlc_spsc_Dequeue( p_owner->p_fifo );
         if( p_block == NULL )
         {
             if( likely(!p_owner->b_draining) )
             {   /* Wait for a block to decode (or a request to drain) */
                 p_owner->b_idle = true;
-                vlc_fifo_Wait( p_owner->p_fifo );
+                vlc_spsc_Wait( p_owner->p_fifo );
                 p_owner->b_idle = false;
                 continue;
             }
@@ -1586,7 +1593,7 @@ static void *DecoderThread( void *p_data )
             p_owner->b_draining = false;
         }
 
-        vlc_fifo_Unlock( p_owner->p_fifo );
+        vlc_spsc_Unlock( p_owner->p_fifo );
 
         int canc = vlc_savecancel();
         DecoderProcess( p_dec, p_block );
@@ -1604,7 +1611,7 @@ static void *DecoderThread( void *p_data )
         atomic_store( &p_owner->drained, (p_block == NULL) );
 
         vlc_mutex_lock( &p_owner->lock );
-        vlc_fifo_Lock( p_owner->p_fifo );
+        vlc_spsc_Lock( p_owner->p_fifo );
         vlc_cond_signal( &p_owner->wait_acknowledge );
         vlc_mutex_unlock( &p_owner->lock );
     }
@@ -1673,7 +1680,7 @@ static decoder_t * CreateDecoder( vlc_object_t *p_parent,
     es_format_Init( &p_owner->fmt, UNKNOWN_ES, 0 );
 
     /* decoder fifo */
-    p_owner->p_fifo = block_FifoNew();
+    p_owner->p_fifo = block_SpscNew();
     if( unlikely(p_owner->p_fifo == NULL) )
     {
         free( p_owner );
@@ -1773,13 +1780,13 @@ static void DeleteDecoder( decoder_t * p_dec )
 
     msg_Dbg( p_dec, "killing decoder fourcc `%4.4s', %u PES in FIFO",
              (char*)&p_dec->fmt_in.i_codec,
-             (unsigned)block_FifoCount( p_owner->p_fifo ) );
+             (unsigned)vlc_spsc_GetCount( p_owner->p_fifo ) );
 
     const bool b_flush_spu = p_dec->fmt_out.i_cat == SPU_ES;
     UnloadDecoder( p_dec );
 
     /* Free all packets still in the decoder fifo. */
-    block_FifoRelease( p_owner->p_fifo );
+    block_SpscRelease( p_owner->p_fifo );
 
     /* Cleanup */
     if( p_owner->p_aout )
@@ -1947,11 +1954,11 @@ void input_DecoderDelete( decoder_t *p_dec )
 
     vlc_cancel( p_owner->thread );
 
-    vlc_fifo_Lock( p_owner->p_fifo );
+    vlc_spsc_Lock( p_owner->p_fifo );
     /* Signal DecoderTimedWait */
     p_owner->flushing = true;
     vlc_cond_signal( &p_owner->wait_timed );
-    vlc_fifo_Unlock( p_owner->p_fifo );
+    vlc_spsc_Unlock( p_owner->p_fifo );
 
     /* Make sure we aren't waiting/decoding anymore */
     vlc_mutex_lock( &p_owner->lock );
@@ -1993,17 +2000,19 @@ void input_DecoderDecode( decoder_t *p_dec, block_t *p_block, bool b_do_pace )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
 
-    vlc_fifo_Lock( p_owner->p_fifo );
     if( !b_do_pace )
     {
         /* FIXME: ideally we would check the time amount of data
          * in the FIFO instead of its size. */
         /* 400 MiB, i.e. ~ 50mb/s for 60s */
-        if( vlc_fifo_GetBytes( p_owner->p_fifo ) > 400*1024*1024 )
+        if( vlc_spsc_GetBytes( p_owner->p_fifo ) > 400*1024*1024 )
         {
             msg_Warn( p_dec, "decoder/packetizer fifo full (data not "
                       "consumed quickly enough), resetting fifo!" );
-            block_ChainRelease( vlc_fifo_DequeueAllUnlocked( p_owner->p_fifo ) );
+            /* The decoder thread only dequeues with the FIFO locked */
+            vlc_spsc_Lock( p_owner->p_fifo );
+            vlc_spsc_Empty( p_owner->p_fifo );
+            vlc_spsc_Unlock( p_owner->p_fifo );
         }
     }
     else
@@ -2011,12 +2020,16 @@ void input_DecoderDecode( decoder_t *p_dec, block_t *p_block, bool b_do_pace )
     {   /* The FIFO is not consumed when waiting, so pacing would deadlock VLC.
          * Locking is not necessary as b_waiting is only read, not written by
          * the decoder thread. */
-        while( vlc_fifo_GetCount( p_owner->p_fifo ) >= 10 )
-            vlc_fifo_WaitCond( p_owner->p_fifo, &p_owner->wait_fifo );
+        vlc_spsc_Lock( p_owner->p_fifo );
+        vlc_spsc_CleanupPush( p_owner->p_fifo );
+        while( vlc_spsc_GetCount( p_owner->p_fifo ) >= 10 )
+            vlc_spsc_WaitCond( p_owner->p_fifo, &p_owner->wait_fifo );
+        vlc_cleanup_pop();
+        vlc_spsc_Unlock( p_owner->p_fifo );
     }
 
-    vlc_fifo_QueueUnlocked( p_owner->p_fifo, p_block );
-    vlc_fifo_Unlock( p_owner->p_fifo );
+    /* Queuing does not lock, unless the decoder thread is idle */
+    block_SpscPut( p_owner->p_fifo, p_block );
 }
 
 bool input_DecoderIsEmpty( decoder_t * p_dec )
@@ -2025,7 +2038,7 @@ bool input_DecoderIsEmpty( decoder_t * p_dec )
 
     assert( !p_owner->b_waiting );
 
-    if( block_FifoCount( p_dec->p_owner->p_fifo ) > 0 )
+    if( !vlc_spsc_IsEmpty( p_dec->p_owner->p_fifo ) )
         return false;
 
     bool b_empty;
@@ -2059,10 +2072,10 @@ void input_DecoderDrain( decoder_t *p_dec )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
 
-    vlc_fifo_Lock( p_owner->p_fifo );
+    vlc_spsc_Lock( p_owner->p_fifo );
     p_owner->b_draining = true;
-    vlc_fifo_Signal( p_owner->p_fifo );
-    vlc_fifo_Unlock( p_owner->p_fifo );
+    vlc_spsc_Signal( p_owner->p_fifo );
+    vlc_spsc_Unlock( p_owner->p_fifo );
 }
 
 /**
@@ -2073,10 +2086,10 @@ void input_DecoderFlush( decoder_t *p_dec )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
 
-    vlc_fifo_Lock( p_owner->p_fifo );
+    vlc_spsc_Lock( p_owner->p_fifo );
 
-    /* Empty the fifo */
-    block_ChainRelease( vlc_fifo_DequeueAllUnlocked( p_owner->p_fifo ) );
+    /* Empty the fifo (the blocks are released by the decoder thread) */
+    vlc_spsc_Flush( p_owner->p_fifo );
 
     /* Don't need to wait for the DecoderThread to flush. Indeed, if called a
      * second time, this function will clear the FIFO again before anything was
@@ -2090,10 +2103,10 @@ void input_DecoderFlush( decoder_t *p_dec )
      && p_owner->frames_countdown == 0 )
         p_owner->frames_countdown++;
 
-    vlc_fifo_Signal( p_owner->p_fifo );
+    vlc_spsc_Signal( p_owner->p_fifo );
     vlc_cond_signal( &p_owner->wait_timed );
 
-    vlc_fifo_Unlock( p_owner->p_fifo );
+    vlc_spsc_Unlock( p_owner->p_fifo );
 }
 
 void input_DecoderIsCcPresent( decoder_t *p_dec, bool pb_present[4] )
@@ -2185,12 +2198,12 @@ void input_DecoderChangePause( decoder_t *p_dec, bool b_paused, mtime_t i_date )
     /* Normally, p_owner->b_paused != b_paused here. But if a track is added
      * while the input is paused (e.g. add sub file), then b_paused is
      * (incorrectly) false. FIXME: This is a bug in the decoder owner. */
-    vlc_fifo_Lock( p_owner->p_fifo );
+    vlc_spsc_Lock( p_owner->p_fifo );
     p_owner->paused = b_paused;
     p_owner->pause_date = i_date;
     p_owner->frames_countdown = 0;
-    vlc_fifo_Signal( p_owner->p_fifo );
-    vlc_fifo_Unlock( p_owner->p_fifo );
+    vlc_spsc_Signal( p_owner->p_fifo );
+    vlc_spsc_Unlock( p_owner->p_fifo );
 }
 
 void input_DecoderChangeDelay( decoder_t *p_dec, mtime_t i_delay )
@@ -2241,14 +2254,14 @@ void input_DecoderWait( decoder_t *p_dec )
          * owner */
         if( p_owner->paused )
             break;
-        vlc_fifo_Lock( p_owner->p_fifo );
-        if( p_owner->b_idle && vlc_fifo_IsEmpty( p_owner->p_fifo ) )
+        vlc_spsc_Lock( p_owner->p_fifo );
+        if( p_owner->b_idle && vlc_spsc_IsEmpty( p_owner->p_fifo ) )
         {
             msg_Err( p_dec, "buffer deadlock prevented" );
-            vlc_fifo_Unlock( p_owner->p_fifo );
+            vlc_spsc_Unlock( p_owner->p_fifo );
             break;
         }
-        vlc_fifo_Unlock( p_owner->p_fifo );
+        vlc_spsc_Unlock( p_owner->p_fifo );
         vlc_cond_wait( &p_owner->wait_acknowledge, &p_owner->lock );
     }
     vlc_mutex_unlock( &p_owner->lock );
@@ -2261,10 +2274,10 @@ void input_DecoderFrameNext( decoder_t *p_dec, mtime_t *pi_duration )
     assert( p_owner->paused );
     *pi_duration = 0;
 
-    vlc_fifo_Lock( p_owner->p_fifo );
+    vlc_spsc_Lock( p_owner->p_fifo );
     p_owner->frames_countdown++;
-    vlc_fifo_Signal( p_owner->p_fifo );
-    vlc_fifo_Unlock( p_owner->p_fifo );
+    vlc_spsc_Signal( p_owner->p_fifo );
+    vlc_spsc_Unlock( p_owner->p_fifo );
 
     vlc_mutex_lock( &p_owner->lock );
     if( p_owner->fmt.i_cat == VIDEO_ES )
@@ -2307,7 +2320,7 @@ size_t input_DecoderGetFifoSize( decoder_t *p_dec )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
 
-    return block_FifoSize( p_owner->p_fifo );
+    return vlc_spsc_GetBytes( p_owner->p_fifo );
 }
 
 void input_DecoderGetObjects( decoder_t *p_dec,
@@ -34,6 +34,7 @@
 #include <vlc_url.h>
 #include <vlc_modules.h>
 #include <vlc_strings.h>
+#include <vlc_tracer.h>
 
 static bool SkipID3Tag( demux_t * );
 static bool SkipAPETag( demux_t *p_demux );
@@ -141,6 +142,73 @@ static const char* DemuxNameFromExtension( char const* ext,
     return result ? result->name : NULL;
 }
 
+/* Number of bytes peeked once to guess the container format */
+#define DEMUX_SNIFF_SIZE 1024
+
+static bool IsTSSync( const uint8_t *p, size_t i_peek,
+                      size_t i_offset, size_t i_packet )
+{
+    for( unsigned i = 0; i < 3; i++ )
+    {
+        size_t i_pos = i_offset + i * i_packet;
+        if( i_pos >= i_peek || p[i_pos] != 0x47 )
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Guesses the demux from the magic bytes at the start of the stream.
+ *
+ * This is only a hint: the returned module is tried first, then the
+ * remaining modules are probed as usual. Formats that several modules
+ * claim, such as raw audio in WAV, are deliberately not listed.
+ */
+static const char *DemuxNameFromContent( const uint8_t *p, size_t i_peek )
+{
+    static const struct
+    {
+        char name[8];
+        char chunk[5]; /* RIFF/IFF container chunk, if any */
+        uint8_t offset;
+        uint8_t length;
+        char magic[20];
+    } magics[] =
+    {
+        { "mp4",  "",     4, 4, "ftyp" },
+        { "mp4",  "",     4, 4, "moov" },
+        { "mkv",  "",     0, 4, "\x1A\x45\xDF\xA3" },
+        { "ogg",  "",     0, 4, "OggS" },
+        { "flac", "",     0, 4, "fLaC" },
+        { "avi",  "RIFF", 8, 4, "AVI " },
+        { "asf",  "",     0, 8, "\x30\x26\xB2\x75\x8E\x66\xCF\x11" },
+        { "aiff", "FORM", 8, 4, "AIFF" },
+        { "aiff", "FORM", 8, 4, "AIFC" },
+        { "au",   "",     0, 4, ".snd" },
+        { "voc",  "",     0, 19, "Creative Voice File" },
+        { "smf",  "",     0, 4, "MThd" },
+        { "ps",   "",     0, 4, "\x00\x00\x01\xBA" },
+    };
+
+    for( size_t i = 0; i < ARRAY_SIZE( magics ); i++ )
+    {
+        if( magics[i].offset + magics[i].length > i_peek )
+            continue;
+        if( magics[i].chunk[0] != '\0' && memcmp( p, magics[i].chunk, 4 ) )
+            continue;
+        if( !memcmp( p + magics[i].offset, magics[i].magic,
+                     magics[i].length ) )
+            return magics[i].name;
+    }
+
+    /* MPEG-TS with 188, 192 (M2TS) or 204 (FEC) bytes packets */
+    if( IsTSSync( p, i_peek, 0, 188 ) || IsTSSync( p, i_peek, 4, 192 )
+     || IsTSSync( p, i_peek, 0, 204 ) )
+        return "ts";
+
+    return NULL;
+}
+
 /*****************************************************************************
  * demux_New:
  *  if s is NULL then load a access_demux
@@ -245,8 +313,9 @@ demux_t *demux_NewAdvanced( vlc_object_t *p_obj, input_thread_t *p_parent_input,
                 psz_module = DemuxNameFromExtension( psz_ext + 1, b_preparsing );
         }
 
-        if( psz_module == NULL )
-            psz_module = p_demux->psz_demux;
+        vlc_trace_span_t span;
+
+        vlc_trace_Begin( p_demux, &span, "demux probe" );
 
         /* ID3/APE tags will mess-up demuxer probing so we skip it here.
          * ID3/APE parsers will called later on in the demuxer to access the
@@ -255,14 +324,59 @@ demux_t *demux_NewAdvanced( vlc_object_t *p_obj, input_thread_t *p_parent_input,
           ;
         SkipAPETag( p_demux );
 
+        /* Peek once and try the demux matching the content first, rather
+         * than going through every higher priority module. The peeked data
+         * remains buffered for the modules probing afterwards. */
+        const char *psz_sniffed = NULL;
+        char psz_list[16];
+
+        if( !strcmp( p_demux->psz_demux, "any" ) )
+        {
+            const uint8_t *p_peek;
+            ssize_t i_peek = vlc_stream_Peek( s, &p_peek, DEMUX_SNIFF_SIZE );
+
+            if( i_peek > 0 )
+                psz_sniffed = DemuxNameFromContent( p_peek, i_peek );
+        }
+
+        if( psz_sniffed != NULL )
+        {
+            if( psz_module != NULL && strcmp( psz_module, psz_sniffed ) )
+            {
+                snprintf( psz_list, sizeof (psz_list), "%s,%s",
+                          psz_sniffed, psz_module );
+                psz_module = psz_list;
+            }
+            else
+                psz_module = psz_sniffed;
+        }
+
+        if( psz_module == NULL )
+            psz_module = p_demux->psz_demux;
+
         p_demux->p_module =
             module_need( p_demux, "demux", psz_module,
                          !strcmp( psz_module, p_demux->psz_demux ) );
+
+        if( psz_sniffed != NULL && (p_demux->p_module == NULL
+         || strcmp( module_get_object( p_demux->p_module ), psz_sniffed )) )
+        {
+            msg_Dbg( p_demux, "content looked like %s, probe missed",
+                     psz_sniffed );
+            vlc_trace_Mark( p_demux, "demux sniff miss", psz_sniffed );
+        }
+        vlc_trace_End( &span, p_demux->p_module != NULL
+                       ? module_get_object( p_demux->p_module ) : NULL );
     }
     else
     {
+        vlc_trace_span_t span;
+
+        vlc_trace_Begin( p_demux, &span, "access_demux probe" );
         p_demux->p_module =
             module_need( p_demux, "access_demux", p_demux->psz_access, true );
+        vlc_trace_End( &span, p_demux->p_module != NULL
+                       ? module_get_object( p_demux->p_module ) : NULL );
     }
 
     if( p_demux->p_module == NULL )
@@ -565,6 +679,7 @@ int demux_vaControlHelper( stream_t *s,
         case DEMUX_SET_ES:
         case DEMUX_GET_ATTACHMENTS:
         case DEMUX_CAN_RECORD:
+        case DEMUX_GET_INDEX_PROGRESS:
         case DEMUX_TEST_AND_CLEAR_FLAGS:
         case DEMUX_GET_TITLE:
         case DEMUX_GET_SEEKPOINT:
@@ -0,0 +1,351 @@
+/*****************************************************************************
+ * demux_index.c: persistent seek index cache
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+#include <vlc_fs.h>
+#include <vlc_md5.h>
+#include <vlc_configuration.h>
+
+/* The file is identified by its size, its modification date and a digest of
+ * its first bytes, rather than by its path, so that the index survives file
+ * moves and is not reused if the file is overwritten in place. */
+#define INDEX_CACHE_HEAD_SIZE 65536
+#define INDEX_CACHE_MAX_SIZE  (UINT32_C(1) << 28)
+
+static const char index_cache_magic[8] = { 'V', 'L', 'C', 'S', 'I', 'D', 'X', '1' };
+
+static char *IndexCacheDir( void )
+{
+    char *psz_cachedir = config_GetUserDir( VLC_CACHE_DIR );
+    if( psz_cachedir == NULL )
+        return NULL;
+
+    char *psz_dir;
+    if( asprintf( &psz_dir, "%s" DIR_SEP "seekindex", psz_cachedir ) == -1 )
+        psz_dir = NULL;
+    free( psz_cachedir );
+    return psz_dir;
+}
+
+/* The user cache directory itself may not exist yet */
+static void IndexCacheCreateDir( char *psz_dir )
+{
+    for( char *psz = psz_dir + 1; *psz; psz++ )
+    {
+        if( *psz != DIR_SEP_CHAR )
+            continue;
+        *psz = '\0';
+        vlc_mkdir( psz_dir, 0700 );
+        *psz = DIR_SEP_CHAR;
+    }
+    vlc_mkdir( psz_dir, 0700 );
+}
+
+static char *IndexCachePath( demux_t *p_demux, const char *psz_name )
+{
+    if( p_demux->psz_file == NULL
+     || !var_InheritBool( p_demux, "demux-index-cache" ) )
+        return NULL;
+
+    struct stat st;
+    if( vlc_stat( p_demux->psz_file, &st ) || !S_ISREG( st.st_mode ) )
+        return NULL;
+
+    FILE *p_file = vlc_fopen( p_demux->psz_file, "rb" );
+    if( p_file == NULL )
+        return NULL;
+
+    uint8_t *p_head = malloc( INDEX_CACHE_HEAD_SIZE );
+    if( unlikely(p_head == NULL) )
+    {
+        fclose( p_file );
+        return NULL;
+    }
+    size_t i_head = fread( p_head, 1, INDEX_CACHE_HEAD_SIZE, p_file );
+    fclose( p_file );
+
+    uint8_t p_stat[16];
+    SetQWBE( &p_stat[0], st.st_size );
+    SetQWBE( &p_stat[8], st.st_mtime );
+
+    struct md5_s md5;
+    InitMD5( &md5 );
+    AddMD5( &md5, psz_name, strlen( psz_name ) + 1 );
+    AddMD5( &md5, p_stat, sizeof( p_stat ) );
+    AddMD5( &md5, p_head, i_head );
+    EndMD5( &md5 );
+    free( p_head );
+
+    char *psz_hash = psz_md5_hash( &md5 );
+    char *psz_dir = IndexCacheDir();
+    char *psz_path = NULL;
+
+    if( psz_hash != NULL && psz_dir != NULL
+     && asprintf( &psz_path, "%s" DIR_SEP "%s", psz_dir, psz_hash ) == -1 )
+        psz_path = NULL;
+    free( psz_dir );
+    free( psz_hash );
+    return psz_path;
+}
+
+struct index_cache_entry
+{
+    char    *psz_path;
+    time_t   i_mtime;
+    uint64_t i_size;
+};
+
+static int IndexCacheEntryCmp( const void *a, const void *b )
+{
+    const struct index_cache_entry *p_a = a, *p_b = b;
+
+    return (p_a->i_mtime > p_b->i_mtime) - (p_a->i_mtime < p_b->i_mtime);
+}
+
+/* Removes the least recently saved indexes until the whole cache fits in
+ * i_max bytes. The index just saved (psz_keep) is always kept. */
+static void IndexCachePrune( demux_t *p_demux, const char *psz_dir,
+                             const char *psz_keep, uint64_t i_max )
+{
+    DIR *p_dir = vlc_opendir( psz_dir );
+    if( p_dir == NULL )
+        return;
+
+    struct index_cache_entry *p_entries = NULL;
+    size_t i_entries = 0, i_max_entries = 0;
+    uint64_t i_total = 0;
+    const char *psz_name;
+
+    while( (psz_name = vlc_readdir( p_dir )) != NULL )
+    {
+        /* Skip dot entries and temporary files being written */
+        if( strchr( psz_name, '.' ) != NULL )
+            continue;
+
+        char *psz_path;
+        struct stat st;
+        if( asprintf( &psz_path, "%s" DIR_SEP "%s", psz_dir, psz_name ) == -1 )
+            continue;
+        if( vlc_stat( psz_path, &st ) || !S_ISREG( st.st_mode ) )
+        {
+            free( psz_path );
+            continue;
+        }
+        i_total += st.st_size;
+
+        if( !strcmp( psz_path, psz_keep ) )
+        {
+            free( psz_path );
+            continue;
+        }
+
+        if( i_entries == i_max_entries )
+        {
+            size_t i_new = i_max_entries ? 2 * i_max_entries : 64;
+            struct index_cache_entry *p_new =
+                realloc( p_entries, i_new * sizeof( *p_new ) );
+            if( unlikely(p_new == NULL) )
+            {
+                free( psz_path );
+                break;
+            }
+            p_entries = p_new;
+            i_max_entries = i_new;
+        }
+        p_entries[i_entries].psz_path = psz_path;
+        p_entries[i_entries].i_mtime = st.st_mtime;
+        p_entries[i_entries].i_size = st.st_size;
+        i_entries++;
+    }
+    closedir( p_dir );
+
+    if( i_total > i_max && i_entries > 0 )
+        qsort( p_entries, i_entries, sizeof( *p_entries ),
+               IndexCacheEntryCmp );
+
+    for( size_t i = 0; i < i_entries; i++ )
+    {
+        if( i_total > i_max && !vlc_unlink( p_entries[i].psz_path ) )
+        {
+            msg_Dbg( p_demux, "removed cached index %s",
+                     p_entries[i].psz_path );
+            i_total -= p_entries[i].i_size;
+        }
+        free( p_entries[i].psz_path );
+    }
+    free( p_entries );
+}
+
+static void IndexCacheDigest( uint8_t *p_digest, const void *p_data,
+                              size_t i_size )
+{
+    struct md5_s md5;
+    InitMD5( &md5 );
+    AddMD5( &md5, p_data, i_size );
+    EndMD5( &md5 );
+    memcpy( p_digest, md5.buf, 16 );
+}
+
+void *demux_IndexCacheLoad( demux_t *p_demux, const char *psz_name,
+                            size_t *pi_size )
+{
+    char *psz_path = IndexCachePath( p_demux, psz_name );
+    if( psz_path == NULL )
+        return NULL;
+
+    FILE *p_file = vlc_fopen( psz_path, "rb" );
+    if( p_file == NULL )
+    {
+        msg_Dbg( p_demux, "no cached %s index", psz_name );
+        free( psz_path );
+        return NULL;
+    }
+
+    uint8_t p_header[16], p_digest[16], p_check[16];
+    void *p_data = NULL;
+    size_t i_size = 0;
+
+    if( fread( p_header, 1, sizeof( p_header ), p_file ) != sizeof( p_header )
+     || memcmp( p_header, index_cache_magic, 8 ) )
+        goto error;
+
+    uint64_t i_size64 = GetQWBE( &p_header[8] );
+    if( i_size64 == 0 || i_size64 > INDEX_CACHE_MAX_SIZE )
+        goto error;
+    i_size = i_size64;
+
+    p_data = malloc( i_size );
+    if( unlikely(p_data == NULL) )
+        goto error;
+
+    if( fread( p_data, 1, i_size, p_file ) != i_size
+     || fread( p_digest, 1, 16, p_file ) != 16 )
+        goto error;
+
+    IndexCacheDigest( p_check, p_data, i_size );
+    if( memcmp( p_check, p_digest, 16 ) )
+        goto error;
+
+    fclose( p_file );
+    msg_Dbg( p_demux, "loaded %s index from %s (%zu bytes)", psz_name,
+             psz_path, i_size );
+    free( psz_path );
+    *pi_size = i_size;
+    return p_data;
+
+error:
+    msg_Warn( p_demux, "ignoring invalid index cache %s", psz_path );
+    fclose( p_file );
+    free( p_data );
+    free( psz_path );
+    return NULL;
+}
+
+int demux_IndexCacheSave( demux_t *p_demux, const char *psz_name,
+                          const void *p_data, size_t i_size )
+{
+    /* The header and the digest are stored along with the index */
+    const uint64_t i_max = (uint64_t)var_InheritInteger( p_demux,
+                                        "demux-index-cache-size" ) << 20;
+    if( i_size == 0 || i_size > INDEX_CACHE_MAX_SIZE || i_size + 32 > i_max )
+        return VLC_EGENERIC;
+
+    char *psz_path = IndexCachePath( p_demux, psz_name );
+    if( psz_path == NULL )
+        return VLC_EGENERIC;
+
+    char *psz_dir = IndexCacheDir();
+    if( psz_dir != NULL )
+        IndexCacheCreateDir( psz_dir );
+
+    /* Write to a temporary file, then rename it, so that concurrent
+     * readers never see a partial index. The name is unique, as other
+     * demuxers may be saving the same index at the same time. */
+    char *psz_tmp;
+    if( asprintf( &psz_tmp, "%s.XXXXXX", psz_path ) == -1 )
+    {
+        free( psz_dir );
+        free( psz_path );
+        return VLC_ENOMEM;
+    }
+
+    FILE *p_file = NULL;
+    int fd = vlc_mkstemp( psz_tmp );
+    if( fd != -1 )
+    {
+        p_file = fdopen( fd, "wb" );
+        if( p_file == NULL )
+        {
+            close( fd );
+            vlc_unlink( psz_tmp );
+        }
+    }
+    if( p_file == NULL )
+    {
+        msg_Warn( p_demux, "cannot create %s: %s", psz_tmp,
+                  vlc_strerror_c( errno ) );
+        goto error;
+    }
+
+    uint8_t p_header[16], p_digest[16];
+    memcpy( p_header, index_cache_magic, 8 );
+    SetQWBE( &p_header[8], i_size );
+    IndexCacheDigest( p_digest, p_data, i_size );
+
+    bool b_error = fwrite( p_header, 1, 16, p_file ) != 16
+                || fwrite( p_data, 1, i_size, p_file ) != i_size
+                || fwrite( p_digest, 1, 16, p_file ) != 16;
+    if( fclose( p_file ) || b_error
+     || vlc_rename( psz_tmp, psz_path ) )
+    {
+        msg_Warn( p_demux, "cannot write %s: %s", psz_path,
+                  vlc_strerror_c( errno ) );
+        vlc_unlink( psz_tmp );
+        goto error;
+    }
+
+    msg_Dbg( p_demux, "saved %s index to %s (%zu bytes)", psz_name,
+             psz_path, i_size );
+    if( psz_dir != NULL )
+        IndexCachePrune( p_demux, psz_dir, psz_path, i_max );
+    free( psz_dir );
+    free( psz_tmp );
+    free( psz_path );
+    return VLC_SUCCESS;
+
+error:
+    free( psz_dir );
+    free( psz_tmp );
+    free( psz_path );
+    return VLC_EGENERIC;
+}
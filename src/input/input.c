@@ -51,6 +51,7 @@
 #include <vlc_fs.h>
 #include <vlc_strings.h>
 #include <vlc_modules.h>
+#include <vlc_tracer.h>
 
 /*****************************************************************************
  * Local prototypes
@@ -280,10 +281,16 @@ static input_thread_t *Create( vlc_object_t *p_parent, input_item_t *p_item,
 {
     /* Allocate descriptor */
     input_thread_private_t *priv;
+    vlc_trace_span_t span;
+
+    vlc_trace_Begin( p_parent, &span, "input create" );
 
     priv = vlc_custom_create( p_parent, sizeof( *priv ), "input" );
     if( unlikely(priv == NULL) )
+    {
+        vlc_trace_End( &span, NULL );
         return NULL;
+    }
 
     input_thread_t *p_input = &priv->input;
 
@@ -465,6 +472,7 @@ static input_thread_t *Create( vlc_object_t *p_parent, input_item_t *p_item,
     /* Set the destructor when we are sure we are initialized */
     vlc_object_set_destructor( p_input, input_Destructor );
 
+    vlc_trace_End( &span, NULL );
     return p_input;
 }
 
@@ -1273,6 +1281,9 @@ static int Init( input_thread_t * p_input )
 {
     input_thread_private_t *priv = input_priv(p_input);
     input_source_t *master;
+    vlc_trace_span_t span;
+
+    vlc_trace_Begin( p_input, &span, "input init" );
 
     if( var_Type( p_input->obj.parent, "meta-file" ) )
     {
@@ -1364,9 +1375,11 @@ static int Init( input_thread_t * p_input )
     /* initialization is complete */
     input_ChangeState( p_input, PLAYING_S );
 
+    vlc_trace_End( &span, priv->p_item->psz_uri );
     return VLC_SUCCESS;
 
 error:
+    vlc_trace_End( &span, NULL );
     input_ChangeState( p_input, ERROR_S );
 
     if( input_priv(p_input)->p_es_out )
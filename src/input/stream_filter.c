@@ -28,6 +28,7 @@
 #include <vlc_common.h>
 #include <vlc_stream.h>
 #include <vlc_modules.h>
+#include <vlc_tracer.h>
 #include <libvlc.h>
 
 #include <assert.h>
@@ -70,6 +71,10 @@ error:
 /* Add automatic stream filter */
 stream_t *stream_FilterAutoNew( stream_t *p_source )
 {
+    vlc_trace_span_t span;
+
+    vlc_trace_Begin( p_source, &span, "stream filters probe" );
+
     /* Limit number of entries to avoid infinite recursion. */
     for( unsigned i = 0; i < 16; i++ )
     {
@@ -80,6 +85,8 @@ stream_t *stream_FilterAutoNew( stream_t *p_source )
         msg_Dbg( p_filter, "stream filter added to %p", (void *)p_source );
         p_source = p_filter;
     }
+
+    vlc_trace_End( &span, NULL );
     return p_source;
 }
 
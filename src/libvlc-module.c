@@ -85,6 +85,23 @@ static const char *const ppsz_snap_formats[] =
     "This is the verbosity level (0=only errors and " \
     "standard messages, 1=warnings, 2=debug).")
 
+#define VERBOSE_MODULES_TEXT N_("Per-module verbosity")
+#define VERBOSE_MODULES_LONGTEXT N_( \
+    "Comma-separated list of module=level pairs, e.g. \"ts=2,avcodec=0\". " \
+    "Messages above the level of their module are discarded before they " \
+    "are formatted. This cannot raise the verbosity of the logger.")
+
+#define LOG_ASYNC_TEXT N_("Asynchronous logging")
+#define LOG_ASYNC_LONGTEXT N_( \
+    "Format messages into per-thread buffers and pass them to the logger " \
+    "from a background thread, so that slow loggers do not delay the " \
+    "emitting threads. Messages are dropped if the buffers are full.")
+
+#define TRACE_FILE_TEXT N_("Trace file")
+#define TRACE_FILE_LONGTEXT N_( \
+    "Records the duration of start-up and input opening steps, and saves " \
+    "them to this file in the Chrome trace event format when VLC exits.")
+
 #define OPEN_TEXT N_("Default stream")
 #define OPEN_LONGTEXT N_( \
     "This stream will always be opened at VLC startup." )
@@ -822,6 +839,11 @@ static const char *const ppsz_prefres[] = {
     "However allocation of port numbers below 1025 is usually restricted " \
     "by the operating system." )
 
+#define HTTP_THREADS_TEXT N_( "HTTP server threads" )
+#define HTTP_THREADS_LONGTEXT N_( \
+    "Number of threads serving the clients of the HTTP and RTSP servers. " \
+    "Using more threads helps serving many simultaneous clients." )
+
 #define RTSP_PORT_TEXT N_( "RTSP server port" )
 #define RTSP_PORT_LONGTEXT N_( \
     "The RTSP server will listen on this TCP port. " \
@@ -1003,6 +1025,17 @@ static const char *const ppsz_prefres[] = {
     "the correct demuxer is not automatically detected. You should not "\
     "set this as a global option unless you really know what you are doing." )
 
+#define DEMUX_INDEX_CACHE_TEXT N_("Cache seek indexes")
+#define DEMUX_INDEX_CACHE_LONGTEXT N_( \
+    "Save the seek indexes that demultiplexers build by scanning files " \
+    "with a broken or missing index, so that later openings of the same " \
+    "files can seek without scanning them again." )
+
+#define DEMUX_INDEX_CACHE_SIZE_TEXT N_("Seek index cache size (MiB)")
+#define DEMUX_INDEX_CACHE_SIZE_LONGTEXT N_( \
+    "Maximum total size of the saved seek indexes. The least recently " \
+    "saved indexes are removed when it is exceeded." )
+
 #define VOD_SERVER_TEXT N_("VoD server module")
 #define VOD_SERVER_LONGTEXT N_( \
     "You can select which VoD server module you want to use. Set this " \
@@ -1048,6 +1081,20 @@ static const char *const ppsz_prefres[] = {
 #define STATS_LONGTEXT N_( \
      "Collect miscellaneous local statistics about the playing media.")
 
+#define BLOCK_POOL_TEXT N_("Pool data blocks")
+#define BLOCK_POOL_LONGTEXT N_( \
+     "Recycle data blocks through per-thread caches instead of the system " \
+     "allocator. This reduces allocator contention when many inputs run " \
+     "in the same process, at the cost of some memory. The pool is shared " \
+     "by the whole process, so only the setting of the first instance " \
+     "applies.")
+
+#define EXECUTOR_THREADS_TEXT N_("Worker threads")
+#define EXECUTOR_THREADS_LONGTEXT N_( \
+     "Number of threads running background tasks, such as meta data " \
+     "preparsing and art fetching. Zero selects the number of CPUs, " \
+     "with a minimum of two.")
+
 #define DAEMON_TEXT N_("Run as daemon process")
 #define DAEMON_LONGTEXT N_( \
      "Runs VLC as a background daemon process.")
@@ -1764,6 +1811,9 @@ vlc_module_begin ()
         change_integer_range( 1, 65535 )
     add_integer( "https-port", 8443, HTTPS_PORT_TEXT, HTTPS_PORT_LONGTEXT, true )
         change_integer_range( 1, 65535 )
+    add_integer( "http-threads", 1, HTTP_THREADS_TEXT,
+                 HTTP_THREADS_LONGTEXT, true )
+        change_integer_range( 1, 64 )
     add_string( "rtsp-host", NULL, RTSP_HOST_TEXT, RTSP_HOST_LONGTEXT, true )
     add_integer( "rtsp-port", 554, RTSP_PORT_TEXT, RTSP_PORT_LONGTEXT, true )
         change_integer_range( 1, 65535 )
@@ -1896,6 +1946,11 @@ vlc_module_begin ()
 
     set_subcategory( SUBCAT_INPUT_DEMUX )
     add_module( "demux", "demux", "any", DEMUX_TEXT, DEMUX_LONGTEXT, true )
+    add_bool( "demux-index-cache", true, DEMUX_INDEX_CACHE_TEXT,
+              DEMUX_INDEX_CACHE_LONGTEXT, true )
+    add_integer( "demux-index-cache-size", 128, DEMUX_INDEX_CACHE_SIZE_TEXT,
+                 DEMUX_INDEX_CACHE_SIZE_LONGTEXT, true )
+        change_integer_range( 1, 4096 )
     set_subcategory( SUBCAT_INPUT_ACODEC )
     set_subcategory( SUBCAT_INPUT_SCODEC )
     add_obsolete_bool( "prefer-system-codecs" )
@@ -2075,6 +2130,12 @@ vlc_module_begin ()
                  false )
         change_short('v')
         change_volatile ()
+    add_string( "verbose-modules", NULL, VERBOSE_MODULES_TEXT,
+                VERBOSE_MODULES_LONGTEXT, true )
+    add_bool( "log-async", false, LOG_ASYNC_TEXT, LOG_ASYNC_LONGTEXT, true )
+    add_savefile( "trace-file", NULL, TRACE_FILE_TEXT, TRACE_FILE_LONGTEXT,
+                  true )
+        change_volatile ()
     add_obsolete_string( "verbose-objects" ) /* since 2.1.0 */
 #if !defined(_WIN32) && !defined(__OS2__)
     add_bool( "daemon", 0, DAEMON_TEXT, DAEMON_LONGTEXT, true )
@@ -2096,6 +2157,11 @@ vlc_module_begin ()
               INTERACTION_LONGTEXT, false )
 
     add_bool ( "stats", true, STATS_TEXT, STATS_LONGTEXT, true )
+    add_bool ( "block-pool", false, BLOCK_POOL_TEXT, BLOCK_POOL_LONGTEXT,
+               true )
+    add_integer( "executor-threads", 0, EXECUTOR_THREADS_TEXT,
+                 EXECUTOR_THREADS_LONGTEXT, true )
+        change_integer_range( 0, 64 )
 
     set_subcategory( SUBCAT_INTERFACE_MAIN )
     add_module_cat( "intf", SUBCAT_INTERFACE_MAIN, NULL, INTF_TEXT,
@@ -67,6 +67,8 @@
 #include <vlc_cpu.h>
 #include <vlc_url.h>
 #include <vlc_modules.h>
+#include <vlc_executor.h>
+#include <vlc_tracer.h>
 
 #include "libvlc.h"
 #include "playlist/playlist_internal.h"
@@ -103,6 +105,7 @@ libvlc_int_t * libvlc_InternalCreate( void )
     priv = libvlc_priv (p_libvlc);
     priv->playlist = NULL;
     priv->p_vlm = NULL;
+    priv->tracer = NULL;
 
     vlc_ExitInit( &priv->exit );
 
@@ -147,11 +150,20 @@ int libvlc_InternalInit( libvlc_int_t *p_libvlc, int i_argc,
 
     vlc_threads_setup (p_libvlc);
 
+    /* Tracing must start before plugins are loaded, so it can only be
+     * enabled from the command line. */
+    vlc_trace_span_t init_span, span;
+
+    priv->tracer = vlc_tracer_Create( VLC_OBJECT(p_libvlc) );
+    vlc_trace_Begin( p_libvlc, &init_span, "libvlc init" );
+
     /* Load the builtins and plugins into the module_bank.
      * We have to do it before config_Load*() because this also gets the
      * list of configuration options exported by each module and loads their
      * default values. */
+    vlc_trace_Begin( p_libvlc, &span, "plugins load" );
     size_t module_count = module_LoadPlugins (p_libvlc);
+    vlc_trace_End( &span, NULL );
 
     /*
      * Override default configuration with config file settings
@@ -355,6 +367,12 @@ dbus_out:
 
     priv->b_stats = var_InheritBool( p_libvlc, "stats" );
 
+    bool b_block_pool = var_InheritBool( p_libvlc, "block-pool" );
+    if( block_PoolInit( b_block_pool ) != b_block_pool )
+        msg_Warn( p_libvlc, "block pool %s by another instance",
+                  b_block_pool ? "disabled" : "enabled" );
+    priv->b_block_pool = true;
+
     /*
      * Initialize hotkey handling
      */
@@ -362,6 +380,17 @@ dbus_out:
     if( !priv->actions )
         goto error;
 
+    /*
+     * Background tasks
+     */
+    unsigned threads = var_InheritInteger( p_libvlc, "executor-threads" );
+    if( threads == 0 )
+        /* Keep preparsing and art fetching from delaying one another */
+        threads = __MAX( vlc_GetCPUCount(), 2 );
+    priv->executor = vlc_executor_New( threads );
+    if( !priv->executor )
+        goto error;
+
     /*
      * Meta data handling
      */
@@ -493,9 +522,11 @@ dbus_out:
         free( psz_val );
     }
 
+    vlc_trace_End( &init_span, NULL );
     return VLC_SUCCESS;
 
 error:
+    vlc_trace_End( &init_span, "error" );
     libvlc_InternalCleanup( p_libvlc );
     return i_ret;
 }
@@ -537,6 +568,8 @@ void libvlc_InternalCleanup( libvlc_int_t *p_libvlc )
 
     if (priv->parser != NULL)
         playlist_preparser_Delete(priv->parser);
+    if (priv->executor != NULL)
+        vlc_executor_Delete(priv->executor);
 
     vlc_DeinitActions( p_libvlc, priv->actions );
 
@@ -544,6 +577,15 @@ void libvlc_InternalCleanup( libvlc_int_t *p_libvlc )
     if( !var_InheritBool( p_libvlc, "ignore-config" ) )
         config_AutoSaveConfigFile( VLC_OBJECT(p_libvlc) );
 
+    if( priv->b_block_pool )
+        block_PoolDeinit();
+
+    if( priv->tracer != NULL )
+    {
+        vlc_tracer_Destroy( VLC_OBJECT(p_libvlc), priv->tracer );
+        priv->tracer = NULL;
+    }
+
     /* Free module bank. It is refcounted, so we call this each time  */
     vlc_LogDeinit (p_libvlc);
     module_EndBank (true);
@@ -77,6 +77,12 @@ int vlc_LogPreinit(libvlc_int_t *);
 int vlc_LogInit(libvlc_int_t *);
 void vlc_LogDeinit(libvlc_int_t *);
 
+/*
+ * Tracing
+ */
+struct vlc_tracer *vlc_tracer_Create(vlc_object_t *);
+void vlc_tracer_Destroy(vlc_object_t *, struct vlc_tracer *);
+
 /*
  * LibVLC exit event handling
  */
@@ -142,6 +148,7 @@ typedef struct libvlc_priv_t
 
     /* Logging */
     bool               b_stats;     ///< Whether to collect stats
+    bool               b_block_pool; ///< Whether registered with the block pool
 
     /* Singleton objects */
     vlc_logger_t      *logger;
@@ -149,8 +156,10 @@ typedef struct libvlc_priv_t
     vlc_dialog_provider *p_dialog_provider; ///< dialog provider
     vlc_keystore      *p_memory_keystore; ///< memory keystore
     struct playlist_t *playlist; ///< Playlist for interfaces
+    struct vlc_executor *executor; ///< Shared pool of worker threads
     struct playlist_preparser_t *parser; ///< Input item meta data handler
     struct vlc_actions *actions; ///< Hotkeys handler
+    struct vlc_tracer *tracer; ///< Latency tracer (or NULL)
 
     /* Exit callback */
     vlc_exit_t       exit;
@@ -167,6 +176,13 @@ void intf_DestroyAll( libvlc_int_t * );
 
 #define libvlc_stats( o ) (libvlc_priv((VLC_OBJECT(o))->obj.libvlc)->b_stats)
 
+/*
+ * Data blocks
+ */
+bool block_PoolInit(bool enable);
+void block_PoolDeinit(void);
+void block_PoolGetStats(uint64_t *hits, uint64_t *misses);
+
 /*
  * Variables stuff
  */
@@ -34,6 +34,9 @@
 #include <vlc_common.h>
 #include <vlc_block.h>
 #include <vlc_fs.h>
+#include <vlc_atomic.h>
+
+#include "libvlc.h"
 
 #ifndef NDEBUG
 static void BlockNoRelease( block_t *b )
@@ -117,15 +120,323 @@ static void BlockMetaCopy( block_t *restrict out, const block_t *in )
 /** Initial reserved header and footer size. */
 #define BLOCK_PADDING      32
 
+/*
+ * Size-classed block pool
+ *
+ * When enabled with the "block-pool" option, block_Alloc() serves
+ * allocations up to BLOCK_POOL_MAX bytes from power-of-two size classes.
+ * Released blocks go to a cache of the releasing thread. Full caches spill to
+ * process-wide lock-free lists, where caches of other threads refill from.
+ * The heap is only used on cache misses, so that threads exchanging blocks
+ * (demux and decoders, muxers and access outputs) do not contend on it.
+ */
+#define BLOCK_POOL_MIN_SHIFT 9 /* 512 bytes */
+#define BLOCK_POOL_CLASSES   8
+#define BLOCK_POOL_MAX       ((size_t)1 << (BLOCK_POOL_MIN_SHIFT + BLOCK_POOL_CLASSES - 1))
+#define BLOCK_POOL_CACHE     32  /* per class, per thread */
+#define BLOCK_POOL_SHARED    256 /* per class, process-wide */
+#define BLOCK_POOL_STATS     256 /* counters update period */
+
+struct block_pool_cache
+{
+    block_t *free[BLOCK_POOL_CLASSES];
+    unsigned count[BLOCK_POOL_CLASSES];
+    unsigned long hits;
+    unsigned long misses;
+    struct block_pool_cache *next; /* in block_pool.caches */
+};
+
+static struct
+{
+    vlc_mutex_t lock;
+    unsigned instances; /* LibVLC instances, protected by lock */
+    atomic_uint refs; /* non-zero if the pool is enabled */
+    bool has_cache; /* cache created, protected by lock */
+    vlc_threadvar_t cache;
+    struct block_pool_cache *caches; /* all thread caches, protected by lock */
+    atomic_uintptr_t shared[BLOCK_POOL_CLASSES];
+    atomic_uint shared_count[BLOCK_POOL_CLASSES];
+    atomic_ulong hits;
+    atomic_ulong misses;
+} block_pool = { .lock = VLC_STATIC_MUTEX };
+
+static int block_pool_Class (size_t size)
+{
+    if (size > BLOCK_POOL_MAX)
+        return -1;
+
+    int c = 0;
+    while (((size_t)1 << (BLOCK_POOL_MIN_SHIFT + c)) < size)
+        c++;
+    return c;
+}
+
+static void block_pool_FlushStats (struct block_pool_cache *cache)
+{
+    atomic_fetch_add_explicit (&block_pool.hits, cache->hits,
+                               memory_order_relaxed);
+    atomic_fetch_add_explicit (&block_pool.misses, cache->misses,
+                               memory_order_relaxed);
+    cache->hits = cache->misses = 0;
+}
+
+static void block_pool_FreeChain (block_t *b)
+{
+    while (b != NULL)
+    {
+        block_t *next = b->p_next;
+        free (b);
+        b = next;
+    }
+}
+
+/** Moves the cached blocks of a class to the shared list, or to the heap. */
+static void block_pool_Spill (struct block_pool_cache *cache, unsigned c)
+{
+    block_t *first = cache->free[c], *last = first;
+    unsigned count = cache->count[c];
+
+    if (first == NULL)
+        return;
+    cache->free[c] = NULL;
+    cache->count[c] = 0;
+
+    if (atomic_fetch_add_explicit (&block_pool.shared_count[c], count,
+                                   memory_order_relaxed) >= BLOCK_POOL_SHARED)
+    {   /* Enough spare blocks already */
+        atomic_fetch_sub_explicit (&block_pool.shared_count[c], count,
+                                   memory_order_relaxed);
+        block_pool_FreeChain (first);
+        return;
+    }
+
+    while (last->p_next != NULL)
+        last = last->p_next;
+
+    /* Lock-free push of the whole chain */
+    uintptr_t head = atomic_load_explicit (&block_pool.shared[c],
+                                           memory_order_relaxed);
+    do
+        last->p_next = (block_t *)head;
+    while (!atomic_compare_exchange_weak_explicit (&block_pool.shared[c],
+                                                   &head, (uintptr_t)first,
+                                                   memory_order_release,
+                                                   memory_order_relaxed));
+}
+
+/** Takes all the blocks of a class from the shared list. */
+static void block_pool_Refill (struct block_pool_cache *cache, unsigned c)
+{
+    /* Taking the whole list at once is not subject to ABA issues */
+    block_t *b = (block_t *)atomic_exchange_explicit (&block_pool.shared[c], 0,
+                                                      memory_order_acquire);
+    unsigned count = 0;
+
+    cache->free[c] = b;
+    for (; b != NULL; b = b->p_next)
+        count++;
+    cache->count[c] = count;
+    atomic_fetch_sub_explicit (&block_pool.shared_count[c], count,
+                               memory_order_relaxed);
+}
+
+/** Thread-specific variable destructor. */
+static void block_pool_DestroyCache (void *data)
+{
+    struct block_pool_cache *cache = data, **pp;
+
+    vlc_mutex_lock (&block_pool.lock);
+    for (pp = &block_pool.caches; *pp != cache; pp = &(*pp)->next)
+        assert (*pp != NULL);
+    *pp = cache->next;
+
+    for (unsigned c = 0; c < BLOCK_POOL_CLASSES; c++)
+    {
+        if (atomic_load_explicit (&block_pool.refs, memory_order_relaxed))
+            block_pool_Spill (cache, c);
+        else
+            block_pool_FreeChain (cache->free[c]);
+    }
+    block_pool_FlushStats (cache);
+    vlc_mutex_unlock (&block_pool.lock);
+    free (cache);
+}
+
+static struct block_pool_cache *block_pool_GetCache (void)
+{
+    if (atomic_load_explicit (&block_pool.refs, memory_order_relaxed) == 0)
+        return NULL;
+
+    struct block_pool_cache *cache = vlc_threadvar_get (block_pool.cache);
+    if (unlikely(cache == NULL))
+    {
+        cache = calloc (1, sizeof (*cache));
+        if (unlikely(cache == NULL))
+            return NULL;
+        if (vlc_threadvar_set (block_pool.cache, cache))
+        {
+            free (cache);
+            return NULL;
+        }
+        vlc_mutex_lock (&block_pool.lock);
+        cache->next = block_pool.caches;
+        block_pool.caches = cache;
+        vlc_mutex_unlock (&block_pool.lock);
+    }
+    return cache;
+}
+
+static void block_pool_Release (block_t *block)
+{
+    assert (block->p_start == (unsigned char *)(block + 1));
+    block_Invalidate (block);
+
+    struct block_pool_cache *cache = block_pool_GetCache ();
+    if (cache == NULL)
+    {   /* Pool disabled in the mean time */
+        free (block);
+        return;
+    }
+
+    int c = block_pool_Class (block->i_size + sizeof (*block));
+    assert (c >= 0);
+
+    block->p_next = cache->free[c];
+    cache->free[c] = block;
+    if (++cache->count[c] > BLOCK_POOL_CACHE)
+        block_pool_Spill (cache, c);
+}
+
+/**
+ * Allocates a block from the pool.
+ * \param size pointer to the requested allocation size [IN],
+ *             rounded up to the size class [OUT]
+ * \return the (uninitialized) block, or NULL if the pool is not used
+ */
+static block_t *block_pool_Alloc (size_t *restrict size)
+{
+    int c = block_pool_Class (*size);
+    if (c < 0)
+        return NULL;
+
+    struct block_pool_cache *cache = block_pool_GetCache ();
+    if (cache == NULL)
+        return NULL;
+
+    if (cache->free[c] == NULL)
+        block_pool_Refill (cache, c);
+
+    *size = (size_t)1 << (BLOCK_POOL_MIN_SHIFT + c);
+
+    block_t *b = cache->free[c];
+    if (b != NULL)
+    {
+        cache->free[c] = b->p_next;
+        cache->count[c]--;
+        cache->hits++;
+    }
+    else
+    {
+        b = malloc (*size);
+        cache->misses++;
+    }
+
+    if ((cache->hits + cache->misses) >= BLOCK_POOL_STATS)
+        block_pool_FlushStats (cache);
+    return b;
+}
+
+/**
+ * Registers a LibVLC instance with the block pool.
+ * The pool is process-wide: the first instance decides whether it is used,
+ * and the setting of later instances is ignored until all are gone.
+ * \param enable whether this instance requests the pool
+ * \return whether the pool is used
+ */
+bool block_PoolInit (bool enable)
+{
+    vlc_mutex_lock (&block_pool.lock);
+    if (block_pool.instances++ == 0 && enable)
+    {
+        /* The thread caches outlive the pool, see block_PoolDeinit() */
+        if (!block_pool.has_cache)
+            block_pool.has_cache = vlc_threadvar_create (&block_pool.cache,
+                                               block_pool_DestroyCache) == 0;
+        if (block_pool.has_cache)
+            atomic_store_explicit (&block_pool.refs, 1, memory_order_relaxed);
+    }
+
+    enable = atomic_load_explicit (&block_pool.refs, memory_order_relaxed) != 0;
+    vlc_mutex_unlock (&block_pool.lock);
+    return enable;
+}
+
+/**
+ * Unregisters a LibVLC instance, and disables the block pool with the last
+ * one. Blocks allocated from the pool remain valid, and are freed on release.
+ * The cache of the calling thread is freed. Other threads that are still
+ * alive may be using theirs: those are freed when the threads exit.
+ */
+void block_PoolDeinit (void)
+{
+    vlc_mutex_lock (&block_pool.lock);
+    assert (block_pool.instances > 0);
+    if (--block_pool.instances > 0
+     || atomic_load_explicit (&block_pool.refs, memory_order_relaxed) == 0)
+    {
+        vlc_mutex_unlock (&block_pool.lock);
+        return;
+    }
+
+    atomic_store_explicit (&block_pool.refs, 0, memory_order_relaxed);
+
+    struct block_pool_cache *cache = vlc_threadvar_get (block_pool.cache);
+    vlc_mutex_unlock (&block_pool.lock);
+
+    if (cache != NULL)
+    {
+        vlc_threadvar_set (block_pool.cache, NULL);
+        block_pool_DestroyCache (cache);
+    }
+
+    /* Threads still alive may spill concurrently: only take what is there */
+    for (unsigned c = 0; c < BLOCK_POOL_CLASSES; c++)
+    {
+        block_t *b = (block_t *)atomic_exchange (&block_pool.shared[c], 0);
+        unsigned count = 0;
+
+        for (block_t *p = b; p != NULL; p = p->p_next)
+            count++;
+        atomic_fetch_sub (&block_pool.shared_count[c], count);
+        block_pool_FreeChain (b);
+    }
+}
+
+/**
+ * Gets the block pool counters.
+ * Those are process-wide, and updated by each thread in batches.
+ */
+void block_PoolGetStats (uint64_t *restrict hits, uint64_t *restrict misses)
+{
+    *hits = atomic_load_explicit (&block_pool.hits, memory_order_relaxed);
+    *misses = atomic_load_explicit (&block_pool.misses, memory_order_relaxed);
+}
+
 block_t *block_Alloc (size_t size)
 {
     /* 2 * BLOCK_PADDING: pre + post padding */
-    const size_t alloc = sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING)
-                       + size;
+    size_t alloc = sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING)
+                 + size;
     if (unlikely(alloc <= size))
         return NULL;
 
-    block_t *b = malloc (alloc);
+    void (*release) (block_t *) = block_pool_Release;
+    block_t *b = block_pool_Alloc (&alloc);
+    if (b == NULL)
+    {
+        b = malloc (alloc);
+        release = block_generic_Release;
+    }
     if (unlikely(b == NULL))
         return NULL;
 
@@ -135,7 +446,7 @@ block_t *block_Alloc (size_t size)
     b->p_buffer += BLOCK_PADDING + BLOCK_ALIGN - 1;
     b->p_buffer = (void *)(((uintptr_t)b->p_buffer) & ~(BLOCK_ALIGN - 1));
     b->i_buffer = size;
-    b->pf_release = block_generic_Release;
+    b->pf_release = release;
     return b;
 }
 
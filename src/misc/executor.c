@@ -0,0 +1,404 @@
+/*****************************************************************************
+ * executor.c: thread pool executing tasks
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <vlc_common.h>
+#include <vlc_atomic.h>
+#include <vlc_executor.h>
+#include <vlc_interrupt.h>
+
+#define PRIORITY_COUNT (VLC_EXECUTOR_PRIORITY_HIGH + 1)
+
+enum
+{
+    TASK_QUEUED,
+    TASK_RUNNING,
+    TASK_DONE, /* completed or cancelled */
+};
+
+struct vlc_executor_task
+{
+    vlc_executor_t *executor;
+    void (*run)(void *);
+    void *data;
+    int priority;
+    unsigned queue; /* index of the queue the task was submitted to */
+    atomic_uint refs;
+    atomic_uint state;
+    vlc_interrupt_t *interrupt;
+    struct vlc_executor_task *prev, *next;
+};
+
+/* Per-thread queue of pending tasks */
+struct vlc_executor_queue
+{
+    vlc_executor_t *executor;
+    vlc_thread_t thread;
+    vlc_executor_task_t *running; /* protected by the executor lock */
+    vlc_mutex_t lock;
+    vlc_executor_task_t *head[PRIORITY_COUNT];
+    vlc_executor_task_t *tail[PRIORITY_COUNT];
+};
+
+struct vlc_executor
+{
+    vlc_mutex_t lock;
+    vlc_cond_t  wait; /* tasks were submitted, or quitting */
+    vlc_cond_t  done; /* a task completed */
+    unsigned    pending; /* number of queued tasks */
+    bool        quit;
+
+    vlc_threadvar_t self; /* queue of the calling executor thread */
+    atomic_uint next; /* queue for the next task from an outside thread */
+    unsigned    count; /* number of queues */
+    unsigned    threads; /* number of threads, queues without one are
+                          * only served by stealing */
+    struct vlc_executor_queue queues[];
+};
+
+static void TaskRelease(vlc_executor_task_t *task)
+{
+    if (atomic_fetch_sub(&task->refs, 1) != 1)
+        return;
+
+    vlc_interrupt_destroy(task->interrupt);
+    free(task);
+}
+
+static void TaskDone(vlc_executor_task_t *task,
+                     struct vlc_executor_queue *queue)
+{
+    vlc_executor_t *executor = task->executor;
+
+    vlc_mutex_lock(&executor->lock);
+    if (queue != NULL)
+        queue->running = NULL;
+    atomic_store(&task->state, TASK_DONE);
+    vlc_cond_broadcast(&executor->done);
+    vlc_mutex_unlock(&executor->lock);
+}
+
+static void QueueAppend(struct vlc_executor_queue *queue,
+                        vlc_executor_task_t *task)
+{
+    int prio = task->priority;
+
+    task->next = NULL;
+    task->prev = queue->tail[prio];
+    if (task->prev != NULL)
+        task->prev->next = task;
+    else
+        queue->head[prio] = task;
+    queue->tail[prio] = task;
+}
+
+static void QueueRemove(struct vlc_executor_queue *queue,
+                        vlc_executor_task_t *task)
+{
+    int prio = task->priority;
+
+    if (task->prev != NULL)
+        task->prev->next = task->next;
+    else
+        queue->head[prio] = task->next;
+    if (task->next != NULL)
+        task->next->prev = task->prev;
+    else
+        queue->tail[prio] = task->prev;
+}
+
+/**
+ * Dequeues the oldest task of the highest priority from a queue.
+ */
+static vlc_executor_task_t *QueueTake(struct vlc_executor_queue *queue)
+{
+    vlc_executor_task_t *task = NULL;
+
+    vlc_mutex_lock(&queue->lock);
+    for (int prio = PRIORITY_COUNT - 1; prio >= 0 && task == NULL; prio--)
+    {
+        task = queue->head[prio];
+        if (task != NULL)
+        {
+            QueueRemove(queue, task);
+            atomic_store(&task->state, TASK_RUNNING);
+        }
+    }
+    vlc_mutex_unlock(&queue->lock);
+    return task;
+}
+
+/**
+ * Takes a task from the own queue of a thread, or steals one from the others.
+ */
+static vlc_executor_task_t *Take(struct vlc_executor_queue *self)
+{
+    vlc_executor_t *executor = self->executor;
+    unsigned index = self - executor->queues;
+
+    for (unsigned i = 0; i < executor->count; i++)
+    {
+        struct vlc_executor_queue *queue =
+            &executor->queues[(index + i) % executor->count];
+        vlc_executor_task_t *task = QueueTake(queue);
+
+        if (task != NULL)
+        {
+            vlc_mutex_lock(&executor->lock);
+            executor->pending--;
+            self->running = task;
+            if (executor->quit) /* taken while the executor is deleted */
+                vlc_interrupt_kill(task->interrupt);
+            vlc_mutex_unlock(&executor->lock);
+            return task;
+        }
+    }
+    return NULL;
+}
+
+static void *Thread(void *data)
+{
+    struct vlc_executor_queue *queue = data;
+    vlc_executor_t *executor = queue->executor;
+
+    vlc_threadvar_set(executor->self, queue);
+
+    for (;;)
+    {
+        vlc_executor_task_t *task = Take(queue);
+
+        if (task == NULL)
+        {
+            vlc_mutex_lock(&executor->lock);
+            while (executor->pending == 0 && !executor->quit)
+                vlc_cond_wait(&executor->wait, &executor->lock);
+
+            bool quit = executor->pending == 0;
+            vlc_mutex_unlock(&executor->lock);
+            if (quit)
+                break;
+            continue;
+        }
+
+        vlc_interrupt_set(task->interrupt);
+        task->run(task->data);
+        vlc_interrupt_set(NULL);
+
+        TaskDone(task, queue);
+        TaskRelease(task);
+    }
+    return NULL;
+}
+
+vlc_executor_t *vlc_executor_New(unsigned threads)
+{
+    if (threads == 0)
+        threads = vlc_GetCPUCount();
+    if (threads == 0)
+        threads = 1;
+
+    vlc_executor_t *executor = malloc(sizeof (*executor)
+                                      + threads * sizeof (executor->queues[0]));
+    if (unlikely(executor == NULL))
+        return NULL;
+
+    if (vlc_threadvar_create(&executor->self, NULL))
+    {
+        free(executor);
+        return NULL;
+    }
+
+    vlc_mutex_init(&executor->lock);
+    vlc_cond_init(&executor->wait);
+    vlc_cond_init(&executor->done);
+    executor->pending = 0;
+    executor->quit = false;
+    atomic_init(&executor->next, 0);
+    executor->count = threads;
+    executor->threads = 0;
+
+    for (unsigned i = 0; i < threads; i++)
+    {
+        struct vlc_executor_queue *queue = &executor->queues[i];
+
+        queue->executor = executor;
+        queue->running = NULL;
+        vlc_mutex_init(&queue->lock);
+        for (int prio = 0; prio < PRIORITY_COUNT; prio++)
+            queue->head[prio] = queue->tail[prio] = NULL;
+    }
+
+    while (executor->threads < threads)
+    {
+        struct vlc_executor_queue *queue =
+            &executor->queues[executor->threads];
+
+        if (vlc_clone(&queue->thread, Thread, queue,
+                      VLC_THREAD_PRIORITY_LOW))
+            break;
+        executor->threads++;
+    }
+
+    if (executor->threads == 0)
+    {
+        vlc_executor_Delete(executor);
+        return NULL;
+    }
+    return executor;
+}
+
+void vlc_executor_Delete(vlc_executor_t *executor)
+{
+    /* Cancel pending tasks, and interrupt running ones */
+    for (unsigned i = 0; i < executor->count; i++)
+    {
+        struct vlc_executor_queue *queue = &executor->queues[i];
+        vlc_executor_task_t *task;
+
+        while ((task = QueueTake(queue)) != NULL)
+        {
+            vlc_mutex_lock(&executor->lock);
+            executor->pending--;
+            vlc_mutex_unlock(&executor->lock);
+
+            TaskDone(task, NULL);
+            TaskRelease(task);
+        }
+    }
+
+    vlc_mutex_lock(&executor->lock);
+    for (unsigned i = 0; i < executor->count; i++)
+        if (executor->queues[i].running != NULL)
+            vlc_interrupt_kill(executor->queues[i].running->interrupt);
+    executor->quit = true;
+    vlc_cond_broadcast(&executor->wait);
+    vlc_mutex_unlock(&executor->lock);
+
+    for (unsigned i = 0; i < executor->threads; i++)
+        vlc_join(executor->queues[i].thread, NULL);
+    for (unsigned i = 0; i < executor->count; i++)
+        vlc_mutex_destroy(&executor->queues[i].lock);
+
+    assert(executor->pending == 0);
+    vlc_cond_destroy(&executor->done);
+    vlc_cond_destroy(&executor->wait);
+    vlc_mutex_destroy(&executor->lock);
+    vlc_threadvar_delete(&executor->self);
+    free(executor);
+}
+
+int vlc_executor_Submit(vlc_executor_t *executor, void (*run)(void *),
+                        void *data, int priority, vlc_executor_task_t **taskp)
+{
+    assert(priority >= 0 && priority < PRIORITY_COUNT);
+
+    vlc_executor_task_t *task = malloc(sizeof (*task));
+    if (unlikely(task == NULL))
+        return VLC_ENOMEM;
+
+    task->interrupt = vlc_interrupt_create();
+    if (unlikely(task->interrupt == NULL))
+    {
+        free(task);
+        return VLC_ENOMEM;
+    }
+
+    task->executor = executor;
+    task->run = run;
+    task->data = data;
+    task->priority = priority;
+    atomic_init(&task->refs, (taskp != NULL) ? 2 : 1);
+    atomic_init(&task->state, TASK_QUEUED);
+
+    /* Tasks submitted from an executor thread go to its own queue, for
+     * locality. Other tasks are spread over all the queues. */
+    struct vlc_executor_queue *queue = vlc_threadvar_get(executor->self);
+
+    if (queue == NULL)
+        queue = &executor->queues[atomic_fetch_add(&executor->next, 1)
+                                  % executor->count];
+    task->queue = queue - executor->queues;
+
+    if (taskp != NULL)
+        *taskp = task;
+
+    /* Count the task before it can be taken, so that the counter never
+     * goes below zero. Until it is queued, an idle thread may at worst find
+     * no task and look again. */
+    vlc_mutex_lock(&executor->lock);
+    executor->pending++;
+    vlc_mutex_unlock(&executor->lock);
+
+    vlc_mutex_lock(&queue->lock);
+    QueueAppend(queue, task);
+    vlc_mutex_unlock(&queue->lock);
+
+    vlc_mutex_lock(&executor->lock);
+    vlc_cond_signal(&executor->wait);
+    vlc_mutex_unlock(&executor->lock);
+    return VLC_SUCCESS;
+}
+
+bool vlc_executor_Cancel(vlc_executor_task_t *task)
+{
+    vlc_executor_t *executor = task->executor;
+    struct vlc_executor_queue *queue = &executor->queues[task->queue];
+    bool queued;
+
+    vlc_mutex_lock(&queue->lock);
+    queued = atomic_load(&task->state) == TASK_QUEUED;
+    if (queued)
+        QueueRemove(queue, task);
+    vlc_mutex_unlock(&queue->lock);
+
+    if (queued)
+    {
+        vlc_mutex_lock(&executor->lock);
+        executor->pending--;
+        vlc_mutex_unlock(&executor->lock);
+
+        TaskDone(task, NULL);
+        TaskRelease(task);
+    }
+    else
+        vlc_interrupt_kill(task->interrupt);
+    return queued;
+}
+
+void vlc_executor_Wait(vlc_executor_task_t *task)
+{
+    vlc_executor_t *executor = task->executor;
+
+    vlc_mutex_lock(&executor->lock);
+    while (atomic_load(&task->state) != TASK_DONE)
+        vlc_cond_wait(&executor->done, &executor->lock);
+    vlc_mutex_unlock(&executor->lock);
+}
+
+void vlc_executor_Release(vlc_executor_task_t *task)
+{
+    TaskRelease(task);
+}
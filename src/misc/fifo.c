@@ -30,6 +30,7 @@
 
 #include <vlc_common.h>
 #include <vlc_block.h>
+#include <vlc_atomic.h>
 #include "libvlc.h"
 
 /**
@@ -233,3 +234,271 @@ size_t block_FifoCount (block_fifo_t *fifo)
     vlc_mutex_unlock (&fifo->lock);
     return depth;
 }
+
+/**
+ * Internal state for single-producer single-consumer block queues
+ *
+ * The producer pushes blocks on a lock-free LIFO. When its own list runs dry,
+ * the consumer takes the whole LIFO at once (so there is no ABA problem), and
+ * reverses it. Depth and size are derived from running totals, which are
+ * each written by a single thread.
+ */
+struct block_spsc_t
+{
+    vlc_mutex_t         lock;
+    vlc_cond_t          wait;      /**< Wait for data */
+    atomic_bool         waiting;   /**< Consumer waits on the condition */
+    atomic_size_t       serial;    /**< Incremented after each queuing */
+    size_t              seen;      /**< Serial last seen by the consumer */
+
+    atomic_uintptr_t    pushed;    /**< Blocks queued, last first */
+    block_t            *p_first;   /**< Blocks taken by the consumer */
+
+    atomic_size_t       in_count, in_bytes;           /**< Queued */
+    atomic_size_t       out_count, out_bytes;         /**< Dequeued */
+    atomic_size_t       discard_count, discard_bytes; /**< Flushed */
+};
+
+block_spsc_t *block_SpscNew(void)
+{
+    block_spsc_t *q = malloc(sizeof (*q));
+    if (unlikely(q == NULL))
+        return NULL;
+
+    vlc_mutex_init(&q->lock);
+    vlc_cond_init(&q->wait);
+    atomic_init(&q->waiting, false);
+    atomic_init(&q->serial, 0);
+    q->seen = 0;
+    atomic_init(&q->pushed, 0);
+    q->p_first = NULL;
+    atomic_init(&q->in_count, 0);
+    atomic_init(&q->in_bytes, 0);
+    atomic_init(&q->out_count, 0);
+    atomic_init(&q->out_bytes, 0);
+    atomic_init(&q->discard_count, 0);
+    atomic_init(&q->discard_bytes, 0);
+    return q;
+}
+
+void block_SpscRelease(block_spsc_t *q)
+{
+    block_ChainRelease(q->p_first);
+    block_ChainRelease((block_t *)atomic_load(&q->pushed));
+    vlc_cond_destroy(&q->wait);
+    vlc_mutex_destroy(&q->lock);
+    free(q);
+}
+
+void block_SpscPut(block_spsc_t *q, block_t *block)
+{
+    /* Only the producer writes those */
+    size_t count = atomic_load_explicit(&q->in_count, memory_order_relaxed);
+    size_t bytes = atomic_load_explicit(&q->in_bytes, memory_order_relaxed);
+
+    while (block != NULL)
+    {
+        block_t *next = block->p_next;
+
+        /* Account before queuing, so that the counts never underflow */
+        atomic_store_explicit(&q->in_count, ++count, memory_order_release);
+        atomic_store_explicit(&q->in_bytes, bytes += block->i_buffer,
+                              memory_order_release);
+
+        uintptr_t head = atomic_load_explicit(&q->pushed,
+                                              memory_order_relaxed);
+        do
+            block->p_next = (block_t *)head;
+        while (!atomic_compare_exchange_weak_explicit(&q->pushed, &head,
+                                                      (uintptr_t)block,
+                                                      memory_order_release,
+                                                      memory_order_relaxed));
+        block = next;
+    }
+
+    /* Pairs with vlc_spsc_Wait(): either the consumer sees the new serial,
+     * or we see that it waits. */
+    atomic_fetch_add(&q->serial, 1);
+    if (atomic_load(&q->waiting))
+    {
+        vlc_mutex_lock(&q->lock);
+        vlc_cond_signal(&q->wait);
+        vlc_mutex_unlock(&q->lock);
+    }
+}
+
+static block_t *vlc_spsc_Take(block_spsc_t *q)
+{
+    block_t *block = q->p_first;
+
+    if (block == NULL)
+    {
+        q->seen = atomic_load(&q->serial);
+        block = (block_t *)atomic_exchange_explicit(&q->pushed, 0,
+                                                    memory_order_acquire);
+        /* Restore queuing order */
+        block_t *prev = NULL;
+        while (block != NULL)
+        {
+            block_t *next = block->p_next;
+            block->p_next = prev;
+            prev = block;
+            block = next;
+        }
+        block = prev;
+        if (block == NULL)
+            return NULL;
+    }
+
+    q->p_first = block->p_next;
+    block->p_next = NULL;
+    return block;
+}
+
+block_t *vlc_spsc_Dequeue(block_spsc_t *q)
+{
+    /* Only the consumer writes those */
+    size_t count = atomic_load_explicit(&q->out_count, memory_order_relaxed);
+    size_t bytes = atomic_load_explicit(&q->out_bytes, memory_order_relaxed);
+    block_t *block;
+
+    while ((block = vlc_spsc_Take(q)) != NULL)
+    {
+        size_t discard = atomic_load_explicit(&q->discard_count,
+                                              memory_order_acquire);
+        /* Blocks are numbered in queuing order: discard flushed ones */
+        bool flushed = (ptrdiff_t)(discard - count) > 0;
+
+        atomic_store_explicit(&q->out_count, ++count, memory_order_release);
+        atomic_store_explicit(&q->out_bytes, bytes += block->i_buffer,
+                              memory_order_release);
+        if (!flushed)
+            break;
+        block_Release(block);
+    }
+    return block;
+}
+
+void vlc_spsc_Flush(block_spsc_t *q)
+{
+    atomic_store_explicit(&q->discard_bytes,
+                          atomic_load_explicit(&q->in_bytes,
+                                               memory_order_relaxed),
+                          memory_order_release);
+    atomic_store_explicit(&q->discard_count,
+                          atomic_load_explicit(&q->in_count,
+                                               memory_order_relaxed),
+                          memory_order_release);
+}
+
+void vlc_spsc_Empty(block_spsc_t *q)
+{
+    vlc_assert_locked(&q->lock);
+
+    /* The consumer is locked out, and only the caller queues blocks */
+    block_t *pushed = (block_t *)atomic_exchange_explicit(&q->pushed, 0,
+                                                         memory_order_acquire);
+    block_t *first = q->p_first;
+
+    q->p_first = NULL;
+    atomic_store_explicit(&q->out_bytes,
+                          atomic_load_explicit(&q->in_bytes,
+                                               memory_order_relaxed),
+                          memory_order_release);
+    atomic_store_explicit(&q->out_count,
+                          atomic_load_explicit(&q->in_count,
+                                               memory_order_relaxed),
+                          memory_order_release);
+
+    block_ChainRelease(first);
+    block_ChainRelease(pushed);
+}
+
+block_t *block_SpscGet(block_spsc_t *q)
+{
+    block_t *block;
+
+    vlc_testcancel();
+
+    block = vlc_spsc_Dequeue(q);
+    if (block != NULL)
+        return block;
+
+    vlc_spsc_Lock(q);
+    vlc_spsc_CleanupPush(q);
+    while ((block = vlc_spsc_Dequeue(q)) == NULL)
+        vlc_spsc_Wait(q);
+    vlc_cleanup_pop();
+    vlc_spsc_Unlock(q);
+
+    return block;
+}
+
+void vlc_spsc_Lock(block_spsc_t *q)
+{
+    vlc_mutex_lock(&q->lock);
+}
+
+void vlc_spsc_Unlock(block_spsc_t *q)
+{
+    vlc_mutex_unlock(&q->lock);
+}
+
+void vlc_spsc_Signal(block_spsc_t *q)
+{
+    vlc_cond_signal(&q->wait);
+}
+
+void vlc_spsc_Wait(block_spsc_t *q)
+{
+    vlc_assert_locked(&q->lock);
+
+    atomic_store(&q->waiting, true);
+
+    size_t serial = atomic_load(&q->serial);
+    if (serial == q->seen)
+    {
+        vlc_cond_wait(&q->wait, &q->lock);
+        serial = atomic_load(&q->serial);
+    }
+    /* Only wake up again for later blocks */
+    q->seen = serial;
+    atomic_store(&q->waiting, false);
+}
+
+void vlc_spsc_WaitCond(block_spsc_t *q, vlc_cond_t *condvar)
+{
+    vlc_cond_wait(condvar, &q->lock);
+}
+
+int vlc_spsc_TimedWaitCond(block_spsc_t *q, vlc_cond_t *condvar,
+                           mtime_t deadline)
+{
+    return vlc_cond_timedwait(condvar, &q->lock, deadline);
+}
+
+/* Difference between running totals, excluding flushed blocks */
+static size_t vlc_spsc_Pending(const atomic_size_t *out,
+                               const atomic_size_t *discard,
+                               const atomic_size_t *in)
+{
+    /* Load the dequeued total first: it can only be behind the queued one */
+    size_t o = atomic_load_explicit(out, memory_order_acquire);
+    size_t d = atomic_load_explicit(discard, memory_order_acquire);
+    size_t i = atomic_load_explicit(in, memory_order_acquire);
+    size_t pending = i - o;
+
+    if (d - o <= pending) /* some of the pending ones are flushed */
+        pending = i - d;
+    return pending;
+}
+
+size_t vlc_spsc_GetCount(const block_spsc_t *q)
+{
+    return vlc_spsc_Pending(&q->out_count, &q->discard_count, &q->in_count);
+}
+
+size_t vlc_spsc_GetBytes(const block_spsc_t *q)
+{
+    return vlc_spsc_Pending(&q->out_bytes, &q->discard_bytes, &q->in_bytes);
+}
@@ -38,11 +38,20 @@
 #include <assert.h>
 
 #include <vlc_common.h>
+#include <vlc_atomic.h>
 #include <vlc_interface.h>
 #include <vlc_charset.h>
 #include <vlc_modules.h>
 #include "../libvlc.h"
 
+typedef struct vlc_log_filter_t
+{
+    char *module;
+    int max_type; /**< Most verbose message type to keep */
+} vlc_log_filter_t;
+
+typedef struct vlc_log_async_t vlc_log_async_t;
+
 struct vlc_logger_t
 {
     VLC_COMMON_MEMBERS
@@ -50,6 +59,12 @@ struct vlc_logger_t
     vlc_log_cb log;
     void *sys;
     module_t *module;
+
+    /* Set by vlc_LogInit(), before other threads can emit messages */
+    vlc_log_filter_t *filters;
+    size_t filters_count;
+    vlc_log_async_t *async;
+    atomic_int max_type; /**< Most verbose message type the callback keeps */
 };
 
 static void vlc_vaLogCallback(libvlc_int_t *vlc, int type,
@@ -77,6 +92,368 @@ static void vlc_LogCallback(libvlc_int_t *vlc, int type, const vlc_log_t *item,
     va_end(ap);
 }
 
+/**
+ * Checks the per-module verbosity, before the message is formatted.
+ */
+static bool vlc_LogFilter(const vlc_logger_t *logger, int type,
+                          const char *module)
+{
+    for (size_t i = 0; i < logger->filters_count; i++)
+        if (!strcmp(logger->filters[i].module, module))
+            return type <= logger->filters[i].max_type;
+    return true;
+}
+
+static void vlc_LogFiltersInit(vlc_logger_t *logger)
+{
+    char *list = var_InheritString(logger, "verbose-modules");
+    if (list == NULL)
+        return;
+
+    char *saveptr;
+    for (char *item = strtok_r(list, ",", &saveptr); item != NULL;
+         item = strtok_r(NULL, ",", &saveptr))
+    {
+        char *level = strchr(item, '=');
+        if (level == NULL)
+            continue;
+        *(level++) = '\0';
+
+        vlc_log_filter_t *tab = realloc(logger->filters,
+                        (logger->filters_count + 1) * sizeof (*tab));
+        if (unlikely(tab == NULL))
+            break;
+        logger->filters = tab;
+
+        tab += logger->filters_count;
+        tab->module = strdup(item);
+        tab->max_type = atoi(level) + VLC_MSG_ERR;
+        if (likely(tab->module != NULL))
+            logger->filters_count++;
+    }
+    free(list);
+}
+
+/**
+ * Returns the most verbose message type that the logger modules may keep.
+ *
+ * Logger modules apply their verbosity in their callback. This mirrors their
+ * settings, so that asynchronous logging does not format and queue messages
+ * only for them to be dropped.
+ */
+static int vlc_LogModuleMaxType(vlc_logger_t *logger)
+{
+    /* syslog and journal filter messages on their own */
+    if (var_InheritBool(logger, "syslog"))
+        return VLC_MSG_DBG;
+
+    int verbosity = var_InheritInteger(logger, "verbose");
+    const char *str = getenv("VLC_VERBOSE");
+    if (str != NULL)
+        verbosity = __MAX(verbosity, atoi(str));
+    if (var_InheritBool(logger, "file-logging"))
+        verbosity = __MAX(verbosity, var_InheritInteger(logger, "log-verbose"));
+
+    return verbosity + VLC_MSG_ERR;
+}
+
+/*** Asynchronous logging ***/
+
+#define VLC_LOG_RING_SIZE 128 /* messages per emitting thread */
+
+/**
+ * A formatted message, waiting for the logger thread.
+ *
+ * Object type, file and function names are static strings. They remain valid
+ * after the emitting object is destroyed: plugins are only unmapped once
+ * vlc_LogDeinit() has flushed all messages.
+ */
+typedef struct
+{
+    unsigned seq; /**< Emission order, across threads */
+    int type;
+    vlc_log_t meta;
+    char module[32];
+    char *header; /**< Copy of the object header, or NULL */
+    char *longmsg; /**< Heap copy of messages that do not fit in msg */
+    char msg[256];
+} vlc_log_record_t;
+
+/**
+ * Single-producer single-consumer ring of messages from one thread.
+ */
+typedef struct vlc_log_ring_t
+{
+    struct vlc_log_ring_t *next;
+    atomic_uint head; /**< Written by the emitting thread */
+    atomic_uint tail; /**< Written by the logger thread */
+    atomic_uint dropped; /**< Messages lost since the last report */
+    atomic_bool dead; /**< The emitting thread exited */
+    vlc_log_record_t records[VLC_LOG_RING_SIZE];
+} vlc_log_ring_t;
+
+struct vlc_log_async_t
+{
+    vlc_thread_t thread;
+    vlc_threadvar_t ring; /**< Ring of the calling thread */
+    vlc_mutex_t lock; /**< Protects the list of rings */
+    vlc_log_ring_t *rings;
+    atomic_uint seq;
+    atomic_uint lost; /**< Messages lost without a ring */
+    atomic_uint wakeup; /**< Bumped whenever a message is queued */
+    atomic_bool sleeping;
+    atomic_bool quit;
+};
+
+static void vlc_LogRingRelease(void *data)
+{
+    vlc_log_ring_t *ring = data;
+
+    /* The logger thread frees the ring once it is drained */
+    atomic_store(&ring->dead, true);
+}
+
+static vlc_log_ring_t *vlc_LogRingGet(vlc_log_async_t *async)
+{
+    vlc_log_ring_t *ring = vlc_threadvar_get(async->ring);
+    if (likely(ring != NULL))
+        return ring;
+
+    ring = malloc(sizeof (*ring));
+    if (unlikely(ring == NULL))
+        return NULL;
+
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+    atomic_init(&ring->dead, false);
+
+    if (vlc_threadvar_set(async->ring, ring))
+    {
+        free(ring);
+        return NULL;
+    }
+
+    vlc_mutex_lock(&async->lock);
+    ring->next = async->rings;
+    async->rings = ring;
+    vlc_mutex_unlock(&async->lock);
+    return ring;
+}
+
+/**
+ * Formats a message into the ring of the calling thread.
+ */
+static void vlc_LogPush(vlc_log_async_t *async, int type,
+                        const vlc_log_t *item, const char *format, va_list ap)
+{
+    vlc_log_ring_t *ring = vlc_LogRingGet(async);
+    if (unlikely(ring == NULL))
+    {
+        atomic_fetch_add(&async->lost, 1);
+        return;
+    }
+
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail >= VLC_LOG_RING_SIZE)
+    {   /* Never block the emitting thread */
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    vlc_log_record_t *rec = &ring->records[head % VLC_LOG_RING_SIZE];
+    va_list aq;
+
+    rec->type = type;
+    rec->meta = *item;
+    strlcpy(rec->module, item->psz_module, sizeof (rec->module));
+    rec->header = (item->psz_header != NULL) ? strdup(item->psz_header)
+                                             : NULL;
+    rec->longmsg = NULL;
+
+    va_copy(aq, ap);
+    int len = vsnprintf(rec->msg, sizeof (rec->msg), format, aq);
+    va_end(aq);
+    if (len >= (int)sizeof (rec->msg)
+     && vasprintf(&rec->longmsg, format, ap) == -1)
+        rec->longmsg = NULL;
+
+    rec->seq = atomic_fetch_add_explicit(&async->seq, 1,
+                                         memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    atomic_fetch_add(&async->wakeup, 1);
+    if (atomic_load(&async->sleeping))
+        vlc_addr_signal(&async->wakeup);
+}
+
+/**
+ * Passes the oldest queued message to the logger.
+ *
+ * \return false if there were no queued messages
+ */
+static bool vlc_LogPopOne(vlc_logger_t *logger)
+{
+    vlc_log_async_t *async = logger->async;
+    vlc_log_ring_t *oldest = NULL;
+    unsigned oldest_seq = 0;
+
+    /* Pick the oldest message across all threads */
+    vlc_mutex_lock(&async->lock);
+    for (vlc_log_ring_t *ring = async->rings; ring != NULL; ring = ring->next)
+    {
+        unsigned tail = atomic_load_explicit(&ring->tail,
+                                             memory_order_relaxed);
+        if (atomic_load_explicit(&ring->head, memory_order_acquire) == tail)
+            continue;
+
+        unsigned seq = ring->records[tail % VLC_LOG_RING_SIZE].seq;
+        if (oldest == NULL || (int)(seq - oldest_seq) < 0)
+        {
+            oldest = ring;
+            oldest_seq = seq;
+        }
+    }
+    vlc_mutex_unlock(&async->lock);
+
+    if (oldest == NULL)
+        return false;
+
+    unsigned tail = atomic_load_explicit(&oldest->tail, memory_order_relaxed);
+    vlc_log_record_t *rec = &oldest->records[tail % VLC_LOG_RING_SIZE];
+
+    rec->meta.psz_module = rec->module;
+    rec->meta.psz_header = rec->header;
+    vlc_LogCallback(logger->obj.libvlc, rec->type, &rec->meta, "%s",
+                    (rec->longmsg != NULL) ? rec->longmsg : rec->msg);
+    free(rec->longmsg);
+    free(rec->header);
+
+    atomic_store_explicit(&oldest->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+/**
+ * Reports lost messages, and frees the rings of exited threads.
+ */
+static void vlc_LogHousekeep(vlc_logger_t *logger)
+{
+    vlc_log_async_t *async = logger->async;
+    unsigned dropped = atomic_exchange(&async->lost, 0);
+
+    vlc_mutex_lock(&async->lock);
+    for (vlc_log_ring_t **pp = &async->rings, *ring; (ring = *pp) != NULL;)
+    {
+        dropped += atomic_exchange_explicit(&ring->dropped, 0,
+                                            memory_order_relaxed);
+
+        if (atomic_load(&ring->dead)
+         && atomic_load(&ring->head) == atomic_load(&ring->tail))
+        {
+            *pp = ring->next;
+            free(ring);
+        }
+        else
+            pp = &ring->next;
+    }
+    vlc_mutex_unlock(&async->lock);
+
+    if (dropped > 0)
+    {
+        vlc_log_t meta = {
+            .i_object_id = (uintptr_t)logger,
+            .psz_object_type = "logger",
+            .psz_module = "core",
+            .line = -1,
+            .tid = vlc_thread_id(),
+        };
+        vlc_LogCallback(logger->obj.libvlc, VLC_MSG_WARN, &meta,
+                        "%u log message(s) dropped", dropped);
+    }
+}
+
+static void *vlc_LogThread(void *data)
+{
+    vlc_logger_t *logger = data;
+    vlc_log_async_t *async = logger->async;
+
+    for (;;)
+    {
+        unsigned wakeup = atomic_load(&async->wakeup);
+
+        while (vlc_LogPopOne(logger));
+        vlc_LogHousekeep(logger);
+
+        if (atomic_load(&async->quit))
+            break;
+
+        atomic_store(&async->sleeping, true);
+        if (atomic_load(&async->wakeup) == wakeup)
+            vlc_addr_wait(&async->wakeup, wakeup);
+        atomic_store(&async->sleeping, false);
+    }
+
+    /* Flush messages queued after the last pass */
+    while (vlc_LogPopOne(logger));
+    return NULL;
+}
+
+static int vlc_LogAsyncStart(vlc_logger_t *logger)
+{
+    vlc_log_async_t *async = malloc(sizeof (*async));
+    if (unlikely(async == NULL))
+        return -1;
+
+    if (vlc_threadvar_create(&async->ring, vlc_LogRingRelease))
+    {
+        free(async);
+        return -1;
+    }
+
+    vlc_mutex_init(&async->lock);
+    async->rings = NULL;
+    atomic_init(&async->seq, 0);
+    atomic_init(&async->lost, 0);
+    atomic_init(&async->wakeup, 0);
+    atomic_init(&async->sleeping, false);
+    atomic_init(&async->quit, false);
+    logger->async = async;
+
+    if (vlc_clone(&async->thread, vlc_LogThread, logger,
+                  VLC_THREAD_PRIORITY_LOW))
+    {
+        logger->async = NULL;
+        vlc_mutex_destroy(&async->lock);
+        vlc_threadvar_delete(&async->ring);
+        free(async);
+        return -1;
+    }
+    return 0;
+}
+
+static void vlc_LogAsyncStop(vlc_logger_t *logger)
+{
+    vlc_log_async_t *async = logger->async;
+
+    atomic_store(&async->quit, true);
+    atomic_fetch_add(&async->wakeup, 1);
+    vlc_addr_broadcast(&async->wakeup);
+    vlc_join(async->thread, NULL);
+    logger->async = NULL;
+
+    /* Threads that still hold a ring will not log to this instance anymore */
+    vlc_threadvar_delete(&async->ring);
+    for (vlc_log_ring_t *ring = async->rings, *next; ring != NULL; ring = next)
+    {
+        assert(atomic_load(&ring->head) == atomic_load(&ring->tail));
+        next = ring->next;
+        free(ring);
+    }
+    vlc_mutex_destroy(&async->lock);
+    free(async);
+}
+
 #ifdef _WIN32
 static void Win32DebugOutputMsg (void *, int , const vlc_log_t *,
                                  const char *, va_list);
@@ -93,6 +470,9 @@ void vlc_vaLog (vlc_object_t *obj, int type, const char *module,
     if (obj != NULL && obj->obj.flags & OBJECT_FLAGS_QUIET)
         return;
 
+    vlc_logger_t *logger = (obj != NULL)
+                         ? libvlc_priv(obj->obj.libvlc)->logger : NULL;
+
     /* Get basename from the module filename */
     char *p = strrchr(module, '/');
     if (p != NULL)
@@ -108,6 +488,9 @@ void vlc_vaLog (vlc_object_t *obj, int type, const char *module,
         module = modulebuf;
     }
 
+    if (logger != NULL && !vlc_LogFilter(logger, type, module))
+        return;
+
     /* Fill message information fields */
     vlc_log_t msg;
 
@@ -136,7 +519,15 @@ void vlc_vaLog (vlc_object_t *obj, int type, const char *module,
 #endif
 
     /* Pass message to the callback */
-    if (obj != NULL)
+    if (logger == NULL)
+        return;
+    if (logger->async != NULL)
+    {
+        if (type <= atomic_load_explicit(&logger->max_type,
+                                         memory_order_relaxed))
+            vlc_LogPush(logger->async, type, &msg, format, args);
+    }
+    else
         vlc_vaLogCallback(obj->obj.libvlc, type, &msg, format, args);
 }
 
@@ -330,6 +721,7 @@ int vlc_LogPreinit(libvlc_int_t *vlc)
         return -1;
 
     vlc_rwlock_init(&logger->lock);
+    atomic_init(&logger->max_type, VLC_MSG_DBG);
 
     if (vlc_LogEarlyOpen(logger))
     {
@@ -379,6 +771,12 @@ int vlc_LogInit(libvlc_int_t *vlc)
     if (early_sys != NULL)
         vlc_LogEarlyClose(logger, early_sys);
 
+    vlc_LogFiltersInit(logger);
+    atomic_store_explicit(&logger->max_type, (module != NULL)
+                          ? vlc_LogModuleMaxType(logger) : -1,
+                          memory_order_relaxed);
+    if (var_InheritBool(logger, "log-async") && vlc_LogAsyncStart(logger))
+        msg_Err(vlc, "cannot start asynchronous logging");
     return 0;
 }
 
@@ -397,6 +795,9 @@ void vlc_LogSet(libvlc_int_t *vlc, vlc_log_cb cb, void *opaque)
     module_t *module;
     void *sys;
 
+    /* The callback gets every message */
+    atomic_store_explicit(&logger->max_type, (cb != NULL) ? VLC_MSG_DBG : -1,
+                          memory_order_relaxed);
     if (cb == NULL)
         cb = vlc_vaLogDiscard;
 
@@ -426,6 +827,9 @@ void vlc_LogDeinit(libvlc_int_t *vlc)
     if (unlikely(logger == NULL))
         return;
 
+    if (logger->async != NULL)
+        vlc_LogAsyncStop(logger);
+
     if (logger->module != NULL)
         vlc_module_unload(logger->module, vlc_logger_unload, logger->sys);
     else
@@ -436,6 +840,10 @@ void vlc_LogDeinit(libvlc_int_t *vlc)
         vlc_LogEarlyClose(logger, logger->sys);
     }
 
+    for (size_t i = 0; i < logger->filters_count; i++)
+        free(logger->filters[i].module);
+    free(logger->filters);
+
     vlc_rwlock_destroy(&logger->lock);
     vlc_object_release(logger);
     libvlc_priv(vlc)->logger = NULL;
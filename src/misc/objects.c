@@ -191,9 +191,16 @@ void *vlc_custom_create (vlc_object_t *parent, size_t length,
     if (unlikely(priv == NULL))
         return NULL;
     priv->psz_name = NULL;
-    priv->var_root = NULL;
+    atomic_init (&priv->var_table, 0);
     vlc_mutex_init (&priv->var_lock);
     vlc_cond_init (&priv->var_wait);
+    atomic_init (&priv->var_epoch, 0);
+    for (unsigned i = 0; i < 2; i++)
+    {
+        atomic_init (&priv->var_readers[i], 0);
+        priv->var_retired[i] = NULL;
+        priv->var_retired_tables[i] = NULL;
+    }
     atomic_init (&priv->refs, 1);
     priv->pf_destructor = NULL;
     priv->prev = NULL;
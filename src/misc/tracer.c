@@ -0,0 +1,231 @@
+/*****************************************************************************
+ * tracer.c: latency tracing
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vlc_common.h>
+#include <vlc_fs.h>
+#include <vlc_tracer.h>
+#include "libvlc.h"
+
+/* Bound memory usage if tracing is left enabled for a long time */
+#define TRACE_MAX_EVENTS 262144
+
+struct vlc_trace_event
+{
+    char *name;
+    char *detail;
+    mtime_t start;
+    mtime_t duration; /* negative for instantaneous events */
+    unsigned long thread;
+};
+
+struct vlc_tracer
+{
+    vlc_mutex_t lock;
+    char *path;
+    mtime_t origin;
+    struct vlc_trace_event *events;
+    size_t count;
+    size_t size;
+    size_t dropped;
+};
+
+static struct vlc_tracer *vlc_tracer_Get(vlc_object_t *obj)
+{
+    return libvlc_priv(obj->obj.libvlc)->tracer;
+}
+
+static void vlc_tracer_Add(struct vlc_tracer *tracer, const char *name,
+                           const char *detail, mtime_t start, mtime_t duration)
+{
+    struct vlc_trace_event ev = {
+        .name = strdup(name),
+        .detail = (detail != NULL) ? strdup(detail) : NULL,
+        .start = start,
+        .duration = duration,
+        .thread = vlc_thread_id(),
+    };
+
+    if (unlikely(ev.name == NULL))
+        goto drop;
+
+    vlc_mutex_lock(&tracer->lock);
+    if (tracer->count >= tracer->size)
+    {
+        size_t size = tracer->size ? (tracer->size * 2) : 256;
+        struct vlc_trace_event *tab = NULL;
+
+        if (size <= TRACE_MAX_EVENTS)
+            tab = realloc(tracer->events, size * sizeof (*tab));
+        if (tab == NULL)
+        {
+            tracer->dropped++;
+            vlc_mutex_unlock(&tracer->lock);
+            goto drop;
+        }
+        tracer->events = tab;
+        tracer->size = size;
+    }
+    tracer->events[tracer->count++] = ev;
+    vlc_mutex_unlock(&tracer->lock);
+    return;
+
+drop:
+    free(ev.detail);
+    free(ev.name);
+}
+
+#undef vlc_trace_Begin
+void vlc_trace_Begin(vlc_object_t *obj, vlc_trace_span_t *span,
+                     const char *name)
+{
+    span->tracer = vlc_tracer_Get(obj);
+    span->name = name;
+    if (span->tracer != NULL)
+        span->start = mdate();
+}
+
+void vlc_trace_End(vlc_trace_span_t *span, const char *detail)
+{
+    struct vlc_tracer *tracer = span->tracer;
+
+    if (tracer == NULL)
+        return;
+
+    mtime_t now = mdate();
+
+    vlc_tracer_Add(tracer, span->name, detail, span->start, now - span->start);
+}
+
+#undef vlc_trace_Mark
+void vlc_trace_Mark(vlc_object_t *obj, const char *name, const char *detail)
+{
+    struct vlc_tracer *tracer = vlc_tracer_Get(obj);
+
+    if (tracer != NULL)
+        vlc_tracer_Add(tracer, name, detail, mdate(), -1);
+}
+
+static void WriteString(FILE *stream, const char *str)
+{
+    fputc('"', stream);
+    for (const unsigned char *p = (const unsigned char *)str; *p; p++)
+    {
+        if (*p == '"' || *p == '\\')
+            fprintf(stream, "\\%c", *p);
+        else if (*p < 0x20)
+            fprintf(stream, "\\u%04x", *p);
+        else
+            fputc(*p, stream);
+    }
+    fputc('"', stream);
+}
+
+/**
+ * Writes the events in the Chrome trace event format, as read by
+ * chrome://tracing and most trace viewers.
+ */
+static int WriteTrace(const struct vlc_tracer *tracer, FILE *stream)
+{
+    unsigned pid = getpid();
+
+    fputs("{\"traceEvents\":[\n", stream);
+    for (size_t i = 0; i < tracer->count; i++)
+    {
+        const struct vlc_trace_event *ev = &tracer->events[i];
+
+        fputs("{\"name\":", stream);
+        WriteString(stream, ev->name);
+        fprintf(stream, ",\"cat\":\"vlc\",\"pid\":%u,\"tid\":%lu,"
+                "\"ts\":%"PRId64, pid, ev->thread, ev->start - tracer->origin);
+        if (ev->duration >= 0)
+            fprintf(stream, ",\"ph\":\"X\",\"dur\":%"PRId64, ev->duration);
+        else
+            fputs(",\"ph\":\"i\",\"s\":\"p\"", stream);
+        if (ev->detail != NULL)
+        {
+            fputs(",\"args\":{\"detail\":", stream);
+            WriteString(stream, ev->detail);
+            fputc('}', stream);
+        }
+        fputs((i + 1 < tracer->count) ? "},\n" : "}\n", stream);
+    }
+    fprintf(stream, "],\"displayTimeUnit\":\"ms\","
+            "\"otherData\":{\"dropped\":\"%zu\"}}\n", tracer->dropped);
+    return ferror(stream) ? -1 : 0;
+}
+
+struct vlc_tracer *vlc_tracer_Create(vlc_object_t *obj)
+{
+    char *path = var_InheritString(obj, "trace-file");
+    if (path == NULL)
+        return NULL;
+
+    struct vlc_tracer *tracer = malloc(sizeof (*tracer));
+    if (unlikely(tracer == NULL))
+    {
+        free(path);
+        return NULL;
+    }
+
+    vlc_mutex_init(&tracer->lock);
+    tracer->path = path;
+    tracer->origin = mdate();
+    tracer->events = NULL;
+    tracer->count = 0;
+    tracer->size = 0;
+    tracer->dropped = 0;
+    msg_Dbg(obj, "tracing to %s", path);
+    return tracer;
+}
+
+void vlc_tracer_Destroy(vlc_object_t *obj, struct vlc_tracer *tracer)
+{
+    FILE *stream = vlc_fopen(tracer->path, "wt");
+
+    if (stream != NULL)
+    {
+        if (WriteTrace(tracer, stream) | fclose(stream))
+            msg_Err(obj, "cannot write %s: %s", tracer->path,
+                    vlc_strerror_c(errno));
+    }
+    else
+        msg_Err(obj, "cannot create %s: %s", tracer->path,
+                vlc_strerror_c(errno));
+
+    for (size_t i = 0; i < tracer->count; i++)
+    {
+        free(tracer->events[i].detail);
+        free(tracer->events[i].name);
+    }
+    free(tracer->events);
+    free(tracer->path);
+    vlc_mutex_destroy(&tracer->lock);
+    free(tracer);
+}
@@ -28,9 +28,6 @@
 # include "config.h"
 #endif
 
-#ifdef HAVE_SEARCH_H
-# include <search.h>
-#endif
 #include <assert.h>
 #include <float.h>
 #include <math.h>
@@ -72,10 +69,13 @@ typedef struct callback_table_t
  */
 struct variable_t
 {
-    char *       psz_name; /**< The variable unique name (must be first) */
+    char *       psz_name; /**< The variable unique name */
+    uint32_t     i_hash;   /**< Hash of the name */
 
     /** The variable's exported value */
     vlc_value_t  val;
+    /** Sequence counter of the value, odd while the value is written */
+    atomic_uint  seq;
 
     /** The variable display name, mainly for use by the interfaces */
     char *       psz_text;
@@ -100,8 +100,31 @@ struct variable_t
     callback_table_t    value_callbacks;
     /** Registered list callbacks */
     callback_table_t    list_callbacks;
+
+    /** Next variable waiting for lockless readers to leave */
+    variable_t  *p_retired;
 };
 
+/**
+ * Open addressing hash table of the variables of an object.
+ *
+ * Lookups and scalar value reads do not take the object variable lock.
+ * Hence, slots are only ever set atomically, removed variables leave a
+ * tombstone, and the table is replaced rather than resized in place.
+ * Unlinked variables and replaced tables are freed once all the lockless
+ * readers that could still see them have left (see Reclaim()).
+ */
+typedef struct variable_table_t
+{
+    size_t       mask; /**< Number of slots minus one */
+    size_t       used; /**< Slots in use, including tombstones */
+    size_t       count; /**< Live variables */
+    struct variable_table_t *p_retired;
+    atomic_uintptr_t slots[];
+} variable_table_t;
+
+#define VAR_REMOVED ((uintptr_t)1)
+
 static int CmpBool( vlc_value_t v, vlc_value_t w )
 {
     return v.b_bool ? w.b_bool ? 0 : 1 : w.b_bool ? -1 : 0;
@@ -140,23 +163,293 @@ int_ops    = { CmpInt,     DupDummy,  FreeDummy,  },
 string_ops = { CmpString,  DupString, FreeString, },
 coords_ops = { NULL,       DupDummy,  FreeDummy,  };
 
-static int varcmp( const void *a, const void *b )
+static uint32_t Hash( const char *psz_name )
+{
+    /* FNV-1a */
+    uint32_t h = 2166136261u;
+
+    while( *psz_name )
+    {
+        h ^= (unsigned char)*(psz_name++);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static variable_t *TableFind( const variable_table_t *tab,
+                              const char *psz_name, uint32_t i_hash )
+{
+    for( size_t i = i_hash & tab->mask;; i = (i + 1) & tab->mask )
+    {
+        uintptr_t slot = atomic_load_explicit( &tab->slots[i],
+                                               memory_order_acquire );
+        if( slot == 0 )
+            return NULL;
+        if( slot == VAR_REMOVED )
+            continue;
+
+        variable_t *p_var = (variable_t *)slot;
+        if( p_var->i_hash == i_hash && !strcmp( p_var->psz_name, psz_name ) )
+            return p_var;
+    }
+}
+
+/**
+ * Stores a variable in the first free slot of its probe sequence.
+ * The variable must not be in the table already.
+ */
+static void TablePut( variable_table_t *tab, variable_t *p_var )
+{
+    for( size_t i = p_var->i_hash & tab->mask;; i = (i + 1) & tab->mask )
+    {
+        uintptr_t slot = atomic_load_explicit( &tab->slots[i],
+                                               memory_order_relaxed );
+        if( slot == 0 || slot == VAR_REMOVED )
+        {
+            if( slot == 0 )
+                tab->used++;
+            tab->count++;
+            atomic_store_explicit( &tab->slots[i], (uintptr_t)p_var,
+                                   memory_order_release );
+            return;
+        }
+    }
+}
+
+static variable_table_t *TableNew( size_t count )
+{
+    size_t size = 16;
+
+    /* Keep the table at most half full, so that probe sequences are short */
+    while( size < 2 * count )
+        size *= 2;
+
+    variable_table_t *tab = malloc( sizeof (*tab)
+                                    + size * sizeof (tab->slots[0]) );
+    if( unlikely(tab == NULL) )
+        return NULL;
+
+    tab->mask = size - 1;
+    tab->used = 0;
+    tab->count = 0;
+    tab->p_retired = NULL;
+    for( size_t i = 0; i < size; i++ )
+        atomic_init( &tab->slots[i], 0 );
+    return tab;
+}
+
+/**
+ * Enters a lockless read-side section. While in the section, the variables
+ * and the table of the object are not freed.
+ * \return the epoch to pass to ReadUnlock()
+ */
+static unsigned ReadLock( vlc_object_internals_t *priv )
+{
+    for( ;; )
+    {
+        unsigned epoch = atomic_load( &priv->var_epoch ) & 1;
+
+        atomic_fetch_add( &priv->var_readers[epoch], 1 );
+        /* If the epoch changed meanwhile, the reclaimer may not have seen
+         * this reader: count it in the current epoch instead. */
+        if( likely((atomic_load( &priv->var_epoch ) & 1) == epoch) )
+            return epoch;
+        atomic_fetch_sub( &priv->var_readers[epoch], 1 );
+    }
+}
+
+static void ReadUnlock( vlc_object_internals_t *priv, unsigned epoch )
 {
-    const variable_t *va = a, *vb = b;
+    atomic_fetch_sub( &priv->var_readers[epoch], 1 );
+}
+
+static void Destroy( variable_t *p_var );
+
+/**
+ * Frees the variables and tables that no lockless reader can see anymore.
+ * Items retired in the previous epoch are freed if no reader remains in
+ * that epoch; then the epoch is advanced. This never waits.
+ * Must be called with the variable lock held.
+ */
+static void Reclaim( vlc_object_internals_t *priv )
+{
+    /* Two rounds, so that items retired in the current epoch can be freed
+     * right away in the common case where there are no readers. */
+    for( unsigned round = 0; round < 2; round++ )
+    {
+        unsigned prev = (atomic_load( &priv->var_epoch ) & 1) ^ 1;
+
+        if( atomic_load( &priv->var_readers[prev] ) != 0 )
+            break;
+
+        variable_t *p_var = priv->var_retired[prev];
+        while( p_var != NULL )
+        {
+            variable_t *p_next = p_var->p_retired;
+            Destroy( p_var );
+            p_var = p_next;
+        }
+        priv->var_retired[prev] = NULL;
+
+        variable_table_t *tab = priv->var_retired_tables[prev];
+        while( tab != NULL )
+        {
+            variable_table_t *p_next = tab->p_retired;
+            free( tab );
+            tab = p_next;
+        }
+        priv->var_retired_tables[prev] = NULL;
+
+        atomic_fetch_add( &priv->var_epoch, 1 );
+    }
+}
+
+/**
+ * Adds a variable to the table of an object, growing the table if needed.
+ * Must be called with the variable lock held.
+ */
+static int Insert( vlc_object_internals_t *priv, variable_t *p_var )
+{
+    variable_table_t *tab = (variable_table_t *)
+        atomic_load_explicit( &priv->var_table, memory_order_relaxed );
+
+    if( tab == NULL || 4 * (tab->used + 1) > 3 * (tab->mask + 1) )
+    {
+        /* The table cannot be rehashed in place under the feet of the
+         * lockless readers: build a new one. */
+        variable_table_t *newtab = TableNew( (tab ? tab->count : 0) + 1 );
+        if( unlikely(newtab == NULL) )
+            return VLC_ENOMEM;
 
-    /* psz_name must be first */
-    assert( va == (const void *)&va->psz_name );
-    return strcmp( va->psz_name, vb->psz_name );
+        if( tab != NULL )
+        {
+            for( size_t i = 0; i <= tab->mask; i++ )
+            {
+                uintptr_t slot = atomic_load_explicit( &tab->slots[i],
+                                                       memory_order_relaxed );
+                if( slot != 0 && slot != VAR_REMOVED )
+                    TablePut( newtab, (variable_t *)slot );
+            }
+
+            unsigned epoch = atomic_load( &priv->var_epoch ) & 1;
+            tab->p_retired = priv->var_retired_tables[epoch];
+            priv->var_retired_tables[epoch] = tab;
+        }
+        TablePut( newtab, p_var );
+        atomic_store_explicit( &priv->var_table, (uintptr_t)newtab,
+                               memory_order_release );
+        Reclaim( priv );
+    }
+    else
+        TablePut( tab, p_var );
+    return VLC_SUCCESS;
+}
+
+/**
+ * Removes a variable from the table of an object. The variable is freed
+ * once no lockless reader can see it anymore.
+ * Must be called with the variable lock held.
+ */
+static void Remove( vlc_object_internals_t *priv, variable_t *p_var )
+{
+    variable_table_t *tab = (variable_table_t *)
+        atomic_load_explicit( &priv->var_table, memory_order_relaxed );
+
+    for( size_t i = p_var->i_hash & tab->mask;; i = (i + 1) & tab->mask )
+    {
+        if( atomic_load_explicit( &tab->slots[i], memory_order_relaxed )
+                                                       == (uintptr_t)p_var )
+        {
+            atomic_store_explicit( &tab->slots[i], VAR_REMOVED,
+                                   memory_order_release );
+            tab->count--;
+            break;
+        }
+    }
+
+    unsigned epoch = atomic_load( &priv->var_epoch ) & 1;
+    p_var->p_retired = priv->var_retired[epoch];
+    priv->var_retired[epoch] = p_var;
+    Reclaim( priv );
 }
 
 static variable_t *Lookup( vlc_object_t *obj, const char *psz_name )
 {
     vlc_object_internals_t *priv = vlc_internals( obj );
-    variable_t **pp_var;
+    variable_table_t *tab;
 
     vlc_mutex_lock(&priv->var_lock);
-    pp_var = tfind( &psz_name, &priv->var_root, varcmp );
-    return (pp_var != NULL) ? *pp_var : NULL;
+    tab = (variable_table_t *)atomic_load_explicit( &priv->var_table,
+                                                    memory_order_relaxed );
+    return (tab != NULL) ? TableFind( tab, psz_name, Hash( psz_name ) )
+                         : NULL;
+}
+
+/**
+ * Sets the value of a variable.
+ * Must be called with the variable lock held.
+ */
+static void StoreValue( variable_t *p_var, vlc_value_t val )
+{
+    unsigned seq = atomic_load_explicit( &p_var->seq, memory_order_relaxed );
+
+    atomic_store_explicit( &p_var->seq, seq + 1, memory_order_relaxed );
+    atomic_thread_fence( memory_order_release );
+    p_var->val = val;
+    atomic_store_explicit( &p_var->seq, seq + 2, memory_order_release );
+}
+
+/**
+ * Gets the value of a variable without taking the variable lock.
+ *
+ * Only values that need not be duplicated can be read this way. The value
+ * is copied optimistically, and the copy is discarded if the value was
+ * written meanwhile (sequence lock).
+ *
+ * \return VLC_SUCCESS, VLC_ENOVAR, or VLC_EGENERIC if the value must be read
+ * with the lock held.
+ */
+static int GetLockless( vlc_object_t *obj, const char *psz_name,
+                        int expected_type, vlc_value_t *p_val )
+{
+    vlc_object_internals_t *priv = vlc_internals( obj );
+    uint32_t i_hash = Hash( psz_name );
+    int ret = VLC_ENOVAR;
+    unsigned epoch = ReadLock( priv );
+
+    variable_table_t *tab = (variable_table_t *)
+        atomic_load_explicit( &priv->var_table, memory_order_acquire );
+    variable_t *p_var = (tab != NULL) ? TableFind( tab, psz_name, i_hash )
+                                      : NULL;
+    if( p_var != NULL )
+    {
+        assert( expected_type == 0 ||
+                (p_var->i_type & VLC_VAR_CLASS) == expected_type );
+        assert ((p_var->i_type & VLC_VAR_CLASS) != VLC_VAR_VOID);
+        (void) expected_type;
+
+        ret = VLC_EGENERIC;
+        if( p_var->ops->pf_dup == DupDummy )
+        {
+            unsigned seq = atomic_load_explicit( &p_var->seq,
+                                                 memory_order_acquire );
+            if( !(seq & 1) )
+            {
+                vlc_value_t val = p_var->val;
+
+                atomic_thread_fence( memory_order_acquire );
+                if( atomic_load_explicit( &p_var->seq,
+                                          memory_order_relaxed ) == seq )
+                {
+                    *p_val = val;
+                    ret = VLC_SUCCESS;
+                }
+            }
+        }
+    }
+
+    ReadUnlock( priv, epoch );
+    return ret;
 }
 
 static void Destroy( variable_t *p_var )
@@ -285,9 +578,9 @@ static void TriggerListCallback(vlc_object_t *obj, variable_t *var,
 /**
  * Initialize a vlc variable
  *
- * We hash the given string and insert it into the sorted list. The insertion
- * may require slow memory copies, but think about what we gain in the log(n)
- * lookup phase when setting/getting the variable value!
+ * We hash the given string and insert it into the hash table of the object.
+ * The table is rebuilt when it fills up, but lookups remain constant-time
+ * when setting/getting the variable value.
  *
  * \param p_this The object in which to create the variable
  * \param psz_name The name of the variable
@@ -303,7 +596,9 @@ int var_Create( vlc_object_t *p_this, const char *psz_name, int i_type )
         return VLC_ENOMEM;
 
     p_var->psz_name = strdup( psz_name );
+    p_var->i_hash = Hash( psz_name );
     p_var->psz_text = NULL;
+    atomic_init( &p_var->seq, 0 );
 
     p_var->i_type = i_type & ~VLC_VAR_DOINHERIT;
 
@@ -361,16 +656,16 @@ int var_Create( vlc_object_t *p_this, const char *psz_name, int i_type )
         var_Inherit(p_this, psz_name, i_type, &p_var->val);
 
     vlc_object_internals_t *p_priv = vlc_internals( p_this );
-    variable_t **pp_var, *p_oldvar;
+    variable_t *p_oldvar;
     int ret = VLC_SUCCESS;
 
-    vlc_mutex_lock( &p_priv->var_lock );
-
-    pp_var = tsearch( p_var, &p_priv->var_root, varcmp );
-    if( unlikely(pp_var == NULL) )
-        ret = VLC_ENOMEM;
-    else if( (p_oldvar = *pp_var) == p_var ) /* Variable create */
-        p_var = NULL; /* Variable created */
+    p_oldvar = Lookup( p_this, psz_name );
+    if( p_oldvar == NULL ) /* Variable create */
+    {
+        ret = Insert( p_priv, p_var );
+        if( likely(ret == VLC_SUCCESS) )
+            p_var = NULL; /* Variable created */
+    }
     else /* Variable already exists */
     {
         assert (((i_type ^ p_oldvar->i_type) & VLC_VAR_CLASS) == 0);
@@ -388,8 +683,8 @@ int var_Create( vlc_object_t *p_this, const char *psz_name, int i_type )
 /**
  * Destroy a vlc variable
  *
- * Look for the variable and destroy it if it is found. As in var_Create we
- * do a call to memmove() but we have performance counterparts elsewhere.
+ * Look for the variable and destroy it if it is found. The memory is
+ * released once no lockless reader can see the variable anymore.
  *
  * \param p_this The object that holds the variable
  * \param psz_name The name of the variable
@@ -409,30 +704,40 @@ void (var_Destroy)(vlc_object_t *p_this, const char *psz_name)
     else if( --p_var->i_usage == 0 )
     {
         assert(!p_var->b_incallback);
-        tdelete( p_var, &p_priv->var_root, varcmp );
+        Remove( p_priv, p_var );
     }
     else
-    {
         assert(p_var->i_usage != -1u);
-        p_var = NULL;
-    }
     vlc_mutex_unlock( &p_priv->var_lock );
-
-    if( p_var != NULL )
-        Destroy( p_var );
-}
-
-static void CleanupVar( void *var )
-{
-    Destroy( var );
 }
 
 void var_DestroyAll( vlc_object_t *obj )
 {
     vlc_object_internals_t *priv = vlc_internals( obj );
+    variable_table_t *tab = (variable_table_t *)
+        atomic_load_explicit( &priv->var_table, memory_order_relaxed );
 
-    tdestroy( priv->var_root, CleanupVar );
-    priv->var_root = NULL;
+    /* The object is being destroyed: there cannot be readers anymore */
+    for( unsigned i = 0; i < 2; i++ )
+        assert( atomic_load( &priv->var_readers[i] ) == 0 );
+
+    vlc_mutex_lock( &priv->var_lock );
+    Reclaim( priv );
+    assert( priv->var_retired[0] == NULL && priv->var_retired[1] == NULL );
+    vlc_mutex_unlock( &priv->var_lock );
+
+    if( tab != NULL )
+    {
+        for( size_t i = 0; i <= tab->mask; i++ )
+        {
+            uintptr_t slot = atomic_load_explicit( &tab->slots[i],
+                                                   memory_order_relaxed );
+            if( slot != 0 && slot != VAR_REMOVED )
+                Destroy( (variable_t *)slot );
+        }
+        free( tab );
+    }
+    atomic_store_explicit( &priv->var_table, 0, memory_order_relaxed );
 }
 
 #undef var_Change
@@ -480,7 +785,9 @@ int var_Change( vlc_object_t *p_this, const char *psz_name,
         case VLC_VAR_SETSTEP:
             assert(p_var->ops->pf_free == FreeDummy);
             p_var->step = *p_val;
-            CheckValue( p_var, &p_var->val );
+            newval = p_var->val;
+            CheckValue( p_var, &newval );
+            StoreValue( p_var, newval );
             break;
         case VLC_VAR_GETSTEP:
             switch (p_var->i_type & VLC_VAR_TYPE)
@@ -566,7 +873,7 @@ int var_Change( vlc_object_t *p_this, const char *psz_name,
             /* Check boundaries and list */
             CheckValue( p_var, &newval );
             /* Set the variable */
-            p_var->val = newval;
+            StoreValue( p_var, newval );
             /* Free data if needed */
             p_var->ops->pf_free( &oldval );
             break;
@@ -630,7 +937,7 @@ int var_GetAndSet( vlc_object_t *p_this, const char *psz_name, int i_action,
                    vlc_value_t *p_val )
 {
     variable_t *p_var;
-    vlc_value_t oldval;
+    vlc_value_t oldval, newval;
 
     assert( p_this );
     assert( p_val );
@@ -650,26 +957,26 @@ int var_GetAndSet( vlc_object_t *p_this, const char *psz_name, int i_action,
     //p_var->ops->pf_dup( &val );
 
     /* Backup needed stuff */
-    oldval = p_var->val;
+    oldval = newval = p_var->val;
 
     /* depending of the action requiered */
     switch( i_action )
     {
     case VLC_VAR_BOOL_TOGGLE:
         assert( ( p_var->i_type & VLC_VAR_BOOL ) == VLC_VAR_BOOL );
-        p_var->val.b_bool = !p_var->val.b_bool;
+        newval.b_bool = !newval.b_bool;
         break;
     case VLC_VAR_INTEGER_ADD:
         assert( ( p_var->i_type & VLC_VAR_INTEGER ) == VLC_VAR_INTEGER );
-        p_var->val.i_int += p_val->i_int;
+        newval.i_int += p_val->i_int;
         break;
     case VLC_VAR_INTEGER_OR:
         assert( ( p_var->i_type & VLC_VAR_INTEGER ) == VLC_VAR_INTEGER );
-        p_var->val.i_int |= p_val->i_int;
+        newval.i_int |= p_val->i_int;
         break;
     case VLC_VAR_INTEGER_NAND:
         assert( ( p_var->i_type & VLC_VAR_INTEGER ) == VLC_VAR_INTEGER );
-        p_var->val.i_int &= ~p_val->i_int;
+        newval.i_int &= ~p_val->i_int;
         break;
     default:
         vlc_mutex_unlock( &p_priv->var_lock );
@@ -677,8 +984,9 @@ int var_GetAndSet( vlc_object_t *p_this, const char *psz_name, int i_action,
     }
 
     /*  Check boundaries */
-    CheckValue( p_var, &p_var->val );
-    *p_val = p_var->val;
+    CheckValue( p_var, &newval );
+    StoreValue( p_var, newval );
+    *p_val = newval;
 
     /* Deal with callbacks.*/
     TriggerCallback( p_this, p_var, psz_name, oldval );
@@ -750,7 +1058,7 @@ int var_SetChecked( vlc_object_t *p_this, const char *psz_name,
     CheckValue( p_var, &val );
 
     /* Set the variable */
-    p_var->val = val;
+    StoreValue( p_var, val );
 
     /* Deal with callbacks */
     TriggerCallback( p_this, p_var, psz_name, oldval );
@@ -783,8 +1091,13 @@ int var_GetChecked( vlc_object_t *p_this, const char *psz_name,
 
     vlc_object_internals_t *p_priv = vlc_internals( p_this );
     variable_t *p_var;
-    int err = VLC_SUCCESS;
+    int err;
+
+    err = GetLockless( p_this, psz_name, expected_type, p_val );
+    if( err != VLC_EGENERIC )
+        return err;
 
+    err = VLC_SUCCESS;
     p_var = Lookup( p_this, psz_name );
     if( p_var != NULL )
     {
@@ -1310,13 +1623,16 @@ void var_FreeList( vlc_value_t *p_val, vlc_value_t *p_val2 )
     }
 }
 
-static void DumpVariable(const void *data, const VISIT which, const int depth)
+static int DumpCompare(const void *a, const void *b)
 {
-    if (which != postorder && which != leaf)
-        return;
-    (void) depth;
+    const variable_t *va = *(const variable_t **)a;
+    const variable_t *vb = *(const variable_t **)b;
+
+    return strcmp(va->psz_name, vb->psz_name);
+}
 
-    const variable_t *var = *(const variable_t **)data;
+static void DumpVariable(const variable_t *var)
+{
     const char *typename = "unknown";
 
     switch (var->i_type & VLC_VAR_TYPE)
@@ -1371,10 +1687,33 @@ static void DumpVariable(const void *data, const VISIT which, const int depth)
 
 void DumpVariables(vlc_object_t *obj)
 {
-    vlc_mutex_lock(&vlc_internals(obj)->var_lock);
-    if (vlc_internals(obj)->var_root == NULL)
+    vlc_object_internals_t *priv = vlc_internals(obj);
+    variable_table_t *tab;
+    variable_t **vars = NULL;
+    size_t count = 0;
+
+    vlc_mutex_lock(&priv->var_lock);
+    tab = (variable_table_t *)atomic_load_explicit(&priv->var_table,
+                                                   memory_order_relaxed);
+    if (tab != NULL && tab->count > 0)
+        vars = malloc(tab->count * sizeof (*vars));
+    if (vars != NULL)
+    {
+        for (size_t i = 0; i <= tab->mask; i++)
+        {
+            uintptr_t slot = atomic_load_explicit(&tab->slots[i],
+                                                  memory_order_relaxed);
+            if (slot != 0 && slot != VAR_REMOVED)
+                vars[count++] = (variable_t *)slot;
+        }
+        /* List the variables in alphabetical order */
+        qsort(vars, count, sizeof (*vars), DumpCompare);
+    }
+
+    if (count == 0)
         puts(" `-o No variables");
-    else
-        twalk(vlc_internals(obj)->var_root, DumpVariable);
-    vlc_mutex_unlock(&vlc_internals(obj)->var_lock);
+    for (size_t i = 0; i < count; i++)
+        DumpVariable(vars[i]);
+    vlc_mutex_unlock(&priv->var_lock);
+    free(vars);
 }
@@ -35,9 +35,13 @@ struct vlc_object_internals
     char           *psz_name; /* given name */
 
     /* Object variables */
-    void           *var_root;
+    atomic_uintptr_t var_table; /* hash table, also read without the lock */
     vlc_mutex_t     var_lock;
     vlc_cond_t      var_wait;
+    atomic_uint     var_epoch; /* reclamation epoch for lockless readers */
+    atomic_uint     var_readers[2]; /* lockless readers in each epoch */
+    void           *var_retired[2]; /* variables unlinked in each epoch */
+    void           *var_retired_tables[2]; /* tables replaced in each epoch */
 
     /* Objects management */
     atomic_uint     refs;
@@ -51,7 +51,11 @@ static struct
     vlc_mutex_t lock;
     block_t *caches;
     unsigned usage;
-} modules = { VLC_STATIC_MUTEX, NULL, 0 };
+
+    /* All modules sorted by capability, then by decreasing score */
+    module_t **index;
+    size_t index_size;
+} modules = { VLC_STATIC_MUTEX, NULL, 0, NULL, 0 };
 
 vlc_plugin_t *vlc_plugins = NULL;
 
@@ -476,6 +480,64 @@ static void module_Unmap(vlc_plugin_t *plugin)
 }
 #endif /* HAVE_DYNAMIC_PLUGINS */
 
+struct module_rank
+{
+    module_t *module;
+    size_t rank; /**< Position in the bank, to keep the sort stable */
+};
+
+static int module_rankcmp(const void *a, const void *b)
+{
+    const struct module_rank *ra = a, *rb = b;
+    int ret = strcmp(module_get_capability(ra->module),
+                     module_get_capability(rb->module));
+    if (ret != 0)
+        return ret;
+    if (ra->module->i_score != rb->module->i_score)
+        return (ra->module->i_score < rb->module->i_score) ? 1 : -1;
+    return (ra->rank < rb->rank) ? -1 : (ra->rank > rb->rank);
+}
+
+/**
+ * Indexes the modules of the bank by capability.
+ *
+ * The bank is read-only once plugins are loaded, so that lookups by
+ * capability only need to search the index rather than scan and sort all the
+ * modules.
+ */
+static void module_BuildIndex(void)
+{
+    /*vlc_assert_locked (&modules.lock); not for static mutexes :( */
+    size_t count;
+    module_t **list = module_list_get(&count);
+    struct module_rank *ranks = malloc(sizeof (*ranks) * count);
+
+    free(modules.index);
+    modules.index = NULL;
+    modules.index_size = 0;
+
+    if (likely(list != NULL && ranks != NULL))
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            ranks[i].module = list[i];
+            ranks[i].rank = i;
+        }
+
+        qsort(ranks, count, sizeof (*ranks), module_rankcmp);
+
+        for (size_t i = 0; i < count; i++)
+            list[i] = ranks[i].module;
+
+        modules.index = list;
+        modules.index_size = count;
+        list = NULL;
+    }
+
+    free(ranks);
+    module_list_free(list);
+}
+
 /**
  * Init bank
  *
@@ -534,6 +596,9 @@ void module_EndBank (bool b_plugins)
         caches = modules.caches;
         vlc_plugins = NULL;
         modules.caches = NULL;
+        free(modules.index);
+        modules.index = NULL;
+        modules.index_size = 0;
     }
     vlc_mutex_unlock (&modules.lock);
 
@@ -570,6 +635,7 @@ size_t module_LoadPlugins (vlc_object_t *obj)
 #endif
         config_UnsortConfig ();
         config_SortConfig ();
+        module_BuildIndex ();
     }
     vlc_mutex_unlock (&modules.lock);
 
@@ -640,11 +706,38 @@ static int modulecmp (const void *a, const void *b)
  */
 ssize_t module_list_cap (module_t ***restrict list, const char *cap)
 {
-    /* TODO: This is quite inefficient. List should be sorted by capability. */
     ssize_t n = 0;
 
     assert (list != NULL);
 
+    if (modules.index != NULL)
+    {   /* Binary search of the first module with the capability */
+        size_t lo = 0, hi = modules.index_size;
+
+        while (lo < hi)
+        {
+            size_t mid = (lo + hi) / 2;
+
+            if (strcmp(module_get_capability(modules.index[mid]), cap) < 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        while (lo + n < modules.index_size
+            && module_provides(modules.index[lo + n], cap))
+            n++;
+
+        module_t **tab = malloc (sizeof (*tab) * n);
+        *list = tab;
+        if (unlikely(tab == NULL))
+            return -1;
+
+        memcpy(tab, modules.index + lo, sizeof (*tab) * n);
+        return n;
+    }
+
+    /* Plugins are not loaded yet */
     for (vlc_plugin_t *lib = vlc_plugins; lib != NULL; lib = lib->next)
          for (module_t *m = lib->module; m != NULL; m = m->next)
              if (module_provides(m, cap))
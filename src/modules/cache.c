@@ -39,6 +39,7 @@
 
 #include <vlc_common.h>
 #include <vlc_block.h>
+#include <vlc_memstream.h>
 #include "libvlc.h"
 
 #include <vlc_plugin.h>
@@ -57,7 +58,7 @@
 #ifdef HAVE_DYNAMIC_PLUGINS
 /* Sub-version number
  * (only used to avoid breakage in dev version when cache structure changes) */
-#define CACHE_SUBVERSION_NUM 34
+#define CACHE_SUBVERSION_NUM 35
 
 /* Cache filename */
 #define CACHE_NAME "plugins.dat"
@@ -153,6 +154,84 @@ static int vlc_cache_load_align(size_t align, block_t *file)
     return 0;
 }
 
+/**
+ * Descriptions section of the cache file.
+ *
+ * Descriptions are only needed for help and preferences. They are stored at
+ * the end of the file and referenced by offset, so that their pages are not
+ * read at all unless a description is actually used.
+ */
+typedef struct
+{
+    const char *base;
+    size_t size; /**< Size of the section (last byte is a nul) */
+} vlc_cache_text_t;
+
+#define CACHE_TEXT_NONE UINT32_MAX
+
+static int vlc_cache_map_text(const char **restrict p, uint32_t offset,
+                              const vlc_cache_text_t *text)
+{
+    if (offset == CACHE_TEXT_NONE)
+    {
+        *p = NULL;
+        return 0;
+    }
+
+    if (offset >= text->size)
+        return -1;
+
+    *p = text->base + offset;
+    return 0;
+}
+
+static int vlc_cache_load_text(const char **restrict p, block_t *file,
+                               const vlc_cache_text_t *text)
+{
+    uint32_t offset;
+
+    if (vlc_cache_load_immediate(&offset, file, sizeof (offset)))
+        return -1;
+    return vlc_cache_map_text(p, offset, text);
+}
+
+/**
+ * Tables of all the cached plugins.
+ *
+ * The file header counts the entries of each table, so that they are all
+ * allocated at once, rather than one allocation per module, per
+ * configuration item and per list.
+ */
+typedef struct
+{
+    vlc_plugin_t *plugins;
+    module_t *modules;
+    module_config_t *items;
+    const char **strings;
+    uint32_t plugins_left;
+    uint32_t modules_left;
+    uint32_t items_left;
+    uint32_t strings_left;
+} vlc_cache_arena_t;
+
+static int vlc_cache_take(void **restrict p, void **restrict next,
+                          uint32_t *restrict left, size_t size, size_t n)
+{
+    if (n > *left)
+        return -1;
+
+    if (n == 0)
+    {
+        *p = NULL;
+        return 0;
+    }
+
+    *p = *next;
+    *next = (char *)*next + size * n;
+    *left -= n;
+    return 0;
+}
+
 #define LOAD_IMMEDIATE(a) \
     if (vlc_cache_load_immediate(&(a), file, sizeof (a))) \
         goto error
@@ -175,11 +254,26 @@ static int vlc_cache_load_align(size_t align, block_t *file)
 #define LOAD_STRING(a) \
     if (vlc_cache_load_string(&(a), file)) \
         goto error
+#define LOAD_TEXT(a) \
+    if (vlc_cache_load_text(&(a), file, text)) \
+        goto error
 #define LOAD_ALIGNOF(t) \
     if (vlc_cache_load_align(alignof(t), file)) \
         goto error
+#define TAKE(a,table,n) \
+    do \
+    { \
+        void *base; \
+        if (vlc_cache_take(&base, (void **)&arena->table, \
+                           &arena->table##_left, sizeof (*arena->table), \
+                           (n))) \
+            goto error; \
+        (a) = base; \
+    } while (0)
 
-static int vlc_cache_load_config(module_config_t *cfg, block_t *file)
+static int vlc_cache_load_config(module_config_t *cfg, block_t *file,
+                                 vlc_cache_arena_t *arena,
+                                 const vlc_cache_text_t *text)
 {
     LOAD_IMMEDIATE (cfg->i_type);
     LOAD_IMMEDIATE (cfg->i_short);
@@ -190,8 +284,8 @@ static int vlc_cache_load_config(module_config_t *cfg, block_t *file)
     LOAD_FLAG (cfg->b_removed);
     LOAD_STRING (cfg->psz_type);
     LOAD_STRING (cfg->psz_name);
-    LOAD_STRING (cfg->psz_text);
-    LOAD_STRING (cfg->psz_longtext);
+    LOAD_TEXT (cfg->psz_text);
+    LOAD_TEXT (cfg->psz_longtext);
     LOAD_IMMEDIATE (cfg->list_count);
 
     if (IsConfigStringType (cfg->i_type))
@@ -199,19 +293,16 @@ static int vlc_cache_load_config(module_config_t *cfg, block_t *file)
         const char *psz;
         LOAD_STRING(psz);
         cfg->orig.psz = (char *)psz;
-        cfg->value.psz = (psz != NULL) ? strdup (cfg->orig.psz) : NULL;
 
-        if (cfg->list_count)
-            cfg->list.psz = xmalloc (cfg->list_count * sizeof (char *));
-        else
+        if (cfg->list_count == 0)
             LOAD_STRING(cfg->list_cb_name);
+
+        TAKE(cfg->list.psz, strings, cfg->list_count);
         for (unsigned i = 0; i < cfg->list_count; i++)
-        {
             LOAD_STRING (cfg->list.psz[i]);
-            if (cfg->list.psz[i] == NULL /* NULL -> empty string */
-             && (cfg->list.psz[i] = calloc (1, 1)) == NULL)
-                goto error;
-        }
+
+        /* Last, so that the item can be destroyed safely on error */
+        cfg->value.psz = (psz != NULL) ? strdup (cfg->orig.psz) : NULL;
     }
     else
     {
@@ -230,48 +321,38 @@ static int vlc_cache_load_config(module_config_t *cfg, block_t *file)
         LOAD_ARRAY(cfg->list.i, cfg->list_count);
     }
 
-    cfg->list_text = xmalloc (cfg->list_count * sizeof (char *));
+    const uint32_t *offsets;
+
+    if (cfg->list_count)
+        LOAD_ALIGNOF(*offsets);
+    LOAD_ARRAY(offsets, cfg->list_count);
+    TAKE(cfg->list_text, strings, cfg->list_count);
     for (unsigned i = 0; i < cfg->list_count; i++)
-    {
-        LOAD_STRING (cfg->list_text[i]);
-        if (cfg->list_text[i] == NULL /* NULL -> empty string */
-         && (cfg->list_text[i] = calloc (1, 1)) == NULL)
+        if (vlc_cache_map_text(&cfg->list_text[i], offsets[i], text))
             goto error;
-    }
 
     return 0;
 error:
-    return -1; /* FIXME: leaks */
+    return -1;
 }
 
-static int vlc_cache_load_plugin_config(vlc_plugin_t *plugin, block_t *file)
+static int vlc_cache_load_plugin_config(vlc_plugin_t *plugin, block_t *file,
+                                        vlc_cache_arena_t *arena,
+                                        const vlc_cache_text_t *text)
 {
     uint16_t lines;
 
     /* Calculate the structure length */
     LOAD_IMMEDIATE (lines);
+    TAKE (plugin->conf.items, items, lines);
 
-    /* Allocate memory */
-    if (lines)
-    {
-        plugin->conf.items = calloc(sizeof (module_config_t), lines);
-        if (unlikely(plugin->conf.items == NULL))
-        {
-            plugin->conf.size = 0;
-            return -1;
-        }
-    }
-    else
-        plugin->conf.items = NULL;
-
-    plugin->conf.size = lines;
-
-    /* Do the duplication job */
     for (size_t i = 0; i < lines; i++)
     {
         module_config_t *item = plugin->conf.items + i;
 
-        if (vlc_cache_load_config(item, file))
+        plugin->conf.size = i + 1;
+
+        if (vlc_cache_load_config(item, file, arena, text))
             return -1;
 
         if (CONFIG_ITEM(item->i_type))
@@ -285,29 +366,24 @@ static int vlc_cache_load_plugin_config(vlc_plugin_t *plugin, block_t *file)
 
     return 0;
 error:
-    return -1; /* FIXME: leaks */
+    return -1;
 }
 
-static int vlc_cache_load_module(vlc_plugin_t *plugin, block_t *file)
+static int vlc_cache_load_module(module_t *module, block_t *file,
+                                 vlc_cache_arena_t *arena,
+                                 const vlc_cache_text_t *text)
 {
-    module_t *module = vlc_module_create(plugin);
-    if (unlikely(module == NULL))
-        return -1;
-
     LOAD_STRING(module->psz_shortname);
     LOAD_STRING(module->psz_longname);
-    LOAD_STRING(module->psz_help);
+    LOAD_TEXT(module->psz_help);
 
     LOAD_IMMEDIATE(module->i_shortcuts);
     if (module->i_shortcuts > MODULE_SHORTCUT_MAX)
         goto error;
-    else
-    {
-        module->pp_shortcuts =
-            xmalloc (sizeof (*module->pp_shortcuts) * module->i_shortcuts);
-        for (unsigned j = 0; j < module->i_shortcuts; j++)
-            LOAD_STRING(module->pp_shortcuts[j]);
-    }
+
+    TAKE(module->pp_shortcuts, strings, module->i_shortcuts);
+    for (unsigned j = 0; j < module->i_shortcuts; j++)
+        LOAD_STRING(module->pp_shortcuts[j]);
 
     LOAD_STRING(module->activate_name);
     LOAD_STRING(module->deactivate_name);
@@ -318,20 +394,35 @@ error:
     return -1;
 }
 
-static vlc_plugin_t *vlc_cache_load_plugin(block_t *file)
+static vlc_plugin_t *vlc_cache_load_plugin(block_t *file,
+                                           vlc_cache_arena_t *arena,
+                                           const vlc_cache_text_t *text)
 {
-    vlc_plugin_t *plugin = vlc_plugin_create();
-    if (unlikely(plugin == NULL))
-        return NULL;
-
+    vlc_plugin_t *plugin = NULL;
+    module_t *tab;
     uint32_t modules;
+
+    TAKE(plugin, plugins, 1);
+    vlc_plugin_init(plugin);
+    /* Tables and strings belong to the cache */
+    plugin->cached = true;
+
     LOAD_IMMEDIATE(modules);
+    TAKE(tab, modules, modules);
 
     for (size_t i = 0; i < modules; i++)
-        if (vlc_cache_load_module(plugin, file))
+    {
+        module_t *module = tab + i;
+
+        module->plugin = plugin;
+        module->next = (i + 1 < modules) ? (module + 1) : NULL;
+        if (vlc_cache_load_module(module, file, arena, text))
             goto error;
+    }
+    plugin->module = tab;
+    plugin->modules_count = modules;
 
-    if (vlc_cache_load_plugin_config(plugin, file))
+    if (vlc_cache_load_plugin_config(plugin, file, arena, text))
         goto error;
 
     LOAD_STRING(plugin->textdomain);
@@ -341,9 +432,7 @@ static vlc_plugin_t *vlc_cache_load_plugin(block_t *file)
     if (path == NULL)
         goto error;
 
-    plugin->path = strdup(path);
-    if (unlikely(plugin->path == NULL))
-        goto error;
+    plugin->path = (char *)path;
 
     LOAD_FLAG(plugin->unloadable);
     LOAD_IMMEDIATE(plugin->mtime);
@@ -355,7 +444,8 @@ static vlc_plugin_t *vlc_cache_load_plugin(block_t *file)
     return plugin;
 
 error:
-    vlc_plugin_destroy(plugin);
+    if (plugin != NULL)
+        vlc_plugin_destroy(plugin);
     return NULL;
 }
 
@@ -387,6 +477,8 @@ vlc_plugin_t *vlc_cache_load(vlc_object_t *p_this, const char *dir,
     if (file == NULL)
         return 0;
 
+    const uint8_t *start = file->p_buffer;
+
     /* Check the file is a plugins cache */
     char cachestr[sizeof (CACHE_STRING) - 1];
 
@@ -438,11 +530,71 @@ vlc_plugin_t *vlc_cache_load(vlc_object_t *p_this, const char *dir,
         return 0;
     }
 
+    /* Locate the descriptions section */
+    vlc_cache_text_t text;
+    uint32_t offset;
+
+    if (vlc_cache_load_immediate(&offset, file, sizeof (offset))
+     || offset < (size_t)(file->p_buffer - start)
+     || offset >= (size_t)(file->p_buffer - start) + file->i_buffer)
+    {
+        msg_Warn( p_this, "This doesn't look like a valid plugins cache "
+                  "(corrupted header)" );
+        block_Release(file);
+        return 0;
+    }
+
+    text.base = (const char *)start + offset;
+    text.size = (file->p_buffer + file->i_buffer) - (const uint8_t *)text.base;
+    file->i_buffer = (const uint8_t *)text.base - file->p_buffer;
+
+    /* Allocate the tables */
+    vlc_cache_arena_t arena;
+    block_t *tables = NULL;
     vlc_plugin_t *cache = NULL;
 
+    if (vlc_cache_load_immediate(&arena.plugins_left, file,
+                                 sizeof (arena.plugins_left))
+     || vlc_cache_load_immediate(&arena.modules_left, file,
+                                 sizeof (arena.modules_left))
+     || vlc_cache_load_immediate(&arena.items_left, file,
+                                 sizeof (arena.items_left))
+     || vlc_cache_load_immediate(&arena.strings_left, file,
+                                 sizeof (arena.strings_left))
+     || text.base[text.size - 1] != '\0')
+        goto error;
+
+    /* Each entry takes at least one byte of the file */
+    if (arena.plugins_left > file->i_buffer
+     || arena.modules_left > file->i_buffer
+     || arena.items_left > file->i_buffer
+     || arena.strings_left > file->i_buffer)
+        goto error;
+
+    /* Configuration items (with 64-bits values) come first for alignment */
+    size_t items_size = arena.items_left * sizeof (module_config_t);
+    size_t plugins_size = arena.plugins_left * sizeof (vlc_plugin_t);
+    size_t modules_size = arena.modules_left * sizeof (module_t);
+    size_t strings_size = arena.strings_left * sizeof (const char *);
+    size_t size = items_size + plugins_size + modules_size + strings_size;
+    char *base = calloc(1, size ? size : 1);
+
+    if (unlikely(base == NULL))
+        goto error;
+
+    tables = block_heap_Alloc(base, size);
+    if (unlikely(tables == NULL))
+        goto error;
+
+    arena.items = (module_config_t *)base;
+    arena.plugins = (vlc_plugin_t *)(base + items_size);
+    arena.modules = (module_t *)(base + items_size + plugins_size);
+    arena.strings = (const char **)(base + items_size + plugins_size
+                                    + modules_size);
+
     while (file->i_buffer > 0)
     {
-        vlc_plugin_t *plugin = vlc_cache_load_plugin(file);
+        vlc_plugin_t *plugin = vlc_cache_load_plugin(file, &arena, &text);
         if (plugin == NULL)
             goto error;
 
@@ -458,14 +610,24 @@ vlc_plugin_t *vlc_cache_load(vlc_object_t *p_this, const char *dir,
         cache = plugin;
     }
 
+    /* Strings point to the file, and tables to the heap block */
     file->p_next = *backingp;
-    *backingp = file;
+    tables->p_next = file;
+    *backingp = tables;
     return cache;
 
 error:
     msg_Warn( p_this, "plugins cache not loaded (corrupted)" );
 
-    /* TODO: cleanup */
+    while (cache != NULL)
+    {
+        vlc_plugin_t *plugin = cache;
+
+        cache = plugin->next;
+        vlc_plugin_destroy(plugin);
+    }
+    if (tables != NULL)
+        block_Release(tables);
     block_Release(file);
     return NULL;
 }
@@ -496,6 +658,36 @@ error:
     if (CacheSaveString (file, (a))) \
         goto error
 
+/** Descriptions section being written */
+struct cache_text
+{
+    struct vlc_memstream stream;
+    uint32_t length;
+};
+
+/**
+ * Appends a string to the descriptions section.
+ * \return the offset of the string within the section
+ */
+static uint32_t CacheAddText(struct cache_text *text, const char *str)
+{
+    if (str == NULL)
+        return CACHE_TEXT_NONE;
+
+    uint32_t offset = text->length;
+    size_t len = strlen(str) + 1;
+
+    vlc_memstream_write(&text->stream, str, len);
+    text->length += len;
+    return offset;
+}
+
+#define SAVE_TEXT( a ) \
+    do { \
+        uint32_t offset = CacheAddText(text, (a)); \
+        SAVE_IMMEDIATE(offset); \
+    } while (0)
+
 static int CacheSaveAlign(FILE *file, size_t align)
 {
     assert(align > 0);
@@ -512,7 +704,8 @@ static int CacheSaveAlign(FILE *file, size_t align)
     if (CacheSaveAlign(file, alignof (t))) \
         goto error
 
-static int CacheSaveConfig (FILE *file, const module_config_t *cfg)
+static int CacheSaveConfig (FILE *file, const module_config_t *cfg,
+                            struct cache_text *text)
 {
     SAVE_IMMEDIATE (cfg->i_type);
     SAVE_IMMEDIATE (cfg->i_short);
@@ -523,8 +716,8 @@ static int CacheSaveConfig (FILE *file, const module_config_t *cfg)
     SAVE_FLAG (cfg->b_removed);
     SAVE_STRING (cfg->psz_type);
     SAVE_STRING (cfg->psz_name);
-    SAVE_STRING (cfg->psz_text);
-    SAVE_STRING (cfg->psz_longtext);
+    SAVE_TEXT (cfg->psz_text);
+    SAVE_TEXT (cfg->psz_longtext);
     SAVE_IMMEDIATE (cfg->list_count);
 
     if (IsConfigStringType (cfg->i_type))
@@ -534,7 +727,11 @@ static int CacheSaveConfig (FILE *file, const module_config_t *cfg)
             SAVE_STRING(cfg->list_cb_name);
 
         for (unsigned i = 0; i < cfg->list_count; i++)
-            SAVE_STRING (cfg->list.psz[i]);
+        {
+            const char *value = cfg->list.psz[i];
+
+            SAVE_STRING ((value != NULL) ? value : ""); /* NULL -> empty */
+        }
     }
     else
     {
@@ -552,22 +749,30 @@ static int CacheSaveConfig (FILE *file, const module_config_t *cfg)
         for (unsigned i = 0; i < cfg->list_count; i++)
              SAVE_IMMEDIATE (cfg->list.i[i]);
     }
+
+    if (cfg->list_count > 0)
+        SAVE_ALIGNOF(uint32_t);
     for (unsigned i = 0; i < cfg->list_count; i++)
-        SAVE_STRING (cfg->list_text[i]);
+    {
+        const char *name = cfg->list_text[i];
+
+        SAVE_TEXT ((name != NULL) ? name : ""); /* NULL -> empty */
+    }
 
     return 0;
 error:
     return -1;
 }
 
-static int CacheSaveModuleConfig(FILE *file, const vlc_plugin_t *plugin)
+static int CacheSaveModuleConfig(FILE *file, const vlc_plugin_t *plugin,
+                                 struct cache_text *text)
 {
     uint16_t lines = plugin->conf.size;
 
     SAVE_IMMEDIATE (lines);
 
     for (size_t i = 0; i < lines; i++)
-        if (CacheSaveConfig(file, plugin->conf.items + i))
+        if (CacheSaveConfig(file, plugin->conf.items + i, text))
            goto error;
 
     return 0;
@@ -575,11 +780,12 @@ error:
     return -1;
 }
 
-static int CacheSaveModule(FILE *file, const module_t *module)
+static int CacheSaveModule(FILE *file, const module_t *module,
+                           struct cache_text *text)
 {
     SAVE_STRING(module->psz_shortname);
     SAVE_STRING(module->psz_longname);
-    SAVE_STRING(module->psz_help);
+    SAVE_TEXT(module->psz_help);
     SAVE_IMMEDIATE(module->i_shortcuts);
 
     for (size_t j = 0; j < module->i_shortcuts; j++)
@@ -597,6 +803,12 @@ error:
 static int CacheSaveBank(FILE *file, vlc_plugin_t *const *cache, size_t n)
 {
     uint32_t i_file_size = 0;
+    struct cache_text text = { .length = 0 };
+
+    if (vlc_memstream_open(&text.stream))
+        return -1;
+    /* Never empty, so that the section always ends with a nul */
+    CacheAddText(&text, "");
 
     /* Contains version number */
     if (fputs (CACHE_STRING, file) == EOF)
@@ -617,6 +829,42 @@ static int CacheSaveBank(FILE *file, vlc_plugin_t *const *cache, size_t n)
     if (fwrite (&i_file_size, sizeof (i_file_size), 1, file) != 1)
         goto error;
 
+    /* Offset of the descriptions section, written last */
+    long text_pos = ftell(file);
+    uint32_t text_offset = 0;
+    SAVE_IMMEDIATE(text_offset);
+
+    /* Sizes of the tables */
+    uint32_t plugins = n, modules = 0, items = 0, strings = 0;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        const vlc_plugin_t *plugin = cache[i];
+
+        for (module_t *module = plugin->module;
+             module != NULL;
+             module = module->next)
+        {
+            modules++;
+            strings += module->i_shortcuts;
+        }
+
+        items += plugin->conf.size;
+        for (size_t j = 0; j < plugin->conf.size; j++)
+        {
+            const module_config_t *cfg = plugin->conf.items + j;
+
+            strings += cfg->list_count; /* friendly names */
+            if (IsConfigStringType(cfg->i_type))
+                strings += cfg->list_count; /* values */
+        }
+    }
+
+    SAVE_IMMEDIATE(plugins);
+    SAVE_IMMEDIATE(modules);
+    SAVE_IMMEDIATE(items);
+    SAVE_IMMEDIATE(strings);
+
     for (size_t i = 0; i < n; i++)
     {
         const vlc_plugin_t *plugin = cache[i];
@@ -627,11 +875,11 @@ static int CacheSaveBank(FILE *file, vlc_plugin_t *const *cache, size_t n)
         for (module_t *module = plugin->module;
              module != NULL;
              module = module->next)
-            if (CacheSaveModule(file, module))
+            if (CacheSaveModule(file, module, &text))
                 goto error;
 
         /* Config stuff */
-        if (CacheSaveModuleConfig(file, plugin))
+        if (CacheSaveModuleConfig(file, plugin, &text))
             goto error;
 
         /* Save common info */
@@ -642,11 +890,27 @@ static int CacheSaveBank(FILE *file, vlc_plugin_t *const *cache, size_t n)
         SAVE_IMMEDIATE(plugin->size);
     }
 
-    if (fflush (file)) /* flush libc buffers */
-        goto error;
+    if (vlc_memstream_close(&text.stream))
+        return -1;
+
+    text_offset = ftell(file);
+    if (fwrite(text.stream.ptr, 1, text.stream.length, file)
+            != text.stream.length
+     || fseek(file, text_pos, SEEK_SET))
+    {
+        free(text.stream.ptr);
+        return -1;
+    }
+    free(text.stream.ptr);
+
+    if (fwrite(&text_offset, sizeof (text_offset), 1, file) != 1
+     || fflush (file)) /* flush libc buffers */
+        return -1;
     return 0; /* success! */
 
 error:
+    if (vlc_memstream_close(&text.stream) == 0)
+        free(text.stream.ptr);
     return -1;
 }
 
@@ -92,12 +92,8 @@ void vlc_module_destroy (module_t *module)
     }
 }
 
-vlc_plugin_t *vlc_plugin_create(void)
+void vlc_plugin_init(vlc_plugin_t *plugin)
 {
-    vlc_plugin_t *plugin = malloc(sizeof (*plugin));
-    if (unlikely(plugin == NULL))
-        return NULL;
-
     plugin->modules_count = 0;
     plugin->textdomain = NULL;
     plugin->conf.items = NULL;
@@ -110,10 +106,17 @@ vlc_plugin_t *vlc_plugin_create(void)
     plugin->unloadable = true;
     plugin->handle = NULL;
     plugin->abspath = NULL;
+    plugin->cached = false;
     plugin->path = NULL;
 #endif
     plugin->module = NULL;
+}
 
+vlc_plugin_t *vlc_plugin_create(void)
+{
+    vlc_plugin_t *plugin = malloc(sizeof (*plugin));
+    if (likely(plugin != NULL))
+        vlc_plugin_init(plugin);
     return plugin;
 }
 
@@ -129,12 +132,29 @@ void vlc_plugin_destroy(vlc_plugin_t *plugin)
     assert(!plugin->unloadable || !atomic_load(&plugin->loaded));
 #endif
 
-    if (plugin->module != NULL)
-        vlc_module_destroy(plugin->module);
+#ifdef HAVE_DYNAMIC_PLUGINS
+    if (plugin->cached)
+    {   /* Tables and strings belong to the plugins cache */
+        for (size_t i = 0; i < plugin->conf.size; i++)
+        {
+            module_config_t *item = plugin->conf.items + i;
 
-    config_Free(plugin->conf.items, plugin->conf.size);
+            if (IsConfigStringType(item->i_type))
+                free(item->value.psz);
+        }
+    }
+    else
+#endif
+    {
+        if (plugin->module != NULL)
+            vlc_module_destroy(plugin->module);
+
+        config_Free(plugin->conf.items, plugin->conf.size);
+    }
 #ifdef HAVE_DYNAMIC_PLUGINS
     free(plugin->abspath);
+    if (plugin->cached)
+        return; /* allocated along with the cache tables */
     free(plugin->path);
 #endif
     free(plugin);
@@ -55,6 +55,7 @@ typedef struct vlc_plugin_t
     module_handle_t handle; /**< Run-time linker handle (if loaded) */
     char *abspath; /**< Absolute path */
 
+    bool cached; /**< Whether the tables are stored in the plugins cache */
     char *path; /**< Relative path (within plug-in directory) */
     int64_t mtime; /**< Last modification time */
     uint64_t size; /**< File size */
@@ -103,6 +104,7 @@ struct module_t
     void *pf_deactivate;
 };
 
+void vlc_plugin_init(vlc_plugin_t *);
 vlc_plugin_t *vlc_plugin_create(void);
 void vlc_plugin_destroy(vlc_plugin_t *);
 module_t *vlc_module_create(vlc_plugin_t *);
@@ -40,15 +40,22 @@
 #include <vlc_url.h>
 #include <vlc_mime.h>
 #include <vlc_block.h>
+#include <vlc_atomic.h>
 #include "../libvlc.h"
 
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
+#ifdef HAVE_SYS_UIO_H
+# include <sys/uio.h>
+#endif
 
 #ifdef HAVE_POLL
 # include <poll.h>
 #endif
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
 
 #if defined(_WIN32)
 #   include <winsock2.h>
@@ -63,10 +70,63 @@
 #define HTTPD_CL_BUFSIZE 10000
 #endif
 
+/* maximum number of stream segments a client sends at once */
+#define HTTPD_CL_SEGMENTS 64
+
+/* maximum number of events handled per epoll_wait() call */
+#define HTTPD_MAX_EVENTS 64
+/* interval between two reports of the host metrics */
+#define HTTPD_REPORT_INTERVAL (INT64_C(10) * CLOCK_FREQ)
+
 static void httpd_ClientDestroy(httpd_client_t *cl);
-static void httpd_AppendData(httpd_stream_t *stream, uint8_t *p_data, int i_data);
 
-/* each host run in his own thread */
+/* immutable chunk of live stream data, shared by all the clients */
+typedef struct httpd_segment_t
+{
+    atomic_uint refs;
+    int64_t     i_pos;  /* absolute position of the first byte */
+    size_t      i_size;
+    uint8_t     p_data[];
+} httpd_segment_t;
+
+static httpd_segment_t *httpd_SegmentHold(httpd_segment_t *seg)
+{
+    atomic_fetch_add(&seg->refs, 1);
+    return seg;
+}
+
+static void httpd_SegmentRelease(httpd_segment_t *seg)
+{
+    if (atomic_fetch_sub(&seg->refs, 1) == 1)
+        free(seg);
+}
+
+typedef struct httpd_worker_t httpd_worker_t;
+
+/* each worker thread serves its own share of the clients of a host */
+struct httpd_worker_t
+{
+    httpd_host_t *host;
+    vlc_thread_t  thread;
+    vlc_mutex_t   lock;
+
+    int            i_client;
+    httpd_client_t **client;
+
+#ifdef HAVE_SYS_EPOLL_H
+    int           epfd;
+#endif
+
+    /* metrics */
+    mtime_t       wake;
+    atomic_uint   active;
+    atomic_uint_fast64_t loops;
+    atomic_uint_fast64_t loop_time;
+    atomic_uint_fast64_t loop_max;
+};
+
+/* each host runs a pool of worker threads, the first one also accepts the
+ * new connections */
 struct httpd_host_t
 {
     VLC_COMMON_MEMBERS
@@ -79,7 +139,6 @@ struct httpd_host_t
     unsigned     nfd;
     unsigned     port;
 
-    vlc_thread_t thread;
     vlc_mutex_t lock;
     vlc_cond_t  wait;
 
@@ -90,8 +149,13 @@ struct httpd_host_t
     int         i_url;
     httpd_url_t **url;
 
-    int            i_client;
-    httpd_client_t **client;
+    unsigned        i_worker;
+    httpd_worker_t *worker;
+
+    /* accept rate (first worker only) */
+    uint64_t    i_accept;
+    uint64_t    i_accept_last;
+    mtime_t     i_report_date;
 
     /* TLS data */
     vlc_tls_creds_t *p_tls;
@@ -150,6 +214,10 @@ struct httpd_client_t
     bool    b_stream_mode;
     uint8_t i_state;
 
+    /* socket readiness, cleared when an operation would block */
+    bool    b_readable;
+    bool    b_writable;
+
     mtime_t i_activity_date;
     mtime_t i_activity_timeout;
 
@@ -165,6 +233,11 @@ struct httpd_client_t
      */
     int64_t i_keyframe_wait_to_pass;
 
+    /* stream segments being sent, starting at i_seg_offset in the first */
+    httpd_segment_t *segv[HTTPD_CL_SEGMENTS];
+    unsigned i_seg;
+    size_t   i_seg_offset;
+
     /* */
     httpd_message_t query;  /* client -> httpd */
     httpd_message_t answer; /* httpd -> client */
@@ -611,9 +684,13 @@ struct httpd_stream_t
     bool        b_has_keyframes;
     int64_t     i_last_keyframe_seen_pos;
 
-    /* circular buffer */
-    int         i_buffer_size;      /* buffer size, can't be reallocated smaller */
-    uint8_t     *p_buffer;          /* buffer */
+    /* ring of shared segments, the oldest first */
+    httpd_segment_t **segv;
+    size_t      i_seg;              /* number of segments */
+    size_t      i_seg_first;        /* index of the oldest segment */
+    size_t      i_seg_alloc;        /* allocated ring entries */
+    int64_t     i_buffer_size;      /* bytes kept in the ring */
+    int64_t     i_buffer_limit;     /* maximum bytes kept in the ring */
     int64_t     i_buffer_pos;       /* absolute position from beginning */
     int64_t     i_buffer_last_pos;  /* a new connection will start with that */
 
@@ -622,6 +699,13 @@ struct httpd_stream_t
     httpd_header * p_http_headers;
 };
 
+static httpd_segment_t *httpd_StreamSegment(const httpd_stream_t *stream,
+                                            size_t i)
+{
+    assert(i < stream->i_seg);
+    return stream->segv[(stream->i_seg_first + i) % stream->i_seg_alloc];
+}
+
 static int httpd_StreamCallBack(httpd_callback_sys_t *p_sys,
                                  httpd_client_t *cl, httpd_message_t *answer,
                                  const httpd_message_t *query)
@@ -632,45 +716,58 @@ static int httpd_StreamCallBack(httpd_callback_sys_t *p_sys,
         return VLC_SUCCESS;
 
     if (answer->i_body_offset > 0) {
-        int     i_pos;
-
-        if (answer->i_body_offset >= stream->i_buffer_pos)
+        vlc_mutex_lock(&stream->lock);
+        if (answer->i_body_offset >= stream->i_buffer_pos) {
+            vlc_mutex_unlock(&stream->lock);
             return VLC_EGENERIC;    /* wait, no data available */
+        }
 
         if (cl->i_keyframe_wait_to_pass >= 0) {
-            if (stream->i_last_keyframe_seen_pos <= cl->i_keyframe_wait_to_pass)
+            if (stream->i_last_keyframe_seen_pos <= cl->i_keyframe_wait_to_pass) {
                 /* still waiting for the next keyframe */
+                vlc_mutex_unlock(&stream->lock);
                 return VLC_EGENERIC;
+            }
 
             /* seek to the new keyframe */
             answer->i_body_offset = stream->i_last_keyframe_seen_pos;
             cl->i_keyframe_wait_to_pass = -1;
         }
 
-        if (answer->i_body_offset + stream->i_buffer_size < stream->i_buffer_pos)
+        assert(stream->i_seg > 0);
+        if (answer->i_body_offset < httpd_StreamSegment(stream, 0)->i_pos)
             answer->i_body_offset = stream->i_buffer_last_pos; /* this client isn't fast enough */
 
-        i_pos   = answer->i_body_offset % stream->i_buffer_size;
-        int64_t i_write = stream->i_buffer_pos - answer->i_body_offset;
+        /* Find the last segment starting at or before the offset */
+        size_t lo = 0, hi = stream->i_seg - 1;
+        while (lo < hi) {
+            size_t mid = (lo + hi + 1) / 2;
 
-        if (i_write > HTTPD_CL_BUFSIZE)
-            i_write = HTTPD_CL_BUFSIZE;
-        else if (i_write <= 0)
-            return VLC_EGENERIC;    /* wait, no data available */
+            if (httpd_StreamSegment(stream, mid)->i_pos <= answer->i_body_offset)
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
 
-        /* Don't go past the end of the circular buffer */
-        i_write = __MIN(i_write, stream->i_buffer_size - i_pos);
+        /* Share the segments with the client rather than copy them */
+        httpd_segment_t *seg = httpd_StreamSegment(stream, lo);
+
+        assert(cl->i_seg == 0);
+        cl->i_seg_offset = answer->i_body_offset - seg->i_pos;
+        while (lo < stream->i_seg && cl->i_seg < HTTPD_CL_SEGMENTS) {
+            seg = httpd_StreamSegment(stream, lo++);
+            cl->segv[cl->i_seg++] = httpd_SegmentHold(seg);
+        }
+        answer->i_body_offset = seg->i_pos + seg->i_size;
+        vlc_mutex_unlock(&stream->lock);
 
         /* using HTTPD_MSG_ANSWER -> data available */
         answer->i_proto  = HTTPD_PROTO_HTTP;
         answer->i_version= 0;
         answer->i_type   = HTTPD_MSG_ANSWER;
 
-        answer->i_body = i_write;
-        answer->p_body = xmalloc(i_write);
-        memcpy(answer->p_body, &stream->p_buffer[i_pos], i_write);
-
-        answer->i_body_offset += i_write;
+        answer->i_body = 0;
+        answer->p_body = NULL;
 
         return VLC_SUCCESS;
     } else {
@@ -765,8 +862,12 @@ httpd_stream_t *httpd_StreamNew(httpd_host_t *host,
 
     stream->i_header = 0;
     stream->p_header = NULL;
-    stream->i_buffer_size = 5000000;    /* 5 Mo per stream */
-    stream->p_buffer = xmalloc(stream->i_buffer_size);
+    stream->segv = NULL;
+    stream->i_seg = 0;
+    stream->i_seg_first = 0;
+    stream->i_seg_alloc = 0;
+    stream->i_buffer_size = 0;
+    stream->i_buffer_limit = 5000000;   /* 5 Mo per stream */
     /* We set to 1 to make life simpler
      * (this way i_body_offset can never be 0) */
     stream->i_buffer_pos = 1;
@@ -802,27 +903,61 @@ int httpd_StreamHeader(httpd_stream_t *stream, uint8_t *p_data, int i_data)
     return VLC_SUCCESS;
 }
 
-static void httpd_AppendData(httpd_stream_t *stream, uint8_t *p_data, int i_data)
+static void httpd_DropData(httpd_stream_t *stream)
 {
-    int i_pos = stream->i_buffer_pos % stream->i_buffer_size;
-    int i_count = i_data;
-    while (i_count > 0) {
-        int i_copy = __MIN(i_count, stream->i_buffer_size - i_pos);
+    httpd_segment_t *seg = httpd_StreamSegment(stream, 0);
 
-        /* Ok, we can't go past the end of our buffer */
-        memcpy(&stream->p_buffer[i_pos], p_data, i_copy);
+    /* Clients still sending the segment keep their own reference */
+    stream->i_seg_first = (stream->i_seg_first + 1) % stream->i_seg_alloc;
+    stream->i_seg--;
+    stream->i_buffer_size -= seg->i_size;
+    httpd_SegmentRelease(seg);
+}
+
+static int httpd_AppendData(httpd_stream_t *stream, const uint8_t *p_data,
+                            size_t i_data)
+{
+    httpd_segment_t *seg = malloc(sizeof (*seg) + i_data);
+    if (unlikely(seg == NULL))
+        return VLC_ENOMEM;
+
+    atomic_init(&seg->refs, 1);
+    seg->i_pos = stream->i_buffer_pos;
+    seg->i_size = i_data;
+    memcpy(seg->p_data, p_data, i_data);
+
+    while (stream->i_seg > 0
+        && stream->i_buffer_size + (int64_t)i_data > stream->i_buffer_limit)
+        httpd_DropData(stream);
+
+    if (stream->i_seg == stream->i_seg_alloc) {
+        /* Grow the ring, unwrapping it at the same time */
+        size_t i_alloc = stream->i_seg_alloc ? 2 * stream->i_seg_alloc : 64;
+        httpd_segment_t **segv = malloc(i_alloc * sizeof (*segv));
+        if (unlikely(segv == NULL)) {
+            free(seg);
+            return VLC_ENOMEM;
+        }
 
-        i_pos = (i_pos + i_copy) % stream->i_buffer_size;
-        i_count -= i_copy;
-        p_data  += i_copy;
+        for (size_t i = 0; i < stream->i_seg; i++)
+            segv[i] = httpd_StreamSegment(stream, i);
+        free(stream->segv);
+        stream->segv = segv;
+        stream->i_seg_first = 0;
+        stream->i_seg_alloc = i_alloc;
     }
 
+    stream->segv[(stream->i_seg_first + stream->i_seg) % stream->i_seg_alloc]
+        = seg;
+    stream->i_seg++;
+    stream->i_buffer_size += i_data;
     stream->i_buffer_pos += i_data;
+    return VLC_SUCCESS;
 }
 
 int httpd_StreamSend(httpd_stream_t *stream, const block_t *p_block)
 {
-    if (!p_block || !p_block->p_buffer)
+    if (!p_block || !p_block->p_buffer || p_block->i_buffer == 0)
         return VLC_SUCCESS;
 
     vlc_mutex_lock(&stream->lock);
@@ -835,10 +970,10 @@ int httpd_StreamSend(httpd_stream_t *stream, const block_t *p_block)
         stream->i_last_keyframe_seen_pos = stream->i_buffer_pos;
     }
 
-    httpd_AppendData(stream, p_block->p_buffer, p_block->i_buffer);
+    int ret = httpd_AppendData(stream, p_block->p_buffer, p_block->i_buffer);
 
     vlc_mutex_unlock(&stream->lock);
-    return VLC_SUCCESS;
+    return ret;
 }
 
 void httpd_StreamDelete(httpd_stream_t *stream)
@@ -852,14 +987,17 @@ void httpd_StreamDelete(httpd_stream_t *stream)
     vlc_mutex_destroy(&stream->lock);
     free(stream->psz_mime);
     free(stream->p_header);
-    free(stream->p_buffer);
+    while (stream->i_seg > 0)
+        httpd_DropData(stream);
+    free(stream->segv);
     free(stream);
 }
 
 /*****************************************************************************
  * Low level
  *****************************************************************************/
-static void* httpd_HostThread(void *);
+static int httpd_WorkerStart(httpd_host_t *, httpd_worker_t *);
+static void httpd_WorkersStop(httpd_host_t *);
 static httpd_host_t *httpd_HostCreate(vlc_object_t *, const char *,
                                        const char *, vlc_tls_creds_t *);
 
@@ -959,6 +1097,8 @@ static httpd_host_t *httpd_HostCreate(vlc_object_t *p_this,
     vlc_mutex_init(&host->lock);
     vlc_cond_init(&host->wait);
     host->i_ref = 1;
+    host->i_worker = 0;
+    host->worker = NULL;
 
     host->fds = net_ListenTCP(p_this, url.psz_host, port);
     if (!host->fds) {
@@ -970,16 +1110,34 @@ static httpd_host_t *httpd_HostCreate(vlc_object_t *p_this,
     host->port     = port;
     host->i_url    = 0;
     host->url      = NULL;
-    host->i_client = 0;
-    host->client   = NULL;
     host->p_tls    = p_tls;
-
-    /* create the thread */
-    if (vlc_clone(&host->thread, httpd_HostThread, host,
-                   VLC_THREAD_PRIORITY_LOW)) {
-        msg_Err(p_this, "cannot spawn http host thread");
+    host->i_accept = 0;
+    host->i_accept_last = 0;
+    host->i_report_date = mdate();
+
+    /* create the worker threads */
+    unsigned i_worker = var_InheritInteger(p_this, "http-threads");
+#ifndef HAVE_SYS_EPOLL_H
+    if (i_worker > 1) {
+        msg_Warn(p_this, "multi-threaded HTTP host not supported");
+        i_worker = 1;
+    }
+#endif
+    host->worker = calloc(i_worker, sizeof (*host->worker));
+    host->i_worker = 0;
+    if (unlikely(host->worker == NULL))
         goto error;
+
+    while (host->i_worker < i_worker) {
+        httpd_worker_t *worker = &host->worker[host->i_worker];
+
+        if (httpd_WorkerStart(host, worker)) {
+            msg_Err(p_this, "cannot spawn http host thread");
+            goto error;
+        }
+        host->i_worker++;
     }
+    msg_Dbg(p_this, "HTTP host started with %u thread(s)", host->i_worker);
 
     /* now add it to httpd */
     TAB_APPEND(httpd.i_host, httpd.host, host);
@@ -993,6 +1151,7 @@ error:
     vlc_mutex_unlock(&httpd.mutex);
 
     if (host) {
+        httpd_WorkersStop(host);
         net_ListenClose(host->fds);
         vlc_cond_destroy(&host->wait);
         vlc_mutex_destroy(&host->lock);
@@ -1024,20 +1183,13 @@ void httpd_HostDelete(httpd_host_t *host)
     }
     TAB_REMOVE(httpd.i_host, httpd.host, host);
 
-    vlc_cancel(host->thread);
-    vlc_join(host->thread, NULL);
+    httpd_WorkersStop(host);
 
     msg_Dbg(host, "HTTP host removed");
 
     for (int i = 0; i < host->i_url; i++)
         msg_Err(host, "url still registered: %s", host->url[i]->psz_url);
 
-    for (int i = 0; i < host->i_client; i++) {
-        msg_Warn(host, "client still connected");
-        httpd_ClientDestroy(host->client[i]);
-    }
-    TAB_CLEAN(host->i_client, host->client);
-
     vlc_tls_Delete(host->p_tls);
     net_ListenClose(host->fds);
     vlc_cond_destroy(&host->wait);
@@ -1075,7 +1227,7 @@ httpd_url_t *httpd_UrlNew(httpd_host_t *host, const char *psz_url,
     }
 
     TAB_APPEND(host->i_url, host->url, url);
-    vlc_cond_signal(&host->wait);
+    vlc_cond_broadcast(&host->wait);
     vlc_mutex_unlock(&host->lock);
 
     return url;
@@ -1100,26 +1252,34 @@ void httpd_UrlDelete(httpd_url_t *url)
 
     vlc_mutex_lock(&host->lock);
     TAB_REMOVE(host->i_url, host->url, url);
+    vlc_mutex_unlock(&host->lock);
 
-    vlc_mutex_destroy(&url->lock);
-    free(url->psz_url);
-    free(url->psz_user);
-    free(url->psz_password);
+    /* No new client can be bound to the URL anymore. Once the lock of a
+     * worker is held, none of its clients is running a callback either.
+     * The clients are closed by their worker on its next iteration. */
+    for (unsigned i = 0; i < host->i_worker; i++) {
+        httpd_worker_t *worker = &host->worker[i];
 
-    for (int i = 0; i < host->i_client; i++) {
-        httpd_client_t *client = host->client[i];
+        vlc_mutex_lock(&worker->lock);
+        for (int j = 0; j < worker->i_client; j++) {
+            httpd_client_t *client = worker->client[j];
 
-        if (client->url != url)
-            continue;
+            if (client->url != url)
+                continue;
 
-        /* TODO complete it */
-        msg_Warn(host, "force closing connections");
-        TAB_REMOVE(host->i_client, host->client, client);
-        httpd_ClientDestroy(client);
-        i--;
+            /* TODO complete it */
+            msg_Warn(host, "force closing connections");
+            client->url = NULL;
+            client->i_state = HTTPD_CLIENT_DEAD;
+        }
+        vlc_mutex_unlock(&worker->lock);
     }
+
+    vlc_mutex_destroy(&url->lock);
+    free(url->psz_url);
+    free(url->psz_user);
+    free(url->psz_password);
     free(url);
-    vlc_mutex_unlock(&host->lock);
 }
 
 static void httpd_MsgInit(httpd_message_t *msg)
@@ -1201,6 +1361,8 @@ static void httpd_ClientInit(httpd_client_t *cl, mtime_t now)
     cl->p_buffer = xmalloc(cl->i_buffer_size);
     cl->i_keyframe_wait_to_pass = -1;
     cl->b_stream_mode = false;
+    cl->i_seg = 0;
+    cl->i_seg_offset = 0;
 
     httpd_MsgInit(&cl->query);
     httpd_MsgInit(&cl->answer);
@@ -1223,6 +1385,9 @@ static void httpd_ClientDestroy(httpd_client_t *cl)
     else
         net_Close(cl->fd);
 
+    for (unsigned i = 0; i < cl->i_seg; i++)
+        httpd_SegmentRelease(cl->segv[i]);
+
     httpd_MsgClean(&cl->answer);
     httpd_MsgClean(&cl->query);
 
@@ -1240,6 +1405,8 @@ static httpd_client_t *httpd_ClientNew(int fd, vlc_tls_t *p_tls, mtime_t now)
     cl->fd      = fd;
     cl->url     = NULL;
     cl->p_tls = p_tls;
+    cl->b_readable = true;
+    cl->b_writable = true;
 
     httpd_ClientInit(cl, now);
     if (p_tls)
@@ -1259,6 +1426,8 @@ ssize_t httpd_NetRecv (httpd_client_t *cl, uint8_t *p, size_t i_len)
         val = p_tls ? tls_Recv (p_tls, p, i_len)
                     : recv (cl->fd, p, i_len, 0);
     while (val == -1 && errno == EINTR);
+    if (val == -1 && errno == EAGAIN)
+        cl->b_readable = false;
     return val;
 }
 
@@ -1273,6 +1442,8 @@ ssize_t httpd_NetSend (httpd_client_t *cl, const uint8_t *p, size_t i_len)
         val = p_tls ? tls_Send(p_tls, p, i_len)
                     : send (cl->fd, p, i_len, MSG_NOSIGNAL);
     while (val == -1 && errno == EINTR);
+    if (val == -1 && errno == EAGAIN)
+        cl->b_writable = false;
     return val;
 }
 
@@ -1580,10 +1751,87 @@ static void httpd_ClientRecv(httpd_client_t *cl)
         cl->i_activity_timeout = 0;
 }
 
+static void httpd_ClientMoreData(httpd_client_t *cl)
+{
+    /* catch more body data */
+    int     i_msg = cl->query.i_type;
+    int64_t i_offset = cl->answer.i_body_offset;
+
+    httpd_MsgClean(&cl->answer);
+    cl->answer.i_body_offset = i_offset;
+
+    cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
+                              &cl->answer, &cl->query);
+}
+
+/**
+ * Sends shared stream segments, straight from their buffers.
+ */
+static void httpd_ClientSendSegments(httpd_client_t *cl)
+{
+    struct iovec iov[HTTPD_CL_SEGMENTS];
+    ssize_t val;
+
+    for (unsigned i = 0; i < cl->i_seg; i++) {
+        iov[i].iov_base = cl->segv[i]->p_data;
+        iov[i].iov_len = cl->segv[i]->i_size;
+    }
+    iov[0].iov_base = (uint8_t *)iov[0].iov_base + cl->i_seg_offset;
+    iov[0].iov_len -= cl->i_seg_offset;
+
+    if (cl->p_tls != NULL)
+        val = httpd_NetSend(cl, iov[0].iov_base, iov[0].iov_len);
+    else {
+        struct msghdr msg = {
+            .msg_iov = iov,
+            .msg_iovlen = cl->i_seg,
+        };
+
+        do
+            val = sendmsg(cl->fd, &msg, MSG_NOSIGNAL);
+        while (val == -1 && errno == EINTR);
+        if (val == -1 && errno == EAGAIN)
+            cl->b_writable = false;
+    }
+
+    if (val <= 0) {
+#if defined(_WIN32)
+        if ((val < 0 && WSAGetLastError() != WSAEWOULDBLOCK) || (val == 0))
+#else
+        if ((val < 0 && errno != EAGAIN) || (val == 0))
+#endif
+            cl->i_state = HTTPD_CLIENT_DEAD;
+        return;
+    }
+
+    /* Release the segments sent completely */
+    unsigned i = 0;
+    size_t sent = val;
+
+    while (i < cl->i_seg && sent >= iov[i].iov_len) {
+        sent -= iov[i].iov_len;
+        httpd_SegmentRelease(cl->segv[i++]);
+    }
+    memmove(cl->segv, cl->segv + i, (cl->i_seg - i) * sizeof (cl->segv[0]));
+    cl->i_seg -= i;
+    cl->i_seg_offset = (i == 0) ? cl->i_seg_offset + sent : sent;
+
+    if (cl->i_seg == 0) {
+        httpd_ClientMoreData(cl);
+        if (cl->i_seg == 0)
+            cl->i_state = HTTPD_CLIENT_SEND_DONE;
+    }
+}
+
 static void httpd_ClientSend(httpd_client_t *cl)
 {
     int i_len;
 
+    if (cl->i_seg > 0) {
+        httpd_ClientSendSegments(cl);
+        return;
+    }
+
     if (cl->i_buffer < 0) {
         /* We need to create the header */
         int i_size = 0;
@@ -1621,17 +1869,8 @@ static void httpd_ClientSend(httpd_client_t *cl)
         cl->i_buffer += i_len;
 
         if (cl->i_buffer >= cl->i_buffer_size) {
-            if (cl->answer.i_body == 0  && cl->answer.i_body_offset > 0) {
-                /* catch more body data */
-                int     i_msg = cl->query.i_type;
-                int64_t i_offset = cl->answer.i_body_offset;
-
-                httpd_MsgClean(&cl->answer);
-                cl->answer.i_body_offset = i_offset;
-
-                cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
-                                          &cl->answer, &cl->query);
-            }
+            if (cl->answer.i_body == 0  && cl->answer.i_body_offset > 0)
+                httpd_ClientMoreData(cl);
 
             if (cl->answer.i_body > 0) {
                 /* send the body data */
@@ -1642,6 +1881,12 @@ static void httpd_ClientSend(httpd_client_t *cl)
 
                 cl->answer.i_body = 0;
                 cl->answer.p_body = NULL;
+            } else if (cl->i_seg > 0) {
+                /* send the shared stream segments */
+                free(cl->p_buffer);
+                cl->p_buffer = NULL;
+                cl->i_buffer_size = 0;
+                cl->i_buffer = 0;
             } else /* send finished */
                 cl->i_state = HTTPD_CLIENT_SEND_DONE;
         }
@@ -1664,8 +1909,14 @@ static void httpd_ClientTlsHandshake(httpd_host_t *host, httpd_client_t *cl)
     {
         case -1: cl->i_state = HTTPD_CLIENT_DEAD;       break;
         case 0:  cl->i_state = HTTPD_CLIENT_RECEIVING;  break;
-        case 1:  cl->i_state = HTTPD_CLIENT_TLS_HS_IN;  break;
-        case 2:  cl->i_state = HTTPD_CLIENT_TLS_HS_OUT; break;
+        case 1:
+            cl->i_state = HTTPD_CLIENT_TLS_HS_IN;
+            cl->b_readable = false;
+            break;
+        case 2:
+            cl->i_state = HTTPD_CLIENT_TLS_HS_OUT;
+            cl->b_writable = false;
+            break;
     }
 }
 
@@ -1709,276 +1960,472 @@ auth_failed:
     return false;
 }
 
-static void httpdLoop(httpd_host_t *host)
+/**
+ * Handles a client whose state does not depend on its socket.
+ */
+static void httpd_ClientProcess(httpd_host_t *host, httpd_client_t *cl)
 {
-    struct pollfd ufd[host->nfd + host->i_client];
-    unsigned nfd;
-    for (nfd = 0; nfd < host->nfd; nfd++) {
-        ufd[nfd].fd = host->fds[nfd];
-        ufd[nfd].events = POLLIN;
-        ufd[nfd].revents = 0;
+    switch (cl->i_state) {
+        case HTTPD_CLIENT_RECEIVE_DONE: {
+            httpd_message_t *answer = &cl->answer;
+            httpd_message_t *query  = &cl->query;
+
+            httpd_MsgInit(answer);
+
+            /* Handle what we received */
+            switch (query->i_type) {
+                case HTTPD_MSG_ANSWER:
+                    cl->url     = NULL;
+                    cl->i_state = HTTPD_CLIENT_DEAD;
+                    break;
+
+                case HTTPD_MSG_OPTIONS:
+                    answer->i_type   = HTTPD_MSG_ANSWER;
+                    answer->i_proto  = query->i_proto;
+                    answer->i_status = 200;
+                    answer->i_body = 0;
+                    answer->p_body = NULL;
+
+                    httpd_MsgAdd(answer, "Server", "VLC/%s", VERSION);
+                    httpd_MsgAdd(answer, "Content-Length", "0");
+
+                    switch(query->i_proto) {
+                    case HTTPD_PROTO_HTTP:
+                        answer->i_version = 1;
+                        httpd_MsgAdd(answer, "Allow", "GET,HEAD,POST,OPTIONS");
+                        break;
+
+                    case HTTPD_PROTO_RTSP:
+                        answer->i_version = 0;
+
+                        const char *p = httpd_MsgGet(query, "Cseq");
+                        if (p)
+                            httpd_MsgAdd(answer, "Cseq", "%s", p);
+                        p = httpd_MsgGet(query, "Timestamp");
+                        if (p)
+                            httpd_MsgAdd(answer, "Timestamp", "%s", p);
+
+                        p = httpd_MsgGet(query, "Require");
+                        if (p) {
+                            answer->i_status = 551;
+                            httpd_MsgAdd(query, "Unsupported", "%s", p);
+                        }
+
+                        httpd_MsgAdd(answer, "Public", "DESCRIBE,SETUP,"
+                                "TEARDOWN,PLAY,PAUSE,GET_PARAMETER");
+                        break;
+                    }
+
+                    cl->i_buffer = -1;  /* Force the creation of the answer in
+                                         * httpd_ClientSend */
+                    cl->i_state = HTTPD_CLIENT_SENDING;
+                    break;
+
+                case HTTPD_MSG_NONE:
+                    if (query->i_proto == HTTPD_PROTO_NONE) {
+                        cl->url = NULL;
+                        cl->i_state = HTTPD_CLIENT_DEAD;
+                    } else {
+                        /* unimplemented */
+                        answer->i_proto  = query->i_proto ;
+                        answer->i_type   = HTTPD_MSG_ANSWER;
+                        answer->i_version= 0;
+                        answer->i_status = 501;
+
+                        char *p;
+                        answer->i_body = httpd_HtmlError (&p, 501, NULL);
+                        answer->p_body = (uint8_t *)p;
+                        httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
+
+                        cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
+                        cl->i_state = HTTPD_CLIENT_SENDING;
+                    }
+                    break;
+
+                default: {
+                    int i_msg = query->i_type;
+                    bool b_auth_failed = false;
+
+                    /* Search the url and trigger callbacks */
+                    vlc_mutex_lock(&host->lock);
+                    for (int i = 0; i < host->i_url; i++) {
+                        httpd_url_t *url = host->url[i];
+
+                        if (strcmp(url->psz_url, query->psz_url))
+                            continue;
+                        if (!url->catch[i_msg].cb)
+                            continue;
+
+                        if (answer) {
+                            b_auth_failed = !httpdAuthOk(url->psz_user,
+                               url->psz_password,
+                               httpd_MsgGet(query, "Authorization")); /* BASIC id */
+                            if (b_auth_failed)
+                               break;
+                        }
+
+                        if (url->catch[i_msg].cb(url->catch[i_msg].p_sys, cl, answer, query))
+                            continue;
+
+                        if (answer->i_proto == HTTPD_PROTO_NONE)
+                            cl->i_buffer = cl->i_buffer_size; /* Raw answer from a CGI */
+                        else
+                            cl->i_buffer = -1;
+
+                        /* only one url can answer */
+                        answer = NULL;
+                        if (!cl->url)
+                            cl->url = url;
+                    }
+                    vlc_mutex_unlock(&host->lock);
+
+                    if (answer) {
+                        answer->i_proto  = query->i_proto;
+                        answer->i_type   = HTTPD_MSG_ANSWER;
+                        answer->i_version= 0;
+
+                       if (b_auth_failed) {
+                            httpd_MsgAdd(answer, "WWW-Authenticate",
+                                    "Basic realm=\"VLC stream\"");
+                            answer->i_status = 401;
+                        } else
+                            answer->i_status = 404; /* no url registered */
+
+                        char *p;
+                        answer->i_body = httpd_HtmlError (&p, answer->i_status,
+                                query->psz_url);
+                        answer->p_body = (uint8_t *)p;
+
+                        cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
+                        httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
+                        httpd_MsgAdd(answer, "Content-Type", "%s", "text/html");
+                    }
+
+                    cl->i_state = HTTPD_CLIENT_SENDING;
+                }
+            }
+            break;
+        }
+
+        case HTTPD_CLIENT_SEND_DONE:
+            if (!cl->b_stream_mode || cl->answer.i_body_offset == 0) {
+                const char *psz_connection = httpd_MsgGet(&cl->answer, "Connection");
+                const char *psz_query = httpd_MsgGet(&cl->query, "Connection");
+                bool b_connection = false;
+                bool b_keepalive = false;
+                bool b_query = false;
+
+                cl->url = NULL;
+                if (psz_connection) {
+                    b_connection = (strcasecmp(psz_connection, "Close") == 0);
+                    b_keepalive = (strcasecmp(psz_connection, "Keep-Alive") == 0);
+                }
+
+                if (psz_query)
+                    b_query = (strcasecmp(psz_query, "Close") == 0);
+
+                if (((cl->query.i_proto == HTTPD_PROTO_HTTP) &&
+                            ((cl->query.i_version == 0 && b_keepalive) ||
+                              (cl->query.i_version == 1 && !b_connection))) ||
+                        ((cl->query.i_proto == HTTPD_PROTO_RTSP) &&
+                          !b_query && !b_connection)) {
+                    httpd_MsgClean(&cl->query);
+                    httpd_MsgInit(&cl->query);
+
+                    cl->i_buffer = 0;
+                    cl->i_buffer_size = 1000;
+                    free(cl->p_buffer);
+                    cl->p_buffer = xmalloc(cl->i_buffer_size);
+                    cl->i_state = HTTPD_CLIENT_RECEIVING;
+                } else
+                    cl->i_state = HTTPD_CLIENT_DEAD;
+                httpd_MsgClean(&cl->answer);
+            } else {
+                int64_t i_offset = cl->answer.i_body_offset;
+                httpd_MsgClean(&cl->answer);
+
+                cl->answer.i_body_offset = i_offset;
+                free(cl->p_buffer);
+                cl->p_buffer = NULL;
+                cl->i_buffer = 0;
+                cl->i_buffer_size = 0;
+
+                cl->i_state = HTTPD_CLIENT_WAITING;
+            }
+            break;
+
+        case HTTPD_CLIENT_WAITING: {
+            int64_t i_offset = cl->answer.i_body_offset;
+            int i_msg = cl->query.i_type;
+
+            httpd_MsgInit(&cl->answer);
+            cl->answer.i_body_offset = i_offset;
+
+            cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
+                    &cl->answer, &cl->query);
+            if (cl->answer.i_type != HTTPD_MSG_NONE) {
+                /* we have new data, so re-enter send mode */
+                cl->i_buffer      = 0;
+                cl->p_buffer      = cl->answer.p_body;
+                cl->i_buffer_size = cl->answer.i_body;
+                cl->answer.p_body = NULL;
+                cl->answer.i_body = 0;
+                cl->i_state = HTTPD_CLIENT_SENDING;
+            }
+            break;
+        }
     }
+}
 
-    /* add all socket that should be read/write and close dead connection */
-    while (host->i_url <= 0) {
-        mutex_cleanup_push(&host->lock);
-        vlc_cond_wait(&host->wait, &host->lock);
-        vlc_cleanup_pop();
+/**
+ * Checks whether a client can make progress without waiting for its socket.
+ */
+static bool httpd_ClientReady(const httpd_client_t *cl)
+{
+    switch (cl->i_state) {
+        case HTTPD_CLIENT_RECEIVING:
+        case HTTPD_CLIENT_TLS_HS_IN:
+            return cl->b_readable;
+        case HTTPD_CLIENT_SENDING:
+        case HTTPD_CLIENT_TLS_HS_OUT:
+            return cl->b_writable;
+        case HTTPD_CLIENT_WAITING:
+            return false;
+    }
+    return true;
+}
+
+static void httpd_WorkerAdd(httpd_worker_t *worker, httpd_client_t *cl)
+{
+    TAB_APPEND(worker->i_client, worker->client, cl);
+    atomic_fetch_add(&worker->active, 1);
+
+#ifdef HAVE_SYS_EPOLL_H
+    /* The registration is persistent and edge-triggered: the readiness flags
+     * of the client are set on events, and cleared by I/O would block. */
+    struct epoll_event ev = {
+        .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+        .data.ptr = cl,
+    };
+
+    if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, cl->fd, &ev)) {
+        msg_Err(worker->host, "cannot poll client: %s",
+                vlc_strerror_c(errno));
+        cl->i_state = HTTPD_CLIENT_DEAD;
     }
+#endif
+}
+
+static void httpd_WorkerAccept(httpd_worker_t *worker, int fd, mtime_t now)
+{
+    httpd_host_t *host = worker->host;
+
+    fd = vlc_accept (fd, NULL, NULL, true);
+    if (fd == -1)
+        return;
+    setsockopt (fd, SOL_SOCKET, SO_REUSEADDR,
+            &(int){ 1 }, sizeof(int));
 
+    vlc_tls_t *p_tls;
+
+    if (host->p_tls != NULL)
+    {
+        const char *alpn[] = { "http/1.1", NULL };
+
+        p_tls = vlc_tls_ServerSessionCreate(host->p_tls, fd, alpn);
+    }
+    else
+        p_tls = NULL;
+
+    httpd_client_t *cl = httpd_ClientNew(fd, p_tls, now);
+    if (unlikely(cl == NULL)) {
+        if (p_tls != NULL)
+            vlc_tls_Close(p_tls);
+        else
+            net_Close(fd);
+        return;
+    }
+    host->i_accept++;
+
+    /* Hand the connection over to the least loaded worker */
+    httpd_worker_t *target = worker;
+    for (unsigned i = 0; i < host->i_worker; i++)
+        if (atomic_load(&host->worker[i].active)
+          < atomic_load(&target->active))
+            target = &host->worker[i];
+
+    if (target != worker)
+        vlc_mutex_lock(&target->lock);
+    httpd_WorkerAdd(target, cl);
+    if (target != worker)
+        vlc_mutex_unlock(&target->lock);
+}
+
+/**
+ * Runs the state machine of all the clients of a worker.
+ *
+ * \return the time (in milliseconds) to wait for events before the next
+ * iteration, or -1 to wait indefinitely
+ */
+static int httpd_WorkerProcess(httpd_worker_t *worker)
+{
+    httpd_host_t *host = worker->host;
     mtime_t now = mdate();
-    bool b_low_delay = false;
+    int timeout = -1;
 
-    int canc = vlc_savecancel();
-    for (int i_client = 0; i_client < host->i_client; i_client++) {
-        int64_t i_offset;
-        httpd_client_t *cl = host->client[i_client];
+    for (int i_client = 0; i_client < worker->i_client; i_client++) {
+        httpd_client_t *cl = worker->client[i_client];
         if (cl->i_ref < 0 || (cl->i_ref == 0 &&
                     (cl->i_state == HTTPD_CLIENT_DEAD ||
                       (cl->i_activity_timeout > 0 &&
                         cl->i_activity_date+cl->i_activity_timeout < now)))) {
-            TAB_REMOVE(host->i_client, host->client, cl);
+            TAB_REMOVE(worker->i_client, worker->client, cl);
+            atomic_fetch_sub(&worker->active, 1);
             i_client--;
             httpd_ClientDestroy(cl);
             continue;
         }
 
-        struct pollfd *pufd = ufd + nfd;
-        assert (pufd < ufd + (sizeof (ufd) / sizeof (ufd[0])));
-
-        pufd->fd = cl->fd;
-        pufd->events = pufd->revents = 0;
-
-        switch (cl->i_state) {
-            case HTTPD_CLIENT_RECEIVING:
-            case HTTPD_CLIENT_TLS_HS_IN:
-                pufd->events = POLLIN;
-                break;
+        httpd_ClientProcess(host, cl);
+
+        if (httpd_ClientReady(cl)) {
+            switch (cl->i_state) {
+                case HTTPD_CLIENT_RECEIVING:
+                    httpd_ClientRecv(cl);
+                    cl->i_activity_date = now;
+                    break;
+                case HTTPD_CLIENT_SENDING:
+                    httpd_ClientSend(cl);
+                    cl->i_activity_date = now;
+                    break;
+                case HTTPD_CLIENT_TLS_HS_IN:
+                case HTTPD_CLIENT_TLS_HS_OUT:
+                    httpd_ClientTlsHandshake(host, cl);
+                    cl->i_activity_date = now;
+                    break;
+            }
+        }
 
-            case HTTPD_CLIENT_SENDING:
-            case HTTPD_CLIENT_TLS_HS_OUT:
-                pufd->events = POLLOUT;
-                break;
+        if (httpd_ClientReady(cl))
+            timeout = 0;
+        /* we will wait 20ms (not too big) if HTTPD_CLIENT_WAITING */
+        else if (cl->i_state == HTTPD_CLIENT_WAITING && timeout != 0)
+            timeout = 20;
+    }
+    return timeout;
+}
 
-            case HTTPD_CLIENT_RECEIVE_DONE: {
-                httpd_message_t *answer = &cl->answer;
-                httpd_message_t *query  = &cl->query;
+static void httpd_WorkerMetrics(httpd_worker_t *worker)
+{
+    httpd_host_t *host = worker->host;
+    mtime_t now = mdate();
+    uint_fast64_t latency = now - worker->wake;
 
-                httpd_MsgInit(answer);
+    atomic_fetch_add(&worker->loops, 1);
+    atomic_fetch_add(&worker->loop_time, latency);
+    if (latency > atomic_load(&worker->loop_max))
+        atomic_store(&worker->loop_max, latency);
 
-                /* Handle what we received */
-                switch (query->i_type) {
-                    case HTTPD_MSG_ANSWER:
-                        cl->url     = NULL;
-                        cl->i_state = HTTPD_CLIENT_DEAD;
-                        break;
+    /* The first worker reports on behalf of the whole host */
+    if (worker != host->worker
+     || now - host->i_report_date < HTTPD_REPORT_INTERVAL)
+        return;
 
-                    case HTTPD_MSG_OPTIONS:
-                        answer->i_type   = HTTPD_MSG_ANSWER;
-                        answer->i_proto  = query->i_proto;
-                        answer->i_status = 200;
-                        answer->i_body = 0;
-                        answer->p_body = NULL;
+    unsigned clients = 0;
+    uint_fast64_t loops = 0, loop_time = 0, loop_max = 0;
 
-                        httpd_MsgAdd(answer, "Server", "VLC/%s", VERSION);
-                        httpd_MsgAdd(answer, "Content-Length", "0");
+    for (unsigned i = 0; i < host->i_worker; i++) {
+        httpd_worker_t *w = &host->worker[i];
+        uint_fast64_t max = atomic_exchange(&w->loop_max, 0);
 
-                        switch(query->i_proto) {
-                        case HTTPD_PROTO_HTTP:
-                            answer->i_version = 1;
-                            httpd_MsgAdd(answer, "Allow", "GET,HEAD,POST,OPTIONS");
-                            break;
+        clients += atomic_load(&w->active);
+        loops += atomic_exchange(&w->loops, 0);
+        loop_time += atomic_exchange(&w->loop_time, 0);
+        if (max > loop_max)
+            loop_max = max;
+    }
 
-                        case HTTPD_PROTO_RTSP:
-                            answer->i_version = 0;
+    uint64_t accepts = host->i_accept - host->i_accept_last;
 
-                            const char *p = httpd_MsgGet(query, "Cseq");
-                            if (p)
-                                httpd_MsgAdd(answer, "Cseq", "%s", p);
-                            p = httpd_MsgGet(query, "Timestamp");
-                            if (p)
-                                httpd_MsgAdd(answer, "Timestamp", "%s", p);
+    if (clients > 0 || accepts > 0)
+        msg_Dbg(host, "%u client(s), %.1f connection(s)/s, loop latency "
+                "%"PRIuFAST64" us average, %"PRIuFAST64" us max", clients,
+                (double)accepts * CLOCK_FREQ / (now - host->i_report_date),
+                loops ? loop_time / loops : 0, loop_max);
 
-                            p = httpd_MsgGet(query, "Require");
-                            if (p) {
-                                answer->i_status = 551;
-                                httpd_MsgAdd(query, "Unsupported", "%s", p);
-                            }
+    host->i_accept_last = host->i_accept;
+    host->i_report_date = now;
+}
 
-                            httpd_MsgAdd(answer, "Public", "DESCRIBE,SETUP,"
-                                    "TEARDOWN,PLAY,PAUSE,GET_PARAMETER");
-                            break;
-                        }
+static void httpdLoop(httpd_worker_t *worker)
+{
+    httpd_host_t *host = worker->host;
 
-                        cl->i_buffer = -1;  /* Force the creation of the answer in
-                                             * httpd_ClientSend */
-                        cl->i_state = HTTPD_CLIENT_SENDING;
-                        break;
+    vlc_mutex_lock(&host->lock);
+    while (host->i_url <= 0) {
+        mutex_cleanup_push(&host->lock);
+        vlc_cond_wait(&host->wait, &host->lock);
+        vlc_cleanup_pop();
+    }
+    vlc_mutex_unlock(&host->lock);
 
-                    case HTTPD_MSG_NONE:
-                        if (query->i_proto == HTTPD_PROTO_NONE) {
-                            cl->url = NULL;
-                            cl->i_state = HTTPD_CLIENT_DEAD;
-                        } else {
-                            /* unimplemented */
-                            answer->i_proto  = query->i_proto ;
-                            answer->i_type   = HTTPD_MSG_ANSWER;
-                            answer->i_version= 0;
-                            answer->i_status = 501;
-
-                            char *p;
-                            answer->i_body = httpd_HtmlError (&p, 501, NULL);
-                            answer->p_body = (uint8_t *)p;
-                            httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
-
-                            cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
-                            cl->i_state = HTTPD_CLIENT_SENDING;
-                        }
-                        break;
+    int canc = vlc_savecancel();
+    vlc_mutex_lock(&worker->lock);
 
-                    default: {
-                        int i_msg = query->i_type;
-                        bool b_auth_failed = false;
-
-                        /* Search the url and trigger callbacks */
-                        for (int i = 0; i < host->i_url; i++) {
-                            httpd_url_t *url = host->url[i];
-
-                            if (strcmp(url->psz_url, query->psz_url))
-                                continue;
-                            if (!url->catch[i_msg].cb)
-                                continue;
-
-                            if (answer) {
-                                b_auth_failed = !httpdAuthOk(url->psz_user,
-                                   url->psz_password,
-                                   httpd_MsgGet(query, "Authorization")); /* BASIC id */
-                                if (b_auth_failed)
-                                   break;
-                            }
-
-                            if (url->catch[i_msg].cb(url->catch[i_msg].p_sys, cl, answer, query))
-                                continue;
-
-                            if (answer->i_proto == HTTPD_PROTO_NONE)
-                                cl->i_buffer = cl->i_buffer_size; /* Raw answer from a CGI */
-                            else
-                                cl->i_buffer = -1;
-
-                            /* only one url can answer */
-                            answer = NULL;
-                            if (!cl->url)
-                                cl->url = url;
-                        }
+    int timeout = httpd_WorkerProcess(worker);
+    httpd_WorkerMetrics(worker);
 
-                        if (answer) {
-                            answer->i_proto  = query->i_proto;
-                            answer->i_type   = HTTPD_MSG_ANSWER;
-                            answer->i_version= 0;
-
-                           if (b_auth_failed) {
-                                httpd_MsgAdd(answer, "WWW-Authenticate",
-                                        "Basic realm=\"VLC stream\"");
-                                answer->i_status = 401;
-                            } else
-                                answer->i_status = 404; /* no url registered */
-
-                            char *p;
-                            answer->i_body = httpd_HtmlError (&p, answer->i_status,
-                                    query->psz_url);
-                            answer->p_body = (uint8_t *)p;
-
-                            cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
-                            httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
-                            httpd_MsgAdd(answer, "Content-Type", "%s", "text/html");
-                        }
+#ifdef HAVE_SYS_EPOLL_H
+    vlc_mutex_unlock(&worker->lock);
+    vlc_restorecancel(canc);
 
-                        cl->i_state = HTTPD_CLIENT_SENDING;
-                    }
-                }
-                break;
-            }
+    struct epoll_event ev[HTTPD_MAX_EVENTS];
+    int ret = epoll_wait(worker->epfd, ev, HTTPD_MAX_EVENTS, timeout);
 
-            case HTTPD_CLIENT_SEND_DONE:
-                if (!cl->b_stream_mode || cl->answer.i_body_offset == 0) {
-                    const char *psz_connection = httpd_MsgGet(&cl->answer, "Connection");
-                    const char *psz_query = httpd_MsgGet(&cl->query, "Connection");
-                    bool b_connection = false;
-                    bool b_keepalive = false;
-                    bool b_query = false;
-
-                    cl->url = NULL;
-                    if (psz_connection) {
-                        b_connection = (strcasecmp(psz_connection, "Close") == 0);
-                        b_keepalive = (strcasecmp(psz_connection, "Keep-Alive") == 0);
-                    }
+    canc = vlc_savecancel();
+    vlc_mutex_lock(&worker->lock);
+#else
+    /* Only one worker without epoll: no other thread adds or removes any
+     * client of this worker while it is waiting. */
+    unsigned nfd = (worker == host->worker) ? host->nfd : 0;
+    struct pollfd ufd[nfd + worker->i_client + 1];
+
+    for (unsigned i = 0; i < nfd; i++) {
+        ufd[i].fd = host->fds[i];
+        ufd[i].events = POLLIN;
+        ufd[i].revents = 0;
+    }
 
-                    if (psz_query)
-                        b_query = (strcasecmp(psz_query, "Close") == 0);
-
-                    if (((cl->query.i_proto == HTTPD_PROTO_HTTP) &&
-                                ((cl->query.i_version == 0 && b_keepalive) ||
-                                  (cl->query.i_version == 1 && !b_connection))) ||
-                            ((cl->query.i_proto == HTTPD_PROTO_RTSP) &&
-                              !b_query && !b_connection)) {
-                        httpd_MsgClean(&cl->query);
-                        httpd_MsgInit(&cl->query);
-
-                        cl->i_buffer = 0;
-                        cl->i_buffer_size = 1000;
-                        free(cl->p_buffer);
-                        cl->p_buffer = xmalloc(cl->i_buffer_size);
-                        cl->i_state = HTTPD_CLIENT_RECEIVING;
-                    } else
-                        cl->i_state = HTTPD_CLIENT_DEAD;
-                    httpd_MsgClean(&cl->answer);
-                } else {
-                    i_offset = cl->answer.i_body_offset;
-                    httpd_MsgClean(&cl->answer);
+    for (int i = 0; i < worker->i_client; i++) {
+        httpd_client_t *cl = worker->client[i];
+        struct pollfd *pufd = &ufd[nfd + i];
 
-                    cl->answer.i_body_offset = i_offset;
-                    free(cl->p_buffer);
-                    cl->p_buffer = NULL;
-                    cl->i_buffer = 0;
-                    cl->i_buffer_size = 0;
+        pufd->fd = cl->fd;
+        pufd->events = pufd->revents = 0;
 
-                    cl->i_state = HTTPD_CLIENT_WAITING;
-                }
+        switch (cl->i_state) {
+            case HTTPD_CLIENT_RECEIVING:
+            case HTTPD_CLIENT_TLS_HS_IN:
+                pufd->events = POLLIN;
                 break;
 
-            case HTTPD_CLIENT_WAITING:
-                i_offset = cl->answer.i_body_offset;
-                int i_msg = cl->query.i_type;
-
-                httpd_MsgInit(&cl->answer);
-                cl->answer.i_body_offset = i_offset;
-
-                cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
-                        &cl->answer, &cl->query);
-                if (cl->answer.i_type != HTTPD_MSG_NONE) {
-                    /* we have new data, so re-enter send mode */
-                    cl->i_buffer      = 0;
-                    cl->p_buffer      = cl->answer.p_body;
-                    cl->i_buffer_size = cl->answer.i_body;
-                    cl->answer.p_body = NULL;
-                    cl->answer.i_body = 0;
-                    cl->i_state = HTTPD_CLIENT_SENDING;
-                }
+            case HTTPD_CLIENT_SENDING:
+            case HTTPD_CLIENT_TLS_HS_OUT:
+                pufd->events = POLLOUT;
+                break;
         }
-
-        if (pufd->events != 0)
-            nfd++;
-        else
-            b_low_delay = true;
     }
-    vlc_mutex_unlock(&host->lock);
+    vlc_mutex_unlock(&worker->lock);
     vlc_restorecancel(canc);
 
-    /* we will wait 20ms (not too big) if HTTPD_CLIENT_WAITING */
-    int ret = poll(ufd, nfd, b_low_delay ? 20 : -1);
+    int ret = poll(ufd, nfd + worker->i_client, timeout);
 
     canc = vlc_savecancel();
-    vlc_mutex_lock(&host->lock);
+    vlc_mutex_lock(&worker->lock);
+#endif
+    mtime_t now = mdate();
+    worker->wake = now;
+
     switch(ret) {
         case -1:
             if (errno != EINTR) {
@@ -1986,86 +2433,127 @@ static void httpdLoop(httpd_host_t *host)
                 msg_Err(host, "polling error: %s", vlc_strerror_c(errno));
                 msleep(100000);
             }
-        case 0:
-            vlc_restorecancel(canc);
-            return;
-    }
-
-    /* Handle client sockets */
-    now = mdate();
-    nfd = host->nfd;
-
-    for (int i_client = 0; i_client < host->i_client; i_client++) {
-        httpd_client_t *cl = host->client[i_client];
-        const struct pollfd *pufd = &ufd[nfd];
+            break;
 
-        assert(pufd < &ufd[sizeof(ufd) / sizeof(ufd[0])]);
+#ifdef HAVE_SYS_EPOLL_H
+        default:
+            for (int i = 0; i < ret; i++) {
+                if (ev[i].data.ptr == host) {
+                    /* Handle server sockets (accept new connections) */
+                    for (unsigned j = 0; j < host->nfd; j++)
+                        httpd_WorkerAccept(worker, host->fds[j], now);
+                    continue;
+                }
 
-        if (cl->fd != pufd->fd)
-            continue; // we were not waiting for this client
-        ++nfd;
-        if (pufd->revents == 0)
-            continue; // no event received
+                httpd_client_t *cl = ev[i].data.ptr;
 
-        cl->i_activity_date = now;
+                if (ev[i].events & (EPOLLIN|EPOLLRDHUP|EPOLLHUP|EPOLLERR))
+                    cl->b_readable = true;
+                if (ev[i].events & (EPOLLOUT|EPOLLHUP|EPOLLERR))
+                    cl->b_writable = true;
+                cl->i_activity_date = now;
+            }
+            break;
+#else
+        default:
+            /* Handle client sockets (level-triggered) */
+            for (int i = 0; i < worker->i_client; i++) {
+                httpd_client_t *cl = worker->client[i];
+                short revents = ufd[nfd + i].revents;
+
+                assert(cl->fd == ufd[nfd + i].fd);
+                cl->b_readable = (revents & (POLLIN|POLLHUP|POLLERR)) != 0;
+                cl->b_writable = (revents & (POLLOUT|POLLHUP|POLLERR)) != 0;
+                if (revents != 0)
+                    cl->i_activity_date = now;
+            }
 
-        switch (cl->i_state) {
-            case HTTPD_CLIENT_RECEIVING: httpd_ClientRecv(cl); break;
-            case HTTPD_CLIENT_SENDING:   httpd_ClientSend(cl); break;
-            case HTTPD_CLIENT_TLS_HS_IN:
-            case HTTPD_CLIENT_TLS_HS_OUT:
-                httpd_ClientTlsHandshake(host, cl);
-                break;
-        }
+            /* Handle server sockets (accept new connections) */
+            for (unsigned i = 0; i < nfd; i++)
+                if (ufd[i].revents != 0)
+                    httpd_WorkerAccept(worker, ufd[i].fd, now);
+            break;
+#endif
     }
 
-    /* Handle server sockets (accept new connections) */
-    for (nfd = 0; nfd < host->nfd; nfd++) {
-        httpd_client_t *cl;
-        int fd = ufd[nfd].fd;
-
-        assert (fd == host->fds[nfd]);
-
-        if (ufd[nfd].revents == 0)
-            continue;
-
-        /* */
-        fd = vlc_accept (fd, NULL, NULL, true);
-        if (fd == -1)
-            continue;
-        setsockopt (fd, SOL_SOCKET, SO_REUSEADDR,
-                &(int){ 1 }, sizeof(int));
+    vlc_mutex_unlock(&worker->lock);
+    vlc_restorecancel(canc);
+}
 
-        vlc_tls_t *p_tls;
+static void* httpd_WorkerThread(void *data)
+{
+    httpd_worker_t *worker = data;
 
-        if (host->p_tls != NULL)
-        {
-            const char *alpn[] = { "http/1.1", NULL };
+    for (;;)
+        httpdLoop(worker);
+    vlc_assert_unreachable();
+}
 
-            p_tls = vlc_tls_ServerSessionCreate(host->p_tls, fd, alpn);
+static int httpd_WorkerStart(httpd_host_t *host, httpd_worker_t *worker)
+{
+    worker->host = host;
+    worker->i_client = 0;
+    worker->client = NULL;
+    worker->wake = mdate();
+    atomic_init(&worker->active, 0);
+    atomic_init(&worker->loops, 0);
+    atomic_init(&worker->loop_time, 0);
+    atomic_init(&worker->loop_max, 0);
+
+#ifdef HAVE_SYS_EPOLL_H
+    worker->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (worker->epfd == -1)
+        return -1;
+
+    /* Only the first worker accepts connections */
+    for (unsigned i = 0; worker == host->worker && i < host->nfd; i++) {
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = host };
+
+        if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, host->fds[i], &ev)) {
+            close(worker->epfd);
+            return -1;
         }
-        else
-            p_tls = NULL;
-
-        cl = httpd_ClientNew(fd, p_tls, now);
-
-        TAB_APPEND(host->i_client, host->client, cl);
     }
+#endif
+    vlc_mutex_init(&worker->lock);
 
-    vlc_restorecancel(canc);
+    if (vlc_clone(&worker->thread, httpd_WorkerThread, worker,
+                   VLC_THREAD_PRIORITY_LOW)) {
+        vlc_mutex_destroy(&worker->lock);
+#ifdef HAVE_SYS_EPOLL_H
+        close(worker->epfd);
+#endif
+        return -1;
+    }
+    return 0;
 }
 
-static void* httpd_HostThread(void *data)
+static void httpd_WorkersStop(httpd_host_t *host)
 {
-    httpd_host_t *host = data;
+    for (unsigned i = 0; i < host->i_worker; i++)
+        vlc_cancel(host->worker[i].thread);
 
-    vlc_mutex_lock(&host->lock);
-    while (host->i_ref > 0)
-        httpdLoop(host);
-    vlc_mutex_unlock(&host->lock);
-    return NULL;
+    for (unsigned i = 0; i < host->i_worker; i++) {
+        httpd_worker_t *worker = &host->worker[i];
+
+        vlc_join(worker->thread, NULL);
+
+        for (int j = 0; j < worker->i_client; j++) {
+            msg_Warn(host, "client still connected");
+            httpd_ClientDestroy(worker->client[j]);
+        }
+        TAB_CLEAN(worker->i_client, worker->client);
+#ifdef HAVE_SYS_EPOLL_H
+        close(worker->epfd);
+#endif
+        vlc_mutex_destroy(&worker->lock);
+    }
+    free(host->worker);
+    host->worker = NULL;
+    host->i_worker = 0;
 }
 
+
 int httpd_StreamSetHTTPHeaders(httpd_stream_t * p_stream, httpd_header * p_headers, size_t i_headers)
 {
     if (!p_stream)
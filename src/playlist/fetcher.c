@@ -35,6 +35,7 @@
 #include <vlc_demux.h>
 #include <vlc_modules.h>
 #include <vlc_interrupt.h>
+#include <vlc_executor.h>
 
 #include "libvlc.h"
 #include "art.h"
@@ -73,6 +74,7 @@ struct fetcher_entry_t
 struct playlist_fetcher_t
 {
     vlc_object_t   *object;
+    vlc_executor_t *executor;
     vlc_mutex_t     lock;
     vlc_cond_t      wait;
     bool            b_live;
@@ -85,7 +87,7 @@ struct playlist_fetcher_t
     meta_fetcher_scope_t e_scope;
 };
 
-static void *Thread( void * );
+static void Thread( void * );
 
 
 /*****************************************************************************
@@ -104,6 +106,7 @@ playlist_fetcher_t *playlist_fetcher_New( vlc_object_t *parent )
         return NULL;
     }
     p_fetcher->object = parent;
+    p_fetcher->executor = libvlc_priv( parent->obj.libvlc )->executor;
     vlc_mutex_init( &p_fetcher->lock );
     vlc_cond_init( &p_fetcher->wait );
     p_fetcher->b_live = false;
@@ -142,10 +145,10 @@ void playlist_fetcher_Push( playlist_fetcher_t *p_fetcher, input_item_t *p_item,
     if( !p_fetcher->b_live )
     {
         assert( p_fetcher->p_waiting_head[PASS1_LOCAL] );
-        if( vlc_clone_detach( NULL, Thread, p_fetcher,
-                              VLC_THREAD_PRIORITY_LOW ) )
+        if( vlc_executor_Submit( p_fetcher->executor, Thread, p_fetcher,
+                                 VLC_EXECUTOR_PRIORITY_LOW, NULL ) )
             msg_Err( p_fetcher->object,
-                     "cannot spawn secondary preparse thread" );
+                     "cannot submit secondary preparse task" );
         else
             p_fetcher->b_live = true;
     }
@@ -444,13 +447,15 @@ static void FetchMeta( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
     vlc_object_release( p_finder );
 }
 
-static void *Thread( void *p_data )
+static void Thread( void *p_data )
 {
     playlist_fetcher_t *p_fetcher = p_data;
     vlc_object_t *obj = p_fetcher->object;
     fetcher_pass_t e_pass = PASS1_LOCAL;
 
-    vlc_interrupt_set(p_fetcher->interrupt);
+    /* Use the fetcher context, so that playlist_fetcher_Delete() can
+     * interrupt the task */
+    vlc_interrupt_t *ctx = vlc_interrupt_set(p_fetcher->interrupt);
 
     for( ;; )
     {
@@ -476,7 +481,7 @@ static void *Thread( void *p_data )
         }
         else
         {
-            vlc_interrupt_set( NULL );
+            vlc_interrupt_set( ctx );
             p_fetcher->b_live = false;
             vlc_cond_signal( &p_fetcher->wait );
         }
@@ -571,5 +576,4 @@ static void *Thread( void *p_data )
             free( p_entry );
         }
     }
-    return NULL;
 }
@@ -28,10 +28,12 @@
 #include <assert.h>
 
 #include <vlc_common.h>
+#include <vlc_executor.h>
 
 #include "fetcher.h"
 #include "preparser.h"
 #include "input/input_interface.h"
+#include "libvlc.h"
 
 /*****************************************************************************
  * Structures/definitions
@@ -49,6 +51,7 @@ struct preparser_entry_t
 struct playlist_preparser_t
 {
     vlc_object_t        *object;
+    vlc_executor_t      *executor;
     playlist_fetcher_t  *p_fetcher;
     mtime_t              default_timeout;
 
@@ -67,7 +70,7 @@ struct playlist_preparser_t
     size_t          i_waiting;
 };
 
-static void *Thread( void * );
+static void Thread( void * );
 
 /*****************************************************************************
  * Public functions
@@ -81,6 +84,7 @@ playlist_preparser_t *playlist_preparser_New( vlc_object_t *parent )
     p_preparser->input_id = NULL;
     p_preparser->input_state = INPUT_RUNNING;
     p_preparser->object = parent;
+    p_preparser->executor = libvlc_priv( parent->obj.libvlc )->executor;
     p_preparser->default_timeout = var_InheritInteger( parent, "preparse-timeout" );
     p_preparser->p_fetcher = playlist_fetcher_New( parent );
     if( unlikely(p_preparser->p_fetcher == NULL) )
@@ -115,9 +119,9 @@ void playlist_preparser_Push( playlist_preparser_t *p_preparser, input_item_t *p
                  p_preparser->i_waiting, p_entry );
     if( !p_preparser->b_live )
     {
-        if( vlc_clone_detach( NULL, Thread, p_preparser,
-                              VLC_THREAD_PRIORITY_LOW ) )
-            msg_Warn( p_preparser->object, "cannot spawn pre-parser thread" );
+        if( vlc_executor_Submit( p_preparser->executor, Thread, p_preparser,
+                                 VLC_EXECUTOR_PRIORITY_NORMAL, NULL ) )
+            msg_Warn( p_preparser->object, "cannot submit pre-parser task" );
         else
             p_preparser->b_live = true;
     }
@@ -332,7 +336,7 @@ static void Art( playlist_preparser_t *p_preparser, input_item_t *p_item )
 /**
  * This function does the preparsing and issues the art fetching requests
  */
-static void *Thread( void *data )
+static void Thread( void *data )
 {
     playlist_preparser_t *p_preparser = data;
 
@@ -366,6 +370,5 @@ static void *Thread( void *data )
         vlc_gc_decref( p_entry->p_item );
         free( p_entry );
     }
-    return NULL;
 }
 
@@ -22,6 +22,7 @@
 # include "config.h"
 #endif
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <assert.h>
@@ -35,36 +36,180 @@
  * they typically require one thread per timer plus one thread per iteration,
  * which is inefficient and overkill (unless you need multiple iteration
  * of the same timer concurrently).
- * Thus, this is a generic manual implementation of timers using a thread.
+ * Thus, this is a generic manual implementation of timers. All the timers of
+ * the process share a heap ordered by deadline, and a small pool of threads.
+ * One thread (the leader) waits for the earliest deadline, while the others
+ * run callbacks or wait to become the leader. The pool grows whenever timers
+ * fire late because all the other threads were busy running callbacks.
  */
 
+#define TIMER_THREADS_MIN 2
+#define TIMER_THREADS_MAX 16
+/* lateness beyond which the pool is grown */
+#define TIMER_LATE (CLOCK_FREQ / 100)
+
 struct vlc_timer
 {
-    vlc_thread_t thread;
-    vlc_cond_t   reschedule;
-    vlc_mutex_t  lock;
     void       (*func) (void *);
     void        *data;
     mtime_t      value, interval;
+    size_t       index; /* position in the heap, SIZE_MAX if not queued */
+    bool         running;
     atomic_uint  overruns;
 };
 
-VLC_NORETURN
-static void *vlc_timer_thread (void *data)
+static struct
 {
-    struct vlc_timer *timer = data;
+    vlc_mutex_t  lock;
+    vlc_cond_t   reschedule; /* the earliest deadline changed */
+    vlc_cond_t   followers; /* the leader role is free */
+    vlc_cond_t   idle; /* a callback returned */
+    struct vlc_timer **heap;
+    size_t       count;
+    size_t       size;
+    size_t       timers;
+    vlc_thread_t threads[TIMER_THREADS_MAX];
+    unsigned     nthreads;
+    unsigned     nfollowers;
+    bool         leader;
+    bool         quit;
+    bool         init; /* the condition variables are initialized */
+} pool = {
+    .lock = VLC_STATIC_MUTEX,
+};
 
-    vlc_mutex_lock (&timer->lock);
-    mutex_cleanup_push (&timer->lock);
+/* Serializes starting and stopping the pool */
+static vlc_mutex_t setup_lock = VLC_STATIC_MUTEX;
+
+static void vlc_timer_heap_set(size_t i, struct vlc_timer *timer)
+{
+    pool.heap[i] = timer;
+    timer->index = i;
+}
+
+static void vlc_timer_heap_up(size_t i)
+{
+    struct vlc_timer *timer = pool.heap[i];
+
+    while (i > 0)
+    {
+        size_t parent = (i - 1) / 2;
+
+        if (pool.heap[parent]->value <= timer->value)
+            break;
+        vlc_timer_heap_set(i, pool.heap[parent]);
+        i = parent;
+    }
+    vlc_timer_heap_set(i, timer);
+}
+
+static void vlc_timer_heap_down(size_t i)
+{
+    struct vlc_timer *timer = pool.heap[i];
 
     for (;;)
     {
-        while (timer->value == 0)
+        size_t child = 2 * i + 1;
+
+        if (child >= pool.count)
+            break;
+        if (child + 1 < pool.count
+         && pool.heap[child + 1]->value < pool.heap[child]->value)
+            child++;
+        if (timer->value <= pool.heap[child]->value)
+            break;
+        vlc_timer_heap_set(i, pool.heap[child]);
+        i = child;
+    }
+    vlc_timer_heap_set(i, timer);
+}
+
+static void vlc_timer_enqueue(struct vlc_timer *timer)
+{
+    assert(timer->index == SIZE_MAX);
+    assert(pool.count < pool.size);
+
+    vlc_timer_heap_set(pool.count++, timer);
+    vlc_timer_heap_up(timer->index);
+
+    if (timer->index == 0) /* new earliest deadline */
+        vlc_cond_signal(&pool.reschedule);
+}
+
+static void vlc_timer_dequeue(struct vlc_timer *timer)
+{
+    size_t i = timer->index;
+
+    assert(i < pool.count && pool.heap[i] == timer);
+    timer->index = SIZE_MAX;
+
+    if (i == 0) /* the leader may be waiting for this deadline */
+        vlc_cond_signal(&pool.reschedule);
+    if (i == --pool.count)
+        return;
+
+    vlc_timer_heap_set(i, pool.heap[pool.count]);
+    vlc_timer_heap_up(i);
+    vlc_timer_heap_down(pool.heap[i]->index);
+}
+
+static void *vlc_timer_thread(void *data);
+
+/* Adds a thread to the pool, the pool lock must be held */
+static int vlc_timer_spawn(void)
+{
+    if (pool.nthreads >= TIMER_THREADS_MAX)
+        return ENOMEM;
+    if (vlc_clone(&pool.threads[pool.nthreads], vlc_timer_thread, NULL,
+                  VLC_THREAD_PRIORITY_INPUT))
+        return ENOMEM;
+    pool.nthreads++;
+    return 0;
+}
+
+static void *vlc_timer_thread (void *data)
+{
+    vlc_mutex_lock (&pool.lock);
+
+    while (!pool.quit)
+    {
+        if (pool.leader)
         {
-            assert(timer->interval == 0);
-            vlc_cond_wait (&timer->reschedule, &timer->lock);
+            pool.nfollowers++;
+            vlc_cond_wait(&pool.followers, &pool.lock);
+            pool.nfollowers--;
+            continue;
         }
 
+        /* Wait for the earliest deadline */
+        struct vlc_timer *timer = NULL;
+
+        pool.leader = true;
+        while (!pool.quit)
+        {
+            if (pool.count == 0)
+            {
+                vlc_cond_wait(&pool.reschedule, &pool.lock);
+                continue;
+            }
+
+            timer = pool.heap[0];
+            if (vlc_cond_timedwait(&pool.reschedule, &pool.lock,
+                                   timer->value) != 0)
+                break;
+            timer = NULL;
+        }
+        pool.leader = false;
+        vlc_cond_signal(&pool.followers);
+
+        if (timer == NULL || pool.count == 0 || timer != pool.heap[0]
+         || mdate() < timer->value)
+            continue; /* quitting, or the deadline changed in the mean time */
+
+        vlc_timer_dequeue(timer);
+
+        mtime_t value = timer->value;
+
         if (timer->interval != 0)
         {
             mtime_t now = mdate();
@@ -80,30 +225,54 @@ static void *vlc_timer_thread (void *data)
             }
         }
 
-        mtime_t value = timer->value;
-
-        if (vlc_cond_timedwait(&timer->reschedule, &timer->lock, value) == 0)
-            continue;
-
-        if (likely(timer->value <= value))
-        {
-            timer->value += timer->interval; /* rearm */
+        timer->value += timer->interval; /* rearm */
+        if (timer->interval == 0)
+            timer->value = 0; /* disarm */
 
-            if (timer->interval == 0)
-                timer->value = 0; /* disarm */
-        }
+        /* Grow the pool if the callbacks of other timers delayed this one */
+        if (pool.nfollowers == 0 && mdate() - value > TIMER_LATE)
+            vlc_timer_spawn();
 
-        vlc_mutex_unlock (&timer->lock);
+        timer->running = true;
+        vlc_mutex_unlock (&pool.lock);
 
-        int canc = vlc_savecancel ();
         timer->func (timer->data);
-        vlc_restorecancel (canc);
 
-        vlc_mutex_lock (&timer->lock);
+        vlc_mutex_lock (&pool.lock);
+        timer->running = false;
+        if (timer->value != 0)
+            vlc_timer_enqueue(timer);
+        vlc_cond_broadcast(&pool.idle);
     }
 
-    vlc_cleanup_pop ();
-    vlc_assert_unreachable ();
+    vlc_mutex_unlock (&pool.lock);
+    (void) data;
+    return NULL;
+}
+
+static void vlc_timer_stop(void)
+{
+    unsigned nthreads;
+
+    vlc_mutex_lock(&pool.lock);
+    pool.quit = true;
+    vlc_cond_broadcast(&pool.reschedule);
+    vlc_cond_broadcast(&pool.followers);
+    nthreads = pool.nthreads;
+    vlc_mutex_unlock(&pool.lock);
+
+    /* No threads are added once quitting */
+    for (unsigned i = 0; i < nthreads; i++)
+        vlc_join(pool.threads[i], NULL);
+
+    vlc_mutex_lock(&pool.lock);
+    assert(pool.count == 0);
+    pool.nthreads = 0;
+    pool.quit = false;
+    free(pool.heap);
+    pool.heap = NULL;
+    pool.size = 0;
+    vlc_mutex_unlock(&pool.lock);
 }
 
 int vlc_timer_create (vlc_timer_t *id, void (*func) (void *), void *data)
@@ -112,34 +281,87 @@ int vlc_timer_create (vlc_timer_t *id, void (*func) (void *), void *data)
 
     if (unlikely(timer == NULL))
         return ENOMEM;
-    vlc_mutex_init (&timer->lock);
-    vlc_cond_init (&timer->reschedule);
     assert (func);
     timer->func = func;
     timer->data = data;
     timer->value = 0;
     timer->interval = 0;
+    timer->index = SIZE_MAX;
+    timer->running = false;
     atomic_init(&timer->overruns, 0);
 
-    if (vlc_clone (&timer->thread, vlc_timer_thread, timer,
-                   VLC_THREAD_PRIORITY_INPUT))
+    vlc_mutex_lock(&setup_lock);
+    vlc_mutex_lock(&pool.lock);
+
+    /* Statically initialized condition variables may not use the mdate()
+     * clock for timed waits */
+    if (!pool.init)
     {
-        vlc_cond_destroy (&timer->reschedule);
-        vlc_mutex_destroy (&timer->lock);
-        free (timer);
-        return ENOMEM;
+        vlc_cond_init(&pool.reschedule);
+        vlc_cond_init(&pool.followers);
+        vlc_cond_init(&pool.idle);
+        pool.init = true;
     }
 
+    /* Make room in the heap for all timers, so that scheduling never fails */
+    if (pool.timers >= pool.size)
+    {
+        size_t size = pool.size ? 2 * pool.size : 16;
+        struct vlc_timer **heap = realloc(pool.heap, size * sizeof (*heap));
+
+        if (unlikely(heap == NULL))
+            goto error;
+        pool.heap = heap;
+        pool.size = size;
+    }
+
+    while (pool.nthreads < TIMER_THREADS_MIN)
+        if (vlc_timer_spawn())
+            goto error;
+
+    pool.timers++;
+    vlc_mutex_unlock(&pool.lock);
+    vlc_mutex_unlock(&setup_lock);
+
     *id = timer;
     return 0;
+
+error:
+    if (pool.timers == 0 && pool.nthreads > 0)
+    {
+        vlc_mutex_unlock(&pool.lock);
+        vlc_timer_stop();
+    }
+    else
+        vlc_mutex_unlock(&pool.lock);
+    vlc_mutex_unlock(&setup_lock);
+    free (timer);
+    return ENOMEM;
 }
 
 void vlc_timer_destroy (vlc_timer_t timer)
 {
-    vlc_cancel (timer->thread);
-    vlc_join (timer->thread, NULL);
-    vlc_cond_destroy (&timer->reschedule);
-    vlc_mutex_destroy (&timer->lock);
+    vlc_mutex_lock(&pool.lock);
+
+    /* Disarm, and wait for any ongoing iteration. The setup lock is not held
+     * here, as the callback may create or destroy other timers. */
+    timer->value = 0;
+    timer->interval = 0;
+    if (timer->index != SIZE_MAX)
+        vlc_timer_dequeue(timer);
+    while (timer->running)
+        vlc_cond_wait(&pool.idle, &pool.lock);
+    vlc_mutex_unlock(&pool.lock);
+
+    /* No callbacks are running if this is the last timer */
+    vlc_mutex_lock(&setup_lock);
+    vlc_mutex_lock(&pool.lock);
+    bool last = --pool.timers == 0;
+    vlc_mutex_unlock(&pool.lock);
+
+    if (last)
+        vlc_timer_stop();
+    vlc_mutex_unlock(&setup_lock);
     free (timer);
 }
 
@@ -152,11 +374,15 @@ void vlc_timer_schedule (vlc_timer_t timer, bool absolute,
     if (!absolute)
         value += mdate();
 
-    vlc_mutex_lock (&timer->lock);
+    vlc_mutex_lock (&pool.lock);
+    if (timer->index != SIZE_MAX)
+        vlc_timer_dequeue(timer);
     timer->value = value;
     timer->interval = interval;
-    vlc_cond_signal (&timer->reschedule);
-    vlc_mutex_unlock (&timer->lock);
+    /* A running timer is queued again once its callback returns */
+    if (value != 0 && !timer->running)
+        vlc_timer_enqueue(timer);
+    vlc_mutex_unlock (&pool.lock);
 }
 
 unsigned vlc_timer_getoverrun (vlc_timer_t timer)
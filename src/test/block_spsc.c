@@ -0,0 +1,166 @@
+/*****************************************************************************
+ * block_spsc.c: Test for single-producer single-consumer block queues
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <unistd.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+
+#define BLOCKS 100000
+
+static block_t *block_Seq(unsigned seq)
+{
+    block_t *block = block_Alloc(1 + (seq % 7));
+    assert(block != NULL);
+    block->i_dts = seq;
+    return block;
+}
+
+static void test_spsc_simple(void)
+{
+    block_spsc_t *q = block_SpscNew();
+    assert(q != NULL);
+    assert(vlc_spsc_IsEmpty(q));
+    assert(vlc_spsc_Dequeue(q) == NULL);
+
+    /* Chains are split and keep their order */
+    block_t *chain = NULL, **pp = &chain;
+    for (unsigned i = 0; i < 3; i++)
+        block_ChainLastAppend(&pp, block_Seq(i));
+    block_SpscPut(q, chain);
+    block_SpscPut(q, block_Seq(3));
+    assert(vlc_spsc_GetCount(q) == 4);
+    assert(vlc_spsc_GetBytes(q) == 1 + 2 + 3 + 4);
+
+    for (unsigned i = 0; i < 2; i++)
+    {
+        block_t *block = vlc_spsc_Dequeue(q);
+        assert(block != NULL && block->i_dts == i && block->p_next == NULL);
+        block_Release(block);
+    }
+    assert(vlc_spsc_GetCount(q) == 2);
+
+    /* Flushed blocks are not counted, nor dequeued */
+    vlc_spsc_Flush(q);
+    assert(vlc_spsc_IsEmpty(q));
+    assert(vlc_spsc_GetBytes(q) == 0);
+    block_SpscPut(q, block_Seq(4));
+    assert(vlc_spsc_GetCount(q) == 1);
+
+    block_t *block = block_SpscGet(q);
+    assert(block->i_dts == 4);
+    block_Release(block);
+    assert(vlc_spsc_Dequeue(q) == NULL);
+    assert(vlc_spsc_IsEmpty(q));
+
+    /* Pending blocks are released with the queue */
+    block_SpscPut(q, block_Seq(5));
+    vlc_spsc_Flush(q);
+    block_SpscPut(q, block_Seq(6));
+    block_SpscRelease(q);
+}
+
+static void test_spsc_empty(void)
+{
+    block_spsc_t *q = block_SpscNew();
+    assert(q != NULL);
+
+    /* Blocks taken by the consumer, and blocks still pushed */
+    for (unsigned i = 0; i < 3; i++)
+        block_SpscPut(q, block_Seq(i));
+    block_Release(vlc_spsc_Dequeue(q));
+    block_SpscPut(q, block_Seq(3));
+    vlc_spsc_Flush(q);
+    block_SpscPut(q, block_Seq(4));
+    assert(vlc_spsc_GetCount(q) == 1);
+
+    vlc_spsc_Lock(q);
+    vlc_spsc_Empty(q);
+    vlc_spsc_Unlock(q);
+    assert(vlc_spsc_IsEmpty(q));
+    assert(vlc_spsc_GetBytes(q) == 0);
+    assert(vlc_spsc_Dequeue(q) == NULL);
+
+    block_SpscPut(q, block_Seq(5));
+    assert(vlc_spsc_GetCount(q) == 1);
+    assert(vlc_spsc_GetBytes(q) == 1 + 5);
+
+    block_t *block = vlc_spsc_Dequeue(q);
+    assert(block != NULL && block->i_dts == 5);
+    block_Release(block);
+    assert(vlc_spsc_IsEmpty(q));
+    block_SpscRelease(q);
+}
+
+static void *consumer(void *data)
+{
+    block_spsc_t *q = data;
+
+    for (unsigned i = 0; i < BLOCKS; i++)
+    {
+        block_t *block;
+
+        if (i & 1)
+            block = block_SpscGet(q);
+        else
+        {   /* Explicit waiting, as the decoder does */
+            vlc_spsc_Lock(q);
+            while ((block = vlc_spsc_Dequeue(q)) == NULL)
+                vlc_spsc_Wait(q);
+            vlc_spsc_Unlock(q);
+        }
+        assert(block->i_dts == i);
+        block_Release(block);
+    }
+    return NULL;
+}
+
+static void test_spsc_threads(void)
+{
+    block_spsc_t *q = block_SpscNew();
+    vlc_thread_t th;
+
+    assert(q != NULL);
+    if (vlc_clone(&th, consumer, q, VLC_THREAD_PRIORITY_LOW))
+        abort();
+
+    for (unsigned i = 0; i < BLOCKS; i++)
+        block_SpscPut(q, block_Seq(i));
+
+    vlc_join(th, NULL);
+    assert(vlc_spsc_IsEmpty(q));
+    block_SpscRelease(q);
+}
+
+int main (void)
+{
+    alarm(10);
+
+    test_spsc_simple();
+    test_spsc_empty();
+    test_spsc_threads();
+    return 0;
+}
@@ -0,0 +1,223 @@
+/*****************************************************************************
+ * executor.c: Test for the task executor API
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vlc_common.h>
+#include <vlc_atomic.h>
+#include <vlc_executor.h>
+#include <vlc_interrupt.h>
+
+static atomic_uint counter;
+static vlc_sem_t started, release;
+
+static void count(void *data)
+{
+    (void) data;
+    atomic_fetch_add(&counter, 1);
+}
+
+/* Occupies an executor thread until released or interrupted */
+static void block(void *data)
+{
+    int *ret = data;
+
+    vlc_sem_post(&started);
+    *ret = vlc_sem_wait_i11e(&release);
+}
+
+static void sleeper(void *data)
+{
+    int *ret = data;
+
+    vlc_sem_post(&started);
+    *ret = vlc_mwait_i11e(mdate() + CLOCK_FREQ * 3600);
+}
+
+static char order[4];
+static atomic_uint order_len;
+
+static void record(void *data)
+{
+    order[atomic_fetch_add(&order_len, 1)] = *(const char *)data;
+}
+
+static void nested(void *data)
+{
+    vlc_executor_t *executor = data;
+
+    for (unsigned i = 0; i < 100; i++)
+        assert(vlc_executor_Submit(executor, count, NULL,
+                                   VLC_EXECUTOR_PRIORITY_NORMAL, NULL) == 0);
+}
+
+static void test_submit(unsigned threads)
+{
+    vlc_executor_t *executor = vlc_executor_New(threads);
+    vlc_executor_task_t *tasks[1000];
+
+    assert(executor != NULL);
+    atomic_store(&counter, 0);
+
+    for (unsigned i = 0; i < 1000; i++)
+        assert(vlc_executor_Submit(executor, count, NULL, i % 3,
+                                   &tasks[i]) == 0);
+    for (unsigned i = 0; i < 1000; i++)
+    {
+        vlc_executor_Wait(tasks[i]);
+        vlc_executor_Release(tasks[i]);
+    }
+    assert(atomic_load(&counter) == 1000);
+
+    /* Tasks submitted by tasks */
+    vlc_executor_task_t *task;
+    atomic_store(&counter, 0);
+    assert(vlc_executor_Submit(executor, nested, executor,
+                               VLC_EXECUTOR_PRIORITY_NORMAL, &task) == 0);
+    vlc_executor_Wait(task);
+    vlc_executor_Release(task);
+    while (atomic_load(&counter) < 100)
+        msleep(CLOCK_FREQ / 100);
+
+    vlc_executor_Delete(executor);
+    assert(atomic_load(&counter) == 100);
+}
+
+static void test_priority(void)
+{
+    vlc_executor_t *executor = vlc_executor_New(1);
+    vlc_executor_task_t *blocker, *tasks[3];
+    static const char names[3] = { 'l', 'n', 'h' };
+    int ret;
+
+    assert(executor != NULL);
+    atomic_store(&order_len, 0);
+
+    assert(vlc_executor_Submit(executor, block, &ret,
+                               VLC_EXECUTOR_PRIORITY_NORMAL, &blocker) == 0);
+    vlc_sem_wait(&started);
+
+    assert(vlc_executor_Submit(executor, record, (void *)&names[0],
+                               VLC_EXECUTOR_PRIORITY_LOW, &tasks[0]) == 0);
+    assert(vlc_executor_Submit(executor, record, (void *)&names[1],
+                               VLC_EXECUTOR_PRIORITY_NORMAL, &tasks[1]) == 0);
+    assert(vlc_executor_Submit(executor, record, (void *)&names[2],
+                               VLC_EXECUTOR_PRIORITY_HIGH, &tasks[2]) == 0);
+    vlc_sem_post(&release);
+
+    vlc_executor_Wait(blocker);
+    vlc_executor_Release(blocker);
+    assert(ret == 0);
+    for (unsigned i = 0; i < 3; i++)
+    {
+        vlc_executor_Wait(tasks[i]);
+        vlc_executor_Release(tasks[i]);
+    }
+    assert(atomic_load(&order_len) == 3);
+    assert(!memcmp(order, "hnl", 3));
+
+    vlc_executor_Delete(executor);
+}
+
+static void test_cancel(void)
+{
+    vlc_executor_t *executor = vlc_executor_New(1);
+    vlc_executor_task_t *running, *queued;
+    int ret;
+
+    assert(executor != NULL);
+    atomic_store(&counter, 0);
+
+    /* Pending task */
+    assert(vlc_executor_Submit(executor, block, &ret,
+                               VLC_EXECUTOR_PRIORITY_NORMAL, &running) == 0);
+    vlc_sem_wait(&started);
+    assert(vlc_executor_Submit(executor, count, NULL,
+                               VLC_EXECUTOR_PRIORITY_NORMAL, &queued) == 0);
+    assert(vlc_executor_Cancel(queued));
+    vlc_executor_Wait(queued);
+    vlc_executor_Release(queued);
+
+    vlc_sem_post(&release);
+    vlc_executor_Wait(running);
+    vlc_executor_Release(running);
+    assert(ret == 0);
+    assert(atomic_load(&counter) == 0);
+
+    /* Running task */
+    assert(vlc_executor_Submit(executor, sleeper, &ret,
+                               VLC_EXECUTOR_PRIORITY_NORMAL, &running) == 0);
+    vlc_sem_wait(&started);
+    assert(!vlc_executor_Cancel(running));
+    vlc_executor_Wait(running);
+    vlc_executor_Release(running);
+    assert(ret == EINTR);
+
+    vlc_executor_Delete(executor);
+}
+
+static void test_delete(void)
+{
+    vlc_executor_t *executor = vlc_executor_New(2);
+    int ret[2];
+
+    assert(executor != NULL);
+    atomic_store(&counter, 0);
+
+    for (unsigned i = 0; i < 2; i++)
+        assert(vlc_executor_Submit(executor, sleeper, &ret[i],
+                                   VLC_EXECUTOR_PRIORITY_HIGH, NULL) == 0);
+    for (unsigned i = 0; i < 2; i++)
+        vlc_sem_wait(&started);
+    for (unsigned i = 0; i < 100; i++)
+        assert(vlc_executor_Submit(executor, count, NULL,
+                                   VLC_EXECUTOR_PRIORITY_LOW, NULL) == 0);
+
+    vlc_executor_Delete(executor);
+    assert(ret[0] == EINTR && ret[1] == EINTR);
+    assert(atomic_load(&counter) == 0);
+}
+
+int main(void)
+{
+    alarm(10);
+
+    vlc_sem_init(&started, 0);
+    vlc_sem_init(&release, 0);
+
+    test_submit(1);
+    test_submit(4);
+    test_submit(0);
+    test_priority();
+    test_cancel();
+    test_delete();
+
+    vlc_sem_destroy(&release);
+    vlc_sem_destroy(&started);
+    return 0;
+}
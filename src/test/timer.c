@@ -48,6 +48,122 @@ static void callback (void *ptr)
     vlc_mutex_unlock (&data->lock);
 }
 
+struct stress_timer
+{
+    vlc_timer_t timer;
+    mtime_t deadline;
+    mtime_t fired;
+    struct timer_data *data;
+};
+
+static void stress_callback (void *ptr)
+{
+    struct stress_timer *st = ptr;
+
+    st->fired = mdate ();
+
+    vlc_mutex_lock (&st->data->lock);
+    if (--st->data->count == 0)
+        vlc_cond_signal (&st->data->wait);
+    vlc_mutex_unlock (&st->data->lock);
+}
+
+/* Measures the wake-up jitter of many concurrent one-shot timers */
+static void stress (struct timer_data *data, unsigned n)
+{
+    struct stress_timer *timers = malloc (n * sizeof (*timers));
+    assert (timers != NULL);
+
+    data->count = n;
+    for (unsigned i = 0; i < n; i++)
+    {
+        int val = vlc_timer_create (&timers[i].timer, stress_callback,
+                                    &timers[i]);
+        assert (val == 0);
+        timers[i].data = data;
+    }
+
+    /* Spread the deadlines over half a second */
+    mtime_t start = mdate () + CLOCK_FREQ / 10;
+
+    for (unsigned i = 0; i < n; i++)
+    {
+        timers[i].deadline = start + (i * (CLOCK_FREQ / 2)) / n;
+        vlc_timer_schedule (timers[i].timer, true, timers[i].deadline, 0);
+    }
+
+    vlc_mutex_lock (&data->lock);
+    while (data->count > 0)
+        vlc_cond_wait (&data->wait, &data->lock);
+    vlc_mutex_unlock (&data->lock);
+
+    mtime_t total = 0, max = 0;
+
+    for (unsigned i = 0; i < n; i++)
+    {
+        mtime_t jitter = timers[i].fired - timers[i].deadline;
+
+        assert (jitter >= 0); /* never early */
+        total += jitter;
+        if (jitter > max)
+            max = jitter;
+        vlc_timer_destroy (timers[i].timer);
+    }
+
+    printf ("%u timers: %"PRId64" us average jitter, %"PRId64" us max\n",
+            n, total / n, max);
+    free (timers);
+}
+
+struct nested_timer
+{
+    vlc_timer_t timer;
+    struct timer_data *data;
+    bool started;
+};
+
+static void nested_callback (void *ptr)
+{
+    struct nested_timer *nt = ptr;
+    struct timer_data *data = nt->data;
+    vlc_timer_t timer;
+
+    vlc_mutex_lock (&data->lock);
+    nt->started = true;
+    vlc_cond_signal (&data->wait);
+    vlc_mutex_unlock (&data->lock);
+
+    /* Let the main thread start destroying this timer */
+    mwait (mdate () + CLOCK_FREQ / 20);
+
+    int val = vlc_timer_create (&timer, callback, data);
+    assert (val == 0);
+    vlc_timer_schedule (timer, false, CLOCK_FREQ, 0);
+    vlc_timer_destroy (timer);
+
+    vlc_mutex_lock (&data->lock);
+    data->count++;
+    vlc_mutex_unlock (&data->lock);
+}
+
+/* Destroys a timer while its callback creates and destroys another one */
+static void nested (struct timer_data *data)
+{
+    struct nested_timer nt = { .data = data, .started = false };
+
+    data->count = 0;
+    int val = vlc_timer_create (&nt.timer, nested_callback, &nt);
+    assert (val == 0);
+    vlc_timer_schedule (nt.timer, false, 1, 0);
+
+    vlc_mutex_lock (&data->lock);
+    while (!nt.started)
+        vlc_cond_wait (&data->wait, &data->lock);
+    vlc_mutex_unlock (&data->lock);
+
+    vlc_timer_destroy (nt.timer);
+    assert (data->count == 1);
+}
 
 int main (void)
 {
@@ -105,6 +221,12 @@ int main (void)
     assert(ts >= (CLOCK_FREQ / 5));
 
     vlc_timer_destroy (data.timer);
+
+    nested (&data);
+
+    stress (&data, 1000);
+    stress (&data, 10000);
+
     vlc_cond_destroy (&data.wait);
     vlc_mutex_destroy (&data.lock);
 
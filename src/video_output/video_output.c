@@ -46,6 +46,7 @@
 #include <vlc_spu.h>
 #include <vlc_vout_osd.h>
 #include <vlc_image.h>
+#include <vlc_tracer.h>
 
 #include <libvlc.h>
 #include "vout_internal.h"
@@ -118,12 +119,16 @@ static vout_thread_t *VoutCreate(vlc_object_t *object,
     if (VoutValidateFormat(&original, cfg->fmt))
         return NULL;
 
+    vlc_trace_span_t span;
+    vlc_trace_Begin(object, &span, "vout create");
+
     /* Allocate descriptor */
     vout_thread_t *vout = vlc_custom_create(object,
                                             sizeof(*vout) + sizeof(*vout->p),
                                             "video output");
     if (!vout) {
         video_format_Clean(&original);
+        vlc_trace_End(&span, NULL);
         return NULL;
     }
 
@@ -197,6 +202,7 @@ static vout_thread_t *VoutCreate(vlc_object_t *object,
             vout_display_window_Delete(vout->p->window);
         spu_Destroy(vout->p->spu);
         vlc_object_release(vout);
+        vlc_trace_End(&span, NULL);
         return NULL;
     }
 
@@ -205,6 +211,7 @@ static vout_thread_t *VoutCreate(vlc_object_t *object,
     if (vout->p->dead) {
         msg_Err(vout, "video output creation failed");
         vout_CloseAndRelease(vout);
+        vlc_trace_End(&span, NULL);
         return NULL;
     }
 
@@ -212,6 +219,7 @@ static vout_thread_t *VoutCreate(vlc_object_t *object,
     if (vout->p->input)
         spu_Attach(vout->p->spu, vout->p->input, true);
 
+    vlc_trace_End(&span, NULL);
     return vout;
 }
 
@@ -1031,8 +1039,12 @@ static int ThreadDisplayRenderPicture(vout_thread_t *vout, bool is_forced)
         mwait(todisplay->date);
 
     /* Display the direct buffer returned by vout_RenderPicture */
+    bool first = vout->p->displayed.date == VLC_TS_INVALID;
+
     vout->p->displayed.date = mdate();
     vout_display_Display(vd, todisplay, subpic);
+    if (first) /* since start or the last flush */
+        vlc_trace_Mark(vout, "first picture", NULL);
 
     vout_statistic_AddDisplayed(&vout->p->statistic, 1);
 
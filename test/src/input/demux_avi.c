@@ -0,0 +1,272 @@
+/*****************************************************************************
+ * demux_avi.c: AVI demuxer background index test
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* An AVI file without idx1 is opened with --avi-index=4, so that its index
+ * is built by a background thread. Once the index is complete, seeking must
+ * land exactly on the requested frame. */
+
+#include "demux_test.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define FPS 25
+
+/*****************************************************************************
+ * Synthetic file
+ *****************************************************************************/
+static void put(FILE *file, const void *data, size_t len)
+{
+    size_t ret = fwrite(data, 1, len, file);
+    assert(ret == len);
+}
+
+static void put32(FILE *file, uint32_t v)
+{
+    uint8_t b[4];
+    SetDWLE(b, v);
+    put(file, b, 4);
+}
+
+static void put16(FILE *file, uint16_t v)
+{
+    uint8_t b[2];
+    SetWLE(b, v);
+    put(file, b, 2);
+}
+
+/* One MJPEG track, one chunk per frame, the frame number in the payload.
+ * Garbage bytes after the first chunk break the chunk sequence. */
+static void GenerateFile(FILE *file, unsigned i_frames, uint32_t i_garbage)
+{
+    static const uint8_t zero[4096];
+    const uint32_t i_movi = 4 + 12 * i_frames + i_garbage;
+    const uint32_t i_strl = 4 + (8 + 56) + (8 + 40);
+    const uint32_t i_hdrl = 4 + (8 + 56) + (8 + i_strl);
+
+    put(file, "RIFF", 4);
+    put32(file, 4 + (8 + i_hdrl) + (8 + i_movi) + (8 + 8));
+    put(file, "AVI ", 4);
+
+    put(file, "LIST", 4);
+    put32(file, i_hdrl);
+    put(file, "hdrl", 4);
+
+    put(file, "avih", 4);
+    put32(file, 56);
+    put32(file, 1000000 / FPS);
+    put32(file, 0);
+    put32(file, 0);
+    put32(file, 0); /* no AVIF_HASINDEX */
+    put32(file, i_frames);
+    put32(file, 0);
+    put32(file, 1);
+    put32(file, 0);
+    put32(file, 320);
+    put32(file, 240);
+    put(file, zero, 16);
+
+    put(file, "LIST", 4);
+    put32(file, i_strl);
+    put(file, "strl", 4);
+
+    put(file, "strh", 4);
+    put32(file, 56);
+    put(file, "vidsMJPG", 8);
+    put32(file, 0);
+    put32(file, 0);
+    put32(file, 0);
+    put32(file, 1);
+    put32(file, FPS);
+    put32(file, 0);
+    put32(file, i_frames);
+    put32(file, 0);
+    put32(file, UINT32_MAX);
+    put32(file, 0);
+    put16(file, 0);
+    put16(file, 0);
+    put16(file, 320);
+    put16(file, 240);
+
+    put(file, "strf", 4);
+    put32(file, 40);
+    put32(file, 40);
+    put32(file, 320);
+    put32(file, 240);
+    put16(file, 1);
+    put16(file, 24);
+    put(file, "MJPG", 4);
+    put32(file, 320 * 240 * 3);
+    put(file, zero, 16);
+
+    put(file, "LIST", 4);
+    put32(file, i_movi);
+    put(file, "movi", 4);
+    for (unsigned i = 0; i < i_frames; i++)
+    {
+        put(file, "00dc", 4);
+        put32(file, 4);
+        put32(file, i);
+
+        for (uint32_t j = 0; i == 0 && j < i_garbage; j += sizeof (zero))
+            put(file, zero, __MIN(i_garbage - j, sizeof (zero)));
+    }
+
+    /* Chunk headers are peeked with the next 8 bytes */
+    put(file, "JUNK", 4);
+    put32(file, 8);
+    put(file, zero, 8);
+}
+
+/*****************************************************************************
+ * Elementary stream output
+ *****************************************************************************/
+struct es_out_sys_t
+{
+    es_out_id_t id;
+    long i_first; /* first frame received since the last reset */
+};
+
+static es_out_id_t *EsOutAdd(es_out_t *out, const es_format_t *fmt)
+{
+    es_out_sys_t *sys = out->p_sys;
+
+    assert(fmt->i_cat == VIDEO_ES);
+    sys->id.i_id = fmt->i_id;
+    return &sys->id;
+}
+
+static int EsOutSend(es_out_t *out, es_out_id_t *id, block_t *block)
+{
+    es_out_sys_t *sys = out->p_sys;
+
+    assert(id == &sys->id);
+    assert(block->i_buffer == 4);
+    if (sys->i_first < 0)
+        sys->i_first = GetDWLE(block->p_buffer);
+    block_Release(block);
+    return VLC_SUCCESS;
+}
+
+int main(void)
+{
+    const unsigned i_frames = 200000;
+    char path[] = "/tmp/vlc-avi-XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd != -1);
+
+    FILE *file = fdopen(fd, "wb");
+    assert(file != NULL);
+    GenerateFile(file, i_frames, 0);
+    fclose(file);
+
+    /* Resyncing over this takes far longer than the test timeout */
+    char broken_path[] = "/tmp/vlc-avi-XXXXXX";
+    fd = mkstemp(broken_path);
+    assert(fd != -1);
+
+    file = fdopen(fd, "wb");
+    assert(file != NULL);
+    GenerateFile(file, 100, 4 << 20);
+    fclose(file);
+
+    test_init();
+
+    static const char *args[] = {
+        "--ignore-config", "-q", "--avi-index=4", "--no-demux-index-cache" };
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(args), args);
+    assert(vlc != NULL);
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    es_out_sys_t sys = { .i_first = -1 };
+    es_out_t out;
+    EsOutInit(&out, &sys);
+
+    /* Closing while the index is being built */
+    demux_t *demux = DemuxOpenFile(obj, "avi", path, &out);
+    if (demux == NULL)
+    {
+        log("avi demux not available, skipping\n");
+        libvlc_release(vlc);
+        unlink(broken_path);
+        unlink(path);
+        return 77;
+    }
+    demux_Delete(demux);
+
+    /* Closing while the index builder resyncs */
+    demux = DemuxOpenFile(obj, "avi", broken_path, &out);
+    assert(demux != NULL);
+    mwait(mdate() + CLOCK_FREQ / 10);
+
+    mtime_t i_close = mdate();
+    demux_Delete(demux);
+    i_close = mdate() - i_close;
+    log("Closed while resyncing in %"PRId64" us\n", i_close);
+    assert(i_close < CLOCK_FREQ / 2);
+    unlink(broken_path);
+
+    demux = DemuxOpenFile(obj, "avi", path, &out);
+    assert(demux != NULL);
+
+    /* Playback starts before the index is complete */
+    double f_progress;
+    assert(demux_Control(demux, DEMUX_GET_INDEX_PROGRESS, &f_progress)
+           == VLC_SUCCESS);
+    log("Index progress after opening: %f\n", f_progress);
+    assert(demux_Demux(demux) == 1);
+    assert(sys.i_first == 0);
+
+    mtime_t i_deadline = mdate() + 60 * CLOCK_FREQ;
+    do
+    {
+        mwait(mdate() + CLOCK_FREQ / 100);
+        assert(demux_Control(demux, DEMUX_GET_INDEX_PROGRESS, &f_progress)
+               == VLC_SUCCESS);
+        assert(f_progress >= 0.0 && f_progress <= 1.0);
+        assert(mdate() < i_deadline);
+    }
+    while (f_progress < 1.0);
+
+    /* Seeking merges the index built so far, and is then exact */
+    static const unsigned targets[] = { 150000, 1000, 199900, 73210 };
+    for (unsigned i = 0; i < ARRAY_SIZE(targets); i++)
+    {
+        mtime_t i_time = (mtime_t)targets[i] * CLOCK_FREQ / FPS;
+
+        assert(demux_Control(demux, DEMUX_SET_TIME, i_time, true)
+               == VLC_SUCCESS);
+        sys.i_first = -1;
+        assert(demux_Demux(demux) == 1);
+        log("Seek to frame %u: got frame %ld\n", targets[i], sys.i_first);
+        assert(sys.i_first == (long)targets[i]);
+    }
+
+    int64_t i_length;
+    assert(demux_Control(demux, DEMUX_GET_LENGTH, &i_length) == VLC_SUCCESS);
+    assert(i_length == (int64_t)i_frames * CLOCK_FREQ / FPS);
+
+    demux_Delete(demux);
+    libvlc_release(vlc);
+    unlink(path);
+    return 0;
+}
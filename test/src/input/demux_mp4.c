@@ -0,0 +1,582 @@
+/*****************************************************************************
+ * demux_mp4.c: MP4 demuxer sample index test and benchmark
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * Generates a single video track MP4 file in memory, with runs of decoding
+ * time deltas, composition offsets and samples per chunk straddling each
+ * other, then checks the timestamps and sizes of every sample output by the
+ * "mp4" demuxer, and of the first sample after seeking.
+ *
+ * The same samples are then laid out as a fragmented file, whose moov
+ * (with a mvex) precedes its mdat and is followed by an empty moof, so that
+ * the demuxer reads them in leaf mode.
+ *
+ * Usage: test_src_input_demux_mp4 [options]
+ *   -n <n>   number of samples (default 200000)
+ *   -a <n>   fail if the allocations when opening are above this threshold
+ *            (default: the number of chunks)
+ *   -c <n>   multiply the number of samples per chunk (default 1)
+ *   -m <n>   fail if the peak heap usage when opening is above this many
+ *            bytes per sample (default: no threshold)
+ *
+ * Opening time, allocations and peak heap usage are logged, so that large
+ * files with few chunks (e.g. -n 2000000 -c 100), where the sample tables
+ * make most of the index footprint, can be used as a benchmark.
+ */
+
+#define DEMUX_TEST_ALLOCATIONS
+#include "demux_test.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+#define TIMESCALE 90000
+
+/*****************************************************************************
+ * Synthetic file
+ *****************************************************************************/
+struct sample
+{
+    int64_t  i_dts;    /* in TIMESCALE units */
+    int32_t  i_offset; /* composition offset */
+    uint32_t i_size;
+};
+
+struct buffer
+{
+    uint8_t *p;
+    size_t   i_len;
+    size_t   i_max;
+};
+
+static void put(struct buffer *buf, const void *data, size_t len)
+{
+    if (buf->i_len + len > buf->i_max)
+    {
+        buf->i_max = (buf->i_len + len) * 2;
+        buf->p = realloc(buf->p, buf->i_max);
+        assert(buf->p != NULL);
+    }
+    if (data != NULL)
+        memcpy(buf->p + buf->i_len, data, len);
+    else
+        memset(buf->p + buf->i_len, 0, len);
+    buf->i_len += len;
+}
+
+static void put8(struct buffer *buf, uint8_t v)
+{
+    put(buf, &v, 1);
+}
+
+static void put16(struct buffer *buf, uint16_t v)
+{
+    uint8_t b[2];
+    SetWBE(b, v);
+    put(buf, b, 2);
+}
+
+static void put32(struct buffer *buf, uint32_t v)
+{
+    uint8_t b[4];
+    SetDWBE(b, v);
+    put(buf, b, 4);
+}
+
+static size_t box_open(struct buffer *buf, const char *type)
+{
+    size_t i_pos = buf->i_len;
+    put32(buf, 0);
+    put(buf, type, 4);
+    return i_pos;
+}
+
+static size_t fullbox_open(struct buffer *buf, const char *type,
+                           uint32_t i_flags)
+{
+    size_t i_pos = box_open(buf, type);
+    put32(buf, i_flags);
+    return i_pos;
+}
+
+static void box_close(struct buffer *buf, size_t i_pos)
+{
+    SetDWBE(buf->p + i_pos, buf->i_len - i_pos);
+}
+
+static void put_matrix(struct buffer *buf)
+{
+    static const uint32_t matrix[9] = {
+        0x10000, 0, 0, 0, 0x10000, 0, 0, 0, 0x40000000 };
+    for (unsigned i = 0; i < 9; i++)
+        put32(buf, matrix[i]);
+}
+
+static uint32_t gen_rand(uint32_t *seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return *seed >> 8;
+}
+
+static uint8_t *GenerateFile(unsigned i_samples, unsigned i_chunk_scale,
+                             bool b_fragmented, struct sample *samples,
+                             size_t *pi_size, unsigned *pi_chunks)
+{
+    static const uint32_t deltas[] = { 3000, 3003, 1500 };
+    static const int32_t offsets[] = { 0, 3000, 6000 };
+    static const uint32_t per_chunk[] = { 1, 5, 30 };
+    uint32_t seed = 42;
+    struct buffer buf = { NULL, 0, 0 }, stts = buf, ctts = buf, stsc = buf;
+    struct buffer mdat = buf;
+    uint32_t i_stts = 0, i_ctts = 0, i_stsc = 0;
+
+    /* Decoding time deltas and composition offsets, by runs */
+    int64_t i_dts = 0;
+    for (unsigned i = 0; i < i_samples; )
+    {
+        uint32_t i_run = 1 + gen_rand(&seed) % 3000;
+        uint32_t i_delta = deltas[gen_rand(&seed) % ARRAY_SIZE(deltas)];
+
+        i_run = __MIN(i_run, i_samples - i);
+        put32(&stts, i_run);
+        put32(&stts, i_delta);
+        i_stts++;
+        for (unsigned j = 0; j < i_run; j++, i++)
+        {
+            samples[i].i_dts = i_dts;
+            samples[i].i_size = 1 + gen_rand(&seed) % 64;
+            i_dts += i_delta;
+        }
+    }
+    for (unsigned i = 0; i < i_samples; )
+    {
+        uint32_t i_run = 1 + gen_rand(&seed) % 4;
+        int32_t i_offset = offsets[gen_rand(&seed) % ARRAY_SIZE(offsets)];
+
+        i_run = __MIN(i_run, i_samples - i);
+        put32(&ctts, i_run);
+        put32(&ctts, i_offset);
+        i_ctts++;
+        for (unsigned j = 0; j < i_run; j++, i++)
+            samples[i].i_offset = i_offset;
+    }
+
+    /* Samples per chunk, by runs of chunks */
+    unsigned i_chunks = 0;
+    uint32_t *pi_chunk_size = NULL;
+    for (unsigned i = 0; i < i_samples; )
+    {
+        uint32_t i_run = 1 + gen_rand(&seed) % 50;
+        uint32_t i_per_chunk = i_chunk_scale
+            * per_chunk[gen_rand(&seed) % ARRAY_SIZE(per_chunk)];
+
+        put32(&stsc, i_chunks + 1);
+        put32(&stsc, i_per_chunk);
+        put32(&stsc, 1);
+        i_stsc++;
+        for (unsigned j = 0; j < i_run && i < i_samples; j++)
+        {
+            pi_chunk_size = realloc(pi_chunk_size,
+                                    (i_chunks + 1) * sizeof (*pi_chunk_size));
+            assert(pi_chunk_size != NULL);
+            pi_chunk_size[i_chunks++] = i_per_chunk;
+            i += i_per_chunk;
+        }
+    }
+    /* The last chunk is only partially filled: shorten the last run */
+    unsigned i_total = 0;
+    for (unsigned i = 0; i < i_chunks; i++)
+        i_total += pi_chunk_size[i];
+    if (i_total > i_samples)
+    {
+        uint32_t i_last = pi_chunk_size[i_chunks - 1] - (i_total - i_samples);
+        put32(&stsc, i_chunks);
+        put32(&stsc, i_last);
+        put32(&stsc, 1);
+        i_stsc++;
+        pi_chunk_size[i_chunks - 1] = i_last;
+    }
+
+    /* ftyp, and mdat payload with the sample index in the first byte of
+     * samples: chunk offsets are relative to the payload until it is placed */
+    size_t i_box = box_open(&buf, "ftyp");
+    put(&buf, "isom", 4);
+    put32(&buf, 0);
+    put(&buf, "isom", 4);
+    box_close(&buf, i_box);
+
+    uint32_t *pi_chunk_offset = malloc(i_chunks * sizeof (*pi_chunk_offset));
+    assert(pi_chunk_offset != NULL);
+
+    for (unsigned i = 0, i_chunk = 0; i_chunk < i_chunks; i_chunk++)
+    {
+        pi_chunk_offset[i_chunk] = mdat.i_len;
+        for (unsigned j = 0; j < pi_chunk_size[i_chunk]; j++, i++)
+        {
+            put8(&mdat, i);
+            put(&mdat, NULL, samples[i].i_size - 1);
+        }
+    }
+
+    if (!b_fragmented)
+    {
+        i_box = box_open(&buf, "mdat");
+        put(&buf, mdat.p, mdat.i_len);
+        box_close(&buf, i_box);
+    }
+
+    const uint32_t i_duration = i_dts * 1000 / TIMESCALE;
+    size_t i_moov = box_open(&buf, "moov");
+
+    i_box = fullbox_open(&buf, "mvhd", 0);
+    put32(&buf, 0);
+    put32(&buf, 0);
+    put32(&buf, 1000);
+    put32(&buf, i_duration);
+    put32(&buf, 0x10000);
+    put16(&buf, 0x100);
+    put(&buf, NULL, 10);
+    put_matrix(&buf);
+    put(&buf, NULL, 24);
+    put32(&buf, 2);
+    box_close(&buf, i_box);
+
+    size_t i_trak = box_open(&buf, "trak");
+    i_box = fullbox_open(&buf, "tkhd", 3);
+    put32(&buf, 0);
+    put32(&buf, 0);
+    put32(&buf, 1);
+    put32(&buf, 0);
+    put32(&buf, i_duration);
+    put(&buf, NULL, 8);
+    put(&buf, NULL, 8);
+    put_matrix(&buf);
+    put32(&buf, 320 << 16);
+    put32(&buf, 240 << 16);
+    box_close(&buf, i_box);
+
+    size_t i_mdia = box_open(&buf, "mdia");
+    i_box = fullbox_open(&buf, "mdhd", 0);
+    put32(&buf, 0);
+    put32(&buf, 0);
+    put32(&buf, TIMESCALE);
+    put32(&buf, i_dts);
+    put16(&buf, 0x55c4);
+    put16(&buf, 0);
+    box_close(&buf, i_box);
+
+    i_box = fullbox_open(&buf, "hdlr", 0);
+    put32(&buf, 0);
+    put(&buf, "vide", 4);
+    put(&buf, NULL, 12);
+    put8(&buf, 0);
+    box_close(&buf, i_box);
+
+    size_t i_minf = box_open(&buf, "minf");
+    i_box = fullbox_open(&buf, "vmhd", 1);
+    put(&buf, NULL, 8);
+    box_close(&buf, i_box);
+
+    size_t i_dinf = box_open(&buf, "dinf");
+    size_t i_dref = fullbox_open(&buf, "dref", 0);
+    put32(&buf, 1);
+    box_close(&buf, fullbox_open(&buf, "url ", 1));
+    box_close(&buf, i_dref);
+    box_close(&buf, i_dinf);
+
+    size_t i_stbl = box_open(&buf, "stbl");
+    size_t i_stsd = fullbox_open(&buf, "stsd", 0);
+    put32(&buf, 1);
+    i_box = box_open(&buf, "mp4v");
+    put(&buf, NULL, 6);
+    put16(&buf, 1);
+    put(&buf, NULL, 16);
+    put16(&buf, 320);
+    put16(&buf, 240);
+    put32(&buf, 0x480000);
+    put32(&buf, 0x480000);
+    put32(&buf, 0);
+    put16(&buf, 1);
+    put(&buf, NULL, 32);
+    put16(&buf, 0x18);
+    put16(&buf, 0xffff);
+    box_close(&buf, i_box);
+    box_close(&buf, i_stsd);
+
+    i_box = fullbox_open(&buf, "stts", 0);
+    put32(&buf, i_stts);
+    put(&buf, stts.p, stts.i_len);
+    box_close(&buf, i_box);
+
+    i_box = fullbox_open(&buf, "ctts", 0);
+    put32(&buf, i_ctts);
+    put(&buf, ctts.p, ctts.i_len);
+    box_close(&buf, i_box);
+
+    i_box = fullbox_open(&buf, "stsc", 0);
+    put32(&buf, i_stsc);
+    put(&buf, stsc.p, stsc.i_len);
+    box_close(&buf, i_box);
+
+    i_box = fullbox_open(&buf, "stsz", 0);
+    put32(&buf, 0);
+    put32(&buf, i_samples);
+    for (unsigned i = 0; i < i_samples; i++)
+        put32(&buf, samples[i].i_size);
+    box_close(&buf, i_box);
+
+    i_box = fullbox_open(&buf, "stco", 0);
+    put32(&buf, i_chunks);
+    const size_t i_stco = buf.i_len;
+    put(&buf, NULL, i_chunks * 4);
+    box_close(&buf, i_box);
+
+    box_close(&buf, i_stbl);
+    box_close(&buf, i_minf);
+    box_close(&buf, i_mdia);
+    box_close(&buf, i_trak);
+
+    if (b_fragmented)
+    {
+        size_t i_mvex = box_open(&buf, "mvex");
+        i_box = fullbox_open(&buf, "trex", 0);
+        put32(&buf, 1);
+        put32(&buf, 1);
+        put(&buf, NULL, 12);
+        box_close(&buf, i_box);
+        box_close(&buf, i_mvex);
+    }
+    box_close(&buf, i_moov);
+
+    /* The mdat payload follows its 8 bytes header, wherever it is */
+    const size_t i_payload = b_fragmented ? buf.i_len + 8
+                                          : i_moov - mdat.i_len;
+    for (unsigned i = 0; i < i_chunks; i++)
+        SetDWBE(buf.p + i_stco + i * 4, i_payload + pi_chunk_offset[i]);
+
+    if (b_fragmented)
+    {
+        i_box = box_open(&buf, "mdat");
+        put(&buf, mdat.p, mdat.i_len);
+        box_close(&buf, i_box);
+
+        /* No more samples, but a moof to make the file fragmented */
+        size_t i_moof = box_open(&buf, "moof");
+        i_box = fullbox_open(&buf, "mfhd", 0);
+        put32(&buf, 1);
+        box_close(&buf, i_box);
+        box_close(&buf, i_moof);
+    }
+
+    free(pi_chunk_offset);
+    free(pi_chunk_size);
+    free(mdat.p);
+    free(stsc.p);
+    free(ctts.p);
+    free(stts.p);
+
+    *pi_size = buf.i_len;
+    *pi_chunks = i_chunks;
+    return buf.p;
+}
+
+/*****************************************************************************
+ * Checking elementary stream output
+ *****************************************************************************/
+struct es_out_sys_t
+{
+    es_out_id_t id;
+    const struct sample *samples;
+    unsigned i_samples;
+    unsigned i_next; /* expected next sample */
+    unsigned i_received;
+};
+
+static mtime_t ToMtime(int64_t i_ts)
+{
+    return CLOCK_FREQ * i_ts / TIMESCALE;
+}
+
+static es_out_id_t *EsOutAdd(es_out_t *out, const es_format_t *fmt)
+{
+    es_out_sys_t *sys = out->p_sys;
+
+    assert(fmt->i_cat == VIDEO_ES);
+    sys->id.i_id = fmt->i_id;
+    return &sys->id;
+}
+
+static int EsOutSend(es_out_t *out, es_out_id_t *id, block_t *block)
+{
+    es_out_sys_t *sys = out->p_sys;
+    const unsigned i = sys->i_next;
+
+    assert(id == &sys->id);
+    assert(i < sys->i_samples);
+
+    const struct sample *s = &sys->samples[i];
+    const mtime_t i_dts = VLC_TS_0 + ToMtime(s->i_dts);
+    const mtime_t i_pts = i_dts + CLOCK_FREQ * s->i_offset / TIMESCALE;
+
+    if (block->i_buffer != s->i_size || block->p_buffer[0] != (uint8_t)i
+     || block->i_dts != i_dts || block->i_pts != i_pts)
+    {
+        log("sample %u: size %zu/%"PRIu32" dts %"PRId64"/%"PRId64
+            " pts %"PRId64"/%"PRId64"\n", i, block->i_buffer, s->i_size,
+            block->i_dts, i_dts, block->i_pts, i_pts);
+        fflush(stdout);
+        abort();
+    }
+
+    sys->i_next++;
+    sys->i_received++;
+    block_Release(block);
+    return VLC_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned i_samples = 200000;
+    long i_max_allocs = -1;
+    unsigned i_chunk_scale = 1;
+    unsigned i_max_heap = 0;
+    int c;
+
+    test_init();
+
+    while ((c = getopt(argc, argv, "n:a:c:m:")) != -1)
+    {
+        switch (c)
+        {
+            case 'n': i_samples = strtoul(optarg, NULL, 0); break;
+            case 'a': i_max_allocs = atol(optarg); break;
+            case 'c': i_chunk_scale = strtoul(optarg, NULL, 0); break;
+            case 'm': i_max_heap = strtoul(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "Usage: %s [-n samples] "
+                        "[-a max allocations] [-c chunk scale] "
+                        "[-m max heap per sample]\n",
+                        argv[0]);
+                return 1;
+        }
+    }
+    if (i_samples < 2 || i_chunk_scale < 1)
+        return 1;
+
+    struct sample *samples = malloc(i_samples * sizeof (*samples));
+    assert(samples != NULL);
+
+    size_t i_size;
+    unsigned i_chunks;
+    uint8_t *p_buf = GenerateFile(i_samples, i_chunk_scale, false, samples,
+                                  &i_size, &i_chunks);
+    log("Generated %u samples in %u chunks, %zu bytes\n", i_samples,
+        i_chunks, i_size);
+    if (i_max_allocs < 0)
+        i_max_allocs = i_chunks;
+
+    static const char *args[] = { "--ignore-config", "-q" };
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(args), args);
+    assert(vlc != NULL);
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    es_out_sys_t sys = {
+        .samples = samples,
+        .i_samples = i_samples,
+    };
+    es_out_t out;
+    EsOutInit(&out, &sys);
+
+    const unsigned i_allocations = GetAllocations();
+    const size_t i_heap = ResetHeapPeak();
+    const mtime_t i_start = mdate();
+    demux_t *demux = DemuxOpenMemory(obj, "mp4", p_buf, i_size, &out);
+    if (demux == NULL)
+    {
+        log("mp4 demux not available, skipping\n");
+        libvlc_release(vlc);
+        free(p_buf);
+        free(samples);
+        return 77;
+    }
+
+    const mtime_t i_open_time = mdate() - i_start;
+    const unsigned i_open_allocs = GetAllocations() - i_allocations;
+    const size_t i_open_heap = GetHeapPeak() - i_heap;
+    log("opened in %"PRId64" us, %u allocations, peak heap %zu KiB "
+        "(%zu bytes per sample)\n", i_open_time, i_open_allocs,
+        i_open_heap / 1024, i_open_heap / i_samples);
+
+    /* Whole file */
+    while (demux_Demux(demux) == VLC_DEMUXER_SUCCESS);
+    assert(sys.i_next == i_samples);
+
+    /* Seeking, half way between two samples */
+    for (unsigned i = 0; i < 20; i++)
+    {
+        const unsigned i_target = (i_samples - 1) * (uint64_t)i / 20;
+        const mtime_t i_time = ToMtime(samples[i_target].i_dts)
+            + (ToMtime(samples[i_target + 1].i_dts)
+             - ToMtime(samples[i_target].i_dts)) / 2;
+
+        assert(demux_Control(demux, DEMUX_SET_TIME, i_time, true)
+               == VLC_SUCCESS);
+        sys.i_next = i_target;
+        sys.i_received = 0;
+        while (sys.i_received == 0
+            && demux_Demux(demux) == VLC_DEMUXER_SUCCESS);
+        assert(sys.i_received > 0);
+    }
+
+    demux_Delete(demux);
+    free(p_buf);
+
+    /* Fragmented file, read in leaf mode */
+    p_buf = GenerateFile(i_samples, i_chunk_scale, true, samples, &i_size,
+                         &i_chunks);
+    log("Generated fragmented file, %zu bytes\n", i_size);
+
+    sys.i_next = 0;
+    demux = DemuxOpenMemory(obj, "mp4", p_buf, i_size, &out);
+    assert(demux != NULL);
+    while (demux_Demux(demux) == VLC_DEMUXER_SUCCESS);
+    assert(sys.i_next == i_samples);
+
+    demux_Delete(demux);
+    libvlc_release(vlc);
+    free(p_buf);
+    free(samples);
+
+#ifdef HAVE_ALLOC_COUNT
+    if (i_open_allocs > (unsigned long)i_max_allocs)
+    {
+        log("FAIL: %u allocations when opening, above threshold %ld\n",
+            i_open_allocs, i_max_allocs);
+        return 1;
+    }
+    if (i_max_heap > 0 && i_open_heap > (size_t)i_max_heap * i_samples)
+    {
+        log("FAIL: %zu bytes of peak heap when opening, above threshold "
+            "%u bytes per sample\n", i_open_heap, i_max_heap);
+        return 1;
+    }
+#endif
+    return 0;
+}
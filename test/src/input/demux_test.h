@@ -0,0 +1,226 @@
+/*****************************************************************************
+ * demux_test.h: common fixture of the demuxer tests
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * Included by exactly one file of each test program. The test defines
+ * EsOutAdd() and EsOutSend(), and its own struct es_out_sys_t.
+ *
+ * If DEMUX_TEST_ALLOCATIONS is defined before inclusion, the allocator is
+ * interposed so that heap allocations are counted (HAVE_ALLOC_COUNT is then
+ * defined where this is supported).
+ */
+
+#ifndef DEMUX_TEST_H
+#define DEMUX_TEST_H
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+#include <vlc_es_out.h>
+#include <vlc_stream.h>
+#include <vlc_url.h>
+
+/*****************************************************************************
+ * Allocations counting
+ *****************************************************************************/
+#ifdef DEMUX_TEST_ALLOCATIONS
+# include <vlc_atomic.h>
+# include <errno.h>
+
+static atomic_uint allocations = ATOMIC_VAR_INIT(0);
+static atomic_size_t heap_size = ATOMIC_VAR_INIT(0);
+static atomic_size_t heap_peak = ATOMIC_VAR_INIT(0);
+
+# ifdef __GLIBC__
+#  include <malloc.h>
+
+/* Interpose the allocator, so that allocations from the core and the plugins
+ * get counted as well (the tests are built with hidden visibility). */
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+extern void *__libc_memalign(size_t, size_t);
+extern void __libc_free(void *);
+
+static void *HeapAdd(void *ptr)
+{
+    if (ptr == NULL)
+        return NULL;
+
+    size_t size = malloc_usable_size(ptr);
+    size_t peak = atomic_load_explicit(&heap_peak, memory_order_relaxed);
+
+    size += atomic_fetch_add_explicit(&heap_size, size, memory_order_relaxed);
+    while (size > peak
+        && !atomic_compare_exchange_weak_explicit(&heap_peak, &peak, size,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed));
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return ptr;
+}
+
+static void HeapRemove(void *ptr)
+{
+    if (ptr != NULL)
+        atomic_fetch_sub_explicit(&heap_size, malloc_usable_size(ptr),
+                                  memory_order_relaxed);
+}
+
+VLC_EXPORT void *malloc(size_t size)
+{
+    return HeapAdd(__libc_malloc(size));
+}
+
+VLC_EXPORT void *calloc(size_t n, size_t size)
+{
+    return HeapAdd(__libc_calloc(n, size));
+}
+
+VLC_EXPORT void *realloc(void *ptr, size_t size)
+{
+    HeapRemove(ptr);
+    return HeapAdd(__libc_realloc(ptr, size));
+}
+
+VLC_EXPORT int posix_memalign(void **pptr, size_t align, size_t size)
+{
+    void *ptr = HeapAdd(__libc_memalign(align, size));
+    if (ptr == NULL)
+        return ENOMEM;
+    *pptr = ptr;
+    return 0;
+}
+
+VLC_EXPORT void *aligned_alloc(size_t align, size_t size)
+{
+    return HeapAdd(__libc_memalign(align, size));
+}
+
+VLC_EXPORT void *memalign(size_t align, size_t size)
+{
+    return HeapAdd(__libc_memalign(align, size));
+}
+
+VLC_EXPORT void free(void *ptr)
+{
+    HeapRemove(ptr);
+    __libc_free(ptr);
+}
+#  define HAVE_ALLOC_COUNT 1
+# endif
+
+static inline unsigned GetAllocations(void)
+{
+    return atomic_load_explicit(&allocations, memory_order_relaxed);
+}
+
+/* Returns the current heap usage, and restarts peak tracking from there */
+static inline size_t ResetHeapPeak(void)
+{
+    size_t size = atomic_load_explicit(&heap_size, memory_order_relaxed);
+    atomic_store_explicit(&heap_peak, size, memory_order_relaxed);
+    return size;
+}
+
+static inline size_t GetHeapPeak(void)
+{
+    return atomic_load_explicit(&heap_peak, memory_order_relaxed);
+}
+#endif /* DEMUX_TEST_ALLOCATIONS */
+
+/*****************************************************************************
+ * Elementary stream output
+ *****************************************************************************/
+struct es_out_id_t
+{
+    int i_id;
+};
+
+static es_out_id_t *EsOutAdd(es_out_t *, const es_format_t *);
+static int EsOutSend(es_out_t *, es_out_id_t *, block_t *);
+
+static inline void EsOutDel(es_out_t *out, es_out_id_t *id)
+{
+    (void) out; (void) id;
+}
+
+static inline int EsOutControl(es_out_t *out, int i_query, va_list args)
+{
+    (void) out;
+
+    switch (i_query)
+    {
+        case ES_OUT_GET_ES_STATE:
+            /* Every ES is selected, as they would be when recording */
+            (void) va_arg(args, es_out_id_t *);
+            *va_arg(args, bool *) = true;
+            return VLC_SUCCESS;
+        default:
+            return VLC_EGENERIC;
+    }
+}
+
+static inline void EsOutInit(es_out_t *out, es_out_sys_t *sys)
+{
+    out->pf_add = EsOutAdd;
+    out->pf_send = EsOutSend;
+    out->pf_del = EsOutDel;
+    out->pf_control = EsOutControl;
+    out->p_sys = sys;
+}
+
+/*****************************************************************************
+ * Demuxer
+ *****************************************************************************/
+
+/* Returns NULL if the demuxer is not available */
+static inline demux_t *DemuxOpenMemory(vlc_object_t *obj, const char *module,
+                                       uint8_t *p_buf, size_t i_size,
+                                       es_out_t *out)
+{
+    stream_t *s = vlc_stream_MemoryNew(obj, p_buf, i_size, true);
+    assert(s != NULL);
+
+    demux_t *demux = demux_New(obj, module, "", s, out);
+    if (demux == NULL)
+        vlc_stream_Delete(s);
+    return demux;
+}
+
+/* Returns NULL if the demuxer is not available */
+static inline demux_t *DemuxOpenFile(vlc_object_t *obj, const char *module,
+                                     const char *path, es_out_t *out)
+{
+    char *url = vlc_path2uri(path, NULL);
+    assert(url != NULL);
+
+    stream_t *s = vlc_stream_NewMRL(obj, url);
+    free(url);
+    assert(s != NULL);
+
+    demux_t *demux = demux_New(obj, module, path, s, out);
+    if (demux == NULL)
+        vlc_stream_Delete(s);
+    return demux;
+}
+
+#endif /* DEMUX_TEST_H */
@@ -0,0 +1,527 @@
+/*****************************************************************************
+ * demux_ts.c: MPEG-TS demuxer throughput benchmark
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * Feeds a transport stream from memory through the "ts" demuxer and a null
+ * elementary stream output, then reports packets/s, ns/packet, and memory
+ * allocations per PES, overall and per PID.
+ *
+ * Usage: test_src_input_demux_ts [options] [file.ts]
+ *   -p <n>   number of programs of the synthetic stream (default 4)
+ *   -n <n>   number of TS packets of the synthetic stream (default 100000)
+ *   -i <n>   iterations (default 5)
+ *   -t <ns>  fail if the best ns/packet is above this threshold
+ *   -a <n>   fail if the allocations per PES are above this threshold
+ *
+ * Without a file argument, a synthetic multi-program stream is generated, and
+ * the number of PES output by the demuxer is checked against it.
+ */
+
+#define DEMUX_TEST_ALLOCATIONS
+#include "demux_test.h"
+
+#include <inttypes.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define TS_PACKET_SIZE 188
+#define MAX_PIDS 64
+
+/*****************************************************************************
+ * Synthetic stream
+ *****************************************************************************/
+struct generator
+{
+    uint8_t *p_buf;
+    size_t   i_packets;
+    size_t   i_max;
+    bool     b_full;
+    uint8_t  cc[8192];
+    uint32_t i_seed;
+    unsigned pi_pes[8192]; /* PES written per PID */
+};
+
+static uint32_t gen_rand(struct generator *gen)
+{
+    gen->i_seed = gen->i_seed * 1103515245 + 12345;
+    return gen->i_seed >> 8;
+}
+
+static uint32_t crc32_mpeg(const uint8_t *p, size_t i_len)
+{
+    uint32_t i_crc = 0xffffffff;
+
+    while (i_len--)
+    {
+        i_crc ^= (uint32_t)*(p++) << 24;
+        for (int i = 0; i < 8; i++)
+            i_crc = (i_crc << 1) ^ ((i_crc & 0x80000000) ? 0x04c11db7 : 0);
+    }
+    return i_crc;
+}
+
+/* Writes one TS packet, with an optional PCR, and returns the number of
+ * payload bytes consumed. */
+static size_t gen_packet(struct generator *gen, uint16_t i_pid, bool b_start,
+                         int64_t i_pcr, const uint8_t *p_data, size_t i_data)
+{
+    if (gen->i_packets >= gen->i_max)
+    {
+        gen->b_full = true;
+        return i_data;
+    }
+
+    uint8_t *p = &gen->p_buf[gen->i_packets++ * TS_PACKET_SIZE];
+    size_t i_af = (i_pcr >= 0) ? 8 : 0; /* adaptation field with its length */
+    size_t i_payload = TS_PACKET_SIZE - 4 - i_af;
+
+    if (i_data < i_payload)
+    {
+        i_af += i_payload - i_data; /* stuffing */
+        i_payload = i_data;
+    }
+
+    p[0] = 0x47;
+    p[1] = (b_start ? 0x40 : 0x00) | (i_pid >> 8);
+    p[2] = i_pid & 0xff;
+    p[3] = (i_af ? 0x30 : 0x10) | (gen->cc[i_pid]++ & 0x0f);
+
+    if (i_af)
+    {
+        p[4] = i_af - 1;
+        if (i_af > 1)
+        {
+            memset(&p[5], 0xff, i_af - 1);
+            p[5] = 0x00;
+            if (i_pcr >= 0)
+            {
+                p[5] = 0x10;
+                p[6] = i_pcr >> 25;
+                p[7] = i_pcr >> 17;
+                p[8] = i_pcr >> 9;
+                p[9] = i_pcr >> 1;
+                p[10] = ((i_pcr & 1) << 7) | 0x7e;
+                p[11] = 0x00;
+            }
+        }
+    }
+
+    memcpy(&p[4 + i_af], p_data, i_payload);
+    return i_payload;
+}
+
+static void gen_section(struct generator *gen, uint16_t i_pid,
+                        uint8_t *p_section, size_t i_len)
+{
+    /* section_length covers everything after it, including the CRC */
+    p_section[1] = 0xb0 | ((i_len + 4 - 3) >> 8);
+    p_section[2] = (i_len + 4 - 3) & 0xff;
+
+    uint32_t i_crc = crc32_mpeg(p_section, i_len);
+    p_section[i_len++] = i_crc >> 24;
+    p_section[i_len++] = i_crc >> 16;
+    p_section[i_len++] = i_crc >> 8;
+    p_section[i_len++] = i_crc;
+
+    uint8_t packet[TS_PACKET_SIZE];
+    packet[0] = 0x00; /* pointer_field */
+    memcpy(&packet[1], p_section, i_len);
+    gen_packet(gen, i_pid, true, -1, packet, i_len + 1);
+}
+
+static void gen_psi(struct generator *gen, unsigned i_programs)
+{
+    uint8_t section[TS_PACKET_SIZE];
+    size_t i_len = 8;
+
+    /* PAT */
+    section[0] = 0x00;
+    section[3] = 0x00; section[4] = 0x01; /* transport_stream_id */
+    section[5] = 0xc1;
+    section[6] = section[7] = 0x00;
+    for (unsigned i = 0; i < i_programs; i++)
+    {
+        section[i_len++] = 0x00;
+        section[i_len++] = 1 + i;
+        section[i_len++] = 0xe0;
+        section[i_len++] = 0x20 + i; /* PMT PID */
+    }
+    gen_section(gen, 0x0000, section, i_len);
+
+    /* PMT: one H.264 video stream carrying the PCR, and one MPEG audio */
+    for (unsigned i = 0; i < i_programs; i++)
+    {
+        const uint16_t i_video = 0x100 + 0x10 * i;
+        i_len = 0;
+        section[i_len++] = 0x02;
+        i_len += 2;
+        section[i_len++] = 0x00;
+        section[i_len++] = 1 + i; /* program_number */
+        section[i_len++] = 0xc1;
+        section[i_len++] = 0x00;
+        section[i_len++] = 0x00;
+        section[i_len++] = 0xe0 | (i_video >> 8);
+        section[i_len++] = i_video & 0xff;
+        section[i_len++] = 0xf0;
+        section[i_len++] = 0x00;
+        for (unsigned j = 0; j < 2; j++)
+        {
+            section[i_len++] = (j == 0) ? 0x1b : 0x03;
+            section[i_len++] = 0xe0 | ((i_video + j) >> 8);
+            section[i_len++] = (i_video + j) & 0xff;
+            section[i_len++] = 0xf0;
+            section[i_len++] = 0x00;
+        }
+        gen_section(gen, 0x20 + i, section, i_len);
+    }
+}
+
+static size_t gen_timestamp(uint8_t *p, uint8_t i_prefix, int64_t i_ts)
+{
+    p[0] = (i_prefix << 4) | (((i_ts >> 30) & 0x07) << 1) | 1;
+    p[1] = i_ts >> 22;
+    p[2] = (((i_ts >> 15) & 0x7f) << 1) | 1;
+    p[3] = i_ts >> 7;
+    p[4] = ((i_ts & 0x7f) << 1) | 1;
+    return 5;
+}
+
+static void gen_pes(struct generator *gen, uint16_t i_pid, bool b_video,
+                    int64_t i_pts, size_t i_size)
+{
+    uint8_t *p_pes = malloc(19 + i_size);
+    assert(p_pes);
+
+    size_t i_len = 0;
+    p_pes[i_len++] = 0x00;
+    p_pes[i_len++] = 0x00;
+    p_pes[i_len++] = 0x01;
+    p_pes[i_len++] = b_video ? 0xe0 : 0xc0;
+    i_len += 2; /* PES_packet_length */
+    p_pes[i_len++] = 0x80;
+    p_pes[i_len++] = b_video ? 0xc0 : 0x80;
+    p_pes[i_len++] = b_video ? 10 : 5;
+    if (b_video)
+    {
+        i_len += gen_timestamp(&p_pes[i_len], 0x3, i_pts + 3600);
+        i_len += gen_timestamp(&p_pes[i_len], 0x1, i_pts);
+    }
+    else
+        i_len += gen_timestamp(&p_pes[i_len], 0x2, i_pts);
+
+    for (size_t i = 0; i < i_size; i++)
+        p_pes[i_len++] = gen_rand(gen);
+
+    /* Video PES are unbounded, as usual */
+    const size_t i_pes_length = b_video ? 0 : i_len - 6;
+    p_pes[4] = i_pes_length >> 8;
+    p_pes[5] = i_pes_length & 0xff;
+
+    size_t i_done = gen_packet(gen, i_pid, true, b_video ? i_pts * 300 : -1,
+                               p_pes, i_len);
+    while (i_done < i_len)
+        i_done += gen_packet(gen, i_pid, false, -1, &p_pes[i_done],
+                             i_len - i_done);
+    free(p_pes);
+
+    if (!gen->b_full)
+        gen->pi_pes[i_pid]++;
+}
+
+static uint8_t *GenerateStream(unsigned i_programs, size_t i_packets,
+                               unsigned *pi_pes)
+{
+    struct generator gen;
+
+    memset(&gen, 0, sizeof (gen));
+    gen.p_buf = malloc(i_packets * TS_PACKET_SIZE);
+    assert(gen.p_buf);
+    gen.i_max = i_packets;
+    gen.i_seed = 42;
+
+    /* 8ms steps: PSI every 96ms, video every 40ms, audio every 24ms */
+    for (unsigned i_step = 0; !gen.b_full; i_step++)
+    {
+        const int64_t i_ts = 90000 + i_step * 720;
+
+        if (i_step % 12 == 0)
+            gen_psi(&gen, i_programs);
+
+        for (unsigned i = 0; i < i_programs; i++)
+        {
+            const uint16_t i_video = 0x100 + 0x10 * i;
+            if (i_step % 5 == 0)
+                gen_pes(&gen, i_video, true, i_ts, 2000 + gen_rand(&gen) % 10000);
+            if (i_step % 3 == 0)
+                gen_pes(&gen, i_video + 1, false, i_ts, 300 + gen_rand(&gen) % 300);
+        }
+    }
+
+    memcpy(pi_pes, gen.pi_pes, sizeof (gen.pi_pes));
+    return gen.p_buf;
+}
+
+/*****************************************************************************
+ * Null elementary stream output
+ *****************************************************************************/
+struct es_out_sys_t
+{
+    unsigned i_ids;
+    es_out_id_t ids[MAX_PIDS];
+    struct
+    {
+        int      i_pid;
+        unsigned i_pes;
+        uint64_t i_bytes;
+        unsigned i_allocations;
+    } stats[MAX_PIDS];
+    unsigned i_stats;
+    unsigned i_last_allocations;
+};
+
+static es_out_id_t *EsOutAdd(es_out_t *out, const es_format_t *fmt)
+{
+    es_out_sys_t *sys = out->p_sys;
+
+    if (sys->i_ids >= MAX_PIDS)
+        return NULL;
+
+    es_out_id_t *id = &sys->ids[sys->i_ids++];
+    id->i_id = fmt->i_id;
+    return id;
+}
+
+static int EsOutSend(es_out_t *out, es_out_id_t *id, block_t *block)
+{
+    es_out_sys_t *sys = out->p_sys;
+    const unsigned i_allocations = GetAllocations();
+    unsigned i;
+
+    for (i = 0; i < sys->i_stats; i++)
+        if (sys->stats[i].i_pid == id->i_id)
+            break;
+    if (i == sys->i_stats && i < MAX_PIDS)
+    {
+        sys->stats[i].i_pid = id->i_id;
+        sys->i_stats++;
+    }
+
+    if (i < MAX_PIDS)
+    {
+        /* Charge the allocations since the previous PES to this one */
+        sys->stats[i].i_pes++;
+        sys->stats[i].i_allocations += i_allocations - sys->i_last_allocations;
+        for (block_t *p = block; p != NULL; p = p->p_next)
+            sys->stats[i].i_bytes += p->i_buffer;
+    }
+
+    block_ChainRelease(block);
+    sys->i_last_allocations = GetAllocations();
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * Benchmark
+ *****************************************************************************/
+struct result
+{
+    mtime_t  i_duration;
+    unsigned i_allocations;
+    unsigned i_pes;
+};
+
+static bool RunOnce(vlc_object_t *obj, uint8_t *p_buf, size_t i_size,
+                    es_out_sys_t *sys, struct result *res)
+{
+    es_out_t out;
+
+    memset(sys, 0, sizeof (*sys));
+    EsOutInit(&out, sys);
+
+    const unsigned i_allocations = GetAllocations();
+    sys->i_last_allocations = i_allocations;
+    const mtime_t i_start = mdate();
+
+    demux_t *demux = DemuxOpenMemory(obj, "ts", p_buf, i_size, &out);
+    if (demux == NULL)
+        return false;
+    while (demux_Demux(demux) == VLC_DEMUXER_SUCCESS);
+    demux_Delete(demux);
+
+    res->i_duration = mdate() - i_start;
+    res->i_allocations = GetAllocations() - i_allocations;
+    res->i_pes = 0;
+    for (unsigned i = 0; i < sys->i_stats; i++)
+        res->i_pes += sys->stats[i].i_pes;
+    return true;
+}
+
+static uint8_t *LoadFile(const char *psz_path, size_t *pi_size)
+{
+    FILE *f = fopen(psz_path, "rb");
+    struct stat st;
+
+    if (f == NULL || fstat(fileno(f), &st) || st.st_size <= 0)
+    {
+        if (f != NULL)
+            fclose(f);
+        return NULL;
+    }
+
+    uint8_t *p_buf = malloc(st.st_size);
+    if (p_buf != NULL
+     && fread(p_buf, 1, st.st_size, f) != (size_t)st.st_size)
+    {
+        free(p_buf);
+        p_buf = NULL;
+    }
+    fclose(f);
+    *pi_size = st.st_size;
+    return p_buf;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned i_programs = 4, i_iterations = 5;
+    size_t i_packets = 100000;
+    double f_max_ns = 0., f_max_allocs = 0.;
+    static unsigned pi_expected[8192];
+    int c;
+
+    test_init();
+
+    while ((c = getopt(argc, argv, "p:n:i:t:a:")) != -1)
+    {
+        switch (c)
+        {
+            case 'p': i_programs = atoi(optarg); break;
+            case 'n': i_packets = strtoul(optarg, NULL, 0); break;
+            case 'i': i_iterations = atoi(optarg); break;
+            case 't': f_max_ns = atof(optarg); break;
+            case 'a': f_max_allocs = atof(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-p programs] [-n packets] "
+                        "[-i iterations] [-t max ns/packet] "
+                        "[-a max allocations/PES] [file.ts]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (i_programs < 1 || i_programs > 16 || i_iterations < 1 || i_packets < 1)
+        return 1;
+
+    uint8_t *p_buf;
+    size_t i_size;
+    const bool b_synthetic = optind >= argc;
+
+    if (b_synthetic)
+    {
+        log("Generating %zu packets with %u programs\n", i_packets, i_programs);
+        p_buf = GenerateStream(i_programs, i_packets, pi_expected);
+        i_size = i_packets * TS_PACKET_SIZE;
+    }
+    else
+    {
+        alarm(0); /* recordings can be arbitrarily large */
+        p_buf = LoadFile(argv[optind], &i_size);
+        if (p_buf == NULL)
+        {
+            log("Cannot read %s\n", argv[optind]);
+            return 1;
+        }
+        i_packets = i_size / TS_PACKET_SIZE;
+    }
+
+    static const char *args[] = { "--ignore-config", "-q" };
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(args), args);
+    assert(vlc != NULL);
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    es_out_sys_t *sys = malloc(sizeof (*sys));
+    assert(sys != NULL);
+
+    /* The first run also loads the plugin: only keep the best time */
+    struct result best = { .i_duration = INT64_MAX };
+    for (unsigned i = 0; i < i_iterations; i++)
+    {
+        struct result res;
+
+        if (!RunOnce(obj, p_buf, i_size, sys, &res))
+        {
+            log("ts demux not available, skipping\n");
+            free(sys);
+            libvlc_release(vlc);
+            free(p_buf);
+            return 77;
+        }
+        log("run %u: %"PRId64" us, %u PES, %u allocations\n", i,
+            res.i_duration, res.i_pes, res.i_allocations);
+        if (res.i_duration < best.i_duration)
+            best = res;
+    }
+
+    const double f_ns = best.i_duration * 1000. / i_packets;
+    const double f_allocs = best.i_pes ? (double)best.i_allocations / best.i_pes
+                                       : 0.;
+
+    log("%zu packets, %.0f packets/s, %.1f ns/packet\n", i_packets,
+        i_packets * 1000000. / __MAX(best.i_duration, 1), f_ns);
+#ifdef HAVE_ALLOC_COUNT
+    log("%u PES, %.2f allocations/PES\n", best.i_pes, f_allocs);
+#else
+    log("%u PES (allocations are not counted on this platform)\n", best.i_pes);
+#endif
+
+    /* Per-PID breakdown of the last run */
+    for (unsigned i = 0; i < sys->i_stats; i++)
+    {
+        const unsigned i_pes = sys->stats[i].i_pes;
+        log("  PID 0x%04x: %6u PES, %10"PRIu64" bytes, %.2f allocations/PES\n",
+            sys->stats[i].i_pid, i_pes, sys->stats[i].i_bytes,
+            i_pes ? (double)sys->stats[i].i_allocations / i_pes : 0.);
+
+        if (b_synthetic)
+        {   /* The last unbounded PES of a PID might be left pending */
+            const unsigned i_expected = pi_expected[sys->stats[i].i_pid & 0x1fff];
+            assert(i_pes <= i_expected && i_pes + 1 >= i_expected);
+        }
+    }
+    if (b_synthetic)
+        assert(sys->i_stats == 2 * i_programs);
+
+    free(sys);
+    libvlc_release(vlc);
+    free(p_buf);
+
+    int i_ret = 0;
+    if (f_max_ns > 0. && f_ns > f_max_ns)
+    {
+        log("FAIL: %.1f ns/packet above threshold %.1f\n", f_ns, f_max_ns);
+        i_ret = 1;
+    }
+#ifdef HAVE_ALLOC_COUNT
+    if (f_max_allocs > 0. && f_allocs > f_max_allocs)
+    {
+        log("FAIL: %.2f allocations/PES above threshold %.2f\n",
+            f_allocs, f_max_allocs);
+        i_ret = 1;
+    }
+#endif
+    return i_ret;
+}
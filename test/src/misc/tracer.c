@@ -0,0 +1,99 @@
+/*****************************************************************************
+ * tracer.c: Test for the latency tracer
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vlc_tracer.h>
+
+static void trace(libvlc_int_t *libvlc)
+{
+    vlc_trace_span_t outer, inner;
+
+    vlc_trace_Begin(libvlc, &outer, "outer");
+    vlc_trace_Begin(libvlc, &inner, "inner");
+    vlc_trace_Mark(libvlc, "mark", NULL);
+    vlc_trace_End(&inner, "say \"hi\"\n");
+    vlc_trace_End(&outer, NULL);
+}
+
+static char *read_file(const char *path)
+{
+    FILE *stream = fopen(path, "rt");
+    assert(stream != NULL);
+
+    static char buf[1 << 16];
+    size_t len = fread(buf, 1, sizeof (buf) - 1, stream);
+
+    assert(len > 0 && len < sizeof (buf) - 1);
+    buf[len] = '\0';
+    fclose(stream);
+    return buf;
+}
+
+int main(void)
+{
+    char path[] = "/tmp/vlc-trace-XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd != -1);
+    close(fd);
+
+    test_init();
+
+    log("Testing without tracing\n");
+    libvlc_instance_t *vlc = libvlc_new(test_defaults_nargs,
+                                        test_defaults_args);
+    assert(vlc != NULL);
+    trace(vlc->p_libvlc_int);
+    libvlc_release(vlc);
+
+    log("Testing with tracing to %s\n", path);
+    char opt[sizeof ("--trace-file=") + sizeof (path)];
+    snprintf(opt, sizeof (opt), "--trace-file=%s", path);
+
+    const char *argv[] = { test_defaults_args[0], test_defaults_args[1], opt };
+    vlc = libvlc_new(ARRAY_SIZE(argv), argv);
+    assert(vlc != NULL);
+    trace(vlc->p_libvlc_int);
+    libvlc_release(vlc);
+
+    const char *json = read_file(path);
+    unlink(path);
+
+    assert(!strncmp(json, "{\"traceEvents\":[\n", 17));
+    assert(strstr(json, "\"name\":\"plugins load\"") != NULL);
+    assert(strstr(json, "\"name\":\"libvlc init\"") != NULL);
+    assert(strstr(json, "\"name\":\"mark\"") != NULL);
+
+    /* Spans are recorded when they end */
+    const char *inner = strstr(json, "\"name\":\"inner\"");
+    const char *outer = strstr(json, "\"name\":\"outer\"");
+    assert(inner != NULL && outer != NULL && inner < outer);
+    assert(strstr(inner, "\"args\":{\"detail\":\"say \\\"hi\\\"\\u000a\"}")
+           != NULL);
+
+    size_t len = strlen(json);
+    assert(len > 2 && !strcmp(json + len - 2, "}\n"));
+    return 0;
+}
@@ -22,6 +22,7 @@
  *****************************************************************************/
 
 #include <limits.h>
+#include <inttypes.h>
 
 #include "../../libvlc/test.h"
 #include "../lib/libvlc_internal.h"
@@ -443,6 +444,123 @@ static void test_creation_and_type( libvlc_int_t *p_libvlc )
     assert( var_Get( p_libvlc, "bla", &val ) == VLC_ENOVAR );
 }
 
+#define READERS 4
+#define READ_COUNT 200000
+
+struct concurrency
+{
+    libvlc_int_t *p_libvlc;
+    vlc_object_t *p_child;
+    mtime_t       duration;
+};
+
+static void *reader_thread( void *data )
+{
+    struct concurrency *c = data;
+    int64_t i_prev = 0;
+    mtime_t start = mdate();
+
+    for( unsigned i = 0; i < READ_COUNT; i++ )
+    {
+        /* The writer only ever increments the value */
+        int64_t i_val = var_GetInteger( c->p_libvlc, "bla" );
+        assert( i_val >= i_prev );
+        i_prev = i_val;
+
+        /* Inherited through the child, and looked up in both objects */
+        assert( var_InheritInteger( c->p_child, "bla" ) >= i_prev );
+    }
+    c->duration = mdate() - start;
+    return NULL;
+}
+
+static void test_concurrency( libvlc_int_t *p_libvlc )
+{
+    struct concurrency c[READERS];
+    vlc_thread_t th[READERS];
+    vlc_object_t *p_child = vlc_object_create( p_libvlc, sizeof (*p_child) );
+    char name[16];
+
+    assert( p_child != NULL );
+    var_Create( p_libvlc, "bla", VLC_VAR_INTEGER );
+
+    for( unsigned i = 0; i < READERS; i++ )
+    {
+        c[i].p_libvlc = p_libvlc;
+        c[i].p_child = p_child;
+        assert( vlc_clone( &th[i], reader_thread, &c[i],
+                           VLC_THREAD_PRIORITY_LOW ) == 0 );
+    }
+
+    /* Modify the value, and the variable tables under the readers' feet */
+    for( unsigned i = 0; i < 1000; i++ )
+    {
+        var_IncInteger( p_libvlc, "bla" );
+
+        snprintf( name, sizeof (name), "churn-%u", i % 100 );
+        var_Create( p_child, name, VLC_VAR_INTEGER );
+        var_SetInteger( p_child, name, i );
+        if( i % 3 == 0 )
+            var_Destroy( p_child, name );
+    }
+
+    mtime_t duration = 0;
+    for( unsigned i = 0; i < READERS; i++ )
+    {
+        vlc_join( th[i], NULL );
+        duration += c[i].duration;
+    }
+    assert( var_GetInteger( p_libvlc, "bla" ) == 1000 );
+
+    log( "%d threads: %"PRId64" ns per lookup\n", READERS,
+         duration * (1000000000 / CLOCK_FREQ) / (READERS * READ_COUNT * 3) );
+
+    vlc_object_release( p_child );
+    var_Destroy( p_libvlc, "bla" );
+}
+
+static void test_lookup_speed( libvlc_int_t *p_libvlc )
+{
+    static const char *const names[] = {
+        "rate", "time", "position", "intf-event", "fullscreen", "volume",
+    };
+    const unsigned count = ARRAY_SIZE(names);
+    char name[16];
+
+    /* Populate the object with plenty of other variables */
+    for( unsigned i = 0; i < 500; i++ )
+    {
+        snprintf( name, sizeof (name), "dummy-%u", i );
+        var_Create( p_libvlc, name, VLC_VAR_INTEGER );
+    }
+    for( unsigned i = 0; i < count; i++ )
+        var_Create( p_libvlc, names[i], VLC_VAR_FLOAT );
+
+    mtime_t start = mdate();
+    float sum = 0.f;
+    for( unsigned i = 0; i < READ_COUNT; i++ )
+        sum += var_GetFloat( p_libvlc, names[i % count] );
+    mtime_t get = mdate() - start;
+
+    start = mdate();
+    for( unsigned i = 0; i < READ_COUNT; i++ )
+        var_SetFloat( p_libvlc, names[i % count], i );
+    mtime_t set = mdate() - start;
+
+    assert( sum == 0.f );
+    log( "get: %"PRId64" ns, set: %"PRId64" ns\n",
+         get * (1000000000 / CLOCK_FREQ) / READ_COUNT,
+         set * (1000000000 / CLOCK_FREQ) / READ_COUNT );
+
+    for( unsigned i = 0; i < count; i++ )
+        var_Destroy( p_libvlc, names[i] );
+    for( unsigned i = 0; i < 500; i++ )
+    {
+        snprintf( name, sizeof (name), "dummy-%u", i );
+        var_Destroy( p_libvlc, name );
+    }
+}
+
 static void test_variables( libvlc_instance_t *p_vlc )
 {
     libvlc_int_t *p_libvlc = p_vlc->p_libvlc_int;
@@ -480,6 +598,12 @@ static void test_variables( libvlc_instance_t *p_vlc )
 
     log( "Testing type at creation\n" );
     test_creation_and_type( p_libvlc );
+
+    log( "Testing concurrent accesses\n" );
+    test_concurrency( p_libvlc );
+
+    log( "Benchmarking lookups\n" );
+    test_lookup_speed( p_libvlc );
 }
 
 
@@ -0,0 +1,160 @@
+/*****************************************************************************
+ * httpd.c: HTTP server worker threads test
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* The host is started with several worker threads, and a URL is registered
+ * once all of them wait for one. Clients are then connected one at a time
+ * and kept alive, so that each new client is handed to an idle worker: every
+ * worker must serve its client. */
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_httpd.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define WORKERS 4 /* as in --http-threads */
+
+static const char body[] = "hello";
+
+static int Fill(httpd_file_sys_t *sys, httpd_file_t *file,
+                uint8_t *psz_request, uint8_t **pp_data, int *pi_data)
+{
+    (void) sys; (void) file; (void) psz_request;
+
+    *pp_data = malloc(sizeof (body) - 1);
+    assert(*pp_data != NULL);
+    memcpy(*pp_data, body, sizeof (body) - 1);
+    *pi_data = sizeof (body) - 1;
+    return VLC_SUCCESS;
+}
+
+static int Connect(unsigned port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    assert(fd != -1);
+
+    /* A client left to a stalled worker would otherwise block forever */
+    struct timeval tv = { .tv_sec = 5 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv));
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    if (connect(fd, (struct sockaddr *)&addr, sizeof (addr)))
+    {
+        perror("connect");
+        abort();
+    }
+    return fd;
+}
+
+/* Sends a request on a kept-alive connection, and reads the whole answer */
+static bool Request(int fd)
+{
+    static const char req[] = "GET /test HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    char buf[4096];
+    size_t len = 0;
+
+    assert(send(fd, req, sizeof (req) - 1, 0) == sizeof (req) - 1);
+
+    while (len < sizeof (buf) - 1)
+    {
+        ssize_t val = recv(fd, buf + len, sizeof (buf) - 1 - len, 0);
+        if (val <= 0)
+            return false;
+        len += val;
+        buf[len] = '\0';
+
+        const char *end = strstr(buf, "\r\n\r\n");
+        if (end != NULL && strlen(end + 4) >= sizeof (body) - 1)
+            return !strncmp(buf, "HTTP/1.1 200", 12)
+                && !strcmp(end + 4, body);
+    }
+    return false;
+}
+
+int main(void)
+{
+    test_init();
+
+    static const char *args[] = {
+        "--ignore-config", "-q", "--http-host=127.0.0.1",
+        "--http-threads=4" };
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(args), args);
+    assert(vlc != NULL);
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    var_Create(obj, "http-port", VLC_VAR_INTEGER);
+
+    httpd_host_t *host = NULL;
+    unsigned port = 20000 + getpid() % 20000;
+    for (unsigned i = 0; i < 16; i++, port++)
+    {
+        var_SetInteger(obj, "http-port", port);
+        host = vlc_http_HostNew(obj);
+        if (host != NULL)
+            break;
+    }
+    if (host == NULL)
+    {
+        log("cannot start the HTTP host, skipping\n");
+        libvlc_release(vlc);
+        return 77;
+    }
+    log("HTTP host on port %u\n", port);
+
+    /* Let every worker block until a URL is registered */
+    mwait(mdate() + CLOCK_FREQ / 10);
+
+    httpd_file_t *file = httpd_FileNew(host, "/test", "text/plain", NULL,
+                                       NULL, Fill, NULL);
+    assert(file != NULL);
+
+    int fds[WORKERS];
+    for (unsigned i = 0; i < WORKERS; i++)
+    {
+        fds[i] = Connect(port);
+        bool ok = Request(fds[i]);
+        log("client %u: %s\n", i, ok ? "served" : "not served");
+        assert(ok);
+    }
+
+    /* Each worker serves its client again */
+    for (unsigned i = 0; i < WORKERS; i++)
+        assert(Request(fds[i]));
+
+    for (unsigned i = 0; i < WORKERS; i++)
+        close(fds[i]);
+
+    httpd_FileDelete(file);
+    httpd_HostDelete(host);
+    libvlc_release(vlc);
+    return 0;
+}